@@ -0,0 +1,1793 @@
+/* A Bison parser, made by GNU Bison 3.8.2.  */
+
+/* Bison implementation for Yacc-like parsers in C
+
+   Copyright (C) 1984, 1989-1990, 2000-2015, 2018-2021 Free Software Foundation,
+   Inc.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.  */
+
+/* As a special exception, you may create a larger work that contains
+   part or all of the Bison parser skeleton and distribute that work
+   under terms of your choice, so long as that work isn't itself a
+   parser generator using the skeleton or a modified version thereof
+   as a parser skeleton.  Alternatively, if you modify or redistribute
+   the parser skeleton itself, you may (at your option) remove this
+   special exception, which will cause the skeleton and the resulting
+   Bison output files to be licensed under the GNU General Public
+   License without this special exception.
+
+   This special exception was added by the Free Software Foundation in
+   version 2.2 of Bison.  */
+
+/* C LALR(1) parser skeleton written by Richard Stallman, by
+   simplifying the original so-called "semantic" parser.  */
+
+/* DO NOT RELY ON FEATURES THAT ARE NOT DOCUMENTED in the manual,
+   especially those whose name start with YY_ or yy_.  They are
+   private implementation details that can be changed or removed.  */
+
+/* All symbols defined below should begin with yy or YY, to avoid
+   infringing on user name space.  This should be done even for local
+   variables, as they might otherwise be expanded by user macros.
+   There are some unavoidable exceptions within include files to
+   define necessary library symbols; they are noted "INFRINGES ON
+   USER NAME SPACE" below.  */
+
+/* Identify Bison output, and Bison version.  */
+#define YYBISON 30802
+
+/* Bison version string.  */
+#define YYBISON_VERSION "3.8.2"
+
+/* Skeleton name.  */
+#define YYSKELETON_NAME "yacc.c"
+
+/* Pure parsers.  */
+#define YYPURE 0
+
+/* Push parsers.  */
+#define YYPUSH 0
+
+/* Pull parsers.  */
+#define YYPULL 1
+
+
+
+
+/* First part of user prologue.  */
+#line 1 "src/grammar.y"
+
+#include <stdio.h> // fopen
+#include <string.h> // strcmp
+#include <stdlib.h>
+#include "ast.h"
+
+extern int yylex(); // defined by the flex lexer.
+
+#define YYERROR_VERBOSE
+
+#define ast_arena (parse_param->slpp_arena)
+
+
+#line 85 "build/debug/src//grammar.tab.c"
+
+# ifndef YY_CAST
+#  ifdef __cplusplus
+#   define YY_CAST(Type, Val) static_cast<Type> (Val)
+#   define YY_REINTERPRET_CAST(Type, Val) reinterpret_cast<Type> (Val)
+#  else
+#   define YY_CAST(Type, Val) ((Type) (Val))
+#   define YY_REINTERPRET_CAST(Type, Val) ((Type) (Val))
+#  endif
+# endif
+# ifndef YY_NULLPTR
+#  if defined __cplusplus
+#   if 201103L <= __cplusplus
+#    define YY_NULLPTR nullptr
+#   else
+#    define YY_NULLPTR 0
+#   endif
+#  else
+#   define YY_NULLPTR ((void*)0)
+#  endif
+# endif
+
+#include "grammar.tab.h"
+/* Symbol kind.  */
+enum yysymbol_kind_t
+{
+  YYSYMBOL_YYEMPTY = -2,
+  YYSYMBOL_YYEOF = 0,                      /* "end of file"  */
+  YYSYMBOL_YYerror = 1,                    /* error  */
+  YYSYMBOL_YYUNDEF = 2,                    /* "invalid token"  */
+  YYSYMBOL_SL_TOK_STRUCT = 3,              /* SL_TOK_STRUCT  */
+  YYSYMBOL_SL_TOK_FN = 4,                  /* SL_TOK_FN  */
+  YYSYMBOL_SL_TOK_LET = 5,                 /* SL_TOK_LET  */
+  YYSYMBOL_SL_TOK_NEW = 6,                 /* SL_TOK_NEW  */
+  YYSYMBOL_SL_TOK_RETURN = 7,              /* SL_TOK_RETURN  */
+  YYSYMBOL_SL_TOK_BREAK = 8,               /* SL_TOK_BREAK  */
+  YYSYMBOL_SL_TOK_LOOP = 9,                /* SL_TOK_LOOP  */
+  YYSYMBOL_SL_TOK_IF = 10,                 /* SL_TOK_IF  */
+  YYSYMBOL_SL_TOK_ELSE = 11,               /* SL_TOK_ELSE  */
+  YYSYMBOL_12_ = 12,                       /* '+'  */
+  YYSYMBOL_13_ = 13,                       /* '-'  */
+  YYSYMBOL_14_ = 14,                       /* '*'  */
+  YYSYMBOL_15_ = 15,                       /* '/'  */
+  YYSYMBOL_16_ = 16,                       /* '<'  */
+  YYSYMBOL_17_ = 17,                       /* '>'  */
+  YYSYMBOL_18_ = 18,                       /* '|'  */
+  YYSYMBOL_19_ = 19,                       /* '&'  */
+  YYSYMBOL_20_ = 20,                       /* '^'  */
+  YYSYMBOL_SL_TOK_LOR = 21,                /* SL_TOK_LOR  */
+  YYSYMBOL_SL_TOK_LAND = 22,               /* SL_TOK_LAND  */
+  YYSYMBOL_SL_TOK_EQ = 23,                 /* SL_TOK_EQ  */
+  YYSYMBOL_SL_TOK_NEQ = 24,                /* SL_TOK_NEQ  */
+  YYSYMBOL_SL_TOK_LE = 25,                 /* SL_TOK_LE  */
+  YYSYMBOL_SL_TOK_GE = 26,                 /* SL_TOK_GE  */
+  YYSYMBOL_SL_TOK_LSH = 27,                /* SL_TOK_LSH  */
+  YYSYMBOL_SL_TOK_RSH = 28,                /* SL_TOK_RSH  */
+  YYSYMBOL_SL_TOK_SARROW = 29,             /* SL_TOK_SARROW  */
+  YYSYMBOL_SL_TOK_TRUE = 30,               /* SL_TOK_TRUE  */
+  YYSYMBOL_SL_TOK_FALSE = 31,              /* SL_TOK_FALSE  */
+  YYSYMBOL_SL_TOK_INT = 32,                /* SL_TOK_INT  */
+  YYSYMBOL_SL_TOK_IDENT = 33,              /* SL_TOK_IDENT  */
+  YYSYMBOL_SL_TOK_ERROR = 34,              /* SL_TOK_ERROR  */
+  YYSYMBOL_35_ = 35,                       /* ','  */
+  YYSYMBOL_36_ = 36,                       /* '='  */
+  YYSYMBOL_37_ = 37,                       /* ':'  */
+  YYSYMBOL_38_ = 38,                       /* '%'  */
+  YYSYMBOL_SL_TOK_DEREF = 39,              /* SL_TOK_DEREF  */
+  YYSYMBOL_SL_TOK_ADDROF = 40,             /* SL_TOK_ADDROF  */
+  YYSYMBOL_41_ = 41,                       /* '('  */
+  YYSYMBOL_42_ = 42,                       /* ')'  */
+  YYSYMBOL_SL_TOK_PTR = 43,                /* SL_TOK_PTR  */
+  YYSYMBOL_44_ = 44,                       /* '.'  */
+  YYSYMBOL_45_ = 45,                       /* '{'  */
+  YYSYMBOL_46_ = 46,                       /* '}'  */
+  YYSYMBOL_47_ = 47,                       /* ';'  */
+  YYSYMBOL_YYACCEPT = 48,                  /* $accept  */
+  YYSYMBOL_program = 49,                   /* program  */
+  YYSYMBOL_declaration_list = 50,          /* declaration_list  */
+  YYSYMBOL_declaration = 51,               /* declaration  */
+  YYSYMBOL_struct_decl = 52,               /* struct_decl  */
+  YYSYMBOL_param_list_opt = 53,            /* param_list_opt  */
+  YYSYMBOL_param_list_comma = 54,          /* param_list_comma  */
+  YYSYMBOL_param_list = 55,                /* param_list  */
+  YYSYMBOL_param = 56,                     /* param  */
+  YYSYMBOL_type_expr = 57,                 /* type_expr  */
+  YYSYMBOL_func_decl = 58,                 /* func_decl  */
+  YYSYMBOL_stmt_list = 59,                 /* stmt_list  */
+  YYSYMBOL_expr = 60,                      /* expr  */
+  YYSYMBOL_conditional_expr = 61,          /* conditional_expr  */
+  YYSYMBOL_if_expr = 62,                   /* if_expr  */
+  YYSYMBOL_lor_expr = 63,                  /* lor_expr  */
+  YYSYMBOL_land_expr = 64,                 /* land_expr  */
+  YYSYMBOL_bor_expr = 65,                  /* bor_expr  */
+  YYSYMBOL_xor_expr = 66,                  /* xor_expr  */
+  YYSYMBOL_band_expr = 67,                 /* band_expr  */
+  YYSYMBOL_eq_expr = 68,                   /* eq_expr  */
+  YYSYMBOL_cmp_expr = 69,                  /* cmp_expr  */
+  YYSYMBOL_shift_expr = 70,                /* shift_expr  */
+  YYSYMBOL_add_expr = 71,                  /* add_expr  */
+  YYSYMBOL_mul_expr = 72,                  /* mul_expr  */
+  YYSYMBOL_deref_expr = 73,                /* deref_expr  */
+  YYSYMBOL_member_expr = 74,               /* member_expr  */
+  YYSYMBOL_primary_expr = 75,              /* primary_expr  */
+  YYSYMBOL_expr_list_opt = 76,             /* expr_list_opt  */
+  YYSYMBOL_expr_list = 77                  /* expr_list  */
+};
+typedef enum yysymbol_kind_t yysymbol_kind_t;
+
+
+
+
+#ifdef short
+# undef short
+#endif
+
+/* On compilers that do not define __PTRDIFF_MAX__ etc., make sure
+   <limits.h> and (if available) <stdint.h> are included
+   so that the code can choose integer types of a good width.  */
+
+#ifndef __PTRDIFF_MAX__
+# include <limits.h> /* INFRINGES ON USER NAME SPACE */
+# if defined __STDC_VERSION__ && 199901 <= __STDC_VERSION__
+#  include <stdint.h> /* INFRINGES ON USER NAME SPACE */
+#  define YY_STDINT_H
+# endif
+#endif
+
+/* Narrow types that promote to a signed type and that can represent a
+   signed or unsigned integer of at least N bits.  In tables they can
+   save space and decrease cache pressure.  Promoting to a signed type
+   helps avoid bugs in integer arithmetic.  */
+
+#ifdef __INT_LEAST8_MAX__
+typedef __INT_LEAST8_TYPE__ yytype_int8;
+#elif defined YY_STDINT_H
+typedef int_least8_t yytype_int8;
+#else
+typedef signed char yytype_int8;
+#endif
+
+#ifdef __INT_LEAST16_MAX__
+typedef __INT_LEAST16_TYPE__ yytype_int16;
+#elif defined YY_STDINT_H
+typedef int_least16_t yytype_int16;
+#else
+typedef short yytype_int16;
+#endif
+
+/* Work around bug in HP-UX 11.23, which defines these macros
+   incorrectly for preprocessor constants.  This workaround can likely
+   be removed in 2023, as HPE has promised support for HP-UX 11.23
+   (aka HP-UX 11i v2) only through the end of 2022; see Table 2 of
+   <https://h20195.www2.hpe.com/V2/getpdf.aspx/4AA4-7673ENW.pdf>.  */
+#ifdef __hpux
+# undef UINT_LEAST8_MAX
+# undef UINT_LEAST16_MAX
+# define UINT_LEAST8_MAX 255
+# define UINT_LEAST16_MAX 65535
+#endif
+
+#if defined __UINT_LEAST8_MAX__ && __UINT_LEAST8_MAX__ <= __INT_MAX__
+typedef __UINT_LEAST8_TYPE__ yytype_uint8;
+#elif (!defined __UINT_LEAST8_MAX__ && defined YY_STDINT_H \
+       && UINT_LEAST8_MAX <= INT_MAX)
+typedef uint_least8_t yytype_uint8;
+#elif !defined __UINT_LEAST8_MAX__ && UCHAR_MAX <= INT_MAX
+typedef unsigned char yytype_uint8;
+#else
+typedef short yytype_uint8;
+#endif
+
+#if defined __UINT_LEAST16_MAX__ && __UINT_LEAST16_MAX__ <= __INT_MAX__
+typedef __UINT_LEAST16_TYPE__ yytype_uint16;
+#elif (!defined __UINT_LEAST16_MAX__ && defined YY_STDINT_H \
+       && UINT_LEAST16_MAX <= INT_MAX)
+typedef uint_least16_t yytype_uint16;
+#elif !defined __UINT_LEAST16_MAX__ && USHRT_MAX <= INT_MAX
+typedef unsigned short yytype_uint16;
+#else
+typedef int yytype_uint16;
+#endif
+
+#ifndef YYPTRDIFF_T
+# if defined __PTRDIFF_TYPE__ && defined __PTRDIFF_MAX__
+#  define YYPTRDIFF_T __PTRDIFF_TYPE__
+#  define YYPTRDIFF_MAXIMUM __PTRDIFF_MAX__
+# elif defined PTRDIFF_MAX
+#  ifndef ptrdiff_t
+#   include <stddef.h> /* INFRINGES ON USER NAME SPACE */
+#  endif
+#  define YYPTRDIFF_T ptrdiff_t
+#  define YYPTRDIFF_MAXIMUM PTRDIFF_MAX
+# else
+#  define YYPTRDIFF_T long
+#  define YYPTRDIFF_MAXIMUM LONG_MAX
+# endif
+#endif
+
+#ifndef YYSIZE_T
+# ifdef __SIZE_TYPE__
+#  define YYSIZE_T __SIZE_TYPE__
+# elif defined size_t
+#  define YYSIZE_T size_t
+# elif defined __STDC_VERSION__ && 199901 <= __STDC_VERSION__
+#  include <stddef.h> /* INFRINGES ON USER NAME SPACE */
+#  define YYSIZE_T size_t
+# else
+#  define YYSIZE_T unsigned
+# endif
+#endif
+
+#define YYSIZE_MAXIMUM                                  \
+  YY_CAST (YYPTRDIFF_T,                                 \
+           (YYPTRDIFF_MAXIMUM < YY_CAST (YYSIZE_T, -1)  \
+            ? YYPTRDIFF_MAXIMUM                         \
+            : YY_CAST (YYSIZE_T, -1)))
+
+#define YYSIZEOF(X) YY_CAST (YYPTRDIFF_T, sizeof (X))
+
+
+/* Stored state numbers (used for stacks). */
+typedef yytype_uint8 yy_state_t;
+
+/* State numbers in computations.  */
+typedef int yy_state_fast_t;
+
+#ifndef YY_
+# if defined YYENABLE_NLS && YYENABLE_NLS
+#  if ENABLE_NLS
+#   include <libintl.h> /* INFRINGES ON USER NAME SPACE */
+#   define YY_(Msgid) dgettext ("bison-runtime", Msgid)
+#  endif
+# endif
+# ifndef YY_
+#  define YY_(Msgid) Msgid
+# endif
+#endif
+
+
+#ifndef YY_ATTRIBUTE_PURE
+# if defined __GNUC__ && 2 < __GNUC__ + (96 <= __GNUC_MINOR__)
+#  define YY_ATTRIBUTE_PURE __attribute__ ((__pure__))
+# else
+#  define YY_ATTRIBUTE_PURE
+# endif
+#endif
+
+#ifndef YY_ATTRIBUTE_UNUSED
+# if defined __GNUC__ && 2 < __GNUC__ + (7 <= __GNUC_MINOR__)
+#  define YY_ATTRIBUTE_UNUSED __attribute__ ((__unused__))
+# else
+#  define YY_ATTRIBUTE_UNUSED
+# endif
+#endif
+
+/* Suppress unused-variable warnings by "using" E.  */
+#if ! defined lint || defined __GNUC__
+# define YY_USE(E) ((void) (E))
+#else
+# define YY_USE(E) /* empty */
+#endif
+
+/* Suppress an incorrect diagnostic about yylval being uninitialized.  */
+#if defined __GNUC__ && ! defined __ICC && 406 <= __GNUC__ * 100 + __GNUC_MINOR__
+# if __GNUC__ * 100 + __GNUC_MINOR__ < 407
+#  define YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN                           \
+    _Pragma ("GCC diagnostic push")                                     \
+    _Pragma ("GCC diagnostic ignored \"-Wuninitialized\"")
+# else
+#  define YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN                           \
+    _Pragma ("GCC diagnostic push")                                     \
+    _Pragma ("GCC diagnostic ignored \"-Wuninitialized\"")              \
+    _Pragma ("GCC diagnostic ignored \"-Wmaybe-uninitialized\"")
+# endif
+# define YY_IGNORE_MAYBE_UNINITIALIZED_END      \
+    _Pragma ("GCC diagnostic pop")
+#else
+# define YY_INITIAL_VALUE(Value) Value
+#endif
+#ifndef YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
+# define YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
+# define YY_IGNORE_MAYBE_UNINITIALIZED_END
+#endif
+#ifndef YY_INITIAL_VALUE
+# define YY_INITIAL_VALUE(Value) /* Nothing. */
+#endif
+
+#if defined __cplusplus && defined __GNUC__ && ! defined __ICC && 6 <= __GNUC__
+# define YY_IGNORE_USELESS_CAST_BEGIN                          \
+    _Pragma ("GCC diagnostic push")                            \
+    _Pragma ("GCC diagnostic ignored \"-Wuseless-cast\"")
+# define YY_IGNORE_USELESS_CAST_END            \
+    _Pragma ("GCC diagnostic pop")
+#endif
+#ifndef YY_IGNORE_USELESS_CAST_BEGIN
+# define YY_IGNORE_USELESS_CAST_BEGIN
+# define YY_IGNORE_USELESS_CAST_END
+#endif
+
+
+#define YY_ASSERT(E) ((void) (0 && (E)))
+
+#if !defined yyoverflow
+
+/* The parser invokes alloca or malloc; define the necessary symbols.  */
+
+# ifdef YYSTACK_USE_ALLOCA
+#  if YYSTACK_USE_ALLOCA
+#   ifdef __GNUC__
+#    define YYSTACK_ALLOC __builtin_alloca
+#   elif defined __BUILTIN_VA_ARG_INCR
+#    include <alloca.h> /* INFRINGES ON USER NAME SPACE */
+#   elif defined _AIX
+#    define YYSTACK_ALLOC __alloca
+#   elif defined _MSC_VER
+#    include <malloc.h> /* INFRINGES ON USER NAME SPACE */
+#    define alloca _alloca
+#   else
+#    define YYSTACK_ALLOC alloca
+#    if ! defined _ALLOCA_H && ! defined EXIT_SUCCESS
+#     include <stdlib.h> /* INFRINGES ON USER NAME SPACE */
+      /* Use EXIT_SUCCESS as a witness for stdlib.h.  */
+#     ifndef EXIT_SUCCESS
+#      define EXIT_SUCCESS 0
+#     endif
+#    endif
+#   endif
+#  endif
+# endif
+
+# ifdef YYSTACK_ALLOC
+   /* Pacify GCC's 'empty if-body' warning.  */
+#  define YYSTACK_FREE(Ptr) do { /* empty */; } while (0)
+#  ifndef YYSTACK_ALLOC_MAXIMUM
+    /* The OS might guarantee only one guard page at the bottom of the stack,
+       and a page size can be as small as 4096 bytes.  So we cannot safely
+       invoke alloca (N) if N exceeds 4096.  Use a slightly smaller number
+       to allow for a few compiler-allocated temporary stack slots.  */
+#   define YYSTACK_ALLOC_MAXIMUM 4032 /* reasonable circa 2006 */
+#  endif
+# else
+#  define YYSTACK_ALLOC YYMALLOC
+#  define YYSTACK_FREE YYFREE
+#  ifndef YYSTACK_ALLOC_MAXIMUM
+#   define YYSTACK_ALLOC_MAXIMUM YYSIZE_MAXIMUM
+#  endif
+#  if (defined __cplusplus && ! defined EXIT_SUCCESS \
+       && ! ((defined YYMALLOC || defined malloc) \
+             && (defined YYFREE || defined free)))
+#   include <stdlib.h> /* INFRINGES ON USER NAME SPACE */
+#   ifndef EXIT_SUCCESS
+#    define EXIT_SUCCESS 0
+#   endif
+#  endif
+#  ifndef YYMALLOC
+#   define YYMALLOC malloc
+#   if ! defined malloc && ! defined EXIT_SUCCESS
+void *malloc (YYSIZE_T); /* INFRINGES ON USER NAME SPACE */
+#   endif
+#  endif
+#  ifndef YYFREE
+#   define YYFREE free
+#   if ! defined free && ! defined EXIT_SUCCESS
+void free (void *); /* INFRINGES ON USER NAME SPACE */
+#   endif
+#  endif
+# endif
+#endif /* !defined yyoverflow */
+
+#if (! defined yyoverflow \
+     && (! defined __cplusplus \
+         || (defined YYSTYPE_IS_TRIVIAL && YYSTYPE_IS_TRIVIAL)))
+
+/* A type that is properly aligned for any stack member.  */
+union yyalloc
+{
+  yy_state_t yyss_alloc;
+  YYSTYPE yyvs_alloc;
+};
+
+/* The size of the maximum gap between one aligned stack and the next.  */
+# define YYSTACK_GAP_MAXIMUM (YYSIZEOF (union yyalloc) - 1)
+
+/* The size of an array large to enough to hold all stacks, each with
+   N elements.  */
+# define YYSTACK_BYTES(N) \
+     ((N) * (YYSIZEOF (yy_state_t) + YYSIZEOF (YYSTYPE)) \
+      + YYSTACK_GAP_MAXIMUM)
+
+# define YYCOPY_NEEDED 1
+
+/* Relocate STACK from its old location to the new one.  The
+   local variables YYSIZE and YYSTACKSIZE give the old and new number of
+   elements in the stack, and YYPTR gives the new location of the
+   stack.  Advance YYPTR to a properly aligned location for the next
+   stack.  */
+# define YYSTACK_RELOCATE(Stack_alloc, Stack)                           \
+    do                                                                  \
+      {                                                                 \
+        YYPTRDIFF_T yynewbytes;                                         \
+        YYCOPY (&yyptr->Stack_alloc, Stack, yysize);                    \
+        Stack = &yyptr->Stack_alloc;                                    \
+        yynewbytes = yystacksize * YYSIZEOF (*Stack) + YYSTACK_GAP_MAXIMUM; \
+        yyptr += yynewbytes / YYSIZEOF (*yyptr);                        \
+      }                                                                 \
+    while (0)
+
+#endif
+
+#if defined YYCOPY_NEEDED && YYCOPY_NEEDED
+/* Copy COUNT objects from SRC to DST.  The source and destination do
+   not overlap.  */
+# ifndef YYCOPY
+#  if defined __GNUC__ && 1 < __GNUC__
+#   define YYCOPY(Dst, Src, Count) \
+      __builtin_memcpy (Dst, Src, YY_CAST (YYSIZE_T, (Count)) * sizeof (*(Src)))
+#  else
+#   define YYCOPY(Dst, Src, Count)              \
+      do                                        \
+        {                                       \
+          YYPTRDIFF_T yyi;                      \
+          for (yyi = 0; yyi < (Count); yyi++)   \
+            (Dst)[yyi] = (Src)[yyi];            \
+        }                                       \
+      while (0)
+#  endif
+# endif
+#endif /* !YYCOPY_NEEDED */
+
+/* YYFINAL -- State number of the termination state.  */
+#define YYFINAL  10
+/* YYLAST -- Last index in YYTABLE.  */
+#define YYLAST   125
+
+/* YYNTOKENS -- Number of terminals.  */
+#define YYNTOKENS  48
+/* YYNNTS -- Number of nonterminals.  */
+#define YYNNTS  30
+/* YYNRULES -- Number of rules.  */
+#define YYNRULES  75
+/* YYNSTATES -- Number of states.  */
+#define YYNSTATES  136
+
+/* YYMAXUTOK -- Last valid token kind.  */
+#define YYMAXUTOK   283
+
+
+/* YYTRANSLATE(TOKEN-NUM) -- Symbol number corresponding to TOKEN-NUM
+   as returned by yylex, with out-of-bounds checking.  */
+#define YYTRANSLATE(YYX)                                \
+  (0 <= (YYX) && (YYX) <= YYMAXUTOK                     \
+   ? YY_CAST (yysymbol_kind_t, yytranslate[YYX])        \
+   : YYSYMBOL_YYUNDEF)
+
+/* YYTRANSLATE[TOKEN-NUM] -- Symbol number corresponding to TOKEN-NUM
+   as returned by yylex.  */
+static const yytype_int8 yytranslate[] =
+{
+       0,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,    38,    19,     2,
+      41,    42,    14,    12,    35,    13,    44,    15,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,    37,    47,
+      16,    36,    17,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,    20,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,    45,    18,    46,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     1,     2,     3,     4,
+       5,     6,     7,     8,     9,    10,    11,    21,    22,    23,
+      24,    25,    26,    27,    28,    29,    30,    31,    32,    33,
+      34,    39,    40,    43
+};
+
+#if YYDEBUG
+/* YYRLINE[YYN] -- Source line where rule number YYN was defined.  */
+static const yytype_int16 yyrline[] =
+{
+       0,    99,    99,   103,   104,   108,   109,   113,   120,   121,
+     125,   126,   130,   131,   135,   139,   140,   144,   152,   153,
+     154,   158,   159,   163,   164,   165,   166,   170,   171,   176,
+     178,   180,   185,   186,   190,   191,   195,   196,   200,   201,
+     205,   206,   210,   211,   212,   216,   217,   218,   219,   220,
+     224,   225,   226,   230,   231,   232,   236,   237,   238,   242,
+     243,   244,   248,   249,   252,   253,   255,   260,   261,   262,
+     263,   264,   268,   269,   273,   274
+};
+#endif
+
+/** Accessing symbol of state STATE.  */
+#define YY_ACCESSING_SYMBOL(State) YY_CAST (yysymbol_kind_t, yystos[State])
+
+#if YYDEBUG || 0
+/* The user-facing name of the symbol whose (internal) number is
+   YYSYMBOL.  No bounds checking.  */
+static const char *yysymbol_name (yysymbol_kind_t yysymbol) YY_ATTRIBUTE_UNUSED;
+
+/* YYTNAME[SYMBOL-NUM] -- String name of the symbol SYMBOL-NUM.
+   First, the terminals, then, starting at YYNTOKENS, nonterminals.  */
+static const char *const yytname[] =
+{
+  "\"end of file\"", "error", "\"invalid token\"", "SL_TOK_STRUCT",
+  "SL_TOK_FN", "SL_TOK_LET", "SL_TOK_NEW", "SL_TOK_RETURN", "SL_TOK_BREAK",
+  "SL_TOK_LOOP", "SL_TOK_IF", "SL_TOK_ELSE", "'+'", "'-'", "'*'", "'/'",
+  "'<'", "'>'", "'|'", "'&'", "'^'", "SL_TOK_LOR", "SL_TOK_LAND",
+  "SL_TOK_EQ", "SL_TOK_NEQ", "SL_TOK_LE", "SL_TOK_GE", "SL_TOK_LSH",
+  "SL_TOK_RSH", "SL_TOK_SARROW", "SL_TOK_TRUE", "SL_TOK_FALSE",
+  "SL_TOK_INT", "SL_TOK_IDENT", "SL_TOK_ERROR", "','", "'='", "':'", "'%'",
+  "SL_TOK_DEREF", "SL_TOK_ADDROF", "'('", "')'", "SL_TOK_PTR", "'.'",
+  "'{'", "'}'", "';'", "$accept", "program", "declaration_list",
+  "declaration", "struct_decl", "param_list_opt", "param_list_comma",
+  "param_list", "param", "type_expr", "func_decl", "stmt_list", "expr",
+  "conditional_expr", "if_expr", "lor_expr", "land_expr", "bor_expr",
+  "xor_expr", "band_expr", "eq_expr", "cmp_expr", "shift_expr", "add_expr",
+  "mul_expr", "deref_expr", "member_expr", "primary_expr", "expr_list_opt",
+  "expr_list", YY_NULLPTR
+};
+
+static const char *
+yysymbol_name (yysymbol_kind_t yysymbol)
+{
+  return yytname[yysymbol];
+}
+#endif
+
+#define YYPACT_NINF (-37)
+
+#define yypact_value_is_default(Yyn) \
+  ((Yyn) == YYPACT_NINF)
+
+#define YYTABLE_NINF (-1)
+
+#define yytable_value_is_error(Yyn) \
+  0
+
+/* YYPACT[STATE-NUM] -- Index in YYTABLE of the portion describing
+   STATE-NUM.  */
+static const yytype_int8 yypact[] =
+{
+      28,   -29,   -13,    25,    28,   -37,   -37,   -37,   -18,    -8,
+     -37,   -37,    16,    16,     7,     5,    27,   -37,    18,   -37,
+      -7,   -37,    16,    45,    -7,   -37,   -37,   -37,    -7,   -37,
+      39,     9,    54,    55,     9,   -37,    44,    15,    15,    15,
+     -37,   -37,   -37,    42,     9,    11,   -37,   -37,   -37,    69,
+      71,    76,    75,    77,   -11,   -37,    38,    24,    53,   -37,
+     -20,   -37,    60,    56,   -37,     9,   -15,   -37,   -37,     9,
+      57,   -37,     9,    15,    15,    15,    15,    15,    15,    15,
+      15,    15,    15,    15,    15,    15,    15,    15,    15,    15,
+      67,    70,    -7,     9,    29,     9,   -37,    62,    72,   -37,
+     -37,    71,    76,    75,    77,   -11,   -37,   -37,    50,    50,
+      50,    50,    24,    24,    53,    53,   -37,   -37,   -37,   -37,
+      66,   -24,   -37,    59,   -37,     9,     9,   -37,    95,   -37,
+     -37,    -2,     9,   -37,    63,   -37
+};
+
+/* YYDEFACT[STATE-NUM] -- Default reduction number in state STATE-NUM.
+   Performed when YYTABLE does not specify something else to do.  Zero
+   means the default is an error.  */
+static const yytype_int8 yydefact[] =
+{
+       0,     0,     0,     0,     2,     3,     5,     6,     0,     0,
+       1,     4,     0,     8,     0,     0,    10,    12,     0,     9,
+       0,     7,    11,     0,     0,    15,    14,    13,     0,    16,
+       0,     0,     0,     0,    23,    25,     0,     0,     0,     0,
+      69,    70,    68,    71,     0,     0,    18,    21,    27,    28,
+      32,    34,    36,    38,    40,    42,    45,    50,    53,    56,
+      59,    62,     0,     0,    24,     0,     0,    60,    61,    72,
+       0,    17,    20,     0,     0,     0,     0,     0,     0,     0,
+       0,     0,     0,     0,     0,     0,     0,     0,     0,     0,
+       0,     0,     0,     0,     0,     0,    74,     0,    73,    67,
+      19,    33,    35,    37,    39,    41,    43,    44,    46,    48,
+      47,    49,    51,    52,    54,    55,    57,    58,    63,    64,
+       0,     0,    26,     0,    65,     0,     0,    66,    29,    75,
+      22,     0,     0,    31,     0,    30
+};
+
+/* YYPGOTO[NTERM-NUM].  */
+static const yytype_int8 yypgoto[] =
+{
+     -37,   -37,   -37,   104,   -37,   -37,    97,   -37,    89,   -23,
+     -37,    47,   -34,   -37,   -17,    78,    40,    43,    41,    46,
+      48,     1,   -10,    -3,    -1,   -36,   -37,   -37,   -37,    26
+};
+
+/* YYDEFGOTO[NTERM-NUM].  */
+static const yytype_int8 yydefgoto[] =
+{
+       0,     3,     4,     5,     6,    18,    15,    16,    17,    26,
+       7,    45,    46,    47,    48,    49,    50,    51,    52,    53,
+      54,    55,    56,    57,    58,    59,    60,    61,    97,    98
+};
+
+/* YYTABLE[YYPACT[STATE-NUM]] -- What to do in state STATE-NUM.  If
+   positive, shift that token.  If negative, reduce the rule whose
+   number is the opposite.  If YYTABLE_NINF, syntax error.  */
+static const yytype_uint8 yytable[] =
+{
+      64,    29,    67,    68,     8,    30,    73,    24,    37,    90,
+      70,   125,    78,    79,    32,    33,    34,    35,    36,    37,
+       9,    33,   127,    38,    91,    10,    25,    12,    39,    38,
+      95,     1,     2,    13,    39,    96,    86,    87,   100,    40,
+      41,    42,    43,   132,    20,    40,    41,    42,    43,    14,
+      44,    21,   116,   117,    80,    81,    44,    71,    72,    96,
+      23,   123,    22,    82,    83,    84,    85,    88,    89,   120,
+     108,   109,   110,   111,    28,   122,    72,    84,    85,   106,
+     107,   112,   113,    69,    31,   114,   115,    62,    63,    65,
+      73,   129,   130,    74,    75,    76,    77,    92,   134,    99,
+     118,    93,   126,   119,   124,   128,   131,   125,    11,   135,
+      19,    27,    94,   101,   133,    66,   103,   102,     0,   121,
+       0,     0,   104,     0,     0,   105
+};
+
+static const yytype_int16 yycheck[] =
+{
+      34,    24,    38,    39,    33,    28,    21,    14,    10,    29,
+      44,    35,    23,    24,     5,     6,     7,     8,     9,    10,
+      33,     6,    46,    14,    44,     0,    33,    45,    19,    14,
+      45,     3,     4,    41,    19,    69,    12,    13,    72,    30,
+      31,    32,    33,    45,    37,    30,    31,    32,    33,    33,
+      41,    46,    88,    89,    16,    17,    41,    46,    47,    93,
+      42,    95,    35,    25,    26,    27,    28,    14,    15,    92,
+      80,    81,    82,    83,    29,    46,    47,    27,    28,    78,
+      79,    84,    85,    41,    45,    86,    87,    33,    33,    45,
+      21,   125,   126,    22,    18,    20,    19,    37,   132,    42,
+      33,    45,    36,    33,    42,    46,    11,    35,     4,    46,
+      13,    22,    65,    73,   131,    37,    75,    74,    -1,    93,
+      -1,    -1,    76,    -1,    -1,    77
+};
+
+/* YYSTOS[STATE-NUM] -- The symbol kind of the accessing symbol of
+   state STATE-NUM.  */
+static const yytype_int8 yystos[] =
+{
+       0,     3,     4,    49,    50,    51,    52,    58,    33,    33,
+       0,    51,    45,    41,    33,    54,    55,    56,    53,    54,
+      37,    46,    35,    42,    14,    33,    57,    56,    29,    57,
+      57,    45,     5,     6,     7,     8,     9,    10,    14,    19,
+      30,    31,    32,    33,    41,    59,    60,    61,    62,    63,
+      64,    65,    66,    67,    68,    69,    70,    71,    72,    73,
+      74,    75,    33,    33,    60,    45,    63,    73,    73,    41,
+      60,    46,    47,    21,    22,    18,    20,    19,    23,    24,
+      16,    17,    25,    26,    27,    28,    12,    13,    14,    15,
+      29,    44,    37,    45,    59,    45,    60,    76,    77,    42,
+      60,    64,    65,    66,    67,    68,    69,    69,    70,    70,
+      70,    70,    71,    71,    72,    72,    73,    73,    33,    33,
+      57,    77,    46,    60,    42,    35,    36,    46,    46,    60,
+      60,    11,    45,    62,    60,    46
+};
+
+/* YYR1[RULE-NUM] -- Symbol kind of the left-hand side of rule RULE-NUM.  */
+static const yytype_int8 yyr1[] =
+{
+       0,    48,    49,    50,    50,    51,    51,    52,    53,    53,
+      54,    54,    55,    55,    56,    57,    57,    58,    59,    59,
+      59,    60,    60,    60,    60,    60,    60,    61,    61,    62,
+      62,    62,    63,    63,    64,    64,    65,    65,    66,    66,
+      67,    67,    68,    68,    68,    69,    69,    69,    69,    69,
+      70,    70,    70,    71,    71,    71,    72,    72,    72,    73,
+      73,    73,    74,    74,    74,    74,    74,    75,    75,    75,
+      75,    75,    76,    76,    77,    77
+};
+
+/* YYR2[RULE-NUM] -- Number of symbols on the right-hand side of rule RULE-NUM.  */
+static const yytype_int8 yyr2[] =
+{
+       0,     2,     1,     1,     2,     1,     1,     5,     0,     1,
+       1,     2,     1,     3,     3,     1,     2,    10,     1,     3,
+       2,     1,     6,     1,     2,     1,     4,     1,     1,     5,
+       9,     7,     1,     3,     1,     3,     1,     3,     1,     3,
+       1,     3,     1,     3,     3,     1,     3,     3,     3,     3,
+       1,     3,     3,     1,     3,     3,     1,     3,     3,     1,
+       2,     2,     1,     3,     3,     4,     5,     3,     1,     1,
+       1,     1,     0,     1,     1,     3
+};
+
+
+enum { YYENOMEM = -2 };
+
+#define yyerrok         (yyerrstatus = 0)
+#define yyclearin       (yychar = YYEMPTY)
+
+#define YYACCEPT        goto yyacceptlab
+#define YYABORT         goto yyabortlab
+#define YYERROR         goto yyerrorlab
+#define YYNOMEM         goto yyexhaustedlab
+
+
+#define YYRECOVERING()  (!!yyerrstatus)
+
+#define YYBACKUP(Token, Value)                                    \
+  do                                                              \
+    if (yychar == YYEMPTY)                                        \
+      {                                                           \
+        yychar = (Token);                                         \
+        yylval = (Value);                                         \
+        YYPOPSTACK (yylen);                                       \
+        yystate = *yyssp;                                         \
+        goto yybackup;                                            \
+      }                                                           \
+    else                                                          \
+      {                                                           \
+        yyerror (parse_param, YY_("syntax error: cannot back up")); \
+        YYERROR;                                                  \
+      }                                                           \
+  while (0)
+
+/* Backward compatibility with an undocumented macro.
+   Use YYerror or YYUNDEF. */
+#define YYERRCODE YYUNDEF
+
+
+/* Enable debugging if requested.  */
+#if YYDEBUG
+
+# ifndef YYFPRINTF
+#  include <stdio.h> /* INFRINGES ON USER NAME SPACE */
+#  define YYFPRINTF fprintf
+# endif
+
+# define YYDPRINTF(Args)                        \
+do {                                            \
+  if (yydebug)                                  \
+    YYFPRINTF Args;                             \
+} while (0)
+
+
+
+
+# define YY_SYMBOL_PRINT(Title, Kind, Value, Location)                    \
+do {                                                                      \
+  if (yydebug)                                                            \
+    {                                                                     \
+      YYFPRINTF (stderr, "%s ", Title);                                   \
+      yy_symbol_print (stderr,                                            \
+                  Kind, Value, parse_param); \
+      YYFPRINTF (stderr, "\n");                                           \
+    }                                                                     \
+} while (0)
+
+
+/*-----------------------------------.
+| Print this symbol's value on YYO.  |
+`-----------------------------------*/
+
+static void
+yy_symbol_value_print (FILE *yyo,
+                       yysymbol_kind_t yykind, YYSTYPE const * const yyvaluep, sl_parse_param_t* parse_param)
+{
+  FILE *yyoutput = yyo;
+  YY_USE (yyoutput);
+  YY_USE (parse_param);
+  if (!yyvaluep)
+    return;
+  YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
+  YY_USE (yykind);
+  YY_IGNORE_MAYBE_UNINITIALIZED_END
+}
+
+
+/*---------------------------.
+| Print this symbol on YYO.  |
+`---------------------------*/
+
+static void
+yy_symbol_print (FILE *yyo,
+                 yysymbol_kind_t yykind, YYSTYPE const * const yyvaluep, sl_parse_param_t* parse_param)
+{
+  YYFPRINTF (yyo, "%s %s (",
+             yykind < YYNTOKENS ? "token" : "nterm", yysymbol_name (yykind));
+
+  yy_symbol_value_print (yyo, yykind, yyvaluep, parse_param);
+  YYFPRINTF (yyo, ")");
+}
+
+/*------------------------------------------------------------------.
+| yy_stack_print -- Print the state stack from its BOTTOM up to its |
+| TOP (included).                                                   |
+`------------------------------------------------------------------*/
+
+static void
+yy_stack_print (yy_state_t *yybottom, yy_state_t *yytop)
+{
+  YYFPRINTF (stderr, "Stack now");
+  for (; yybottom <= yytop; yybottom++)
+    {
+      int yybot = *yybottom;
+      YYFPRINTF (stderr, " %d", yybot);
+    }
+  YYFPRINTF (stderr, "\n");
+}
+
+# define YY_STACK_PRINT(Bottom, Top)                            \
+do {                                                            \
+  if (yydebug)                                                  \
+    yy_stack_print ((Bottom), (Top));                           \
+} while (0)
+
+
+/*------------------------------------------------.
+| Report that the YYRULE is going to be reduced.  |
+`------------------------------------------------*/
+
+static void
+yy_reduce_print (yy_state_t *yyssp, YYSTYPE *yyvsp,
+                 int yyrule, sl_parse_param_t* parse_param)
+{
+  int yylno = yyrline[yyrule];
+  int yynrhs = yyr2[yyrule];
+  int yyi;
+  YYFPRINTF (stderr, "Reducing stack by rule %d (line %d):\n",
+             yyrule - 1, yylno);
+  /* The symbols being reduced.  */
+  for (yyi = 0; yyi < yynrhs; yyi++)
+    {
+      YYFPRINTF (stderr, "   $%d = ", yyi + 1);
+      yy_symbol_print (stderr,
+                       YY_ACCESSING_SYMBOL (+yyssp[yyi + 1 - yynrhs]),
+                       &yyvsp[(yyi + 1) - (yynrhs)], parse_param);
+      YYFPRINTF (stderr, "\n");
+    }
+}
+
+# define YY_REDUCE_PRINT(Rule)          \
+do {                                    \
+  if (yydebug)                          \
+    yy_reduce_print (yyssp, yyvsp, Rule, parse_param); \
+} while (0)
+
+/* Nonzero means print parse trace.  It is left uninitialized so that
+   multiple parsers can coexist.  */
+int yydebug;
+#else /* !YYDEBUG */
+# define YYDPRINTF(Args) ((void) 0)
+# define YY_SYMBOL_PRINT(Title, Kind, Value, Location)
+# define YY_STACK_PRINT(Bottom, Top)
+# define YY_REDUCE_PRINT(Rule)
+#endif /* !YYDEBUG */
+
+
+/* YYINITDEPTH -- initial size of the parser's stacks.  */
+#ifndef YYINITDEPTH
+# define YYINITDEPTH 200
+#endif
+
+/* YYMAXDEPTH -- maximum size the stacks can grow to (effective only
+   if the built-in stack extension method is used).
+
+   Do not make this value too large; the results are undefined if
+   YYSTACK_ALLOC_MAXIMUM < YYSTACK_BYTES (YYMAXDEPTH)
+   evaluated with infinite-precision integer arithmetic.  */
+
+#ifndef YYMAXDEPTH
+# define YYMAXDEPTH 10000
+#endif
+
+
+
+
+
+
+/*-----------------------------------------------.
+| Release the memory associated to this symbol.  |
+`-----------------------------------------------*/
+
+static void
+yydestruct (const char *yymsg,
+            yysymbol_kind_t yykind, YYSTYPE *yyvaluep, sl_parse_param_t* parse_param)
+{
+  YY_USE (yyvaluep);
+  YY_USE (parse_param);
+  if (!yymsg)
+    yymsg = "Deleting";
+  YY_SYMBOL_PRINT (yymsg, yykind, yyvaluep, yylocationp);
+
+  YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
+  YY_USE (yykind);
+  YY_IGNORE_MAYBE_UNINITIALIZED_END
+}
+
+
+/* Lookahead token kind.  */
+int yychar;
+
+/* The semantic value of the lookahead symbol.  */
+YYSTYPE yylval;
+/* Number of syntax errors so far.  */
+int yynerrs;
+
+
+
+
+/*----------.
+| yyparse.  |
+`----------*/
+
+int
+yyparse (sl_parse_param_t* parse_param)
+{
+    yy_state_fast_t yystate = 0;
+    /* Number of tokens to shift before error messages enabled.  */
+    int yyerrstatus = 0;
+
+    /* Refer to the stacks through separate pointers, to allow yyoverflow
+       to reallocate them elsewhere.  */
+
+    /* Their size.  */
+    YYPTRDIFF_T yystacksize = YYINITDEPTH;
+
+    /* The state stack: array, bottom, top.  */
+    yy_state_t yyssa[YYINITDEPTH];
+    yy_state_t *yyss = yyssa;
+    yy_state_t *yyssp = yyss;
+
+    /* The semantic value stack: array, bottom, top.  */
+    YYSTYPE yyvsa[YYINITDEPTH];
+    YYSTYPE *yyvs = yyvsa;
+    YYSTYPE *yyvsp = yyvs;
+
+  int yyn;
+  /* The return value of yyparse.  */
+  int yyresult;
+  /* Lookahead symbol kind.  */
+  yysymbol_kind_t yytoken = YYSYMBOL_YYEMPTY;
+  /* The variables used to return semantic value and location from the
+     action routines.  */
+  YYSTYPE yyval;
+
+
+
+#define YYPOPSTACK(N)   (yyvsp -= (N), yyssp -= (N))
+
+  /* The number of symbols on the RHS of the reduced rule.
+     Keep to zero when no symbol should be popped.  */
+  int yylen = 0;
+
+  YYDPRINTF ((stderr, "Starting parse\n"));
+
+  yychar = YYEMPTY; /* Cause a token to be read.  */
+
+  goto yysetstate;
+
+
+/*------------------------------------------------------------.
+| yynewstate -- push a new state, which is found in yystate.  |
+`------------------------------------------------------------*/
+yynewstate:
+  /* In all cases, when you get here, the value and location stacks
+     have just been pushed.  So pushing a state here evens the stacks.  */
+  yyssp++;
+
+
+/*--------------------------------------------------------------------.
+| yysetstate -- set current state (the top of the stack) to yystate.  |
+`--------------------------------------------------------------------*/
+yysetstate:
+  YYDPRINTF ((stderr, "Entering state %d\n", yystate));
+  YY_ASSERT (0 <= yystate && yystate < YYNSTATES);
+  YY_IGNORE_USELESS_CAST_BEGIN
+  *yyssp = YY_CAST (yy_state_t, yystate);
+  YY_IGNORE_USELESS_CAST_END
+  YY_STACK_PRINT (yyss, yyssp);
+
+  if (yyss + yystacksize - 1 <= yyssp)
+#if !defined yyoverflow && !defined YYSTACK_RELOCATE
+    YYNOMEM;
+#else
+    {
+      /* Get the current used size of the three stacks, in elements.  */
+      YYPTRDIFF_T yysize = yyssp - yyss + 1;
+
+# if defined yyoverflow
+      {
+        /* Give user a chance to reallocate the stack.  Use copies of
+           these so that the &'s don't force the real ones into
+           memory.  */
+        yy_state_t *yyss1 = yyss;
+        YYSTYPE *yyvs1 = yyvs;
+
+        /* Each stack pointer address is followed by the size of the
+           data in use in that stack, in bytes.  This used to be a
+           conditional around just the two extra args, but that might
+           be undefined if yyoverflow is a macro.  */
+        yyoverflow (YY_("memory exhausted"),
+                    &yyss1, yysize * YYSIZEOF (*yyssp),
+                    &yyvs1, yysize * YYSIZEOF (*yyvsp),
+                    &yystacksize);
+        yyss = yyss1;
+        yyvs = yyvs1;
+      }
+# else /* defined YYSTACK_RELOCATE */
+      /* Extend the stack our own way.  */
+      if (YYMAXDEPTH <= yystacksize)
+        YYNOMEM;
+      yystacksize *= 2;
+      if (YYMAXDEPTH < yystacksize)
+        yystacksize = YYMAXDEPTH;
+
+      {
+        yy_state_t *yyss1 = yyss;
+        union yyalloc *yyptr =
+          YY_CAST (union yyalloc *,
+                   YYSTACK_ALLOC (YY_CAST (YYSIZE_T, YYSTACK_BYTES (yystacksize))));
+        if (! yyptr)
+          YYNOMEM;
+        YYSTACK_RELOCATE (yyss_alloc, yyss);
+        YYSTACK_RELOCATE (yyvs_alloc, yyvs);
+#  undef YYSTACK_RELOCATE
+        if (yyss1 != yyssa)
+          YYSTACK_FREE (yyss1);
+      }
+# endif
+
+      yyssp = yyss + yysize - 1;
+      yyvsp = yyvs + yysize - 1;
+
+      YY_IGNORE_USELESS_CAST_BEGIN
+      YYDPRINTF ((stderr, "Stack size increased to %ld\n",
+                  YY_CAST (long, yystacksize)));
+      YY_IGNORE_USELESS_CAST_END
+
+      if (yyss + yystacksize - 1 <= yyssp)
+        YYABORT;
+    }
+#endif /* !defined yyoverflow && !defined YYSTACK_RELOCATE */
+
+
+  if (yystate == YYFINAL)
+    YYACCEPT;
+
+  goto yybackup;
+
+
+/*-----------.
+| yybackup.  |
+`-----------*/
+yybackup:
+  /* Do appropriate processing given the current state.  Read a
+     lookahead token if we need one and don't already have one.  */
+
+  /* First try to decide what to do without reference to lookahead token.  */
+  yyn = yypact[yystate];
+  if (yypact_value_is_default (yyn))
+    goto yydefault;
+
+  /* Not known => get a lookahead token if don't already have one.  */
+
+  /* YYCHAR is either empty, or end-of-input, or a valid lookahead.  */
+  if (yychar == YYEMPTY)
+    {
+      YYDPRINTF ((stderr, "Reading a token\n"));
+      yychar = yylex ();
+    }
+
+  if (yychar <= YYEOF)
+    {
+      yychar = YYEOF;
+      yytoken = YYSYMBOL_YYEOF;
+      YYDPRINTF ((stderr, "Now at end of input.\n"));
+    }
+  else if (yychar == YYerror)
+    {
+      /* The scanner already issued an error message, process directly
+         to error recovery.  But do not keep the error token as
+         lookahead, it is too special and may lead us to an endless
+         loop in error recovery. */
+      yychar = YYUNDEF;
+      yytoken = YYSYMBOL_YYerror;
+      goto yyerrlab1;
+    }
+  else
+    {
+      yytoken = YYTRANSLATE (yychar);
+      YY_SYMBOL_PRINT ("Next token is", yytoken, &yylval, &yylloc);
+    }
+
+  /* If the proper action on seeing token YYTOKEN is to reduce or to
+     detect an error, take that action.  */
+  yyn += yytoken;
+  if (yyn < 0 || YYLAST < yyn || yycheck[yyn] != yytoken)
+    goto yydefault;
+  yyn = yytable[yyn];
+  if (yyn <= 0)
+    {
+      if (yytable_value_is_error (yyn))
+        goto yyerrlab;
+      yyn = -yyn;
+      goto yyreduce;
+    }
+
+  /* Count tokens shifted since error; after three, turn off error
+     status.  */
+  if (yyerrstatus)
+    yyerrstatus--;
+
+  /* Shift the lookahead token.  */
+  YY_SYMBOL_PRINT ("Shifting", yytoken, &yylval, &yylloc);
+  yystate = yyn;
+  YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
+  *++yyvsp = yylval;
+  YY_IGNORE_MAYBE_UNINITIALIZED_END
+
+  /* Discard the shifted token.  */
+  yychar = YYEMPTY;
+  goto yynewstate;
+
+
+/*-----------------------------------------------------------.
+| yydefault -- do the default action for the current state.  |
+`-----------------------------------------------------------*/
+yydefault:
+  yyn = yydefact[yystate];
+  if (yyn == 0)
+    goto yyerrlab;
+  goto yyreduce;
+
+
+/*-----------------------------.
+| yyreduce -- do a reduction.  |
+`-----------------------------*/
+yyreduce:
+  /* yyn is the number of a rule to reduce with.  */
+  yylen = yyr2[yyn];
+
+  /* If YYLEN is nonzero, implement the default value of the action:
+     '$$ = $1'.
+
+     Otherwise, the following line sets YYVAL to garbage.
+     This behavior is undocumented and Bison
+     users should not rely upon it.  Assigning to YYVAL
+     unconditionally makes the parser a bit smaller, and it avoids a
+     GCC warning that YYVAL may be used uninitialized.  */
+  yyval = yyvsp[1-yylen];
+
+
+  YY_REDUCE_PRINT (yyn);
+  switch (yyn)
+    {
+  case 2: /* program: declaration_list  */
+#line 99 "src/grammar.y"
+                         { parse_param->slpp_root = (yyval.l_decl) = (yyvsp[0].l_decl); }
+#line 1241 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 3: /* declaration_list: declaration  */
+#line 103 "src/grammar.y"
+                                        { (yyval.l_decl) = (yyvsp[0].l_decl); }
+#line 1247 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 4: /* declaration_list: declaration_list declaration  */
+#line 104 "src/grammar.y"
+                                        { (yyval.l_decl) = dl_append((yyvsp[-1].l_decl), (yyvsp[0].l_decl)); }
+#line 1253 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 5: /* declaration: struct_decl  */
+#line 108 "src/grammar.y"
+                    { (yyval.l_decl) = (yyvsp[0].l_decl); }
+#line 1259 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 6: /* declaration: func_decl  */
+#line 109 "src/grammar.y"
+                    { (yyval.l_decl) = (yyvsp[0].l_decl); }
+#line 1265 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 7: /* struct_decl: SL_TOK_STRUCT SL_TOK_IDENT '{' param_list_comma '}'  */
+#line 114 "src/grammar.y"
+        {
+            (yyval.l_decl) = dl_struct((yyvsp[-3].l_sym), (yyvsp[-1].l_decl));
+        }
+#line 1273 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 8: /* param_list_opt: %empty  */
+#line 120 "src/grammar.y"
+                                { (yyval.l_decl) = NULL; }
+#line 1279 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 9: /* param_list_opt: param_list_comma  */
+#line 121 "src/grammar.y"
+                                { (yyval.l_decl) = (yyvsp[0].l_decl); }
+#line 1285 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 10: /* param_list_comma: param_list  */
+#line 125 "src/grammar.y"
+                        { (yyval.l_decl) = (yyvsp[0].l_decl); }
+#line 1291 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 11: /* param_list_comma: param_list ','  */
+#line 126 "src/grammar.y"
+                        { (yyval.l_decl) = (yyvsp[-1].l_decl); }
+#line 1297 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 12: /* param_list: param  */
+#line 130 "src/grammar.y"
+                                { (yyval.l_decl) = (yyvsp[0].l_decl); }
+#line 1303 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 13: /* param_list: param_list ',' param  */
+#line 131 "src/grammar.y"
+                                { (yyval.l_decl) = dl_append((yyvsp[-2].l_decl), (yyvsp[0].l_decl)); }
+#line 1309 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 14: /* param: SL_TOK_IDENT ':' type_expr  */
+#line 135 "src/grammar.y"
+                                     { (yyval.l_decl) = dl_param((yyvsp[-2].l_sym), (yyvsp[0].l_type)); }
+#line 1315 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 15: /* type_expr: SL_TOK_IDENT  */
+#line 139 "src/grammar.y"
+                        { (yyval.l_type) = ty_type_name(ast_arena, (yyvsp[0].l_sym)); }
+#line 1321 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 16: /* type_expr: '*' type_expr  */
+#line 140 "src/grammar.y"
+                        { (yyval.l_type) = ty_type_pointer(ast_arena, (yyvsp[0].l_type)); }
+#line 1327 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 17: /* func_decl: SL_TOK_FN SL_TOK_IDENT '(' param_list_opt ')' SL_TOK_SARROW type_expr '{' stmt_list '}'  */
+#line 146 "src/grammar.y"
+        {
+            (yyval.l_decl) = dl_func((yyvsp[-8].l_sym), (yyvsp[-6].l_decl), (yyvsp[-3].l_type), (yyvsp[-1].l_expr));
+        }
+#line 1335 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 18: /* stmt_list: expr  */
+#line 152 "src/grammar.y"
+                            { (yyval.l_expr) = (yyvsp[0].l_expr); }
+#line 1341 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 19: /* stmt_list: stmt_list ';' expr  */
+#line 153 "src/grammar.y"
+                            { (yyval.l_expr) = ex_append((yyvsp[-2].l_expr), (yyvsp[0].l_expr)); }
+#line 1347 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 20: /* stmt_list: stmt_list ';'  */
+#line 154 "src/grammar.y"
+                            { (yyval.l_expr) = (yyvsp[-1].l_expr); }
+#line 1353 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 22: /* expr: SL_TOK_LET SL_TOK_IDENT ':' type_expr '=' expr  */
+#line 160 "src/grammar.y"
+        {
+            (yyval.l_expr) = sl_expr_let((yyvsp[-4].l_sym), (yyvsp[-2].l_type), (yyvsp[0].l_expr));
+        }
+#line 1361 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 23: /* expr: SL_TOK_RETURN  */
+#line 163 "src/grammar.y"
+                                        { (yyval.l_expr) = sl_expr_return(NULL); }
+#line 1367 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 24: /* expr: SL_TOK_RETURN expr  */
+#line 164 "src/grammar.y"
+                                        { (yyval.l_expr) = sl_expr_return((yyvsp[0].l_expr)); }
+#line 1373 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 25: /* expr: SL_TOK_BREAK  */
+#line 165 "src/grammar.y"
+                                        { (yyval.l_expr) = sl_expr_break(); }
+#line 1379 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 26: /* expr: SL_TOK_LOOP '{' stmt_list '}'  */
+#line 166 "src/grammar.y"
+                                        { (yyval.l_expr) = sl_expr_loop((yyvsp[-1].l_expr)); }
+#line 1385 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 29: /* if_expr: SL_TOK_IF lor_expr '{' expr '}'  */
+#line 177 "src/grammar.y"
+                                        { (yyval.l_expr) = sl_expr_if((yyvsp[-3].l_expr), (yyvsp[-1].l_expr), sl_expr_void()); }
+#line 1391 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 30: /* if_expr: SL_TOK_IF lor_expr '{' expr '}' SL_TOK_ELSE '{' expr '}'  */
+#line 179 "src/grammar.y"
+                                        { (yyval.l_expr) = sl_expr_if((yyvsp[-7].l_expr), (yyvsp[-5].l_expr), (yyvsp[-1].l_expr)); }
+#line 1397 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 31: /* if_expr: SL_TOK_IF lor_expr '{' expr '}' SL_TOK_ELSE if_expr  */
+#line 181 "src/grammar.y"
+                                        { (yyval.l_expr) = sl_expr_if((yyvsp[-5].l_expr), (yyvsp[-3].l_expr), (yyvsp[0].l_expr)); }
+#line 1403 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 33: /* lor_expr: lor_expr SL_TOK_LOR land_expr  */
+#line 186 "src/grammar.y"
+                                        { (yyval.l_expr) = sl_expr_binop((yyvsp[-1].l_tok), (yyvsp[-2].l_expr), (yyvsp[0].l_expr)); }
+#line 1409 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 35: /* land_expr: land_expr SL_TOK_LAND bor_expr  */
+#line 191 "src/grammar.y"
+                                        { (yyval.l_expr) = sl_expr_binop((yyvsp[-1].l_tok), (yyvsp[-2].l_expr), (yyvsp[0].l_expr)); }
+#line 1415 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 37: /* bor_expr: bor_expr '|' xor_expr  */
+#line 196 "src/grammar.y"
+                                        { (yyval.l_expr) = sl_expr_binop((yyvsp[-1].l_tok), (yyvsp[-2].l_expr), (yyvsp[0].l_expr)); }
+#line 1421 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 39: /* xor_expr: xor_expr '^' band_expr  */
+#line 201 "src/grammar.y"
+                                        { (yyval.l_expr) = sl_expr_binop((yyvsp[-1].l_tok), (yyvsp[-2].l_expr), (yyvsp[0].l_expr)); }
+#line 1427 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 41: /* band_expr: band_expr '&' eq_expr  */
+#line 206 "src/grammar.y"
+                                        { (yyval.l_expr) = sl_expr_binop((yyvsp[-1].l_tok), (yyvsp[-2].l_expr), (yyvsp[0].l_expr)); }
+#line 1433 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 43: /* eq_expr: eq_expr SL_TOK_EQ cmp_expr  */
+#line 211 "src/grammar.y"
+                                        { (yyval.l_expr) = sl_expr_binop((yyvsp[-1].l_tok), (yyvsp[-2].l_expr), (yyvsp[0].l_expr)); }
+#line 1439 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 44: /* eq_expr: eq_expr SL_TOK_NEQ cmp_expr  */
+#line 212 "src/grammar.y"
+                                        { (yyval.l_expr) = sl_expr_binop((yyvsp[-1].l_tok), (yyvsp[-2].l_expr), (yyvsp[0].l_expr)); }
+#line 1445 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 46: /* cmp_expr: shift_expr '<' shift_expr  */
+#line 217 "src/grammar.y"
+                                        { (yyval.l_expr) = sl_expr_binop((yyvsp[-1].l_tok), (yyvsp[-2].l_expr), (yyvsp[0].l_expr)); }
+#line 1451 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 47: /* cmp_expr: shift_expr SL_TOK_LE shift_expr  */
+#line 218 "src/grammar.y"
+                                        { (yyval.l_expr) = sl_expr_binop((yyvsp[-1].l_tok), (yyvsp[-2].l_expr), (yyvsp[0].l_expr)); }
+#line 1457 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 48: /* cmp_expr: shift_expr '>' shift_expr  */
+#line 219 "src/grammar.y"
+                                        { (yyval.l_expr) = sl_expr_binop((yyvsp[-1].l_tok), (yyvsp[-2].l_expr), (yyvsp[0].l_expr)); }
+#line 1463 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 49: /* cmp_expr: shift_expr SL_TOK_GE shift_expr  */
+#line 220 "src/grammar.y"
+                                        { (yyval.l_expr) = sl_expr_binop((yyvsp[-1].l_tok), (yyvsp[-2].l_expr), (yyvsp[0].l_expr)); }
+#line 1469 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 51: /* shift_expr: shift_expr SL_TOK_LSH add_expr  */
+#line 225 "src/grammar.y"
+                                        { (yyval.l_expr) = sl_expr_binop((yyvsp[-1].l_tok), (yyvsp[-2].l_expr), (yyvsp[0].l_expr)); }
+#line 1475 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 52: /* shift_expr: shift_expr SL_TOK_RSH add_expr  */
+#line 226 "src/grammar.y"
+                                        { (yyval.l_expr) = sl_expr_binop((yyvsp[-1].l_tok), (yyvsp[-2].l_expr), (yyvsp[0].l_expr)); }
+#line 1481 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 54: /* add_expr: add_expr '+' mul_expr  */
+#line 231 "src/grammar.y"
+                                        { (yyval.l_expr) = sl_expr_binop((yyvsp[-1].l_tok), (yyvsp[-2].l_expr), (yyvsp[0].l_expr)); }
+#line 1487 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 55: /* add_expr: add_expr '-' mul_expr  */
+#line 232 "src/grammar.y"
+                                        { (yyval.l_expr) = sl_expr_binop((yyvsp[-1].l_tok), (yyvsp[-2].l_expr), (yyvsp[0].l_expr)); }
+#line 1493 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 57: /* mul_expr: mul_expr '*' deref_expr  */
+#line 237 "src/grammar.y"
+                                        { (yyval.l_expr) = sl_expr_binop((yyvsp[-1].l_tok), (yyvsp[-2].l_expr), (yyvsp[0].l_expr)); }
+#line 1499 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 58: /* mul_expr: mul_expr '/' deref_expr  */
+#line 238 "src/grammar.y"
+                                        { (yyval.l_expr) = sl_expr_binop((yyvsp[-1].l_tok), (yyvsp[-2].l_expr), (yyvsp[0].l_expr)); }
+#line 1505 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 60: /* deref_expr: '*' deref_expr  */
+#line 243 "src/grammar.y"
+                                              { (yyval.l_expr) = sl_expr_deref((yyvsp[0].l_expr)); }
+#line 1511 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 61: /* deref_expr: '&' deref_expr  */
+#line 244 "src/grammar.y"
+                                              { (yyval.l_expr) = sl_expr_addrof((yyvsp[0].l_expr)); }
+#line 1517 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 63: /* member_expr: member_expr SL_TOK_SARROW SL_TOK_IDENT  */
+#line 250 "src/grammar.y"
+                                        { (yyval.l_expr) = sl_expr_member(
+                                                sl_expr_deref((yyvsp[-2].l_expr)), (yyvsp[0].l_sym)); }
+#line 1524 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 64: /* member_expr: member_expr '.' SL_TOK_IDENT  */
+#line 252 "src/grammar.y"
+                                        { (yyval.l_expr) = sl_expr_member((yyvsp[-2].l_expr), (yyvsp[0].l_sym)); }
+#line 1530 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 65: /* member_expr: SL_TOK_IDENT '(' expr_list_opt ')'  */
+#line 253 "src/grammar.y"
+                                            { (yyval.l_expr) = sl_expr_call((yyvsp[-3].l_sym), (yyvsp[-1].l_expr)); }
+#line 1536 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 66: /* member_expr: SL_TOK_NEW SL_TOK_IDENT '{' expr_list '}'  */
+#line 256 "src/grammar.y"
+                                        { (yyval.l_expr) = sl_expr_new((yyvsp[-3].l_sym), (yyvsp[-1].l_expr)); }
+#line 1542 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 67: /* primary_expr: '(' expr ')'  */
+#line 260 "src/grammar.y"
+                                        { (yyval.l_expr) = (yyvsp[-1].l_expr); }
+#line 1548 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 68: /* primary_expr: SL_TOK_INT  */
+#line 261 "src/grammar.y"
+                                        { (yyval.l_expr) = sl_expr_int((yyvsp[0].l_int)); }
+#line 1554 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 69: /* primary_expr: SL_TOK_TRUE  */
+#line 262 "src/grammar.y"
+                                        { (yyval.l_expr) = sl_expr_bool(1); }
+#line 1560 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 70: /* primary_expr: SL_TOK_FALSE  */
+#line 263 "src/grammar.y"
+                                        { (yyval.l_expr) = sl_expr_bool(0); }
+#line 1566 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 71: /* primary_expr: SL_TOK_IDENT  */
+#line 264 "src/grammar.y"
+                                        { (yyval.l_expr) = sl_expr_var((yyvsp[0].l_sym)); }
+#line 1572 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 72: /* expr_list_opt: %empty  */
+#line 268 "src/grammar.y"
+                         { (yyval.l_expr) = NULL; }
+#line 1578 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 73: /* expr_list_opt: expr_list  */
+#line 269 "src/grammar.y"
+                         { (yyval.l_expr) = (yyvsp[0].l_expr); }
+#line 1584 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 74: /* expr_list: expr  */
+#line 273 "src/grammar.y"
+                            { (yyval.l_expr) = (yyvsp[0].l_expr); }
+#line 1590 "build/debug/src//grammar.tab.c"
+    break;
+
+  case 75: /* expr_list: expr_list ',' expr  */
+#line 274 "src/grammar.y"
+                            { (yyval.l_expr) = ex_append((yyvsp[-2].l_expr), (yyvsp[0].l_expr)); }
+#line 1596 "build/debug/src//grammar.tab.c"
+    break;
+
+
+#line 1600 "build/debug/src//grammar.tab.c"
+
+      default: break;
+    }
+  /* User semantic actions sometimes alter yychar, and that requires
+     that yytoken be updated with the new translation.  We take the
+     approach of translating immediately before every use of yytoken.
+     One alternative is translating here after every semantic action,
+     but that translation would be missed if the semantic action invokes
+     YYABORT, YYACCEPT, or YYERROR immediately after altering yychar or
+     if it invokes YYBACKUP.  In the case of YYABORT or YYACCEPT, an
+     incorrect destructor might then be invoked immediately.  In the
+     case of YYERROR or YYBACKUP, subsequent parser actions might lead
+     to an incorrect destructor call or verbose syntax error message
+     before the lookahead is translated.  */
+  YY_SYMBOL_PRINT ("-> $$ =", YY_CAST (yysymbol_kind_t, yyr1[yyn]), &yyval, &yyloc);
+
+  YYPOPSTACK (yylen);
+  yylen = 0;
+
+  *++yyvsp = yyval;
+
+  /* Now 'shift' the result of the reduction.  Determine what state
+     that goes to, based on the state we popped back to and the rule
+     number reduced by.  */
+  {
+    const int yylhs = yyr1[yyn] - YYNTOKENS;
+    const int yyi = yypgoto[yylhs] + *yyssp;
+    yystate = (0 <= yyi && yyi <= YYLAST && yycheck[yyi] == *yyssp
+               ? yytable[yyi]
+               : yydefgoto[yylhs]);
+  }
+
+  goto yynewstate;
+
+
+/*--------------------------------------.
+| yyerrlab -- here on detecting error.  |
+`--------------------------------------*/
+yyerrlab:
+  /* Make sure we have latest lookahead translation.  See comments at
+     user semantic actions for why this is necessary.  */
+  yytoken = yychar == YYEMPTY ? YYSYMBOL_YYEMPTY : YYTRANSLATE (yychar);
+  /* If not already recovering from an error, report this error.  */
+  if (!yyerrstatus)
+    {
+      ++yynerrs;
+      yyerror (parse_param, YY_("syntax error"));
+    }
+
+  if (yyerrstatus == 3)
+    {
+      /* If just tried and failed to reuse lookahead token after an
+         error, discard it.  */
+
+      if (yychar <= YYEOF)
+        {
+          /* Return failure if at end of input.  */
+          if (yychar == YYEOF)
+            YYABORT;
+        }
+      else
+        {
+          yydestruct ("Error: discarding",
+                      yytoken, &yylval, parse_param);
+          yychar = YYEMPTY;
+        }
+    }
+
+  /* Else will try to reuse lookahead token after shifting the error
+     token.  */
+  goto yyerrlab1;
+
+
+/*---------------------------------------------------.
+| yyerrorlab -- error raised explicitly by YYERROR.  |
+`---------------------------------------------------*/
+yyerrorlab:
+  /* Pacify compilers when the user code never invokes YYERROR and the
+     label yyerrorlab therefore never appears in user code.  */
+  if (0)
+    YYERROR;
+  ++yynerrs;
+
+  /* Do not reclaim the symbols of the rule whose action triggered
+     this YYERROR.  */
+  YYPOPSTACK (yylen);
+  yylen = 0;
+  YY_STACK_PRINT (yyss, yyssp);
+  yystate = *yyssp;
+  goto yyerrlab1;
+
+
+/*-------------------------------------------------------------.
+| yyerrlab1 -- common code for both syntax error and YYERROR.  |
+`-------------------------------------------------------------*/
+yyerrlab1:
+  yyerrstatus = 3;      /* Each real token shifted decrements this.  */
+
+  /* Pop stack until we find a state that shifts the error token.  */
+  for (;;)
+    {
+      yyn = yypact[yystate];
+      if (!yypact_value_is_default (yyn))
+        {
+          yyn += YYSYMBOL_YYerror;
+          if (0 <= yyn && yyn <= YYLAST && yycheck[yyn] == YYSYMBOL_YYerror)
+            {
+              yyn = yytable[yyn];
+              if (0 < yyn)
+                break;
+            }
+        }
+
+      /* Pop the current state because it cannot handle the error token.  */
+      if (yyssp == yyss)
+        YYABORT;
+
+
+      yydestruct ("Error: popping",
+                  YY_ACCESSING_SYMBOL (yystate), yyvsp, parse_param);
+      YYPOPSTACK (1);
+      yystate = *yyssp;
+      YY_STACK_PRINT (yyss, yyssp);
+    }
+
+  YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
+  *++yyvsp = yylval;
+  YY_IGNORE_MAYBE_UNINITIALIZED_END
+
+
+  /* Shift the error token.  */
+  YY_SYMBOL_PRINT ("Shifting", YY_ACCESSING_SYMBOL (yyn), yyvsp, yylsp);
+
+  yystate = yyn;
+  goto yynewstate;
+
+
+/*-------------------------------------.
+| yyacceptlab -- YYACCEPT comes here.  |
+`-------------------------------------*/
+yyacceptlab:
+  yyresult = 0;
+  goto yyreturnlab;
+
+
+/*-----------------------------------.
+| yyabortlab -- YYABORT comes here.  |
+`-----------------------------------*/
+yyabortlab:
+  yyresult = 1;
+  goto yyreturnlab;
+
+
+/*-----------------------------------------------------------.
+| yyexhaustedlab -- YYNOMEM (memory exhaustion) comes here.  |
+`-----------------------------------------------------------*/
+yyexhaustedlab:
+  yyerror (parse_param, YY_("memory exhausted"));
+  yyresult = 2;
+  goto yyreturnlab;
+
+
+/*----------------------------------------------------------.
+| yyreturnlab -- parsing is finished, clean up and return.  |
+`----------------------------------------------------------*/
+yyreturnlab:
+  if (yychar != YYEMPTY)
+    {
+      /* Make sure we have latest lookahead translation.  See comments at
+         user semantic actions for why this is necessary.  */
+      yytoken = YYTRANSLATE (yychar);
+      yydestruct ("Cleanup: discarding lookahead",
+                  yytoken, &yylval, parse_param);
+    }
+  /* Do not reclaim the symbols of the rule whose action triggered
+     this YYABORT or YYACCEPT.  */
+  YYPOPSTACK (yylen);
+  YY_STACK_PRINT (yyss, yyssp);
+  while (yyssp != yyss)
+    {
+      yydestruct ("Cleanup: popping",
+                  YY_ACCESSING_SYMBOL (+*yyssp), yyvsp, parse_param);
+      YYPOPSTACK (1);
+    }
+#ifndef yyoverflow
+  if (yyss != yyssa)
+    YYSTACK_FREE (yyss);
+#endif
+
+  return yyresult;
+}
+
+#line 276 "src/grammar.y"
+
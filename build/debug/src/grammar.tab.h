@@ -0,0 +1,119 @@
+/* A Bison parser, made by GNU Bison 3.8.2.  */
+
+/* Bison interface for Yacc-like parsers in C
+
+   Copyright (C) 1984, 1989-1990, 2000-2015, 2018-2021 Free Software Foundation,
+   Inc.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.  */
+
+/* As a special exception, you may create a larger work that contains
+   part or all of the Bison parser skeleton and distribute that work
+   under terms of your choice, so long as that work isn't itself a
+   parser generator using the skeleton or a modified version thereof
+   as a parser skeleton.  Alternatively, if you modify or redistribute
+   the parser skeleton itself, you may (at your option) remove this
+   special exception, which will cause the skeleton and the resulting
+   Bison output files to be licensed under the GNU General Public
+   License without this special exception.
+
+   This special exception was added by the Free Software Foundation in
+   version 2.2 of Bison.  */
+
+/* DO NOT RELY ON FEATURES THAT ARE NOT DOCUMENTED in the manual,
+   especially those whose name start with YY_ or yy_.  They are
+   private implementation details that can be changed or removed.  */
+
+#ifndef YY_YY_BUILD_DEBUG_SRC_GRAMMAR_TAB_H_INCLUDED
+# define YY_YY_BUILD_DEBUG_SRC_GRAMMAR_TAB_H_INCLUDED
+/* Debug traces.  */
+#ifndef YYDEBUG
+# define YYDEBUG 0
+#endif
+#if YYDEBUG
+extern int yydebug;
+#endif
+
+/* Token kinds.  */
+#ifndef YYTOKENTYPE
+# define YYTOKENTYPE
+  enum yytokentype
+  {
+    YYEMPTY = -2,
+    YYEOF = 0,                     /* "end of file"  */
+    YYerror = 256,                 /* error  */
+    YYUNDEF = 257,                 /* "invalid token"  */
+    SL_TOK_STRUCT = 258,           /* SL_TOK_STRUCT  */
+    SL_TOK_FN = 259,               /* SL_TOK_FN  */
+    SL_TOK_LET = 260,              /* SL_TOK_LET  */
+    SL_TOK_NEW = 261,              /* SL_TOK_NEW  */
+    SL_TOK_RETURN = 262,           /* SL_TOK_RETURN  */
+    SL_TOK_BREAK = 263,            /* SL_TOK_BREAK  */
+    SL_TOK_LOOP = 264,             /* SL_TOK_LOOP  */
+    SL_TOK_IF = 265,               /* SL_TOK_IF  */
+    SL_TOK_ELSE = 266,             /* SL_TOK_ELSE  */
+    SL_TOK_LOR = 267,              /* SL_TOK_LOR  */
+    SL_TOK_LAND = 268,             /* SL_TOK_LAND  */
+    SL_TOK_EQ = 269,               /* SL_TOK_EQ  */
+    SL_TOK_NEQ = 270,              /* SL_TOK_NEQ  */
+    SL_TOK_LE = 271,               /* SL_TOK_LE  */
+    SL_TOK_GE = 272,               /* SL_TOK_GE  */
+    SL_TOK_LSH = 273,              /* SL_TOK_LSH  */
+    SL_TOK_RSH = 274,              /* SL_TOK_RSH  */
+    SL_TOK_SARROW = 275,           /* SL_TOK_SARROW  */
+    SL_TOK_TRUE = 276,             /* SL_TOK_TRUE  */
+    SL_TOK_FALSE = 277,            /* SL_TOK_FALSE  */
+    SL_TOK_INT = 278,              /* SL_TOK_INT  */
+    SL_TOK_IDENT = 279,            /* SL_TOK_IDENT  */
+    SL_TOK_ERROR = 280,            /* SL_TOK_ERROR  */
+    SL_TOK_DEREF = 281,            /* SL_TOK_DEREF  */
+    SL_TOK_ADDROF = 282,           /* SL_TOK_ADDROF  */
+    SL_TOK_PTR = 283               /* SL_TOK_PTR  */
+  };
+  typedef enum yytokentype yytoken_kind_t;
+#endif
+
+/* Value type.  */
+#if ! defined YYSTYPE && ! defined YYSTYPE_IS_DECLARED
+union YYSTYPE
+{
+#line 15 "src/grammar.y"
+
+    sl_decl_t* l_decl;
+    sl_expr_t* l_expr;
+    sl_type_t* l_type;
+
+/* terminals */
+    long long l_int;
+    char* l_str;
+    sl_sym_t l_sym;
+    int l_tok;
+    const char* error_msg;
+
+#line 105 "build/debug/src//grammar.tab.h"
+
+};
+typedef union YYSTYPE YYSTYPE;
+# define YYSTYPE_IS_TRIVIAL 1
+# define YYSTYPE_IS_DECLARED 1
+#endif
+
+
+extern YYSTYPE yylval;
+
+
+int yyparse (sl_parse_param_t* parse_param);
+
+
+#endif /* !YY_YY_BUILD_DEBUG_SRC_GRAMMAR_TAB_H_INCLUDED  */
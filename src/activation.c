@@ -47,6 +47,7 @@ Two bitmaps, one for arguments, another for locals.
 typedef struct act_info_t {
     const sl_decl_t* program;
     temp_state_t* temp_state;
+    translate_types_t* types;
     Arena_T frag_arena; // for permanent tree_ allocations
 } act_info_t;
 
@@ -69,7 +70,7 @@ const size_t ac_word_size = 8;
 static const target_t* target = &target_x86_64;
 
 static ac_frame_t* ac_frame_new(
-        sl_sym_t func_name, const target_t* target, Table_T temp_map,
+        sl_sym_t func_name, const target_t* target, temp_map_t temp_map,
         Arena_T ar)
 {
     ac_frame_t* f = Alloc(ar, sizeof *f);
@@ -501,7 +502,7 @@ calculate_activation_record_decl_func(
             v->acf_reg = assign_temporary_for_reg(info, frame,
                     target->arg_registers.elems[frame->acf_next_arg_reg++],
                     size, ptr_disp_of_type(type),
-                    translate_type(info->frag_arena, info->program, type));
+                    translate_type(info->types, type));
         } else {
             // Add formal parameter
             v->acf_tag = ACF_ACCESS_FRAME;
@@ -525,13 +526,13 @@ calculate_activation_record_decl_func(
 ac_frame_t*
 calculate_activation_records(
         Arena_T frag_arena, const target_t* target, temp_state_t* temp_state,
-        sl_decl_t* program)
+        sl_decl_t* program, translate_types_t* types)
 {
     if (ac_debug) {
         fprintf(stderr, "calculating activation records\n");
     }
 
-    Table_T temp_map = target->tgt_temp_map();
+    temp_map_t temp_map = target->tgt_temp_map();
 
     ac_frame_t* frame_list = NULL;
     for (sl_decl_t* d = program; d; d = d->dl_list) {
@@ -541,6 +542,7 @@ calculate_activation_records(
             act_info_t info = {
                 .program = program,
                 .temp_state = temp_state,
+                .types = types,
                 .frag_arena = frag_arena,
             };
             calculate_activation_record_decl_func(&info, f, d);
@@ -619,6 +621,17 @@ ac_calculate_ptr_maps(
     ac_frame_map_t* frame_map = Alloc(frag_arena, sizeof *frame_map);
     frame_map->acfm_frame = frame;
 
+    // Keep our own copy of the defined vars, which belong to the ast, so
+    // that the map can be calculated again if the frame grows
+    int num_defined_vars = 0;
+    while (defined_vars[num_defined_vars] > 0) {
+        num_defined_vars++;
+    }
+    frame_map->acfm_defined_vars = Alloc(
+            frag_arena, (num_defined_vars + 1) * sizeof *defined_vars);
+    memcpy(frame_map->acfm_defined_vars, defined_vars,
+            num_defined_vars * sizeof *defined_vars);
+
     if (ac_debug) {
         debug_print_frame(frame);
     }
@@ -701,6 +714,50 @@ ac_spill_temporary(ac_frame_t* frame, temp_t t, Arena_T frag_arena)
     return v;
 }
 
+struct ac_frame_var*
+ac_copy_local(ac_frame_t* frame, const struct ac_frame_var* v, int var_id,
+        Arena_T frag_arena)
+{
+    assert(v->acf_tag == ACF_ACCESS_FRAME && v->acf_offset < 0);
+    struct ac_frame_var* copy = Alloc(frag_arena, sizeof *copy);
+    *copy = *v;
+    copy->acf_var_id = var_id;
+    copy->acf_offset = frame->acf_last_local_offset - copy->acf_size;
+    while ((copy->acf_offset % copy->acf_alignment) != 0)
+        copy->acf_offset--;
+    copy->acf_list = NULL;
+
+    frame->acf_last_local_offset = copy->acf_offset;
+    ac_frame_append_var(frame, copy);
+    return copy;
+}
+
+/*
+ * Moves the slots made by ac_spill_temporary, since the locals ended at
+ * locals_end, so that those of the same colour share a word. The words
+ * that are no longer used are taken off the end of the frame.
+ */
+void
+ac_share_spill_slots(
+        ac_frame_t* frame, int locals_end,
+        struct ac_frame_var** slots, const int* colours, int num_slots)
+{
+    const int size = frame->acf_target->word_size;
+    int first = locals_end - size;
+    while ((first % size) != 0)
+        first--;
+
+    frame->acf_last_local_offset = locals_end;
+    for (int i = 0; i < num_slots; i++) {
+        var v = slots[i];
+        assert(v->acf_tag == ACF_ACCESS_FRAME && v->acf_size == size);
+        v->acf_offset = first - colours[i] * size;
+        if (v->acf_offset < frame->acf_last_local_offset) {
+            frame->acf_last_local_offset = v->acf_offset;
+        }
+    }
+}
+
 static const char*
 temp_dispo_str(temp_t t) // XXX: dup
 {
@@ -733,7 +790,7 @@ static int
 reg_idx_for_name(const ac_frame_t* frame, const char* reg_name)
 {
     // O(1)
-    const int num_registers = Table_length(frame->acf_temp_map);
+    const int num_registers = frame->acf_temp_map.tm_len;
     int i = 0;
     for (i = 0; i < num_registers; i++) {
         // abuses knowledge that these are from the same place
@@ -776,7 +833,7 @@ reg_idx_for_name(const ac_frame_t* frame, const char* reg_name)
  */
 void ac_extend_frame_map_for_spills(
         ac_frame_map_t* frame_map, temp_list_t* spill_live_outs,
-        Table_T allocation, Arena_T frag_arena)
+        temp_map_t allocation, Arena_T frag_arena)
 {
     const ac_frame_t* frame = frame_map->acfm_frame;
 
@@ -827,7 +884,7 @@ void ac_extend_frame_map_for_spills(
                 // was live during this call / allocation
                 && temp_list_contains(spill_live_outs, v->acf_spilled)
         ) {
-            const char* reg_name = Table_get(allocation, &v->acf_stored);
+            const char* reg_name = temp_map_get(allocation, v->acf_stored);
             if (reg_name == NULL) {
                 reg_name = "";
             }
@@ -852,7 +909,7 @@ void ac_extend_frame_map_for_spills(
                     // spilled.
                     assert(strlen(reg_name) > 0);
                     uint8_t reg_idx = reg_idx_for_name(frame, reg_name);
-                    assert(reg_idx != Table_length(frame->acf_temp_map));
+                    assert(reg_idx != frame->acf_temp_map.tm_len);
 
                     // we should only need to store the spilled registers
                     // when we don't know if they are pointers, and need
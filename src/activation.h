@@ -22,8 +22,8 @@ typedef struct ac_frame {
 
     const target_t* acf_target;
 
-    // The mapping from temp_t* to register names
-    Table_T acf_temp_map;
+    // The names of the registers of the machine temps
+    temp_map_t acf_temp_map;
 
     struct ac_frame_var {
         enum {
@@ -60,8 +60,11 @@ typedef struct ac_frame {
  */
 int ac_frame_words(const ac_frame_t* frame);
 
+struct translate_types_t;
+
 ac_frame_t* calculate_activation_records(
-        Arena_T frag_arena, const target_t*, temp_state_t*, sl_decl_t* program);
+        Arena_T frag_arena, const target_t*, temp_state_t*, sl_decl_t* program,
+        struct translate_types_t* types);
 size_t size_of_type(const sl_decl_t* program, sl_type_t* type);
 size_t alignment_of_type(const sl_decl_t* program, sl_type_t* type);
 
@@ -104,6 +107,7 @@ typedef struct ac_frame_map_t {
     uint64_t* acfm_locals; // Bitmap of ptrs in the space allocated for locals
     uint64_t* acfm_spills; // Bitmap indicating inherited ptr dispositions.
     ac_frame_t* acfm_frame; // The frame being mapped. (not owned)
+    int* acfm_defined_vars; // The var_ids in scope at the call, 0 terminated
 } ac_frame_map_t;
 
 /*
@@ -119,9 +123,25 @@ extern bool ac_debug;
 struct ac_frame_var* ac_spill_temporary(ac_frame_t* frame, temp_t t,
         Arena_T frag_arena);
 
+/*
+ * Adds a local to frame, with the size, alignment and pointer map of v, a
+ * local of another frame, and with the id var_id. This is for the locals of
+ * a function that is inlined into the function of frame.
+ */
+struct ac_frame_var* ac_copy_local(ac_frame_t* frame,
+        const struct ac_frame_var* v, int var_id, Arena_T frag_arena);
+
+/*
+ * Lets spilled temporaries share words of the frame. colours[i] is the
+ * colour of slots[i], and slots of the same colour are given the same word.
+ * locals_end is the last local offset before the first spill.
+ */
+void ac_share_spill_slots(ac_frame_t* frame, int locals_end,
+        struct ac_frame_var** slots, const int* colours, int num_slots);
+
 void ac_extend_frame_map_for_spills(
         ac_frame_map_t* frame_map, temp_list_t* spill_live_outs,
-        Table_T allocation, Arena_T frag_arena);
+        temp_map_t allocation, Arena_T frag_arena);
 
 
 /*
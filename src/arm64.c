@@ -37,6 +37,8 @@ typedef struct codegen_state_t {
  */
 #define Assm_oper(s, dst, src, jmp) \
     assm_oper(s, dst, src, jmp, state.ret_arena)
+#define Assm_remat(s, dst, src) \
+    assm_remat(s, dst, src, state.ret_arena)
 #define Assm_label(s, lbl) \
     assm_label(s, lbl, state.ret_arena)
 #define Assm_move(s, dst, src) \
@@ -157,9 +159,11 @@ static const char* suff(tree_exp_t* exp)
 
 
 // TODO: change the interface so this takes the buffer (or an arena)
+// Until then, the buffer is per thread since functions may be emitted in
+// parallel.
 static const char* arm64_register_for_size(const char* regname, size_t size)
 {
-    static char buf[8] = {};
+    static _Thread_local char buf[8] = {};
     assert(regname);
     assert(strlen(regname) >= 2 && strlen(regname) <= 3);
     assert(strcmp(regname, "sp")==0
@@ -203,6 +207,20 @@ arm64_store_temp(struct ac_frame_var* v, temp_t temp, Arena_T ar)
             ar);
 }
 
+/*
+ * Constants, label addresses and frame addresses, as munched by munch_exp,
+ * can be computed again wherever they are needed instead of being spilled.
+ */
+static assm_instr_t*
+arm64_rematerialise(const assm_instr_t* def, temp_t temp, Arena_T ar)
+{
+    if (def->ai_tag != ASSM_INSTR_OPER || !def->ai_oper_remat) {
+        return NULL;
+    }
+    var src_list = def->ai_oper_src ? temp_list(FP, ar) : NULL;
+    return assm_remat(def->ai_assem, temp_list(temp, ar), src_list, ar);
+}
+
 
 /*
  * Immediates in instructions can be shifted 16-bit values.
@@ -377,8 +395,13 @@ static temp_t munch_exp(codegen_state_t state, tree_exp_t* exp)
                     Asprintf(&s, "add	`d0, `s0, #%d\n",
                             exp->te_rhs->te_const);
                     var src_list = temp_list(Munch_exp(exp->te_lhs));
-                    emit(state,
-                            Assm_oper(s, temp_list(r), src_list, NULL));
+                    // BINOP(+, TEMP fp, CONST)
+                    bool is_frame_addr =
+                        exp->te_lhs->te_tag == TREE_EXP_TEMP
+                        && exp->te_lhs->te_temp.temp_id == FP.temp_id;
+                    emit(state, is_frame_addr
+                            ? Assm_remat(s, temp_list(r), src_list)
+                            : Assm_oper(s, temp_list(r), src_list, NULL));
                     return r;
                 }
                 tree_printf(stderr, "$$$ %E\n", exp);
@@ -418,7 +441,7 @@ static temp_t munch_exp(codegen_state_t state, tree_exp_t* exp)
             } else {
                 Asprintf(&s, "ldr	`d0, =%d\n", exp->te_const);
             }
-            emit(state, Assm_oper(s, temp_list(r), NULL, NULL));
+            emit(state, Assm_remat(s, temp_list(r), NULL));
             return r;
         }
         case TREE_EXP_TEMP:
@@ -432,16 +455,12 @@ static temp_t munch_exp(codegen_state_t state, tree_exp_t* exp)
              * A label pointing to some data (or maybe a function in the future)
              */
             temp_t r = new_temp_for_exp(state.temp_state, exp);
-            {
-                char* s = NULL;
-                Asprintf(&s, "adrp	`d0, %s@PAGE\n", exp->te_name);
-                emit(state, Assm_oper(s, temp_list(r), NULL, NULL));
-            }
-            {
-                char* s = NULL;
-                Asprintf(&s, "add	`d0, `s0, %s@PAGEOFF\n", exp->te_name);
-                emit(state, Assm_oper(s, temp_list(r), temp_list(r), NULL));
-            }
+            // As one instruction, so that r has a single definition that
+            // the register allocator can rematerialise
+            char* s = NULL;
+            Asprintf(&s, "adrp	`d0, %s@PAGE\n\tadd	`d0, `d0, %s@PAGEOFF\n",
+                    exp->te_name, exp->te_name);
+            emit(state, Assm_remat(s, temp_list(r), NULL));
             return r;
         }
         case TREE_EXP_CALL:
@@ -993,11 +1012,12 @@ static codegen_t arm64_codegen_module = {
     .proc_entry_exit_3 = arm64_proc_entry_exit_3,
     .load_temp = arm64_load_temp,
     .store_temp = arm64_store_temp,
+    .rematerialise = arm64_rematerialise,
     .emit_text_segment_header = emit_text_segment_header,
     .emit_data_segment = emit_data_segment,
 };
 
-static Table_T arm64_temp_map();
+static temp_map_t arm64_temp_map();
 
 const target_t target_arm64 = {
     .word_size = 8,
@@ -1022,33 +1042,14 @@ const target_t target_arm64 = {
 static_assert(NELEMS(arm64_callee_saves) <= TARGET_CS_COUNT_MAX,
         "callee save count");
 
-/*
- * These are used when we have Tables with temp_t's as keys
- */
-static int cmptemp(const void* x, const void* y)
-{
-    const temp_t* xx = x;
-    const temp_t* yy = y;
-    return xx->temp_id - yy->temp_id;
-}
-static unsigned hashtemp(const void* key)
+static temp_map_t arm64_temp_map()
 {
-    const temp_t* k = key;
-    return k->temp_id;
-}
-
-
-static Table_T arm64_temp_map()
-{
-    static Table_T result = NULL;
-    if (result)
-        return result;
-
-    result = Table_new(0, cmptemp, hashtemp);
-    for (int i = 0; i < NELEMS(arm64_registers); i++) {
-        Table_put(result,
-                &(arm64_temp_map_temps[i]),
-                (void*)arm64_registers[i]);
-    }
+    static_assert(NELEMS(arm64_temp_map_temps) == NELEMS(arm64_registers),
+            "arm64_temp_map_temps length");
+    // The machine registers are temps 0 to 31, in order
+    temp_map_t result = {
+        .tm_regs = arm64_registers,
+        .tm_len = NELEMS(arm64_registers),
+    };
     return result;
 }
@@ -1,6 +1,5 @@
 #include <string.h>
 #include <stdlib.h> // free
-#include <stdio.h> // snprintf
 #include "assem.h"
 #include "assertions.h"
 
@@ -22,6 +21,16 @@ assm_oper(
     return instr;
 }
 
+assm_instr_t*
+assm_remat(char* assem, temp_list_t* dst, temp_list_t* src, Arena_T arena)
+{
+    assert(dst && !dst->tmp_list);
+    assert(!src || !src->tmp_list);
+    assm_instr_t* instr = assm_oper(assem, dst, src, NULL, arena);
+    instr->ai_oper_remat = true;
+    return instr;
+}
+
 assm_instr_t*
 assm_label(char* assem, sl_sym_t label, Arena_T arena)
 {
@@ -54,128 +63,104 @@ temp_dispo_str(temp_t t)
     return "!!!!!!!";
 }
 
-// returns chars written not including null term
-static int format_temp(
-        char* const out, const size_t size, temp_t t, Table_T allocation,
-        const target_t* target)
+static void format_temp(
+        writer_t* w, temp_t t, temp_map_t allocation, const target_t* target)
 {
-    assert(size > 0);
-    char* o = out;
-    const char* allocated_reg = Table_get(allocation, &t);
+    const char* allocated_reg = temp_map_get(allocation, t);
     if (allocated_reg != NULL) {
-        char regname_buf[8] = {};
-        const char* sized_reg_name = target->register_for_size(allocated_reg, t.temp_size);
-        strncpy(regname_buf, sized_reg_name, sizeof(regname_buf) - 1);
-        int n = snprintf(o, size - (o - out), "%s", regname_buf);
-        assert(n > 0); // rudimentary error check lol
-        o += n;
+        wr_puts(w, target->register_for_size(allocated_reg, t.temp_size));
     } else {
-        int n = snprintf(o, size - (o - out), "t%d.%d%s", t.temp_id,
-                t.temp_size, temp_dispo_str(t));
-        assert(n > 0); // rudimentary error check lol
-        o += n;
+        wr_putc(w, 't');
+        wr_put_int(w, t.temp_id);
+        wr_putc(w, '.');
+        wr_put_int(w, t.temp_size);
+        wr_puts(w, temp_dispo_str(t));
+    }
+}
+
+/*
+ * Expands the template, replacing `s0 `d0 etc. with the temporaries
+ */
+static void
+format_template(
+        writer_t* w, const char* in, temp_t* temp_arrays[2], int num_temps[2],
+        temp_map_t allocation, const target_t* target)
+{
+    // indent a bit to start
+    wr_putc(w, '\t');
+
+    for (;;) {
+        const char* tick = strchr(in, '`');
+        if (!tick) {
+            wr_puts(w, in);
+            return;
+        }
+        wr_write(w, in, tick - in);
+        char s_or_d = tick[1];
+        assert(s_or_d == 's' || s_or_d == 'd');
+        int idx = tick[2] - '0';
+        assert(((unsigned)idx) < 8);
+        assert(idx < num_temps[s_or_d & 0x1]);
+        temp_t t = temp_arrays[s_or_d & 0x1][idx];
+        format_temp(w, t, allocation, target);
+        in = tick + 3;
     }
-    // Check the remaining space in the buffer
-    assert(size - (o - out) > 0);
-    *o++ = '\0';
-    return o - out - 1;
 }
 
 void
 assm_format(
-        char* const out, const size_t out_len, const assm_instr_t* instr,
-        Table_T allocation, const target_t* target)
+        writer_t* w, const assm_instr_t* instr, temp_map_t allocation,
+        const target_t* target)
 {
+    static_assert(('s' & 0x1) != ('d' & 0x1), "neat trick eh ;)");
+
     switch (instr->ai_tag) {
         case ASSM_INSTR_OPER:
         {
-            // replace `s0 `d0 with their temporaries
             // so, let's not go overboard
-            temp_t src_array[32] = {};
-            int i = 0;
-            for (var ti = instr->ai_oper_src; ti; ti = ti->tmp_list, i++) {
-                assert(i < 32);
-                src_array[i] = ti->tmp_temp;
+            temp_t src_array[32];
+            int num_src = 0;
+            for (var ti = instr->ai_oper_src; ti; ti = ti->tmp_list) {
+                assert(num_src < 32);
+                src_array[num_src++] = ti->tmp_temp;
             }
             // need to consider the number of temps that function calls can
             // trash
-            temp_t dst_array[32] = {};
-            i = 0;
-            for (var ti = instr->ai_oper_dst; ti; ti = ti->tmp_list, i++) {
-                assert(i < 32);
-                dst_array[i] = ti->tmp_temp;
+            temp_t dst_array[32];
+            int num_dst = 0;
+            for (var ti = instr->ai_oper_dst; ti; ti = ti->tmp_list) {
+                assert(num_dst < 32);
+                dst_array[num_dst++] = ti->tmp_temp;
             }
 
-            static_assert(('s' & 0x1) != ('d' & 0x1), "neat trick eh ;)");
             temp_t* temp_arrays[2];
             temp_arrays['s' & 0x1] = src_array;
             temp_arrays['d' & 0x1] = dst_array;
+            int num_temps[2];
+            num_temps['s' & 0x1] = num_src;
+            num_temps['d' & 0x1] = num_dst;
 
-            char c = 0;
-            char* o = out;
-            const char* in = instr->ai_assem;
-
-            // indent a bit to start
-            *o++ = '\t';
-
-            while ((c = *in++) != 0) {
-                if (c == '`') {
-                    char s_or_d = *in++;
-                    assert(s_or_d == 's' || s_or_d == 'd');
-                    c = *in++;
-                    int idx = c - '0';
-                    assert(((unsigned)idx) < 8);
-                    temp_t* temp_array = temp_arrays[s_or_d & 0x1];
-                    temp_t t = temp_array[idx];
-                    // at this point we would like to call our temp_formatting
-                    // function
-                    o += format_temp(o, out_len - (o - out), t, allocation, target);
-                } else {
-                    *o++ = c;
-                }
-                assert(o - out < out_len);
-            }
-            assert(o - out < out_len);
-            *o++ = '\0';
+            format_template(w, instr->ai_assem, temp_arrays, num_temps,
+                    allocation, target);
             return;
         }
         case ASSM_INSTR_LABEL:
         {
-            strncpy(out, instr->ai_assem, out_len - 1);
-            out[out_len - 1] = '\0';
+            wr_puts(w, instr->ai_assem);
             return;
         }
         case ASSM_INSTR_MOVE:
         {
-            // this shall have exactly 1 src and 1 dst each
-            //
-            // maybe we can do this one with scanf ?
-            char* o = out;
-            char parts[10][10] = {};
-            int ret = sscanf(instr->ai_assem,
-                    "%[^`]%3[`sd0-9]%[^`]%3[`sd0-9]%[^`]",
-                    parts[0], parts[1], parts[2], parts[3], parts[4]);
-            assert(ret == 5);
-
-            // allow for either order
-            assert(parts[1][1] == 's' || parts[1][1] == 'd');
-            assert(parts[3][1] == 's' || parts[3][1] == 'd');
-
-            *o++ = '\t'; // indent
-            o += snprintf(o, out_len - (o - out), "%s", parts[0]);
-            if (parts[1][1] == 's') {
-                o += format_temp(o, out_len - (o - out), instr->ai_move_src, allocation, target);
-            } else {
-                o += format_temp(o, out_len - (o - out), instr->ai_move_dst, allocation, target);
-            }
-            o += snprintf(o, out_len - (o - out), "%s", parts[2]);
-            if (parts[3][1] == 's') {
-                o += format_temp(o, out_len - (o - out), instr->ai_move_src, allocation, target);
-            } else {
-                o += format_temp(o, out_len - (o - out), instr->ai_move_dst, allocation, target);
-            }
-            o += snprintf(o, out_len - (o - out), "%s", parts[4]);
-            *o++ = '\0';
+            // this shall have exactly 1 src and 1 dst each, in either order
+            temp_t src = instr->ai_move_src;
+            temp_t dst = instr->ai_move_dst;
+            temp_t* temp_arrays[2];
+            temp_arrays['s' & 0x1] = &src;
+            temp_arrays['d' & 0x1] = &dst;
+            int num_temps[2] = {1, 1};
+
+            format_template(w, instr->ai_assem, temp_arrays, num_temps,
+                    allocation, target);
             return;
         }
     }
@@ -7,6 +7,7 @@
 #include "interfaces/arena.h"
 #include "interfaces/table.h"
 #include "target.h"
+#include "writer.h"
 
 typedef struct assm_instr_t assm_instr_t;
 
@@ -24,6 +25,7 @@ struct assm_instr_t {
             temp_list_t* ai_oper_dst;
             temp_list_t* ai_oper_src;
             sl_sym_t* ai_oper_jump; // label list option
+            bool ai_oper_remat; // see assm_remat
         }; // OPER
         sl_sym_t ai_label; // LABEL
         struct {
@@ -38,16 +40,26 @@ assm_instr_t* assm_oper(
         char* assem, temp_list_t* dst, temp_list_t* src, sl_sym_t* jump,
         Arena_T);
 
+/*
+ * An OPER with no jumps that defines its one dst from a constant, the
+ * address of a label or an address in the frame, reading at most the
+ * frame pointer. The register allocator may repeat it instead of
+ * spilling dst.
+ */
+assm_instr_t* assm_remat(
+        char* assem, temp_list_t* dst, temp_list_t* src, Arena_T);
+
 assm_instr_t* assm_label(char* assem, sl_sym_t label, Arena_T);
 
 assm_instr_t* assm_move(char* assem, temp_t dst, temp_t src, Arena_T);
 
 /*
- * The caller provides an adequately sized buffer `out` of size `out_len`
- * that the formatted instruction is written into.
+ * Appends the formatted instruction to w. Temporaries that have been
+ * allocated a register are shown by the register name.
  */
-void assm_format(char* const out, const size_t out_len,
-        const assm_instr_t* instr, Table_T allocation, const target_t* target);
+void assm_format(writer_t* w,
+        const assm_instr_t* instr, temp_map_t allocation,
+        const target_t* target);
 
 assm_instr_t* assm_list_reverse(assm_instr_t*);
 
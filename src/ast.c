@@ -3,6 +3,12 @@
 #include <stdarg.h> // va_start, va_arg, va_end
 #include <string.h> // memset
 #include <assert.h> // assert
+#include <errno.h>
+#include <pthread.h>
+#include <fcntl.h> // open
+#include <sys/mman.h> // mmap, munmap
+#include <sys/stat.h> // fstat
+#include <unistd.h> // read, close, sysconf
 #include "ast.h"
 #include "interfaces/arena.h"
 #include "grammar.tab.h"
@@ -12,7 +18,14 @@
 /* Line number from flex lexer */
 extern int yylineno;
 
-Arena_T ast_arena = NULL; // The current arena for allocating nodes
+/* For scanning the input in place */
+typedef struct yy_buffer_state* YY_BUFFER_STATE;
+extern YY_BUFFER_STATE yy_scan_buffer(char* base, size_t size);
+extern void yy_delete_buffer(YY_BUFFER_STATE buffer);
+
+// The current arena for allocating nodes. Thread local so that files may
+// be compiled in parallel.
+_Thread_local Arena_T ast_arena = NULL;
 
 
 static sl_decl_t* dl_alloc(int tag)
@@ -533,11 +546,6 @@ int ty_cmp(sl_type_t* t1, sl_type_t* t2)
     }
 }
 
-/*
- * Defined by the flex lexer
- */
-extern FILE* yyin;
-
 /*
  * Tells flex that once it reaches EOF, that there's no new yyin.
  * i.e. it's over.
@@ -556,11 +564,122 @@ void yyerror(sl_parse_param_t* pp, const char* msg)
 }
 
 /*
- * parse_file is not reentrant
+ * The text of an input file. flex's yy_scan_buffer requires that the
+ * buffer ends with two NULs, which are included in the size.
+ */
+typedef struct source_text {
+    char* srct_base;
+    size_t srct_size;
+    bool srct_mapped; // otherwise malloc'd
+} source_text_t;
+
+/* Reads the rest of fd into a malloc'd buffer */
+static bool read_source(int fd, source_text_t* text)
+{
+    size_t len = 0, cap = 64 * 1024;
+    char* buf = malloc(cap);
+    for (;;) {
+        if (!buf) {
+            return false;
+        }
+        if (cap - len < 2) {
+            cap *= 2;
+            char* new_buf = realloc(buf, cap);
+            if (!new_buf) {
+                free(buf);
+            }
+            buf = new_buf;
+            continue;
+        }
+        ssize_t n = read(fd, buf + len, cap - len - 2);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            free(buf);
+            return false;
+        }
+        if (n == 0) {
+            break;
+        }
+        len += n;
+    }
+    buf[len] = buf[len + 1] = '\0';
+    *text = (source_text_t){
+        .srct_base = buf,
+        .srct_size = len + 2,
+    };
+    return true;
+}
+
+/*
+ * Maps the file into memory so that the lexer can scan it without copying
+ * it. The mapping is private and writable, since flex writes NULs into the
+ * buffer after each token while it is being matched. When the file fills
+ * its last page, there is no room for the NULs, so it is read instead, as
+ * are pipes and the like.
+ */
+static bool load_source(const char* filename, source_text_t* text)
+{
+    if (strcmp(filename, "-") == 0) {
+        return read_source(STDIN_FILENO, text);
+    }
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    bool result = false;
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        goto cleanup;
+    }
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    size_t tail_room = (page_size - st.st_size % page_size) % page_size;
+    if (!S_ISREG(st.st_mode) || st.st_size == 0 || tail_room < 2) {
+        result = read_source(fd, text);
+        goto cleanup;
+    }
+
+    // The rest of the last page is filled with zeros
+    size_t size = st.st_size + 2;
+    char* base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (base == MAP_FAILED) {
+        result = read_source(fd, text);
+        goto cleanup;
+    }
+    madvise(base, size, MADV_SEQUENTIAL);
+    *text = (source_text_t){
+        .srct_base = base,
+        .srct_size = size,
+        .srct_mapped = true,
+    };
+    result = true;
+cleanup:
+    close(fd);
+    return result;
+}
+
+static void unload_source(source_text_t* text)
+{
+    if (text->srct_mapped) {
+        munmap(text->srct_base, text->srct_size);
+    } else {
+        free(text->srct_base);
+    }
+    *text = (source_text_t){};
+}
+
+/*
+ * The lexer and parser are not reentrant, so only one file may be parsed
+ * at a time.
  */
+static pthread_mutex_t parse_lock = PTHREAD_MUTEX_INITIALIZER;
+
 sl_decl_t* parse_file(Arena_T arena, const char* filename)
 {
     sl_decl_t* result = NULL;
+    pthread_mutex_lock(&parse_lock);
     ast_arena = arena;
     sl_parse_param_t parse_param = {
         .slpp_filename = NULL,
@@ -568,32 +687,30 @@ sl_decl_t* parse_file(Arena_T arena, const char* filename)
         .slpp_root = NULL,
     };
 
-    FILE* old_yyin = yyin;
+    bool is_stdin = strcmp(filename, "-") == 0;
+    parse_param.slpp_filename = is_stdin ? "<stdin>" : filename;
 
-    if (strcmp(filename, "-") == 0) {
-        yyin = stdin; // default anyway
-        parse_param.slpp_filename = "<stdin>";
-    } else {
-        yyin = fopen(filename, "r");
-        if (!yyin) {
-            perror(filename);
-            goto cleanup;
-        }
-        parse_param.slpp_filename = filename;
+    source_text_t text;
+    if (!load_source(filename, &text)) {
+        perror(is_stdin ? "<stdin>" : filename);
+        goto cleanup;
     }
-
+    YY_BUFFER_STATE buffer = yy_scan_buffer(text.srct_base, text.srct_size);
+    assert(buffer);
+    yylineno = 1;
 
     if (yyparse(&parse_param) == 0) {
         result = parse_param.slpp_root;
     }
 
+    // Identifiers are interned, so nothing refers to the text any more
+    yy_delete_buffer(buffer);
+    unload_source(&text);
+
 cleanup:
     // Restore state
     ast_arena = NULL; // This will break shit
-    if (yyin != NULL && yyin != stdin) {
-        fclose(yyin);
-    }
-    yyin = old_yyin;
+    pthread_mutex_unlock(&parse_lock);
 
     return result;
 }
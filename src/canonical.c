@@ -1,5 +1,7 @@
 #include "canonical.h"
 #include <stdbool.h> /* bool */
+#include <stdint.h> /* uint64_t */
+#include <string.h> /* memset */
 #include "interfaces/arena.h"
 #include "interfaces/table.h"
 #include "array.h"
@@ -792,6 +794,62 @@ get_unmarked(Table_T block_by_label, sl_sym_t lbl)
     return NULL;
 }
 
+/*
+ * Removes the blocks that cannot be reached from the first, such as those
+ * after a return or a break, so that they are not scheduled
+ */
+static void
+remove_unreachable_blocks(canon_info_t* info, basic_blocks_t* blocks)
+{
+    Table_T by_label = Table_new(0, NULL, NULL);
+    int num_blocks = 0;
+    for (basic_block_t* b = blocks->bb_blocks; b; b = b->bb_list) {
+        Table_put(by_label, label_for_block(b), b);
+        num_blocks++;
+    }
+
+    // a depth first search from the first block, marking each block found
+    basic_block_t** stack = Alloc(info->scratch, num_blocks * sizeof *stack);
+    int sp = 0;
+    blocks->bb_blocks->bb_marked = true;
+    stack[sp++] = blocks->bb_blocks;
+    while (sp > 0) {
+        tree_stm_t* last = last_stm_in_block(stack[--sp]);
+        sl_sym_t cjump_labels[2];
+        sl_sym_t* labels = cjump_labels;
+        int num_labels = 2;
+        if (last->tst_tag == TREE_STM_JUMP) {
+            labels = last->tst_jump_labels;
+            num_labels = last->tst_jump_num_labels;
+        } else {
+            cjump_labels[0] = last->tst_cjump_true;
+            cjump_labels[1] = last->tst_cjump_false;
+        }
+        for (int i = 0; i < num_labels; i++) {
+            var c = get_unmarked(by_label, labels[i]);
+            if (c) {
+                c->bb_marked = true;
+                stack[sp++] = c;
+            }
+        }
+    }
+    Table_free(&by_label);
+
+    // unmark the blocks again, for trace_schedule
+    for (var pb = &blocks->bb_blocks; *pb; ) {
+        if ((*pb)->bb_marked) {
+            (*pb)->bb_marked = false;
+            pb = &(*pb)->bb_list;
+        } else {
+            if (debug) {
+                tree_printf(stderr, "removing unreachable block: %S\n",
+                        (*pb)->bb_stmts);
+            }
+            *pb = (*pb)->bb_list;
+        }
+    }
+}
+
 static tree_stm_t*
 trace_schedule(canon_info_t* info, basic_blocks_t blocks)
 {
@@ -958,6 +1016,652 @@ static void verify_basic_blocks(basic_blocks_t blocks, const char* check)
     assert(err == 0);
 }
 
+/*
+ * Local value numbering. Within a basic block, an expression that is
+ * computed again with the same operands (and, for a load, with no store or
+ * call in between) is computed once, into a new temp, and then reused.
+ * Everything is forgotten at a call, so that these temps, which may hold
+ * derived pointers, are never live across one.
+ */
+
+typedef struct vn_key_t {
+    int vk_tag; // TREE_EXP_CONST, TEMP, BINOP or MEM
+    int vk_op; // the binop, the constant or the temp_id
+    int vk_lhs; // the value numbers of the operands, or the address
+    int vk_rhs; // or, for loads, the stores seen so far
+    int vk_size;
+    int vk_dispo;
+} vn_key_t;
+
+typedef struct vn_entry_t {
+    struct vn_entry_t* child[4];
+    vn_key_t key;
+    int vn;
+} vn_entry_t;
+
+typedef struct vn_state_t {
+    canon_info_t* info;
+    vn_entry_t* values; // for the current block
+    int num_stores;
+    bool saw_call;
+    // The value number of each BINOP and MEM, in the order visited, or 0 if
+    // it is not to be reused
+    arrtype(int) occurrences;
+    int next_occurrence;
+    arrtype(int) counts; // occurrences, by value number
+    tree_exp_t** holders; // the temp holding each value number
+    tree_stm_t* hoisted; // moves into holders, to go before the statement
+    tree_stm_t** hoisted_end;
+} vn_state_t;
+
+static uint32_t vn_key_hash(const vn_key_t* k)
+{
+    uint64_t h = 0x100;
+    const int fields[] = {
+        k->vk_tag, k->vk_op, k->vk_lhs, k->vk_rhs, k->vk_size, k->vk_dispo,
+    };
+    for (int i = 0; i < 6; i++) {
+        h ^= (uint32_t)fields[i];
+        h *= 1111111111111111111;
+    }
+    return h ^ h>>32;
+}
+
+static bool vn_key_eq(const vn_key_t* a, const vn_key_t* b)
+{
+    return a->vk_tag == b->vk_tag && a->vk_op == b->vk_op
+        && a->vk_lhs == b->vk_lhs && a->vk_rhs == b->vk_rhs
+        && a->vk_size == b->vk_size && a->vk_dispo == b->vk_dispo;
+}
+
+static vn_entry_t* vn_upsert(vn_state_t* st, vn_key_t key)
+{
+    vn_entry_t** m = &st->values;
+    for (uint32_t h = vn_key_hash(&key); *m; h <<= 2) {
+        if (vn_key_eq(&key, &(*m)->key)) {
+            return *m;
+        }
+        m = &(*m)->child[h>>30];
+    }
+    *m = Alloc(st->info->scratch, sizeof **m);
+    (*m)->key = key;
+    return *m;
+}
+
+static int vn_new(vn_state_t* st)
+{
+    arrpush(&st->counts, st->info->scratch, 0);
+    return st->counts.len - 1;
+}
+
+static int vn_lookup(vn_state_t* st, vn_key_t key)
+{
+    var entry = vn_upsert(st, key);
+    if (!entry->vn) {
+        entry->vn = vn_new(st);
+    }
+    return entry->vn;
+}
+
+static vn_key_t vn_temp_key(temp_t t)
+{
+    return (vn_key_t){ .vk_tag = TREE_EXP_TEMP, .vk_op = t.temp_id };
+}
+
+/*
+ * Additions of constants to temps are left where they are, since they are
+ * as cheap as the move that would replace them, and can become part of
+ * the addressing mode of a load or store.
+ */
+static bool vn_is_cheap(tree_exp_t* e)
+{
+    return e->te_tag == TREE_EXP_BINOP
+        && (e->te_binop == TREE_BINOP_PLUS || e->te_binop == TREE_BINOP_MINUS)
+        && e->te_lhs->te_tag == TREE_EXP_TEMP
+        && e->te_rhs->te_tag == TREE_EXP_CONST;
+}
+
+/*
+ * Records an occurrence of the value vn, whose subexpressions' occurrences
+ * start at first. When the value has been seen before, the whole of this
+ * occurrence will be replaced, and so the ones within it no longer count.
+ */
+static int vn_occurs(vn_state_t* st, int first, int vn, bool reusable)
+{
+    int occurrence = reusable ? vn : 0;
+    if (occurrence && st->counts.data[vn] > 0) {
+        for (int i = first; i < st->occurrences.len; i++) {
+            int inner = st->occurrences.data[i];
+            if (inner) {
+                st->counts.data[inner]--;
+                st->occurrences.data[i] = 0;
+            }
+        }
+    }
+    if (occurrence) {
+        st->counts.data[vn]++;
+    }
+    arrpush(&st->occurrences, st->info->scratch, occurrence);
+    return vn;
+}
+
+/* Returns the value number of e, or 0 if it cannot be known */
+static int vn_exp(vn_state_t* st, tree_exp_t* e)
+{
+    int first = st->occurrences.len;
+    switch (e->te_tag) {
+        case TREE_EXP_CONST:
+            return vn_lookup(st, (vn_key_t){
+                .vk_tag = TREE_EXP_CONST, .vk_op = e->te_const,
+                .vk_size = e->te_size,
+            });
+        case TREE_EXP_NAME:
+            return 0;
+        case TREE_EXP_TEMP:
+            // non-fp machine registers are easily clobbered by calls.
+            if (temp_is_machine(e->te_temp)
+                    && e->te_temp.temp_id != st->info->target->tgt_fp.temp_id) {
+                return 0;
+            }
+            return vn_lookup(st, vn_temp_key(e->te_temp));
+        case TREE_EXP_BINOP:
+        {
+            int lhs = vn_exp(st, e->te_lhs);
+            int rhs = vn_exp(st, e->te_rhs);
+            int vn = (lhs && rhs) ? vn_lookup(st, (vn_key_t){
+                .vk_tag = TREE_EXP_BINOP, .vk_op = e->te_binop,
+                .vk_lhs = lhs, .vk_rhs = rhs, .vk_size = e->te_size,
+                .vk_dispo = tree_dispo_from_type(e->te_type),
+            }) : 0;
+            return vn_occurs(st, first, vn, !vn_is_cheap(e));
+        }
+        case TREE_EXP_MEM:
+        {
+            int addr = vn_exp(st, e->te_mem_addr);
+            int vn = (addr && e->te_size <= ac_word_size) ? vn_lookup(st,
+                (vn_key_t){
+                    .vk_tag = TREE_EXP_MEM, .vk_lhs = addr,
+                    .vk_rhs = st->num_stores, .vk_size = e->te_size,
+                    .vk_dispo = tree_dispo_from_type(e->te_type),
+                }) : 0;
+            return vn_occurs(st, first, vn, true);
+        }
+        case TREE_EXP_CALL:
+            vn_exp(st, e->te_func);
+            for (var arg = e->te_args; arg; arg = arg->te_list) {
+                vn_exp(st, arg);
+            }
+            st->saw_call = true;
+            return 0;
+        case TREE_EXP_ESEQ:
+            assert(!"ESEQs should have been removed");
+    }
+}
+
+static void vn_stm(vn_state_t* st, tree_stm_t* s)
+{
+    st->saw_call = false;
+    switch (s->tst_tag) {
+        case TREE_STM_MOVE:
+        {
+            var dst = s->tst_move_dst;
+            if (dst->te_tag == TREE_EXP_MEM) {
+                vn_exp(st, dst->te_mem_addr);
+            }
+            int vn = vn_exp(st, s->tst_move_exp);
+            if (dst->te_tag == TREE_EXP_MEM) {
+                st->num_stores++;
+            } else if (dst->te_tag == TREE_EXP_TEMP
+                    && !temp_is_machine(dst->te_temp)) {
+                vn_upsert(st, vn_temp_key(dst->te_temp))->vn =
+                    vn ? vn : vn_new(st);
+            }
+            break;
+        }
+        case TREE_STM_EXP:
+            vn_exp(st, s->tst_exp);
+            break;
+        case TREE_STM_JUMP:
+            vn_exp(st, s->tst_jump_dst);
+            break;
+        case TREE_STM_CJUMP:
+            vn_exp(st, s->tst_cjump_lhs);
+            vn_exp(st, s->tst_cjump_rhs);
+            break;
+        case TREE_STM_SEQ:
+            assert(!"SEQs should have been removed");
+        case TREE_STM_LABEL:
+            // The start of a block
+            st->values = NULL;
+            break;
+    }
+    if (st->saw_call) {
+        st->values = NULL;
+    }
+}
+
+/*
+ * Rewrites e, visiting the BINOPs and MEMs in the same order as vn_exp
+ */
+static tree_exp_t* vn_rewrite_exp(vn_state_t* st, tree_exp_t* e)
+{
+    var ar = st->info->arena;
+    switch (e->te_tag) {
+        case TREE_EXP_CONST:
+        case TREE_EXP_NAME:
+        case TREE_EXP_TEMP:
+            return e;
+        case TREE_EXP_BINOP:
+            e->te_lhs = vn_rewrite_exp(st, e->te_lhs);
+            e->te_rhs = vn_rewrite_exp(st, e->te_rhs);
+            break;
+        case TREE_EXP_MEM:
+            e->te_mem_addr = vn_rewrite_exp(st, e->te_mem_addr);
+            break;
+        case TREE_EXP_CALL:
+            e->te_func = vn_rewrite_exp(st, e->te_func);
+            for (var parg = &e->te_args; *parg; parg = &(*parg)->te_list) {
+                var next = (*parg)->te_list;
+                *parg = vn_rewrite_exp(st, *parg);
+                (*parg)->te_list = next;
+            }
+            return e;
+        case TREE_EXP_ESEQ:
+            assert(!"ESEQs should have been removed");
+    }
+
+    int vn = st->occurrences.data[st->next_occurrence++];
+    if (!vn || st->counts.data[vn] < 2) {
+        return e;
+    }
+    var holder = st->holders[vn];
+    if (!holder) {
+        var t = temp_newtemp(st->info->temp_state, e->te_size,
+                tree_dispo_from_type(e->te_type));
+        holder = tree_exp_temp(t, e->te_size, e->te_type, ar);
+        st->holders[vn] = holder;
+        e->te_list = NULL;
+        *st->hoisted_end = tree_stm_move(holder, e, ar);
+        st->hoisted_end = &(*st->hoisted_end)->tst_list;
+    }
+    return tree_exp_temp(holder->te_temp, e->te_size, e->te_type, ar);
+}
+
+static void vn_rewrite_stm(vn_state_t* st, tree_stm_t* s)
+{
+    switch (s->tst_tag) {
+        case TREE_STM_MOVE:
+        {
+            var dst = s->tst_move_dst;
+            if (dst->te_tag == TREE_EXP_MEM) {
+                dst->te_mem_addr = vn_rewrite_exp(st, dst->te_mem_addr);
+            }
+            s->tst_move_exp = vn_rewrite_exp(st, s->tst_move_exp);
+            break;
+        }
+        case TREE_STM_EXP:
+            s->tst_exp = vn_rewrite_exp(st, s->tst_exp);
+            break;
+        case TREE_STM_JUMP:
+            s->tst_jump_dst = vn_rewrite_exp(st, s->tst_jump_dst);
+            break;
+        case TREE_STM_CJUMP:
+            s->tst_cjump_lhs = vn_rewrite_exp(st, s->tst_cjump_lhs);
+            s->tst_cjump_rhs = vn_rewrite_exp(st, s->tst_cjump_rhs);
+            break;
+        case TREE_STM_SEQ:
+            assert(!"SEQs should have been removed");
+        case TREE_STM_LABEL:
+            break;
+    }
+}
+
+static tree_stm_t* value_number(canon_info_t* info, tree_stm_t* stmts)
+{
+    vn_state_t st = { .info = info };
+    vn_new(&st); // so that 0 is not a value number
+
+    for (var s = stmts; s; s = s->tst_list) {
+        vn_stm(&st, s);
+    }
+
+    st.holders = Alloc(info->scratch, st.counts.len * sizeof *st.holders);
+    tree_stm_t* result = stmts;
+    for (tree_stm_t** link = &result; *link; ) {
+        var s = *link;
+        st.hoisted = NULL;
+        st.hoisted_end = &st.hoisted;
+        vn_rewrite_stm(&st, s);
+        if (st.hoisted) {
+            *st.hoisted_end = s;
+            *link = st.hoisted;
+        }
+        link = &s->tst_list;
+    }
+    assert(st.next_occurrence == st.occurrences.len);
+    return result;
+}
+
+/*
+ * Dead code elimination. A move into a temp that is not live after it is
+ * removed, as long as computing the value has no effect. Calls are kept,
+ * and so are loads and divisions, since they may fault. Moves into machine
+ * registers are kept too, as the calling convention and the exit of the
+ * function use them. Liveness is solved over the basic blocks of the
+ * scheduled statements, and solved again after each round of removals,
+ * since those can leave more moves dead.
+ */
+
+typedef struct dce_index_t {
+    struct dce_index_t* child[4];
+    int temp_id;
+    int index;
+} dce_index_t;
+
+typedef struct dce_block_t {
+    int db_start; // the statements, by index
+    int db_end;
+    arrtype(int) db_succs;
+    uint64_t* db_use; // the temps used before they are defined
+    uint64_t* db_def;
+    uint64_t* db_in;
+    uint64_t* db_out;
+} dce_block_t;
+
+typedef struct dce_state_t {
+    canon_info_t* info;
+    dce_index_t* indices; // dense numbers for the non-machine temps
+    int num_temps;
+    int num_words; // in a set of temps
+} dce_state_t;
+
+static int dce_index(dce_state_t* st, temp_t t)
+{
+    if (temp_is_machine(t)) {
+        return -1;
+    }
+    dce_index_t** m = &st->indices;
+    uint64_t h64 = (uint32_t)t.temp_id * 1111111111111111111u;
+    for (uint32_t h = h64 ^ h64>>32; *m; h <<= 2) {
+        if ((*m)->temp_id == t.temp_id) {
+            return (*m)->index;
+        }
+        m = &(*m)->child[h>>30];
+    }
+    *m = Alloc(st->info->scratch, sizeof **m);
+    (*m)->temp_id = t.temp_id;
+    (*m)->index = st->num_temps++;
+    return (*m)->index;
+}
+
+/* Adds the temps used by e to the set, or only numbers them if it is NULL */
+static void dce_exp_uses(dce_state_t* st, tree_exp_t* e, uint64_t* set)
+{
+    switch (e->te_tag) {
+        case TREE_EXP_CONST:
+        case TREE_EXP_NAME:
+            return;
+        case TREE_EXP_TEMP:
+        {
+            int i = dce_index(st, e->te_temp);
+            if (i >= 0 && set) {
+                set[i / 64] |= (uint64_t)1 << (i % 64);
+            }
+            return;
+        }
+        case TREE_EXP_BINOP:
+            dce_exp_uses(st, e->te_lhs, set);
+            dce_exp_uses(st, e->te_rhs, set);
+            return;
+        case TREE_EXP_MEM:
+            dce_exp_uses(st, e->te_mem_addr, set);
+            return;
+        case TREE_EXP_CALL:
+            dce_exp_uses(st, e->te_func, set);
+            for (var arg = e->te_args; arg; arg = arg->te_list) {
+                dce_exp_uses(st, arg, set);
+            }
+            return;
+        case TREE_EXP_ESEQ:
+            assert(!"ESEQs should have been removed");
+            return;
+    }
+}
+
+/* The temp that s defines, or -1 */
+static int dce_def(dce_state_t* st, tree_stm_t* s)
+{
+    if (s->tst_tag == TREE_STM_MOVE
+            && s->tst_move_dst->te_tag == TREE_EXP_TEMP) {
+        return dce_index(st, s->tst_move_dst->te_temp);
+    }
+    return -1;
+}
+
+static void dce_stm_uses(dce_state_t* st, tree_stm_t* s, uint64_t* set)
+{
+    switch (s->tst_tag) {
+        case TREE_STM_MOVE:
+            if (s->tst_move_dst->te_tag == TREE_EXP_MEM) {
+                dce_exp_uses(st, s->tst_move_dst->te_mem_addr, set);
+            }
+            dce_exp_uses(st, s->tst_move_exp, set);
+            return;
+        case TREE_STM_EXP:
+            dce_exp_uses(st, s->tst_exp, set);
+            return;
+        case TREE_STM_JUMP:
+            dce_exp_uses(st, s->tst_jump_dst, set);
+            return;
+        case TREE_STM_CJUMP:
+            dce_exp_uses(st, s->tst_cjump_lhs, set);
+            dce_exp_uses(st, s->tst_cjump_rhs, set);
+            return;
+        case TREE_STM_SEQ:
+            assert(!"SEQs should have been removed");
+            return;
+        case TREE_STM_LABEL:
+            return;
+    }
+}
+
+/* Whether evaluating e has no effect, other than giving its value */
+static bool dce_is_pure(tree_exp_t* e)
+{
+    switch (e->te_tag) {
+        case TREE_EXP_CONST:
+        case TREE_EXP_NAME:
+        case TREE_EXP_TEMP:
+            return true;
+        case TREE_EXP_BINOP:
+            return e->te_binop != TREE_BINOP_DIV
+                && dce_is_pure(e->te_lhs) && dce_is_pure(e->te_rhs);
+        case TREE_EXP_MEM:
+        case TREE_EXP_CALL:
+        case TREE_EXP_ESEQ:
+            return false;
+    }
+}
+
+static void dce_block_sets(dce_state_t* st, dce_block_t* b,
+        tree_stm_t** stmts, const bool* removed)
+{
+    int num_words = st->num_words;
+    memset(b->db_use, 0, num_words * sizeof *b->db_use);
+    memset(b->db_def, 0, num_words * sizeof *b->db_def);
+    memset(b->db_in, 0, num_words * sizeof *b->db_in);
+    for (int i = b->db_end - 1; i >= b->db_start; i--) {
+        if (removed[i]) {
+            continue;
+        }
+        int d = dce_def(st, stmts[i]);
+        if (d >= 0) {
+            b->db_def[d / 64] |= (uint64_t)1 << (d % 64);
+            b->db_use[d / 64] &= ~((uint64_t)1 << (d % 64));
+        }
+        dce_stm_uses(st, stmts[i], b->db_use);
+    }
+}
+
+/* Removes the dead moves of one block, given what is live out of it */
+static int dce_block_remove(dce_state_t* st, dce_block_t* b,
+        tree_stm_t** stmts, bool* removed, uint64_t* live)
+{
+    int num_removed = 0;
+    memcpy(live, b->db_out, st->num_words * sizeof *live);
+    for (int i = b->db_end - 1; i >= b->db_start; i--) {
+        if (removed[i]) {
+            continue;
+        }
+        var s = stmts[i];
+        int d = dce_def(st, s);
+        bool dead =
+            (d >= 0 && !(live[d / 64] & (uint64_t)1 << (d % 64))
+                && dce_is_pure(s->tst_move_exp))
+            || (s->tst_tag == TREE_STM_EXP && dce_is_pure(s->tst_exp));
+        if (dead) {
+            if (debug) {
+                tree_printf(stderr, "removing dead definition: %S\n", s);
+            }
+            removed[i] = true;
+            num_removed++;
+            continue;
+        }
+        if (d >= 0) {
+            live[d / 64] &= ~((uint64_t)1 << (d % 64));
+        }
+        dce_stm_uses(st, s, live);
+    }
+    return num_removed;
+}
+
+static tree_stm_t*
+remove_dead_definitions(canon_info_t* info, tree_stm_t* stmts)
+{
+    dce_state_t st = { .info = info };
+    arrtype(tree_stm_t*) all = {};
+    for (var s = stmts; s; s = s->tst_list) {
+        // NOLINTNEXTLINE(bugprone-sizeof-expression)
+        arrpush(&all, info->scratch, s);
+        dce_stm_uses(&st, s, NULL);
+        dce_def(&st, s);
+    }
+    if (st.num_temps == 0) {
+        return stmts;
+    }
+    st.num_words = (st.num_temps + 63) / 64;
+
+    // split the statements into blocks at each label
+    arrtype(dce_block_t) blocks = {};
+    Table_T by_label = Table_new(0, NULL, NULL);
+    for (int i = 0; i < all.len; i++) {
+        if (i == 0 || all.data[i]->tst_tag == TREE_STM_LABEL) {
+            if (i > 0) {
+                arrlast(blocks).db_end = i;
+            }
+            arrpush(&blocks, info->scratch, (dce_block_t){ .db_start = i });
+        }
+        if (all.data[i]->tst_tag == TREE_STM_LABEL) {
+            Table_put(by_label, all.data[i]->tst_label,
+                    (void*)(intptr_t)blocks.len);
+        }
+    }
+    arrlast(blocks).db_end = all.len;
+
+    for (int b = 0; b < blocks.len; b++) {
+        var blk = &blocks.data[b];
+        var last = all.data[blk->db_end - 1];
+        if (last->tst_tag == TREE_STM_JUMP) {
+            for (int i = 0; i < last->tst_jump_num_labels; i++) {
+                intptr_t succ = (intptr_t)Table_get(by_label,
+                        last->tst_jump_labels[i]);
+                if (succ) {
+                    arrpush(&blk->db_succs, info->scratch, succ - 1);
+                }
+            }
+        } else if (last->tst_tag == TREE_STM_CJUMP) {
+            intptr_t t = (intptr_t)Table_get(by_label, last->tst_cjump_true);
+            intptr_t f = (intptr_t)Table_get(by_label, last->tst_cjump_false);
+            if (t) {
+                arrpush(&blk->db_succs, info->scratch, t - 1);
+            }
+            if (f) {
+                arrpush(&blk->db_succs, info->scratch, f - 1);
+            }
+        } else if (b + 1 < blocks.len) {
+            arrpush(&blk->db_succs, info->scratch, b + 1);
+        }
+        size_t set_size = st.num_words * sizeof(uint64_t);
+        blk->db_use = Alloc(info->scratch, set_size);
+        blk->db_def = Alloc(info->scratch, set_size);
+        blk->db_in = Alloc(info->scratch, set_size);
+        blk->db_out = Alloc(info->scratch, set_size);
+    }
+    Table_free(&by_label);
+
+    bool* removed = Alloc(info->scratch, all.len * sizeof *removed);
+    uint64_t* live = Alloc(info->scratch, st.num_words * sizeof *live);
+    for (int num_removed = 1; num_removed > 0; ) {
+        for (int b = 0; b < blocks.len; b++) {
+            dce_block_sets(&st, &blocks.data[b], all.data, removed);
+        }
+        // in = use ∪ (out - def), out = ∪ in[succ], until nothing changes
+        for (bool changed = true; changed; ) {
+            changed = false;
+            for (int b = blocks.len - 1; b >= 0; b--) {
+                var blk = &blocks.data[b];
+                for (int w = 0; w < st.num_words; w++) {
+                    uint64_t out = 0;
+                    for (int i = 0; i < blk->db_succs.len; i++) {
+                        out |= blocks.data[blk->db_succs.data[i]].db_in[w];
+                    }
+                    uint64_t in = blk->db_use[w] | (out & ~blk->db_def[w]);
+                    changed |= in != blk->db_in[w];
+                    blk->db_out[w] = out;
+                    blk->db_in[w] = in;
+                }
+            }
+        }
+        num_removed = 0;
+        for (int b = 0; b < blocks.len; b++) {
+            num_removed += dce_block_remove(
+                    &st, &blocks.data[b], all.data, removed, live);
+        }
+    }
+
+    tree_stm_t* result = NULL;
+    tree_stm_t** link = &result;
+    for (int i = 0; i < all.len; i++) {
+        if (!removed[i]) {
+            *link = all.data[i];
+            link = &all.data[i]->tst_list;
+        }
+    }
+    *link = NULL;
+    return result;
+}
+
+static void canonicalise_code(canon_info_t* info, sl_fragment_t* frag)
+{
+    frag->fr_body = linearise(info, frag->fr_body);
+    verify_statements(frag->fr_body, "post-linearise");
+
+    var blocks = basic_blocks(info, frag->fr_body);
+    verify_basic_blocks(blocks, "post-basic_blocks");
+
+    remove_unreachable_blocks(info, &blocks);
+    verify_basic_blocks(blocks, "post-remove_unreachable_blocks");
+
+    frag->fr_body = trace_schedule(info, blocks);
+    verify_statements(frag->fr_body, "post-trace_schedule");
+
+    frag->fr_body = value_number(info, frag->fr_body);
+    verify_statements(frag->fr_body, "post-value_number");
+
+    frag->fr_body = remove_dead_definitions(info, frag->fr_body);
+    verify_statements(frag->fr_body, "post-remove_dead_definitions");
+}
+
 void
 canonicalise_tree(
         Arena_T arena, const target_t* target, temp_state_t* temp_state,
@@ -973,17 +1677,8 @@ canonicalise_tree(
     for (var frag = fragments; frag; frag = frag->fr_list) {
         switch (frag->fr_tag) {
             case FR_CODE:
-            {
-                frag->fr_body = linearise(&info, frag->fr_body);
-                verify_statements(frag->fr_body, "post-linearise");
-
-                var blocks = basic_blocks(&info, frag->fr_body);
-                verify_basic_blocks(blocks, "post-basic_blocks");
-
-                frag->fr_body = trace_schedule(&info, blocks);
-                verify_statements(frag->fr_body, "post-trace_schedule");
+                canonicalise_code(&info, frag);
                 break;
-            }
             case FR_STRING:
             case FR_FRAME_MAP:
                 continue;
@@ -993,3 +1688,19 @@ canonicalise_tree(
 
     Arena_dispose(&info.scratch);
 }
+
+void
+canonicalise_fragment(
+        Arena_T arena, const target_t* target, temp_state_t* temp_state,
+        sl_fragment_t* frag)
+{
+    assert(frag->fr_tag == FR_CODE);
+    canon_info_t info = {
+        .temp_state = temp_state,
+        .target = target,
+        .arena = arena,
+        .scratch = Arena_new(),
+    };
+    canonicalise_code(&info, frag);
+    Arena_dispose(&info.scratch);
+}
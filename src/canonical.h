@@ -8,5 +8,10 @@ void canonicalise_tree(
         Arena_T, const target_t* target, temp_state_t* temp_state,
         sl_fragment_t* fragments);
 
+/* Canonicalises a single FR_CODE fragment */
+void canonicalise_fragment(
+        Arena_T, const target_t* target, temp_state_t* temp_state,
+        sl_fragment_t* frag);
+
 
 #endif /* __CANONICAL_H__ */
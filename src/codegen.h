@@ -34,6 +34,16 @@ typedef struct codegen_t {
     assm_instr_t* (*load_temp)(struct ac_frame_var*, temp_t, Arena_T);
     assm_instr_t* (*store_temp)(struct ac_frame_var*, temp_t, Arena_T);
 
+    /*
+     * If def, the only definition of a temporary, computes a value that
+     * can be computed again anywhere in the function - a constant, the
+     * address of a label or an address in the frame, as tagged by
+     * assm_remat - this returns a copy of it that defines temp instead.
+     * Otherwise it returns NULL.
+     * The register allocator uses this instead of spilling.
+     */
+    assm_instr_t* (*rematerialise)(const assm_instr_t* def, temp_t, Arena_T);
+
 
     void (*emit_text_segment_header)(FILE* out);
 
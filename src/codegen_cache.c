@@ -0,0 +1,800 @@
+#include "codegen_cache.h"
+#include <ctype.h> // isalnum
+#include <errno.h>
+#include <inttypes.h> // PRIu64
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h> // mkstemp, free
+#include <string.h>
+#include <sys/stat.h> // mkdir
+#include <unistd.h> // unlink
+#include "activation.h"
+#include "array.h"
+#include "assertions.h"
+#include "build_id.h" // STRUCTLANGC_BUILD_ID
+
+#define var __auto_type
+#define Alloc(arena, size) Arena_alloc(arena, size, __FILE__, __LINE__)
+#define NELEMS(A) ((sizeof A) / sizeof A[0])
+#define BitsetLen(len) (((len) + 63) / 64)
+
+/* Change this whenever the format of the entries or the keys changes */
+static const char cache_magic[] = "structlangc-cache 1";
+
+/*
+ * Any change to the backend may change what it emits, so entries are
+ * only used by the build of the compiler that stored them. The build ID
+ * is a checksum of the other objects, made by the Makefile.
+ */
+static const char compiler_build[] = STRUCTLANGC_BUILD_ID;
+
+/* Marks the references to labels in the stored assembly */
+enum { LABEL_REF_START = '\x01', LABEL_REF_END = '\x02' };
+
+struct cc_cache {
+    const char* dir;
+    const target_t* target;
+    enum ra_algorithm regalloc;
+    Table_T string_labels; // sl_sym_t -> const char*
+};
+
+struct cc_key {
+    writer_t cck_material; // what the hash is of, kept to check entries
+    uint64_t cck_hash;
+    Arena_T cck_arena;
+    Table_T cck_label_idx; // sl_sym_t -> 1 + index in cck_labels
+    arrtype(sl_sym_t) cck_labels;
+    Table_T cck_temp_idx; // temp id -> 1 + the order it was found
+    int cck_num_temps;
+    Table_T cck_defined; // labels defined in the function
+};
+
+cc_cache_t* cc_new(const char* dir, const target_t* target,
+        enum ra_algorithm regalloc, Arena_T arena)
+{
+    if (mkdir(dir, 0777) != 0 && errno != EEXIST) {
+        perror(dir);
+        return NULL;
+    }
+
+    cc_cache_t* cache = Alloc(arena, sizeof *cache);
+    cache->dir = dir;
+    cache->target = target;
+    cache->regalloc = regalloc;
+    cache->string_labels = Table_new(0, NULL, NULL);
+    return cache;
+}
+
+void cc_add_strings(cc_cache_t* cache, const sl_fragment_t* fragments)
+{
+    for (var frag = fragments; frag; frag = frag->fr_list) {
+        if (frag->fr_tag == FR_STRING) {
+            Table_put(cache->string_labels, frag->fr_label,
+                    (void*)frag->fr_string);
+        }
+    }
+}
+
+void cc_dispose(cc_cache_t** pcache)
+{
+    assert(pcache && *pcache);
+    Table_free(&(*pcache)->string_labels);
+    *pcache = NULL;
+}
+
+static int cmp_temp_id(const void* x, const void* y)
+{
+    return (x < y) ? -1 : (x > y);
+}
+
+static unsigned hash_temp_id(const void* key)
+{
+    return (uintptr_t)key;
+}
+
+static uint64_t fnv1a(const char* data, size_t len)
+{
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)data[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+/*
+ * The key is built up as a string, of space separated ints, strings
+ * prefixed with their length, and single character tags.
+ */
+
+static void key_tag(cc_key_t* key, char tag)
+{
+    wr_putc(&key->cck_material, tag);
+}
+
+static void key_int(cc_key_t* key, long x)
+{
+    wr_put_int(&key->cck_material, x);
+    wr_putc(&key->cck_material, ' ');
+}
+
+static void key_str(cc_key_t* key, const char* s)
+{
+    size_t len = strlen(s);
+    key_int(key, len);
+    wr_write(&key->cck_material, s, len);
+}
+
+/*
+ * Temps are numbered across the whole program, so are renumbered in the
+ * order they are found. Machine registers keep their numbers.
+ */
+static void key_temp(cc_key_t* key, temp_t t)
+{
+    long id = t.temp_id;
+    if (!temp_is_machine(t)) {
+        const void* id_key = (const void*)(uintptr_t)t.temp_id;
+        id = (intptr_t)Table_get(key->cck_temp_idx, id_key);
+        if (!id) {
+            id = ++key->cck_num_temps;
+            Table_put(key->cck_temp_idx, id_key, (void*)(intptr_t)id);
+        }
+        id = -id;
+    }
+    key_int(key, id);
+    key_int(key, t.temp_size);
+    key_int(key, t.temp_ptr_dispo);
+}
+
+static void key_label(cc_cache_t* cache, cc_key_t* key, sl_sym_t label)
+{
+    intptr_t idx = (intptr_t)Table_get(key->cck_label_idx, label);
+    if (idx) {
+        key_tag(key, 'l');
+        key_int(key, idx - 1);
+        return;
+    }
+    const char* string = Table_get(cache->string_labels, label);
+    if (string || Table_get(key->cck_defined, label)) {
+        arrpush(&key->cck_labels, key->cck_arena, label);
+        idx = key->cck_labels.len;
+        Table_put(key->cck_label_idx, label, (void*)idx);
+        key_tag(key, 'l');
+        key_int(key, idx - 1);
+        if (string) {
+            key_tag(key, 's');
+            key_str(key, string);
+        }
+        return;
+    }
+    // A function, or something else outside this one
+    key_tag(key, 'g');
+    key_str(key, label);
+}
+
+static void key_bitset(cc_key_t* key, const uint64_t* bitset, int num_bits)
+{
+    for (int i = 0; i < BitsetLen(num_bits); i++) {
+        key_int(key, bitset[i] & INT64_MAX);
+        key_int(key, bitset[i] >> 63);
+    }
+}
+
+static void key_frame_map(cc_key_t* key, const ac_frame_map_t* map)
+{
+    if (!map) {
+        key_tag(key, '-');
+        return;
+    }
+    key_int(key, map->acfm_num_arg_words);
+    key_int(key, map->acfm_num_local_words);
+    key_int(key, map->acfm_num_spill_words);
+    for (int i = 0; i < NELEMS(map->acfm_spill_reg); i++) {
+        key_int(key, map->acfm_spill_reg[i]);
+    }
+    key_bitset(key, map->acfm_args, map->acfm_num_arg_words);
+    key_bitset(key, map->acfm_locals, map->acfm_num_local_words);
+    key_bitset(key, map->acfm_spills, map->acfm_num_spill_words);
+}
+
+static void key_stm(cc_cache_t* cache, cc_key_t* key, const tree_stm_t* stm);
+
+static void key_exp(cc_cache_t* cache, cc_key_t* key, const tree_exp_t* exp)
+{
+    key_int(key, exp->te_tag);
+    key_int(key, exp->te_size);
+    // Only the pointer disposition is used by the backend
+    key_int(key, exp->te_type ? tree_dispo_from_type(exp->te_type) : 0);
+    switch (exp->te_tag) {
+        case TREE_EXP_CONST:
+            key_int(key, exp->te_const);
+            return;
+        case TREE_EXP_NAME:
+            key_label(cache, key, exp->te_name);
+            return;
+        case TREE_EXP_TEMP:
+            key_temp(key, exp->te_temp);
+            return;
+        case TREE_EXP_BINOP:
+            key_int(key, exp->te_binop);
+            key_exp(cache, key, exp->te_lhs);
+            key_exp(cache, key, exp->te_rhs);
+            return;
+        case TREE_EXP_MEM:
+            key_exp(cache, key, exp->te_mem_addr);
+            return;
+        case TREE_EXP_CALL:
+            key_exp(cache, key, exp->te_func);
+            for (var arg = exp->te_args; arg; arg = arg->te_list) {
+                key_tag(key, ',');
+                key_exp(cache, key, arg);
+            }
+            key_tag(key, ')');
+            key_frame_map(key, exp->te_ptr_map);
+            return;
+        case TREE_EXP_ESEQ:
+            key_stm(cache, key, exp->te_eseq_stm);
+            key_exp(cache, key, exp->te_eseq_exp);
+            return;
+    }
+    assert(!"unknown expression");
+}
+
+static void key_stm(cc_cache_t* cache, cc_key_t* key, const tree_stm_t* stm)
+{
+    key_int(key, stm->tst_tag);
+    switch (stm->tst_tag) {
+        case TREE_STM_MOVE:
+            key_exp(cache, key, stm->tst_move_dst);
+            key_exp(cache, key, stm->tst_move_exp);
+            return;
+        case TREE_STM_EXP:
+            key_exp(cache, key, stm->tst_exp);
+            return;
+        case TREE_STM_JUMP:
+            key_exp(cache, key, stm->tst_jump_dst);
+            key_int(key, stm->tst_jump_num_labels);
+            for (int i = 0; i < stm->tst_jump_num_labels; i++) {
+                key_label(cache, key, stm->tst_jump_labels[i]);
+            }
+            return;
+        case TREE_STM_CJUMP:
+            key_int(key, stm->tst_cjump_op);
+            key_exp(cache, key, stm->tst_cjump_lhs);
+            key_exp(cache, key, stm->tst_cjump_rhs);
+            key_label(cache, key, stm->tst_cjump_true);
+            key_label(cache, key, stm->tst_cjump_false);
+            return;
+        case TREE_STM_SEQ:
+            key_stm(cache, key, stm->tst_seq_s1);
+            key_stm(cache, key, stm->tst_seq_s2);
+            return;
+        case TREE_STM_LABEL:
+            key_label(cache, key, stm->tst_label);
+            return;
+    }
+    assert(!"unknown statement");
+}
+
+static void key_frame(cc_key_t* key, const ac_frame_t* frame)
+{
+    key_str(key, frame->acf_name);
+    key_int(key, frame->acf_last_local_offset);
+    key_int(key, frame->acf_next_arg_offset);
+    key_int(key, frame->acf_next_arg_reg);
+    key_int(key, frame->acf_outgoing_arg_bytes);
+    size_t word_size = frame->acf_target->word_size;
+    for (var v = frame->ac_frame_vars; v; v = v->acf_list) {
+        key_tag(key, 'v');
+        key_int(key, v->acf_tag);
+        key_int(key, v->acf_size);
+        key_int(key, v->acf_alignment);
+        if (v->acf_tag == ACF_ACCESS_FRAME) {
+            key_int(key, v->acf_offset);
+        } else {
+            key_temp(key, v->acf_reg);
+        }
+        key_int(key, v->acf_is_formal);
+        if (v->acf_ptr_map) {
+            key_bitset(key, v->acf_ptr_map,
+                    (v->acf_size + word_size - 1) / word_size);
+        } else {
+            key_tag(key, '-');
+        }
+    }
+}
+
+static void find_defined_labels_exp(Table_T defined, const tree_exp_t* exp);
+
+static void find_defined_labels(Table_T defined, const tree_stm_t* stm)
+{
+    switch (stm->tst_tag) {
+        case TREE_STM_MOVE:
+            find_defined_labels_exp(defined, stm->tst_move_dst);
+            find_defined_labels_exp(defined, stm->tst_move_exp);
+            return;
+        case TREE_STM_EXP:
+            find_defined_labels_exp(defined, stm->tst_exp);
+            return;
+        case TREE_STM_JUMP:
+        case TREE_STM_CJUMP:
+            return;
+        case TREE_STM_SEQ:
+            find_defined_labels(defined, stm->tst_seq_s1);
+            find_defined_labels(defined, stm->tst_seq_s2);
+            return;
+        case TREE_STM_LABEL:
+            Table_put(defined, stm->tst_label, (void*)stm->tst_label);
+            return;
+    }
+}
+
+static void find_defined_labels_exp(Table_T defined, const tree_exp_t* exp)
+{
+    switch (exp->te_tag) {
+        case TREE_EXP_CONST:
+        case TREE_EXP_NAME:
+        case TREE_EXP_TEMP:
+            return;
+        case TREE_EXP_BINOP:
+            find_defined_labels_exp(defined, exp->te_lhs);
+            find_defined_labels_exp(defined, exp->te_rhs);
+            return;
+        case TREE_EXP_MEM:
+            find_defined_labels_exp(defined, exp->te_mem_addr);
+            return;
+        case TREE_EXP_CALL:
+            for (var arg = exp->te_args; arg; arg = arg->te_list) {
+                find_defined_labels_exp(defined, arg);
+            }
+            return;
+        case TREE_EXP_ESEQ:
+            find_defined_labels(defined, exp->te_eseq_stm);
+            find_defined_labels_exp(defined, exp->te_eseq_exp);
+            return;
+    }
+}
+
+cc_key_t* cc_key(cc_cache_t* cache, const sl_fragment_t* frag, Arena_T arena)
+{
+    assert(frag->fr_tag == FR_CODE);
+    cc_key_t* key = Alloc(arena, sizeof *key);
+    key->cck_arena = arena;
+    wr_init(&key->cck_material, NULL);
+    key->cck_label_idx = Table_new(0, NULL, NULL);
+    key->cck_temp_idx = Table_new(0, cmp_temp_id, hash_temp_id);
+    key->cck_defined = Table_new(0, NULL, NULL);
+    for (var s = frag->fr_body; s; s = s->tst_list) {
+        find_defined_labels(key->cck_defined, s);
+    }
+
+    key_str(key, cache_magic);
+    key_str(key, compiler_build);
+    key_str(key, (cache->target == &target_arm64) ? "arm64" : "x86_64");
+    key_str(key, ra_algorithm_name(cache->regalloc));
+    key_frame(key, frag->fr_frame);
+    for (var s = frag->fr_body; s; s = s->tst_list) {
+        key_tag(key, ';');
+        key_stm(cache, key, s);
+    }
+
+    Table_free(&key->cck_defined);
+    Table_free(&key->cck_temp_idx);
+    key->cck_hash =
+        fnv1a(key->cck_material.wr_buf, key->cck_material.wr_len);
+    return key;
+}
+
+void cc_key_dispose(cc_key_t* key)
+{
+    wr_dispose(&key->cck_material);
+    Table_free(&key->cck_label_idx);
+}
+
+static char* entry_path(const cc_cache_t* cache, const cc_key_t* key)
+{
+    size_t len = strlen(cache->dir) + 32;
+    char* path = malloc(len);
+    if (!path) {
+        perror("out of memory");
+        abort();
+    }
+    snprintf(path, len, "%s/%016" PRIx64 ".slc", cache->dir, key->cck_hash);
+    return path;
+}
+
+/* Reads a length, which is followed by exactly one newline */
+static bool read_size(FILE* f, size_t* size)
+{
+    return fscanf(f, "%zu", size) == 1 && fgetc(f) == '\n';
+}
+
+struct entry_map {
+    int em_label_idx;
+    uint32_t em_cs_bitmap;
+    ac_frame_map_t em_map;
+};
+
+bool cc_lookup(cc_cache_t* cache, const cc_key_t* key, sl_fragment_t* frag,
+        temp_state_t* temp_state, Table_T label_to_cs_bitmap,
+        writer_t* w, Arena_T frag_arena)
+{
+    char* path = entry_path(cache, key);
+    FILE* f = fopen(path, "r");
+    free(path);
+    if (!f) {
+        return false;
+    }
+
+    bool hit = false;
+    char* buf = NULL;
+    char magic[sizeof cache_magic] = {};
+    if (fread(magic, 1, sizeof magic, f) != sizeof magic
+            || memcmp(magic, cache_magic, sizeof magic - 1) != 0
+            || magic[sizeof magic - 1] != '\n') {
+        goto cleanup;
+    }
+
+    // Check that it really is our entry, not just the same hash
+    size_t key_len = 0;
+    if (!read_size(f, &key_len) || key_len != key->cck_material.wr_len) {
+        goto cleanup;
+    }
+    buf = malloc(key_len);
+    if (!buf) {
+        goto cleanup;
+    }
+    if (fread(buf, 1, key_len, f) != key_len
+            || memcmp(buf, key->cck_material.wr_buf, key_len) != 0) {
+        goto cleanup;
+    }
+    free(buf);
+    buf = NULL;
+
+    // The labels of the tree are those of the key, and those created by
+    // the backend are stored by their prefix
+    int num_tree_labels = 0, num_labels = 0;
+    if (fscanf(f, "%d %d", &num_tree_labels, &num_labels) != 2
+            || num_tree_labels != key->cck_labels.len
+            || num_labels < num_tree_labels) {
+        goto cleanup;
+    }
+    char (*prefixes)[32] = Alloc(frag_arena,
+            (num_labels - num_tree_labels + 1) * sizeof *prefixes);
+    for (int i = num_tree_labels; i < num_labels; i++) {
+        if (fscanf(f, "%31s", prefixes[i - num_tree_labels]) != 1
+                || prefixes[i - num_tree_labels][0] != 'L') {
+            goto cleanup;
+        }
+    }
+
+    int num_maps = 0;
+    if (fscanf(f, "%d", &num_maps) != 1 || num_maps < 0) {
+        goto cleanup;
+    }
+    struct entry_map* maps =
+        Alloc(frag_arena, (num_maps + 1) * sizeof *maps);
+    for (int i = 0; i < num_maps; i++) {
+        var em = &maps[i];
+        var map = &em->em_map;
+        if (fscanf(f, "%d %" SCNu32 " %d %d %d", &em->em_label_idx,
+                    &em->em_cs_bitmap, &map->acfm_num_arg_words,
+                    &map->acfm_num_local_words,
+                    &map->acfm_num_spill_words) != 5
+                || em->em_label_idx < 0 || em->em_label_idx >= num_labels
+                || map->acfm_num_arg_words < 0
+                || map->acfm_num_local_words < 0
+                || map->acfm_num_spill_words < 0) {
+            goto cleanup;
+        }
+        for (int j = 0; j < NELEMS(map->acfm_spill_reg); j++) {
+            if (fscanf(f, "%" SCNu8, &map->acfm_spill_reg[j]) != 1) {
+                goto cleanup;
+            }
+        }
+        struct { uint64_t** bitset; int num_bits; } bitsets[] = {
+            { &map->acfm_args, map->acfm_num_arg_words },
+            { &map->acfm_locals, map->acfm_num_local_words },
+            { &map->acfm_spills, map->acfm_num_spill_words },
+        };
+        for (int j = 0; j < NELEMS(bitsets); j++) {
+            int len = BitsetLen(bitsets[j].num_bits);
+            uint64_t* bitset =
+                Alloc(frag_arena, (len + 1) * sizeof *bitset);
+            for (int k = 0; k < len; k++) {
+                if (fscanf(f, "%" SCNu64, &bitset[k]) != 1) {
+                    goto cleanup;
+                }
+            }
+            *bitsets[j].bitset = bitset;
+        }
+        map->acfm_frame = frag->fr_frame;
+    }
+
+    size_t text_len = 0;
+    if (fgetc(f) != '\n' || !read_size(f, &text_len)) {
+        goto cleanup;
+    }
+    buf = malloc(text_len + 1);
+    if (!buf || fread(buf, 1, text_len, f) != text_len) {
+        goto cleanup;
+    }
+    buf[text_len] = '\0';
+
+    // Everything has been read, so now the entry can be used
+
+    sl_sym_t* labels = Alloc(frag_arena, (num_labels + 1) * sizeof *labels);
+    for (int i = 0; i < num_labels; i++) {
+        if (i < num_tree_labels) {
+            labels[i] = key->cck_labels.data[i];
+        } else if (prefixes[i - num_tree_labels][1] == '\0') {
+            labels[i] = temp_newlabel(temp_state);
+        } else {
+            labels[i] = temp_prefixedlabel(temp_state,
+                    prefixes[i - num_tree_labels] + 1);
+        }
+    }
+
+    size_t start_len = w->wr_len;
+    for (const char* c = buf; c < buf + text_len; ) {
+        const char* ref = memchr(c, LABEL_REF_START, buf + text_len - c);
+        if (!ref) {
+            wr_write(w, c, buf + text_len - c);
+            break;
+        }
+        wr_write(w, c, ref - c);
+        char* end = NULL;
+        long idx = strtol(ref + 1, &end, 10);
+        if (*end != LABEL_REF_END || idx < 0 || idx >= num_labels) {
+            w->wr_len = start_len;
+            goto cleanup;
+        }
+        wr_puts(w, labels[idx]);
+        c = end + 1;
+    }
+
+    // The frame maps go after the code fragment, as instruction selection
+    // would have put them.
+    sl_fragment_t* maps_head = NULL;
+    sl_fragment_t* maps_tail = NULL;
+    for (int i = 0; i < num_maps; i++) {
+        ac_frame_map_t* map = Alloc(frag_arena, sizeof(ac_frame_map_t));
+        *map = maps[i].em_map;
+        sl_sym_t ret_label = labels[maps[i].em_label_idx];
+        var map_frag = sl_frame_map_fragment(map, ret_label, frag_arena);
+        if (maps_tail) {
+            maps_tail->fr_list = map_frag;
+        } else {
+            maps_head = map_frag;
+        }
+        maps_tail = map_frag;
+
+        if (maps[i].em_cs_bitmap) {
+            // Table_T only accepts non-zero pointers as values.
+            union { uint32_t i32; void* v; } table_value = {
+                .i32 = maps[i].em_cs_bitmap
+            };
+            Table_put(label_to_cs_bitmap, ret_label, table_value.v);
+        }
+    }
+    if (maps_tail) {
+        maps_tail->fr_list = frag->fr_list;
+        frag->fr_list = maps_head;
+    }
+    hit = true;
+
+cleanup:
+    free(buf);
+    fclose(f);
+    return hit;
+}
+
+static bool is_label_char(char c)
+{
+    return isalnum((unsigned char)c) || c == '_' || c == '$' || c == '.';
+}
+
+/*
+ * Labels created by temp_newlabel and temp_prefixedlabel look like
+ * L<prefix><n>. Returns the length of L<prefix>, or 0 if it doesn't.
+ */
+static int label_prefix_len(sl_sym_t label)
+{
+    int len = strlen(label);
+    int prefix_len = len;
+    while (prefix_len > 0 && isdigit((unsigned char)label[prefix_len - 1])) {
+        prefix_len--;
+    }
+    if (label[0] != 'L' || prefix_len == len || prefix_len >= 32) {
+        return 0;
+    }
+    for (int i = 1; i < prefix_len; i++) {
+        if (!islower((unsigned char)label[i])) {
+            return 0;
+        }
+    }
+    return prefix_len;
+}
+
+void cc_store(cc_cache_t* cache, const cc_key_t* key,
+        const sl_fragment_t* frag, const assm_instr_t* instrs,
+        const char* text, size_t text_len, Table_T label_to_cs_bitmap)
+{
+    assert(frag->fr_tag == FR_CODE);
+    // Only labels that look like ours are renamed in the text
+    for (int i = 0; i < key->cck_labels.len; i++) {
+        if (!label_prefix_len(key->cck_labels.data[i])) {
+            return;
+        }
+    }
+    if (memchr(text, LABEL_REF_START, text_len)) {
+        return;
+    }
+
+    Arena_T arena = Arena_new();
+    Table_T label_idx = Table_new(0, NULL, NULL);
+    arrtype(sl_sym_t) labels = {};
+    for (int i = 0; i < key->cck_labels.len; i++) {
+        arrpush(&labels, arena, key->cck_labels.data[i]);
+        Table_put(label_idx, labels.data[i], (void*)(intptr_t)labels.len);
+    }
+
+    // Then the labels that the backend created
+    char* path = NULL;
+    char* tmp_path = NULL;
+    FILE* f = NULL;
+    for (var instr = instrs; instr; instr = instr->ai_list) {
+        if (instr->ai_tag != ASSM_INSTR_LABEL
+                || Table_get(label_idx, instr->ai_label)) {
+            continue;
+        }
+        if (!label_prefix_len(instr->ai_label)) {
+            goto cleanup;
+        }
+        arrpush(&labels, arena, instr->ai_label);
+        Table_put(label_idx, instr->ai_label, (void*)(intptr_t)labels.len);
+    }
+
+    path = entry_path(cache, key);
+    tmp_path = malloc(strlen(cache->dir) + 32);
+    if (!tmp_path) {
+        goto cleanup;
+    }
+    sprintf(tmp_path, "%s/.tmp-XXXXXX", cache->dir);
+    int fd = mkstemp(tmp_path);
+    if (fd < 0 || (f = fdopen(fd, "w")) == NULL) {
+        if (fd >= 0) {
+            close(fd);
+            unlink(tmp_path);
+        }
+        free(tmp_path);
+        tmp_path = NULL;
+        goto cleanup;
+    }
+
+    writer_t w;
+    wr_init(&w, f);
+    wr_puts(&w, cache_magic);
+    wr_putc(&w, '\n');
+    wr_put_int(&w, key->cck_material.wr_len);
+    wr_putc(&w, '\n');
+    wr_write(&w, key->cck_material.wr_buf, key->cck_material.wr_len);
+
+    wr_put_int(&w, key->cck_labels.len);
+    wr_putc(&w, ' ');
+    wr_put_int(&w, labels.len);
+    wr_putc(&w, '\n');
+    for (int i = key->cck_labels.len; i < labels.len; i++) {
+        wr_write(&w, labels.data[i], label_prefix_len(labels.data[i]));
+        wr_putc(&w, '\n');
+    }
+
+    int num_maps = 0;
+    for (var map_frag = frag->fr_list;
+            map_frag && map_frag->fr_tag != FR_CODE;
+            map_frag = map_frag->fr_list) {
+        num_maps += (map_frag->fr_tag == FR_FRAME_MAP);
+    }
+    wr_put_int(&w, num_maps);
+    wr_putc(&w, '\n');
+    for (var map_frag = frag->fr_list;
+            map_frag && map_frag->fr_tag != FR_CODE;
+            map_frag = map_frag->fr_list) {
+        if (map_frag->fr_tag != FR_FRAME_MAP) {
+            continue;
+        }
+        intptr_t idx = (intptr_t)Table_get(label_idx, map_frag->fr_ret_label);
+        if (!idx) {
+            wr_dispose(&w);
+            goto cleanup;
+        }
+        union { uint32_t i32; void* v; } cs_bitmap = {};
+        cs_bitmap.v = Table_get(label_to_cs_bitmap, map_frag->fr_ret_label);
+        var map = map_frag->fr_map;
+        wr_put_int(&w, idx - 1);
+        wr_putc(&w, ' ');
+        wr_put_int(&w, cs_bitmap.i32);
+        int counts[] = {
+            map->acfm_num_arg_words,
+            map->acfm_num_local_words,
+            map->acfm_num_spill_words,
+        };
+        for (int i = 0; i < NELEMS(counts); i++) {
+            wr_putc(&w, ' ');
+            wr_put_int(&w, counts[i]);
+        }
+        for (int i = 0; i < NELEMS(map->acfm_spill_reg); i++) {
+            wr_putc(&w, ' ');
+            wr_put_int(&w, map->acfm_spill_reg[i]);
+        }
+        const uint64_t* bitsets[] = {
+            map->acfm_args, map->acfm_locals, map->acfm_spills,
+        };
+        for (int i = 0; i < NELEMS(bitsets); i++) {
+            for (int j = 0; j < BitsetLen(counts[i]); j++) {
+                // wr_put_int is for signed values
+                char digits[24];
+                int n = snprintf(digits, sizeof digits, " %" PRIu64,
+                        bitsets[i][j]);
+                wr_write(&w, digits, n);
+            }
+        }
+        wr_putc(&w, '\n');
+    }
+
+    // The text, with our labels replaced by references. It's long, so is
+    // written to a buffer first in order to know its length.
+    writer_t body;
+    wr_init(&body, NULL);
+    for (size_t i = 0; i < text_len; ) {
+        if (text[i] != 'L' || (i > 0 && is_label_char(text[i - 1]))) {
+            wr_putc(&body, text[i++]);
+            continue;
+        }
+        size_t end = i + 1;
+        while (end < text_len && is_label_char(text[end])) {
+            end++;
+        }
+        intptr_t idx =
+            (intptr_t)Table_get(label_idx, Atom_new(text + i, end - i));
+        if (idx) {
+            wr_putc(&body, LABEL_REF_START);
+            wr_put_int(&body, idx - 1);
+            wr_putc(&body, LABEL_REF_END);
+        } else {
+            wr_write(&body, text + i, end - i);
+        }
+        i = end;
+    }
+    wr_put_int(&w, body.wr_len);
+    wr_putc(&w, '\n');
+    wr_write(&w, body.wr_buf, body.wr_len);
+    wr_dispose(&body);
+    // e.g. the disk is full; the partial entry is removed below
+    wr_flush(&w);
+    bool written = !w.wr_error;
+    wr_dispose(&w);
+
+    // The stream is gone after fclose, even when it fails
+    int closed = fclose(f);
+    f = NULL;
+    if (written && closed == 0) {
+        // Renaming is atomic, so readers see either the whole entry or none
+        if (rename(tmp_path, path) == 0) {
+            free(tmp_path);
+            tmp_path = NULL;
+        }
+    }
+
+cleanup:
+    if (f) {
+        fclose(f);
+    }
+    if (tmp_path) {
+        unlink(tmp_path);
+        free(tmp_path);
+    }
+    free(path);
+    Table_free(&label_idx);
+    Arena_dispose(&arena);
+}
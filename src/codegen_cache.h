@@ -0,0 +1,80 @@
+#ifndef __CODEGEN_CACHE_H__
+#define __CODEGEN_CACHE_H__
+// vim:ft=c:
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "assem.h"
+#include "fragment.h"
+#include "target.h"
+#include "temp.h"
+#include "writer.h"
+#include "reg_alloc.h" // enum ra_algorithm
+#include "interfaces/arena.h"
+#include "interfaces/table.h"
+
+/*
+ * An on-disk cache of what the backend produces for each function, for
+ * --cache-dir.
+ *
+ * Entries are keyed by the canonical tree IR of the function, its frame,
+ * the target and the register allocator. The labels that belong to the
+ * function are numbered in the order they are found, so that an unchanged
+ * function has the same key even when the labels in the rest of the
+ * program are renumbered.
+ * Calls are keyed by the callee's name, the arguments and the frame map
+ * at the call, and string literals by their contents. So a change to a
+ * struct layout or to the signature of a callee changes the key of every
+ * function that depends on it.
+ *
+ * An entry holds the final assembly, with the function's labels replaced
+ * by references that are resolved when the entry is used, as well as the
+ * frame map and callee-save bitmap for each call site.
+ */
+typedef struct cc_cache cc_cache_t;
+typedef struct cc_key cc_key_t;
+
+/*
+ * Opens the cache in dir, creating the directory if need be. Returns NULL,
+ * having reported why, if the cache cannot be used.
+ */
+cc_cache_t* cc_new(const char* dir, const target_t* target,
+        enum ra_algorithm regalloc, Arena_T arena);
+
+/*
+ * Tells the cache about the strings in a list of fragments. This must be
+ * done for the strings a function refers to before its key is taken.
+ */
+void cc_add_strings(cc_cache_t* cache, const sl_fragment_t* fragments);
+
+void cc_dispose(cc_cache_t** pcache);
+
+/*
+ * Computes the key for a code fragment. This must be done before
+ * instruction selection, which modifies the frame.
+ */
+cc_key_t* cc_key(cc_cache_t* cache, const sl_fragment_t* frag, Arena_T);
+
+void cc_key_dispose(cc_key_t* key);
+
+/*
+ * Looks up the entry for the key. On a hit, the assembly is appended to
+ * w, the frame maps are inserted into the fragment list after frag, and
+ * their callee-save bitmaps are added to label_to_cs_bitmap. Labels that
+ * were created by the backend are replaced by fresh ones from temp_state.
+ */
+bool cc_lookup(cc_cache_t* cache, const cc_key_t* key, sl_fragment_t* frag,
+        temp_state_t* temp_state, Table_T label_to_cs_bitmap,
+        writer_t* w, Arena_T frag_arena);
+
+/*
+ * Stores the entry for a function once it has been through the backend.
+ * instrs are the final instructions and text is the assembly that was
+ * emitted for them. The frame maps are taken from the fragments that
+ * follow frag. Failures are not reported; the entry is just not stored.
+ */
+void cc_store(cc_cache_t* cache, const cc_key_t* key,
+        const sl_fragment_t* frag, const assm_instr_t* instrs,
+        const char* text, size_t text_len, Table_T label_to_cs_bitmap);
+
+#endif /* __CODEGEN_CACHE_H__ */
@@ -1,6 +1,7 @@
 #include "liveness.h"
-#include <assert.h>
+#include "assertions.h"
 #include <stdbool.h>
+#include <string.h>
 #include "array.h"
 
 #define var __auto_type
@@ -23,9 +24,39 @@ typedef struct {
 
 typedef arrtype(node_rep_t) node_rep_array_t;
 
+typedef struct {
+    node_t e_lo;
+    node_t e_hi;
+} edge_t;
+
+typedef arrtype(edge_t) edge_array_t;
+
+/*
+ * Up to this many nodes, an undirected graph keeps a triangular bit matrix
+ * of its edges, which is 16MiB at the limit. Larger graphs do without, and
+ * search the adjacency vectors instead.
+ */
+enum { MATRIX_MAX_NODES = 16384 };
+
+/*
+ * An undirected graph, i.e. an interference graph, keeps the nodes
+ * adjacent to each node in its succ array, and pred is unused. While the
+ * graph is being built, edges are only collected. lv_finish_edges then
+ * gives each node an adjacency vector of the right size, sorted and
+ * without duplicates. The matrix, when there is one, makes lv_is_adj O(1)
+ * and keeps duplicates out of the collected edges. Later edges, e.g. from
+ * coalescing, are appended to the vectors, or inserted in order when there
+ * is no matrix and the vectors must be searched. Nodes can also be added
+ * later, e.g. for the temps made by spilling.
+ */
 struct lv_graph_t {
      node_rep_array_t nodes;
      Arena_T arena; // for allocations of internal structures
+     bool undirected;
+     bool finished; // lv_finish_edges has been called
+     edge_array_t edges; // collected until lv_finish_edges
+     uint64_t* matrix; // bit lo + hi * (hi - 1) / 2 is set for edge lo-hi
+     int matrix_nodes; // the number of nodes the matrix has room for
 };
 
 lv_graph_t*
@@ -36,6 +67,14 @@ lv_new_graph(Arena_T ar)
     return result;
 }
 
+lv_graph_t*
+lv_new_undirected_graph(Arena_T ar)
+{
+    lv_graph_t* result = lv_new_graph(ar);
+    result->undirected = true;
+    return result;
+}
+
 size_t
 lv_graph_length(const lv_graph_t* g)
 {
@@ -51,11 +90,18 @@ lv_node_new(lv_graph_t* graph, size_t idx, Arena_T ar)
     return node;
 }
 
+static void grow_matrix(lv_graph_t* graph);
+
 lv_node_t*
 lv_new_node(lv_graph_t* graph, Arena_T ar)
 {
+    // Until the edges are finished, the nodes must be made before them
+    assert(graph->finished || (!graph->matrix && !graph->edges.len));
     node_rep_t node_rep = {};
     arrpush(&graph->nodes, graph->arena, node_rep);
+    if (graph->matrix && graph->nodes.len > graph->matrix_nodes) {
+        grow_matrix(graph);
+    }
     return lv_node_new(graph, graph->nodes.len - 1, ar);
 }
 
@@ -97,11 +143,180 @@ node_array_keep_sorted(node_array_t* a)
     }
 }
 
+static size_t
+matrix_bit(node_t lo, node_t hi)
+{
+    return (size_t)lo + (size_t)hi * (hi - 1) / 2;
+}
+
+static bool
+matrix_test_and_set(lv_graph_t* graph, node_t lo, node_t hi)
+{
+    size_t bit = matrix_bit(lo, hi);
+    uint64_t mask = 1ULL << (bit % 64);
+    bool was_set = graph->matrix[bit / 64] & mask;
+    graph->matrix[bit / 64] |= mask;
+    return was_set;
+}
+
+static void
+matrix_clear(lv_graph_t* graph, node_t lo, node_t hi)
+{
+    size_t bit = matrix_bit(lo, hi);
+    graph->matrix[bit / 64] &= ~(1ULL << (bit % 64));
+}
+
+static void
+node_array_insert_sorted(node_array_t* a, node_t n, Arena_T arena)
+{
+    arrpush(a, arena, n);
+    node_array_keep_sorted(a);
+}
+
+/*
+ * Removes n from a, keeping the order. The search starts from the end,
+ * since the edge most recently made is the one most often removed.
+ */
+static void
+node_array_remove(node_array_t* a, node_t n)
+{
+    int i = a->len - 1;
+    for (; i >= 0 && a->data[i] != n; i--) {
+    }
+    assert(i >= 0);
+    memmove(&a->data[i], &a->data[i + 1], (a->len - i - 1) * sizeof *a->data);
+    a->len--;
+}
+
+static int
+cmp_node(const void* x, const void* y)
+{
+    return *(const node_t*)x - *(const node_t*)y;
+}
+
+/*
+ * Makes room in the matrix for the nodes added since the edges were
+ * finished. The triangular layout means the bits already set stay where
+ * they are. Past MATRIX_MAX_NODES the matrix is given up, and the vectors,
+ * which may have had later edges appended, are sorted to be searched.
+ */
+static void
+grow_matrix(lv_graph_t* graph)
+{
+    const int num_nodes = graph->nodes.len;
+    if (num_nodes > MATRIX_MAX_NODES) {
+        graph->matrix = NULL;
+        graph->matrix_nodes = 0;
+        for (int n = 0; n < num_nodes; n++) {
+            var succ = &graph->nodes.data[n].succ;
+            qsort(succ->data, succ->len, sizeof *succ->data, cmp_node);
+        }
+        return;
+    }
+    int new_nodes = graph->matrix_nodes + graph->matrix_nodes / 2;
+    if (new_nodes < num_nodes) {
+        new_nodes = num_nodes;
+    }
+    if (new_nodes > MATRIX_MAX_NODES) {
+        new_nodes = MATRIX_MAX_NODES;
+    }
+    size_t old_words = matrix_bit(0, graph->matrix_nodes) / 64 + 1;
+    size_t new_words = matrix_bit(0, new_nodes) / 64 + 1;
+    uint64_t* matrix = Alloc(graph->arena, new_words * sizeof *matrix);
+    memcpy(matrix, graph->matrix, old_words * sizeof *matrix);
+    graph->matrix = matrix;
+    graph->matrix_nodes = new_nodes;
+}
+
+static void
+mk_undirected_edge(lv_graph_t* graph, node_t n, node_t m)
+{
+    if (n == m) {
+        return;
+    }
+    node_t lo = (n < m) ? n : m;
+    node_t hi = (n < m) ? m : n;
+    if (!graph->matrix && !graph->finished && !graph->edges.len
+            && graph->nodes.len <= MATRIX_MAX_NODES) {
+        size_t nbits = matrix_bit(0, graph->nodes.len);
+        graph->matrix =
+            Alloc(graph->arena, (nbits / 64 + 1) * sizeof *graph->matrix);
+        graph->matrix_nodes = graph->nodes.len;
+    }
+    if (graph->finished) {
+        var nodes = graph->nodes.data;
+        if (graph->matrix) {
+            if (!matrix_test_and_set(graph, lo, hi)) {
+                arrpush(&nodes[lo].succ, graph->arena, hi);
+                arrpush(&nodes[hi].succ, graph->arena, lo);
+            }
+        } else if (!node_array_contains(&nodes[lo].succ, hi)) {
+            node_array_insert_sorted(&nodes[lo].succ, hi, graph->arena);
+            node_array_insert_sorted(&nodes[hi].succ, lo, graph->arena);
+        }
+        return;
+    }
+    if (graph->matrix && matrix_test_and_set(graph, lo, hi)) {
+        return;
+    }
+    edge_t edge = {.e_lo = lo, .e_hi = hi};
+    arrpush(&graph->edges, graph->arena, edge);
+}
+
+/*
+ * Gives each node of an undirected graph its adjacency vector, from the
+ * edges collected since it was made.
+ */
+void
+lv_finish_edges(lv_graph_t* graph)
+{
+    assert(graph->undirected && !graph->finished);
+    var nodes = graph->nodes.data;
+    const int num_nodes = graph->nodes.len;
+    for (int i = 0; i < graph->edges.len; i++) {
+        nodes[graph->edges.data[i].e_lo].succ.cap++;
+        nodes[graph->edges.data[i].e_hi].succ.cap++;
+    }
+    for (int n = 0; n < num_nodes; n++) {
+        var succ = &nodes[n].succ;
+        if (succ->cap > 0) {
+            succ->data = Alloc(graph->arena, succ->cap * sizeof *succ->data);
+        }
+    }
+    for (int i = 0; i < graph->edges.len; i++) {
+        var edge = graph->edges.data[i];
+        var lo_succ = &nodes[edge.e_lo].succ;
+        var hi_succ = &nodes[edge.e_hi].succ;
+        lo_succ->data[lo_succ->len++] = edge.e_hi;
+        hi_succ->data[hi_succ->len++] = edge.e_lo;
+    }
+    for (int n = 0; n < num_nodes; n++) {
+        var succ = &nodes[n].succ;
+        qsort(succ->data, succ->len, sizeof *succ->data, cmp_node);
+        if (!graph->matrix && succ->len > 1) {
+            int len = 1;
+            for (int i = 1; i < succ->len; i++) {
+                if (succ->data[i] != succ->data[len - 1]) {
+                    succ->data[len++] = succ->data[i];
+                }
+            }
+            succ->len = len;
+        }
+    }
+    graph->edges = (edge_array_t){};
+    graph->finished = true;
+}
+
 void
 lv_mk_edge(lv_node_t* from, lv_node_t* to)
 {
     assert(from->lvn_graph == to->lvn_graph);
 
+    if (from->lvn_graph->undirected) {
+        mk_undirected_edge(from->lvn_graph, from->lvn_idx, to->lvn_idx);
+        return;
+    }
+
     var arena = from->lvn_graph->arena;
     var nodes = from->lvn_graph->nodes;
     if (!node_array_contains(&nodes.data[from->lvn_idx].succ, to->lvn_idx)) {
@@ -112,7 +327,75 @@ lv_mk_edge(lv_node_t* from, lv_node_t* to)
     }
 }
 
-// TODO: lv_rm_edge
+/*
+ * Removes an edge made after lv_finish_edges, e.g. to undo coalescing.
+ */
+void
+lv_rm_edge(lv_node_t* from, lv_node_t* to)
+{
+    assert(from->lvn_graph == to->lvn_graph);
+    var graph = from->lvn_graph;
+    assert(graph->undirected && graph->finished);
+    if (lv_eq(from, to) || !lv_is_adj(from, to)) {
+        return;
+    }
+    node_t lo = (from->lvn_idx < to->lvn_idx) ? from->lvn_idx : to->lvn_idx;
+    node_t hi = (from->lvn_idx < to->lvn_idx) ? to->lvn_idx : from->lvn_idx;
+    if (graph->matrix) {
+        matrix_clear(graph, lo, hi);
+    }
+    node_array_remove(&graph->nodes.data[lo].succ, hi);
+    node_array_remove(&graph->nodes.data[hi].succ, lo);
+}
+
+/*
+ * Removes all the edges of the nodes, which must be in the same
+ * undirected graph. The nodes remain, with no adjacent nodes. This is
+ * used for temps that have been spilled. Each other node's vector is only
+ * walked once.
+ */
+void
+lv_isolate_nodes(lv_node_list_t* nodes, Arena_T scratch)
+{
+    if (!nodes) {
+        return;
+    }
+    var graph = nodes->nl_node->lvn_graph;
+    assert(graph->undirected && graph->finished);
+    var reps = graph->nodes.data;
+    enum { KEPT, ISOLATED, NEIGHBOUR };
+    unsigned char* mark = Alloc(scratch, graph->nodes.len * sizeof *mark);
+    node_array_t neighbours = {};
+
+    for (var n = nodes; n; n = n->nl_list) {
+        assert(n->nl_node->lvn_graph == graph);
+        mark[n->nl_node->lvn_idx] = ISOLATED;
+    }
+    for (var n = nodes; n; n = n->nl_list) {
+        node_t x = n->nl_node->lvn_idx;
+        for (NODE_ARR_IT(y, reps[x].succ)) {
+            if (graph->matrix) {
+                matrix_clear(graph, (x < y) ? x : y, (x < y) ? y : x);
+            }
+            if (mark[y] == KEPT) {
+                mark[y] = NEIGHBOUR;
+                arrpush(&neighbours, scratch, y);
+            }
+        }
+        reps[x].succ.len = 0;
+    }
+    for (NODE_ARR_IT(y, neighbours)) {
+        var succ = &reps[y].succ;
+        int len = 0;
+        for (int i = 0; i < succ->len; i++) {
+            if (mark[succ->data[i]] != ISOLATED) {
+                succ->data[len++] = succ->data[i];
+            }
+        }
+        succ->len = len;
+    }
+}
+
 // TODO: lv_print_graph
 
 
@@ -145,6 +428,7 @@ lv_node_it_arr
 lv_succ(lv_node_t* n)
 {
     var graph = n->lvn_graph;
+    assert(!graph->undirected || graph->finished);
     node_array_t* a = &graph->nodes.data[n->lvn_idx].succ;
     return (lv_node_it_arr){
         .node_array = a,
@@ -229,6 +513,7 @@ lv_node_it_2arr
 lv_adj(lv_node_t* node)
 {
     var graph = node->lvn_graph;
+    assert(!graph->undirected || graph->finished);
 
     lv_node_it_2arr it = {};
     it.lvni_node.lvn_graph = graph;
@@ -258,6 +543,25 @@ bool
 lv_is_adj(const lv_node_t* n, const lv_node_t* m)
 {
     assert(n->lvn_graph == m->lvn_graph);
+    var graph = n->lvn_graph;
+    if (graph->undirected) {
+        node_t lo = (n->lvn_idx < m->lvn_idx) ? n->lvn_idx : m->lvn_idx;
+        node_t hi = (n->lvn_idx < m->lvn_idx) ? m->lvn_idx : n->lvn_idx;
+        if (lo == hi) {
+            return false;
+        }
+        if (graph->matrix) {
+            size_t bit = matrix_bit(lo, hi);
+            return graph->matrix[bit / 64] & (1ULL << (bit % 64));
+        }
+        assert(graph->finished);
+        // search the shorter vector
+        var lo_succ = &graph->nodes.data[lo].succ;
+        var hi_succ = &graph->nodes.data[hi].succ;
+        return (lo_succ->len < hi_succ->len)
+            ? node_array_contains(lo_succ, hi)
+            : node_array_contains(hi_succ, lo);
+    }
     return lv_is_succ(m, n) || lv_is_succ(n, m);
 }
 
@@ -291,11 +595,95 @@ test_graph()
     Arena_dispose(&a);
 }
 
+static void
+check_undirected_graph(int num_nodes)
+{
+    var a = Arena_new();
+    var g = lv_new_undirected_graph(a);
+    lv_node_t* nodes[4];
+    for (int i = 0; i < num_nodes; i++) {
+        var node = lv_new_node(g, a);
+        if (i < NELEMS(nodes)) {
+            nodes[i] = node;
+        }
+    }
+
+    lv_mk_edge(nodes[2], nodes[0]);
+    lv_mk_edge(nodes[0], nodes[1]);
+    lv_mk_edge(nodes[0], nodes[2]); // the same as the first
+    lv_mk_edge(nodes[1], nodes[1]); // not an edge
+    lv_finish_edges(g);
+    assert(g->finished);
+    assert((num_nodes <= MATRIX_MAX_NODES) == !!g->matrix);
+
+    assert(lv_is_adj(nodes[0], nodes[1]) && lv_is_adj(nodes[1], nodes[0]));
+    assert(lv_is_adj(nodes[0], nodes[2]) && lv_is_adj(nodes[2], nodes[0]));
+    assert(!lv_is_adj(nodes[1], nodes[2]));
+    assert(!lv_is_adj(nodes[1], nodes[1]));
+    assert(!lv_is_adj(nodes[0], nodes[3]));
+
+    // In order and without duplicates
+    int expected[] = {1, 2};
+    int i = 0;
+    for (var it = lv_adj(nodes[0]); lv_node_it_next(&it); i++) {
+        assert(i < NELEMS(expected));
+        assert(it.lvni_node.lvn_idx == expected[i]);
+    }
+    assert(i == NELEMS(expected));
+
+    // As when coalescing
+    lv_mk_edge(nodes[3], nodes[1]);
+    lv_mk_edge(nodes[1], nodes[3]);
+    assert(lv_is_adj(nodes[1], nodes[3]));
+    i = 0;
+    for (var it = lv_adj(nodes[3]); lv_node_it_next(&it); i++) {
+        assert(it.lvni_node.lvn_idx == 1);
+    }
+    assert(i == 1);
+
+    // As when undoing the coalescing
+    lv_rm_edge(nodes[1], nodes[3]);
+    assert(!lv_is_adj(nodes[1], nodes[3]) && !lv_is_adj(nodes[3], nodes[1]));
+    assert(lv_is_adj(nodes[0], nodes[1]));
+
+    // As when spilling
+    var spill = lv_new_node(g, a);
+    assert(!lv_is_adj(spill, nodes[2]));
+    lv_mk_edge(spill, nodes[2]);
+    lv_mk_edge(nodes[0], nodes[3]);
+    assert(lv_is_adj(nodes[2], spill));
+    assert((num_nodes < MATRIX_MAX_NODES) == !!g->matrix);
+    lv_node_list_t isolate = {.nl_node = nodes[0]};
+    lv_isolate_nodes(&isolate, a);
+    for (i = 0; i < NELEMS(nodes); i++) {
+        assert(!lv_is_adj(nodes[0], nodes[i]));
+    }
+    assert(lv_is_adj(nodes[2], spill));
+    i = 0;
+    for (var it = lv_adj(nodes[2]); lv_node_it_next(&it); i++) {
+        assert(it.lvni_node.lvn_idx == spill->lvn_idx);
+    }
+    assert(i == 1);
+
+    Arena_dispose(&a);
+}
+
+void
+test_undirected_graph()
+{
+    check_undirected_graph(4);
+    // the matrix is dropped for the node made after the edges
+    check_undirected_graph(MATRIX_MAX_NODES);
+    // too many for the matrix
+    check_undirected_graph(MATRIX_MAX_NODES + 1);
+}
+
 
 static void register_tests() __attribute__((constructor));
 void
 register_tests() {
 
     REGISTER_TEST(test_graph);
+    REGISTER_TEST(test_undirected_graph);
 
 }
@@ -0,0 +1,816 @@
+#include "inliner.h"
+#include <stdbool.h> /* bool */
+#include <stdint.h> /* uint32_t, uint64_t, uintptr_t */
+#include "interfaces/arena.h"
+#include "array.h"
+#include "liveness.h" /* lv_graph_t */
+#include "assertions.h"
+
+#define var __auto_type
+#define Alloc(arena, size) Arena_alloc(arena, size, __FILE__, __LINE__)
+
+/*
+ * A function is only inlined when its body, leaving out the entry and exit
+ * and the SEQs, has at most this many nodes. This is enough for accessors,
+ * small arithmetic helpers and constructors of a few fields.
+ */
+enum { INLINE_MAX_SIZE = 40 };
+
+/*
+ * A hash trie from a key, which is a symbol or a temp_id, to what it is
+ * renamed to in the copy of a body, or from a function name to the
+ * function.
+ */
+typedef struct inline_map_t {
+    struct inline_map_t* child[4];
+    uintptr_t key;
+    union {
+        sl_sym_t im_label;
+        int im_temp_id;
+        struct inline_func_t* im_func;
+    };
+} inline_map_t;
+
+typedef struct inline_func_t {
+    sl_fragment_t* frag;
+    lv_node_t* node; // in the call graph
+    int size; // the number of nodes, but for the entry, exit and SEQs
+    bool can_copy; // the body and the frame are of a shape we can copy
+    bool recursive; // in a cycle of the call graph
+    int index; // the order it was reached in the search for cycles, from 1
+    int lowlink;
+    bool on_stack;
+} inline_func_t;
+
+/* A local of the inlined function, and the local of the caller it becomes */
+typedef struct inline_local_t {
+    const struct ac_frame_var* from;
+    const struct ac_frame_var* to;
+} inline_local_t;
+
+typedef struct inline_info_t {
+    temp_state_t* temp_state;
+    Arena_T arena;
+    Arena_T scratch;
+    inline_func_t* funcs; // indexed by their node in the call graph
+    inline_map_t* funcs_by_name;
+    lv_graph_t* calls; // with an edge from each caller to each callee
+    bool finding_calls; // while the edges of the call graph are made
+    arrtype(inline_func_t*) stack; // for the search for cycles
+    int next_index;
+    int next_var_id;
+
+    // The function that calls are being inlined into
+    ac_frame_t* frame;
+    bool frame_grown;
+
+    // The call being inlined, while the body of its callee is copied
+    const ac_frame_t* callee_frame;
+    tree_exp_t** args; // indexed by the argument register they are passed in
+    int num_args;
+    temp_t result;
+    const int* site_vars; // the vars in scope at the call
+    inline_map_t* labels;
+    inline_map_t* temps;
+    inline_local_t* locals;
+    int num_locals;
+} inline_info_t;
+
+static tree_stm_t* inline_stm(inline_info_t*, tree_stm_t*);
+static void measure_stm(inline_info_t*, inline_func_t*, const tree_stm_t*);
+static tree_stm_t* copy_stm(inline_info_t*, const tree_stm_t*);
+
+// https://nullprogram.com/blog/2018/07/31/
+static uint32_t key_hash(uintptr_t key)
+{
+    uint64_t x = key;
+    x ^= x >> 32;
+    x *= 0xd6e8feb86659fd93U;
+    x ^= x >> 32;
+    return x;
+}
+
+static inline_map_t* im_upsert(inline_map_t** m, uintptr_t key, Arena_T ar)
+{
+    for (uint32_t h = key_hash(key); *m; h <<= 2) {
+        if (key == (*m)->key) {
+            return *m;
+        }
+        m = &(*m)->child[h>>30];
+    }
+    if (!ar) {
+        return NULL;
+    }
+    *m = Alloc(ar, sizeof **m);
+    (*m)->key = key;
+    return *m;
+}
+
+static bool is_machine_temp(const tree_exp_t* e, temp_t t)
+{
+    return e->te_tag == TREE_EXP_TEMP && e->te_temp.temp_id == t.temp_id;
+}
+
+static bool is_callee_save(const target_t* target, const tree_exp_t* e)
+{
+    for (int i = 0; i < target->callee_saves.length; i++) {
+        if (is_machine_temp(e, target->callee_saves.elems[i])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* The index of the argument register that e is, or -1 */
+static int arg_register_index(const target_t* target, const tree_exp_t* e)
+{
+    for (int i = 0; i < target->arg_registers.length; i++) {
+        if (is_machine_temp(e, target->arg_registers.elems[i])) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* Whether e is the address of a local, i.e. fp + offset with offset < 0 */
+static bool is_local_address(const target_t* target, const tree_exp_t* e)
+{
+    return e->te_tag == TREE_EXP_BINOP && e->te_binop == TREE_BINOP_PLUS
+        && is_machine_temp(e->te_lhs, target->tgt_fp)
+        && e->te_rhs->te_tag == TREE_EXP_CONST && e->te_rhs->te_const < 0;
+}
+
+/* The local of frame that the word at offset from the fp is part of */
+static const struct ac_frame_var*
+find_local(const ac_frame_t* frame, int offset)
+{
+    for (var v = frame->ac_frame_vars; v; v = v->acf_list) {
+        if (v->acf_tag == ACF_ACCESS_FRAME && v->acf_offset <= offset
+                && offset < v->acf_offset + (int)v->acf_size) {
+            return v;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Whether we can move the locals of frame into the frame of a caller. The
+ * arguments must all be passed in registers, since a caller's frame has no
+ * room for them.
+ */
+static bool can_copy_frame(const ac_frame_t* frame)
+{
+    for (var v = frame->ac_frame_vars; v; v = v->acf_list) {
+        if (v->acf_tag != ACF_ACCESS_FRAME) {
+            continue;
+        }
+        if (v->acf_is_formal || v->acf_offset >= 0 || v->acf_var_id <= 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Measuring a function finds its size and whether its body can be copied
+ * and, while the call graph is being built, the functions it calls. The
+ * machine temps in a body we can copy are only the fp, in the addresses of
+ * locals, and those of the entry and exit that proc_entry_exit_1 added and
+ * of the assignment of the result.
+ */
+static void
+measure_exp(inline_info_t* info, inline_func_t* func, const tree_exp_t* e)
+{
+    const ac_frame_t* frame = func->frag->fr_frame;
+    func->size++;
+    switch (e->te_tag) {
+        case TREE_EXP_CONST:
+        case TREE_EXP_NAME:
+            return;
+        case TREE_EXP_TEMP:
+            if (temp_is_machine(e->te_temp)) {
+                func->can_copy = false;
+            }
+            return;
+        case TREE_EXP_BINOP:
+            if (is_local_address(frame->acf_target, e)) {
+                if (!find_local(frame, e->te_rhs->te_const)) {
+                    func->can_copy = false;
+                }
+                func->size += 2;
+                return;
+            }
+            measure_exp(info, func, e->te_lhs);
+            measure_exp(info, func, e->te_rhs);
+            return;
+        case TREE_EXP_MEM:
+            measure_exp(info, func, e->te_mem_addr);
+            return;
+        case TREE_EXP_CALL:
+            if (info->finding_calls && e->te_func->te_tag == TREE_EXP_NAME) {
+                var callee = im_upsert(&info->funcs_by_name,
+                        (uintptr_t)e->te_func->te_name, NULL);
+                if (callee) {
+                    lv_mk_edge(func->node, callee->im_func->node);
+                }
+            }
+            measure_exp(info, func, e->te_func);
+            for (var arg = e->te_args; arg; arg = arg->te_list) {
+                measure_exp(info, func, arg);
+            }
+            return;
+        case TREE_EXP_ESEQ:
+            measure_stm(info, func, e->te_eseq_stm);
+            measure_exp(info, func, e->te_eseq_exp);
+            return;
+    }
+}
+
+static void
+measure_stm(inline_info_t* info, inline_func_t* func, const tree_stm_t* s)
+{
+    var target = func->frag->fr_frame->acf_target;
+    switch (s->tst_tag) {
+        case TREE_STM_MOVE:
+        {
+            var dst = s->tst_move_dst;
+            var src = s->tst_move_exp;
+            if (is_callee_save(target, dst) || is_callee_save(target, src)) {
+                // the saves and restores of the entry and exit
+                return;
+            }
+            func->size++;
+            if (is_machine_temp(dst, target->tgt_ret0)) {
+                measure_exp(info, func, src);
+            } else if (arg_register_index(target, src) >= 0) {
+                measure_exp(info, func, dst);
+            } else {
+                measure_exp(info, func, dst);
+                measure_exp(info, func, src);
+            }
+            return;
+        }
+        case TREE_STM_EXP:
+            func->size++;
+            measure_exp(info, func, s->tst_exp);
+            return;
+        case TREE_STM_JUMP:
+            func->size++;
+            if (s->tst_jump_dst->te_tag != TREE_EXP_NAME) {
+                func->can_copy = false;
+            }
+            return;
+        case TREE_STM_CJUMP:
+            func->size++;
+            measure_exp(info, func, s->tst_cjump_lhs);
+            measure_exp(info, func, s->tst_cjump_rhs);
+            return;
+        case TREE_STM_SEQ:
+            measure_stm(info, func, s->tst_seq_s1);
+            measure_stm(info, func, s->tst_seq_s2);
+            return;
+        case TREE_STM_LABEL:
+            func->size++;
+            return;
+    }
+}
+
+static void measure_func(inline_info_t* info, inline_func_t* func)
+{
+    func->size = 0;
+    func->can_copy = can_copy_frame(func->frag->fr_frame);
+    measure_stm(info, func, func->frag->fr_body);
+}
+
+static sl_sym_t rename_label(inline_info_t* info, sl_sym_t label)
+{
+    var renamed = im_upsert(&info->labels, (uintptr_t)label, info->scratch);
+    if (!renamed->im_label) {
+        renamed->im_label = temp_newlabel(info->temp_state);
+    }
+    return renamed->im_label;
+}
+
+static int rename_temp(inline_info_t* info, temp_t t)
+{
+    assert(!temp_is_machine(t));
+    var renamed = im_upsert(&info->temps, t.temp_id, info->scratch);
+    if (!renamed->im_temp_id) {
+        renamed->im_temp_id = temp_newtemp(
+                info->temp_state, t.temp_size, t.temp_ptr_dispo).temp_id;
+    }
+    return renamed->im_temp_id;
+}
+
+/* The offset from the fp, in the caller, of offset in the callee */
+static int local_offset(inline_info_t* info, int offset)
+{
+    for (int i = 0; i < info->num_locals; i++) {
+        var from = info->locals[i].from;
+        if (from->acf_offset <= offset
+                && offset < from->acf_offset + (int)from->acf_size) {
+            return offset - from->acf_offset + info->locals[i].to->acf_offset;
+        }
+    }
+    assert(0 && "the address of a local that is not in the frame");
+    return offset;
+}
+
+/*
+ * The pointer map of a call in the copied body. The locals of the callee
+ * that are in scope at the call have new ids in the caller, and the vars
+ * of the caller that are in scope at the inlined call are also in scope.
+ */
+static ac_frame_map_t*
+map_for_copied_call(inline_info_t* info, const ac_frame_map_t* map)
+{
+    assert(map && map->acfm_defined_vars);
+    int num_vars = 0;
+    for (var it = map->acfm_defined_vars; *it > 0; it++) {
+        num_vars++;
+    }
+    for (var it = info->site_vars; *it > 0; it++) {
+        num_vars++;
+    }
+
+    int* vars = Alloc(info->scratch, (num_vars + 1) * sizeof *vars);
+    int len = 0;
+    for (var it = map->acfm_defined_vars; *it > 0; it++) {
+        for (int i = 0; i < info->num_locals; i++) {
+            if (info->locals[i].from->acf_var_id == *it) {
+                vars[len++] = info->locals[i].to->acf_var_id;
+            }
+        }
+    }
+    for (var it = info->site_vars; *it > 0; it++) {
+        vars[len++] = *it;
+    }
+    return ac_calculate_ptr_maps(info->frame, vars, info->arena);
+}
+
+static tree_exp_t* copy_exp(inline_info_t* info, const tree_exp_t* e)
+{
+    var target = info->callee_frame->acf_target;
+    tree_exp_t* c = Alloc(info->arena, sizeof *c);
+    *c = *e;
+    c->te_list = NULL;
+    switch (e->te_tag) {
+        case TREE_EXP_CONST:
+        case TREE_EXP_NAME:
+            return c;
+        case TREE_EXP_TEMP:
+            c->te_temp.temp_id = rename_temp(info, e->te_temp);
+            return c;
+        case TREE_EXP_BINOP:
+            if (is_local_address(target, e)) {
+                c->te_lhs = Alloc(info->arena, sizeof *c->te_lhs);
+                *c->te_lhs = *e->te_lhs;
+                c->te_rhs = Alloc(info->arena, sizeof *c->te_rhs);
+                *c->te_rhs = *e->te_rhs;
+                c->te_rhs->te_const = local_offset(info, e->te_rhs->te_const);
+                return c;
+            }
+            c->te_lhs = copy_exp(info, e->te_lhs);
+            c->te_rhs = copy_exp(info, e->te_rhs);
+            return c;
+        case TREE_EXP_MEM:
+            c->te_mem_addr = copy_exp(info, e->te_mem_addr);
+            return c;
+        case TREE_EXP_CALL:
+            c->te_func = copy_exp(info, e->te_func);
+            c->te_args = NULL;
+            for (var arg = e->te_args; arg; arg = arg->te_list) {
+                c->te_args = tree_exp_append(c->te_args, copy_exp(info, arg));
+            }
+            c->te_ptr_map = map_for_copied_call(info, e->te_ptr_map);
+            return c;
+        case TREE_EXP_ESEQ:
+        {
+            var s = copy_stm(info, e->te_eseq_stm);
+            var x = copy_exp(info, e->te_eseq_exp);
+            if (!s) {
+                return x;
+            }
+            c->te_eseq_stm = s;
+            c->te_eseq_exp = x;
+            return c;
+        }
+    }
+}
+
+/*
+ * Copies a statement of the callee's body. The saves and restores of the
+ * callee-save registers are left out, since the caller has its own, and so
+ * the copy of a statement may be NULL.
+ */
+static tree_stm_t* copy_stm(inline_info_t* info, const tree_stm_t* s)
+{
+    var ar = info->arena;
+    var target = info->callee_frame->acf_target;
+    tree_stm_t* c = Alloc(ar, sizeof *c);
+    *c = *s;
+    c->tst_list = NULL;
+    switch (s->tst_tag) {
+        case TREE_STM_MOVE:
+        {
+            var dst = s->tst_move_dst;
+            var src = s->tst_move_exp;
+            if (is_callee_save(target, dst) || is_callee_save(target, src)) {
+                return NULL;
+            }
+            if (is_machine_temp(dst, target->tgt_ret0)) {
+                // The result is assigned to a temp of ours instead. An
+                // assignment of another size is the one after a return,
+                // which is never reached, and so it gets a temp of its own.
+                temp_t t = info->result;
+                if (dst->te_size != t.temp_size) {
+                    t = temp_newtemp(info->temp_state, dst->te_size,
+                            t.temp_ptr_dispo);
+                }
+                c->tst_move_dst =
+                    tree_exp_temp(t, t.temp_size, dst->te_type, ar);
+                c->tst_move_exp = copy_exp(info, src);
+                return c;
+            }
+            int i = arg_register_index(target, src);
+            if (i >= 0) {
+                // The argument is moved into the parameter's temp directly.
+                // These moves come first, and in order, so the arguments
+                // are still evaluated left to right before the body.
+                assert(i < info->num_args && info->args[i]);
+                c->tst_move_dst = copy_exp(info, dst);
+                c->tst_move_exp = info->args[i];
+                info->args[i] = NULL;
+                return c;
+            }
+            c->tst_move_dst = copy_exp(info, dst);
+            c->tst_move_exp = copy_exp(info, src);
+            return c;
+        }
+        case TREE_STM_EXP:
+            c->tst_exp = copy_exp(info, s->tst_exp);
+            return c;
+        case TREE_STM_JUMP:
+        {
+            int n = s->tst_jump_num_labels;
+            c->tst_jump_labels = Alloc(ar, n * sizeof *c->tst_jump_labels);
+            for (int i = 0; i < n; i++) {
+                c->tst_jump_labels[i] =
+                    rename_label(info, s->tst_jump_labels[i]);
+            }
+            c->tst_jump_dst = copy_exp(info, s->tst_jump_dst);
+            c->tst_jump_dst->te_name =
+                rename_label(info, s->tst_jump_dst->te_name);
+            return c;
+        }
+        case TREE_STM_CJUMP:
+            c->tst_cjump_lhs = copy_exp(info, s->tst_cjump_lhs);
+            c->tst_cjump_rhs = copy_exp(info, s->tst_cjump_rhs);
+            c->tst_cjump_true = rename_label(info, s->tst_cjump_true);
+            c->tst_cjump_false = rename_label(info, s->tst_cjump_false);
+            return c;
+        case TREE_STM_SEQ:
+        {
+            var s1 = copy_stm(info, s->tst_seq_s1);
+            var s2 = copy_stm(info, s->tst_seq_s2);
+            if (!s1 || !s2) {
+                return (s1) ? s1 : s2;
+            }
+            c->tst_seq_s1 = s1;
+            c->tst_seq_s2 = s2;
+            return c;
+        }
+        case TREE_STM_LABEL:
+            c->tst_label = rename_label(info, s->tst_label);
+            return c;
+    }
+}
+
+/*
+ * The callee of call, if the call should be inlined. The callee has been
+ * inlined into already, since it is in an earlier component of the call
+ * graph, unless it is recursive.
+ */
+static inline_func_t* callee_to_inline(inline_info_t* info, tree_exp_t* call)
+{
+    if (call->te_func->te_tag != TREE_EXP_NAME) {
+        return NULL;
+    }
+    var entry = im_upsert(
+            &info->funcs_by_name, (uintptr_t)call->te_func->te_name, NULL);
+    if (!entry) {
+        return NULL; // e.g. sl_alloc_des, from the runtime
+    }
+    var callee = entry->im_func;
+    if (!callee->can_copy || callee->recursive
+            || callee->size > INLINE_MAX_SIZE) {
+        return NULL;
+    }
+    // A void result is not assigned, and larger results are not yet
+    // returned in registers
+    var word_size = info->frame->acf_target->word_size;
+    if (call->te_size == 0 || call->te_size > word_size) {
+        return NULL;
+    }
+    // The argument is moved straight into the parameter, so they must be
+    // of the same size. A small struct may be passed as a whole word.
+    var arg = call->te_args;
+    for (var v = callee->frag->fr_frame->ac_frame_vars; v; v = v->acf_list) {
+        if (v->acf_is_formal) {
+            if (!arg || arg->te_size != v->acf_size) {
+                return NULL;
+            }
+            arg = arg->te_list;
+        }
+    }
+    return (arg) ? NULL : callee;
+}
+
+/*
+ * Replaces call by ESEQ(body, TEMP result), where body is a copy of the
+ * callee's body, with its own labels, temps and locals.
+ */
+static tree_exp_t*
+inline_call(inline_info_t* info, inline_func_t* callee, tree_exp_t* call)
+{
+    var ar = info->arena;
+    const ac_frame_t* callee_frame = callee->frag->fr_frame;
+    info->callee_frame = callee_frame;
+    info->labels = NULL;
+    info->temps = NULL;
+
+    info->num_args = 0;
+    for (var arg = call->te_args; arg; arg = arg->te_list) {
+        info->num_args++;
+    }
+    info->args = Alloc(info->scratch, info->num_args * sizeof *info->args);
+    int i = 0;
+    for (var arg = call->te_args; arg; ) {
+        var next = arg->te_list;
+        arg->te_list = NULL;
+        info->args[i++] = arg;
+        arg = next;
+    }
+
+    info->result = temp_newtemp(info->temp_state, call->te_size,
+            tree_dispo_from_type(call->te_type));
+    const ac_frame_map_t* site_map = call->te_ptr_map;
+    assert(site_map && site_map->acfm_defined_vars);
+    info->site_vars = site_map->acfm_defined_vars;
+
+    // The locals of the callee move into our frame
+    info->num_locals = 0;
+    for (var v = callee_frame->ac_frame_vars; v; v = v->acf_list) {
+        if (v->acf_tag == ACF_ACCESS_FRAME) {
+            info->num_locals++;
+        }
+    }
+    info->locals =
+        Alloc(info->scratch, info->num_locals * sizeof *info->locals);
+    i = 0;
+    for (var v = callee_frame->ac_frame_vars; v; v = v->acf_list) {
+        if (v->acf_tag == ACF_ACCESS_FRAME) {
+            info->locals[i].from = v;
+            info->locals[i].to =
+                ac_copy_local(info->frame, v, info->next_var_id++, ar);
+            info->frame_grown = true;
+            i++;
+        }
+    }
+
+    var body = copy_stm(info, callee->frag->fr_body);
+    for (i = 0; i < info->num_args; i++) {
+        assert(!info->args[i] && "an argument was not moved to a param");
+    }
+    var result = tree_exp_temp(info->result, call->te_size, call->te_type, ar);
+    return tree_exp_eseq(body, result, ar);
+}
+
+static tree_exp_t* inline_exp(inline_info_t* info, tree_exp_t* e)
+{
+    switch (e->te_tag) {
+        case TREE_EXP_CONST:
+        case TREE_EXP_NAME:
+        case TREE_EXP_TEMP:
+            return e;
+        case TREE_EXP_BINOP:
+            e->te_lhs = inline_exp(info, e->te_lhs);
+            e->te_rhs = inline_exp(info, e->te_rhs);
+            return e;
+        case TREE_EXP_MEM:
+            e->te_mem_addr = inline_exp(info, e->te_mem_addr);
+            return e;
+        case TREE_EXP_CALL:
+        {
+            for (var arg = &e->te_args; *arg; arg = &(*arg)->te_list) {
+                var next = (*arg)->te_list;
+                *arg = inline_exp(info, *arg);
+                (*arg)->te_list = next;
+            }
+            var callee = callee_to_inline(info, e);
+            return (callee) ? inline_call(info, callee, e) : e;
+        }
+        case TREE_EXP_ESEQ:
+            e->te_eseq_stm = inline_stm(info, e->te_eseq_stm);
+            e->te_eseq_exp = inline_exp(info, e->te_eseq_exp);
+            return e;
+    }
+}
+
+static tree_stm_t* inline_stm(inline_info_t* info, tree_stm_t* s)
+{
+    switch (s->tst_tag) {
+        case TREE_STM_MOVE:
+            s->tst_move_dst = inline_exp(info, s->tst_move_dst);
+            s->tst_move_exp = inline_exp(info, s->tst_move_exp);
+            return s;
+        case TREE_STM_EXP:
+            s->tst_exp = inline_exp(info, s->tst_exp);
+            return s;
+        case TREE_STM_JUMP:
+            return s;
+        case TREE_STM_CJUMP:
+            s->tst_cjump_lhs = inline_exp(info, s->tst_cjump_lhs);
+            s->tst_cjump_rhs = inline_exp(info, s->tst_cjump_rhs);
+            return s;
+        case TREE_STM_SEQ:
+            s->tst_seq_s1 = inline_stm(info, s->tst_seq_s1);
+            s->tst_seq_s2 = inline_stm(info, s->tst_seq_s2);
+            return s;
+        case TREE_STM_LABEL:
+            return s;
+    }
+}
+
+/*
+ * The pointer maps of the calls were calculated while the frame had fewer
+ * locals, and so fewer words, so they are calculated again.
+ */
+static void update_maps_stm(inline_info_t* info, tree_stm_t* s);
+
+static void update_maps_exp(inline_info_t* info, tree_exp_t* e)
+{
+    switch (e->te_tag) {
+        case TREE_EXP_CONST:
+        case TREE_EXP_NAME:
+        case TREE_EXP_TEMP:
+            return;
+        case TREE_EXP_BINOP:
+            update_maps_exp(info, e->te_lhs);
+            update_maps_exp(info, e->te_rhs);
+            return;
+        case TREE_EXP_MEM:
+            update_maps_exp(info, e->te_mem_addr);
+            return;
+        case TREE_EXP_CALL:
+        {
+            for (var arg = e->te_args; arg; arg = arg->te_list) {
+                update_maps_exp(info, arg);
+            }
+            const ac_frame_map_t* map = e->te_ptr_map;
+            e->te_ptr_map = ac_calculate_ptr_maps(
+                    info->frame, map->acfm_defined_vars, info->arena);
+            return;
+        }
+        case TREE_EXP_ESEQ:
+            update_maps_stm(info, e->te_eseq_stm);
+            update_maps_exp(info, e->te_eseq_exp);
+            return;
+    }
+}
+
+static void update_maps_stm(inline_info_t* info, tree_stm_t* s)
+{
+    switch (s->tst_tag) {
+        case TREE_STM_MOVE:
+            update_maps_exp(info, s->tst_move_dst);
+            update_maps_exp(info, s->tst_move_exp);
+            return;
+        case TREE_STM_EXP:
+            update_maps_exp(info, s->tst_exp);
+            return;
+        case TREE_STM_JUMP:
+        case TREE_STM_LABEL:
+            return;
+        case TREE_STM_CJUMP:
+            update_maps_exp(info, s->tst_cjump_lhs);
+            update_maps_exp(info, s->tst_cjump_rhs);
+            return;
+        case TREE_STM_SEQ:
+            update_maps_stm(info, s->tst_seq_s1);
+            update_maps_stm(info, s->tst_seq_s2);
+            return;
+    }
+}
+
+static void inline_into(inline_info_t* info, inline_func_t* func)
+{
+    info->frame = func->frag->fr_frame;
+    info->frame_grown = false;
+    func->frag->fr_body = inline_stm(info, func->frag->fr_body);
+    if (info->frame_grown) {
+        update_maps_stm(info, func->frag->fr_body);
+    }
+    // its callers see the body with the calls inlined
+    measure_func(info, func);
+}
+
+/*
+ * Tarjan's algorithm for the strongly connected components of the call
+ * graph. A component is complete only after those of the functions it
+ * calls, so the callees are inlined into before they are inlined. A
+ * function is recursive if its component has more than one function, or
+ * if it calls itself.
+ */
+static void visit(inline_info_t* info, inline_func_t* func)
+{
+    func->index = func->lowlink = ++info->next_index;
+    arrpush(&info->stack, info->scratch, func);
+    func->on_stack = true;
+
+    for (var it = lv_succ(func->node); lv_node_it_next(&it); ) {
+        var callee = &info->funcs[it.lvni_node.lvn_idx];
+        if (callee == func) {
+            func->recursive = true;
+        } else if (!callee->index) {
+            visit(info, callee);
+            if (callee->lowlink < func->lowlink) {
+                func->lowlink = callee->lowlink;
+            }
+        } else if (callee->on_stack && callee->index < func->lowlink) {
+            func->lowlink = callee->index;
+        }
+    }
+
+    if (func->lowlink == func->index) {
+        int first = info->stack.len - 1;
+        while (info->stack.data[first] != func) {
+            first--;
+        }
+        bool recursive = func->recursive || first < info->stack.len - 1;
+        for (int i = first; i < info->stack.len; i++) {
+            info->stack.data[i]->on_stack = false;
+            info->stack.data[i]->recursive = recursive;
+        }
+        for (int i = first; i < info->stack.len; i++) {
+            inline_into(info, info->stack.data[i]);
+        }
+        info->stack.len = first;
+    }
+}
+
+void inline_calls(
+        Arena_T arena, temp_state_t* temp_state, sl_fragment_t* fragments)
+{
+    inline_info_t info = {
+        .temp_state = temp_state,
+        .arena = arena,
+        .scratch = Arena_new(),
+        .next_var_id = 1,
+    };
+    info.calls = lv_new_graph(info.scratch);
+
+    int num_funcs = 0;
+    for (var frag = fragments; frag; frag = frag->fr_list) {
+        if (frag->fr_tag == FR_CODE) {
+            num_funcs++;
+        }
+    }
+    info.funcs = Alloc(info.scratch, num_funcs * sizeof *info.funcs);
+
+    // The ids of the locals moved into callers come after all the others
+    int i = 0;
+    for (var frag = fragments; frag; frag = frag->fr_list) {
+        switch (frag->fr_tag) {
+            case FR_CODE:
+                break;
+            case FR_STRING:
+            case FR_FRAME_MAP:
+                continue;
+        }
+        var func = &info.funcs[i++];
+        func->frag = frag;
+        func->node = lv_new_node(info.calls, info.scratch);
+        im_upsert(&info.funcs_by_name, (uintptr_t)frag->fr_frame->acf_name,
+                info.scratch)->im_func = func;
+        for (var v = frag->fr_frame->ac_frame_vars; v; v = v->acf_list) {
+            if (v->acf_var_id >= info.next_var_id) {
+                info.next_var_id = v->acf_var_id + 1;
+            }
+        }
+    }
+
+    info.finding_calls = true;
+    for (i = 0; i < num_funcs; i++) {
+        measure_func(&info, &info.funcs[i]);
+    }
+    info.finding_calls = false;
+
+    for (i = 0; i < num_funcs; i++) {
+        if (!info.funcs[i].index) {
+            visit(&info, &info.funcs[i]);
+        }
+    }
+
+    Arena_dispose(&info.scratch);
+}
@@ -0,0 +1,19 @@
+#ifndef __INLINER_H__
+#define __INLINER_H__
+// vim:ft=c:
+
+#include "fragment.h"
+#include "temp.h"
+
+/*
+ * Replaces the calls to small functions, in the tree of each FR_CODE
+ * fragment, by copies of their bodies. Functions are inlined into their
+ * callers before their callers are inlined in turn, and functions that
+ * call themselves, directly or through others, are not inlined. The locals
+ * of an inlined function are moved into the frame of its caller, and the
+ * pointer maps of the caller's calls are calculated again.
+ */
+void inline_calls(Arena_T, temp_state_t*, sl_fragment_t* fragments);
+
+
+#endif /* __INLINER_H__ */
@@ -1,9 +1,14 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h> // malloc, abort
+#include <stdbool.h>
+#include <pthread.h>
+#include <stdint.h> // uintptr_t
 #include "arena.h"
 #include "../assertions.h"
 
+#define var __auto_type
+
 
 #if defined(__arm64__) && !defined(NDEBUG)
 #define USE_ZONES 1
@@ -20,6 +25,10 @@ enum { THRESHOLD = 10 };
 
 #define fatal(msg) do { perror(msg); abort(); } while (0)
 
+#ifndef ARENA_PROFILE
+#define ARENA_PROFILE 0
+#endif
+
 struct Arena {
 #if USE_ZONES
     malloc_zone_t* zone;
@@ -28,6 +37,11 @@ struct Arena {
     char* avail;
     char* limit;
 #endif // USE_ZONES
+#if ARENA_PROFILE
+    // Set on creation and never changed, so it is fine that it is also
+    // copied into the chunk headers.
+    struct arena_profile* profile;
+#endif
 };
 
 union align {
@@ -49,17 +63,266 @@ union header {
 
 
 #if ! USE_ZONES
+/*
+ * The free chunks are shared by all arenas, and arenas may be used from
+ * multiple threads (see -j in main.c), so they are guarded by a lock.
+ * Chunks are only taken and returned in bulk, so contention is low.
+ */
+static pthread_mutex_t freechunks_lock = PTHREAD_MUTEX_INITIALIZER;
 static T freechunks;
 static int nfree;
 #endif
 
+/*
+ * The number of bytes of chunks currently held by all arenas, and the most
+ * that has been held since the high water mark was last reset.
+ * Updated atomically, since arenas may be used from multiple threads.
+ */
+static long bytes_in_use;
+static long high_water;
+/*
+ * The same, counting only the chunks acquired and released by this thread,
+ * so that a pass on one thread can be measured while others are running.
+ */
+static _Thread_local long thread_bytes_in_use;
+static _Thread_local long thread_high_water;
+
+#if ! USE_ZONES
+static void add_bytes_in_use(long delta)
+{
+    thread_bytes_in_use += delta;
+    if (thread_bytes_in_use > thread_high_water) {
+        thread_high_water = thread_bytes_in_use;
+    }
+    long now = __atomic_add_fetch(&bytes_in_use, delta, __ATOMIC_RELAXED);
+    long hw = __atomic_load_n(&high_water, __ATOMIC_RELAXED);
+    while (now > hw && !__atomic_compare_exchange_n(&high_water, &hw, now,
+                true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+#endif
+
+
+#if ARENA_PROFILE
+/*
+ * Profiling of allocations by call site, enabled by building with
+ * ARENA_PROFILE defined (make ARENA_PROFILE=1). Each site is the file and
+ * line of a call to Arena_alloc and friends, or of the Arena_new that
+ * created an arena. A report is written to stderr at exit.
+ *
+ * This is slow and takes a global lock, so it's not for normal builds.
+ */
+enum { MAX_SITES = 8192 }; // must be a power of 2
+
+static struct arena_site {
+    const char* file;
+    int line;
+    long allocs;
+    long bytes;
+    long live; // bytes allocated from here in arenas not yet cleared
+    long peak_live;
+    // for arena creation sites
+    long arenas;
+    long arena_allocs;
+    long arena_bytes;
+    long arena_high_water; // the most allocated in one arena between clears
+} sites[MAX_SITES];
+static int num_sites;
+
+static pthread_mutex_t profile_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* The bytes allocated from each call site into an arena since it was
+ * last cleared, so that they can be subtracted from the sites' live bytes
+ * when it is. An open addressing hash table keyed on the site. */
+struct arena_profile {
+    struct arena_site* created_at;
+    long bytes;
+    struct arena_tally {
+        struct arena_site* site;
+        long bytes;
+    } *tallies;
+    int num_tallies;
+    int cap_tallies; // a power of 2
+};
+
+static void profile_report();
+
+/* profile_lock must be held */
+static struct arena_site* profile_site(const char* file, int line)
+{
+    static bool registered = false;
+    if (!registered) {
+        atexit(profile_report);
+        registered = true;
+    }
+
+    unsigned h = ((uintptr_t)file >> 3) * 31 + line;
+    for (unsigned i = 0; i < MAX_SITES; i++) {
+        struct arena_site* site = &sites[(h + i) & (MAX_SITES - 1)];
+        if (site->file == file && site->line == line) {
+            return site;
+        }
+        if (site->file == NULL) {
+            if (num_sites + 1 == MAX_SITES) {
+                fatal("arena profile: too many call sites");
+            }
+            num_sites++;
+            site->file = file;
+            site->line = line;
+            return site;
+        }
+    }
+    fatal("arena profile: too many call sites");
+}
+
+static struct arena_tally*
+profile_tally(struct arena_profile* profile, struct arena_site* site)
+{
+    if (2 * (profile->num_tallies + 1) > profile->cap_tallies) {
+        var old_tallies = profile->tallies;
+        int old_cap = profile->cap_tallies;
+        profile->cap_tallies = old_cap ? 2 * old_cap : 16;
+        profile->tallies =
+            calloc(profile->cap_tallies, sizeof *profile->tallies);
+        if (unlikely(!profile->tallies)) {
+            fatal("out of memory");
+        }
+        profile->num_tallies = 0;
+        for (int i = 0; i < old_cap; i++) {
+            if (old_tallies[i].site) {
+                *profile_tally(profile, old_tallies[i].site) = old_tallies[i];
+            }
+        }
+        free(old_tallies);
+    }
+
+    unsigned mask = profile->cap_tallies - 1;
+    for (unsigned i = ((uintptr_t)site >> 4) & mask; ; i = (i + 1) & mask) {
+        var tally = &profile->tallies[i];
+        if (tally->site == site) {
+            return tally;
+        }
+        if (tally->site == NULL) {
+            tally->site = site;
+            profile->num_tallies++;
+            return tally;
+        }
+    }
+}
+
+static void
+profile_alloc(T arena, long nbytes, const char* file, int line)
+{
+    pthread_mutex_lock(&profile_lock);
+    var site = profile_site(file, line);
+    site->allocs++;
+    site->bytes += nbytes;
+    site->live += nbytes;
+    if (site->live > site->peak_live) {
+        site->peak_live = site->live;
+    }
+    profile_tally(arena->profile, site)->bytes += nbytes;
+
+    var profile = arena->profile;
+    profile->created_at->arena_allocs++;
+    profile->created_at->arena_bytes += nbytes;
+    profile->bytes += nbytes;
+    if (profile->bytes > profile->created_at->arena_high_water) {
+        profile->created_at->arena_high_water = profile->bytes;
+    }
+    pthread_mutex_unlock(&profile_lock);
+}
+
+static void profile_clear(T arena)
+{
+    pthread_mutex_lock(&profile_lock);
+    var profile = arena->profile;
+    for (int i = 0; i < profile->cap_tallies; i++) {
+        var tally = &profile->tallies[i];
+        if (tally->site) {
+            tally->site->live -= tally->bytes;
+            tally->bytes = 0;
+        }
+    }
+    profile->bytes = 0;
+    pthread_mutex_unlock(&profile_lock);
+}
 
-T Arena_new()
+static int cmp_sites_by_bytes(const void* x, const void* y)
+{
+    const struct arena_site* const* a = x;
+    const struct arena_site* const* b = y;
+    return ((*a)->bytes < (*b)->bytes) ? 1
+        : ((*a)->bytes > (*b)->bytes) ? -1 : 0;
+}
+
+static int cmp_sites_by_arena_bytes(const void* x, const void* y)
+{
+    const struct arena_site* const* a = x;
+    const struct arena_site* const* b = y;
+    return ((*a)->arena_bytes < (*b)->arena_bytes) ? 1
+        : ((*a)->arena_bytes > (*b)->arena_bytes) ? -1 : 0;
+}
+
+static void profile_report()
+{
+    pthread_mutex_lock(&profile_lock);
+    struct arena_site* sorted[MAX_SITES];
+    int n = 0;
+    for (int i = 0; i < MAX_SITES; i++) {
+        if (sites[i].file) {
+            sorted[n++] = &sites[i];
+        }
+    }
+
+    FILE* out = stderr;
+    qsort(sorted, n, sizeof sorted[0], cmp_sites_by_arena_bytes);
+    fprintf(out, "===== arena profile: arenas by creation site =====\n");
+    fprintf(out, "%-32s %8s %10s %14s %14s\n",
+            "site", "arenas", "allocs", "bytes", "high water");
+    for (int i = 0; i < n; i++) {
+        var site = sorted[i];
+        if (site->arenas == 0) {
+            continue;
+        }
+        fprintf(out, "%-26s:%-5d %8ld %10ld %14ld %14ld\n", site->file,
+                site->line, site->arenas, site->arena_allocs,
+                site->arena_bytes, site->arena_high_water);
+    }
+
+    qsort(sorted, n, sizeof sorted[0], cmp_sites_by_bytes);
+    fprintf(out, "===== arena profile: allocations by call site =====\n");
+    fprintf(out, "%-32s %10s %14s %14s\n",
+            "site", "allocs", "bytes", "peak live");
+    for (int i = 0; i < n; i++) {
+        var site = sorted[i];
+        if (site->allocs == 0) {
+            continue;
+        }
+        fprintf(out, "%-26s:%-5d %10ld %14ld %14ld\n", site->file,
+                site->line, site->allocs, site->bytes, site->peak_live);
+    }
+    pthread_mutex_unlock(&profile_lock);
+}
+#endif // ARENA_PROFILE
+
+
+T Arena_new_at(const char* file, int line)
 {
     T arena = malloc(sizeof *arena);
     if (unlikely(!arena)) {
         fatal("out of memory");
     }
+#if ARENA_PROFILE
+    arena->profile = calloc(1, sizeof *arena->profile);
+    if (unlikely(!arena->profile)) {
+        fatal("out of memory");
+    }
+    pthread_mutex_lock(&profile_lock);
+    arena->profile->created_at = profile_site(file, line);
+    arena->profile->created_at->arenas++;
+    pthread_mutex_unlock(&profile_lock);
+#endif
 #if USE_ZONES
     arena->zone = malloc_create_zone(0, 0);
     if (unlikely(!arena->zone)) {
@@ -80,6 +343,11 @@ Arena_dispose(T* ap)
     malloc_destroy_zone((*ap)->zone);
 #else
     Arena_clear(*ap);
+#endif
+#if ARENA_PROFILE
+    profile_clear(*ap);
+    free((*ap)->profile->tallies);
+    free((*ap)->profile);
 #endif
     free(*ap);
     *ap = NULL;
@@ -92,6 +360,9 @@ Arena_alloc(T arena, long nbytes, const char* file, int line)
 {
     assert(arena);
     assert(nbytes >= 0);
+#if ARENA_PROFILE
+    profile_alloc(arena, nbytes, file, line);
+#endif
 #if USE_ZONES
     void* ptr = malloc_zone_calloc(arena->zone, 1, nbytes);
     if (unlikely(!ptr)) {
@@ -106,11 +377,14 @@ Arena_alloc(T arena, long nbytes, const char* file, int line)
         T ptr;
         char *limit;
 
+        pthread_mutex_lock(&freechunks_lock);
         if ((ptr = freechunks) != NULL) {
             freechunks = freechunks->prev;
             nfree--;
             limit = ptr->limit;
-        } else {
+        }
+        pthread_mutex_unlock(&freechunks_lock);
+        if (ptr == NULL) {
             long m = sizeof (union header) + nbytes + 10*1024;
             ptr = malloc(m);
             if (unlikely(!ptr)) {
@@ -118,6 +392,7 @@ Arena_alloc(T arena, long nbytes, const char* file, int line)
             }
             limit = (char*)ptr + m;
         }
+        add_bytes_in_use(limit - (char*)ptr);
 
         *ptr = *arena;
         arena->avail = (char*)((union header *)ptr + 1);
@@ -187,6 +462,9 @@ void
 Arena_clear(T arena)
 {
     assert(arena);
+#if ARENA_PROFILE
+    profile_clear(arena);
+#endif
 #if USE_ZONES
     // doesn't exist with zones
     malloc_destroy_zone(arena->zone);
@@ -195,7 +473,9 @@ Arena_clear(T arena)
         fatal("malloc_create_zone");
     }
 #else
+    pthread_mutex_lock(&freechunks_lock);
     while (arena->prev) {
+        add_bytes_in_use(-(arena->limit - (char*)arena->prev));
         struct Arena tmp = *arena->prev;
         if (nfree < THRESHOLD) {
             arena->prev->prev = freechunks;
@@ -207,11 +487,42 @@ Arena_clear(T arena)
         }
         *arena = tmp;
     }
+    pthread_mutex_unlock(&freechunks_lock);
     assert(arena->limit == NULL);
     assert(arena->avail == NULL);
 #endif // USE_ZONES
 }
 
+long Arena_bytes_in_use()
+{
+    return __atomic_load_n(&bytes_in_use, __ATOMIC_RELAXED);
+}
+
+long Arena_high_water()
+{
+    return __atomic_load_n(&high_water, __ATOMIC_RELAXED);
+}
+
+void Arena_reset_high_water()
+{
+    __atomic_store_n(&high_water, Arena_bytes_in_use(), __ATOMIC_RELAXED);
+}
+
+long Arena_thread_bytes_in_use()
+{
+    return thread_bytes_in_use;
+}
+
+long Arena_thread_high_water()
+{
+    return thread_high_water;
+}
+
+void Arena_reset_thread_high_water()
+{
+    thread_high_water = thread_bytes_in_use;
+}
+
 #undef T
 
 #include "../test_harness.h"
@@ -7,9 +7,11 @@
 typedef struct Arena *T;
 
 /*
- * Allocates a new arena.
+ * Allocates a new arena. The call site is recorded so that arenas can be
+ * told apart when built with ARENA_PROFILE.
  */
-T Arena_new();
+T Arena_new_at(const char* file, int line);
+#define Arena_new() Arena_new_at(__FILE__, __LINE__)
 
 /*
  * Deallocates and disposes of the arena. ap is set to NULL.
@@ -52,6 +54,23 @@ void Arena_free(T arena, void* ptr, ptrdiff_t size);
  */
 void Arena_clear(T arena);
 
+/*
+ * The number of bytes held by all arenas together, and the largest that
+ * figure has been since the high water mark was last reset.
+ * These are not tracked when arenas are backed by malloc zones.
+ */
+long Arena_bytes_in_use();
+long Arena_high_water();
+void Arena_reset_high_water();
+
+/*
+ * As above, but counting only the chunks acquired and released by the
+ * calling thread.
+ */
+long Arena_thread_bytes_in_use();
+long Arena_thread_high_water();
+void Arena_reset_thread_high_water();
+
 
 #undef T
 #endif /* __ARENA_H__ */
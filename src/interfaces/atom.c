@@ -1,18 +1,40 @@
 #include "atom.h"
 #include <string.h>
-#include <assert.h>
+#include "../assertions.h"
 #include <limits.h>
 
 #include <stdlib.h>
+#include <pthread.h>
 
 
 #define NELEMS(x) ((sizeof (x)) / (sizeof ((x)[0])))
 
-static struct atom {
+/*
+ * The atoms are split between a number of shards, chosen by hash, so that
+ * threads interning different strings rarely contend on the same lock.
+ * Each shard is a chained hash table that doubles its number of buckets
+ * when the average chain length goes above 2.
+ */
+enum {
+    NSHARDS = 64,           // must be a power of 2
+    INITIAL_BUCKETS = 64,   // per shard, must be a power of 2
+};
+
+struct atom {
     struct atom* link;
+    unsigned long hash;
     int len;
     char* str;
-} *buckets[2048];
+};
+
+static struct shard {
+    pthread_mutex_t lock;
+    struct atom** buckets;
+    unsigned long size; // the number of buckets
+    unsigned long count; // the number of atoms
+} __attribute__((aligned(64))) shards[NSHARDS] = {
+    [0 ... NSHARDS - 1] = { .lock = PTHREAD_MUTEX_INITIALIZER },
+};
 
 static unsigned long scatter[] = {
 2078917053, 143302914, 1027100827, 1953210302, 755253631, 2002600785,
@@ -93,6 +115,54 @@ const char* Atom_int(long n)
 }
 
 
+static unsigned long hash_str(const char* str, int len)
+{
+    unsigned long h;
+    int i;
+    for (h = 0, i = 0; i < len; i++) {
+        h = (h << 1) + scatter[(unsigned char)str[i]];
+    }
+    return h;
+}
+
+static struct shard* shard_for_hash(unsigned long h)
+{
+    return &shards[h & (NSHARDS - 1)];
+}
+
+/*
+ * The low bits of the hash choose the shard, so the buckets within a shard
+ * are chosen using the bits above them.
+ */
+static unsigned long bucket_for_hash(const struct shard* shard, unsigned long h)
+{
+    return (h / NSHARDS) & (shard->size - 1);
+}
+
+/* The shard's lock must be held */
+static void grow(struct shard* shard)
+{
+    unsigned long new_size = shard->size ? 2 * shard->size : INITIAL_BUCKETS;
+    struct atom** old_buckets = shard->buckets;
+    unsigned long old_size = shard->size;
+
+    shard->buckets = calloc(new_size, sizeof *shard->buckets);
+    assert(shard->buckets);
+    shard->size = new_size;
+
+    for (unsigned long i = 0; i < old_size; i++) {
+        struct atom* p = old_buckets[i];
+        while (p) {
+            struct atom* next = p->link;
+            unsigned long b = bucket_for_hash(shard, p->hash);
+            p->link = shard->buckets[b];
+            shard->buckets[b] = p;
+            p = next;
+        }
+    }
+    free(old_buckets);
+}
+
 const char* Atom_new(const char* str, int len)
 {
     unsigned long h;
@@ -102,37 +172,47 @@ const char* Atom_new(const char* str, int len)
     assert(str);
     assert(len >= 0);
 
-    /* start: hash str */
-    for (h = 0, i = 0; i < len; i++) {
-        h = (h << 1) + scatter[(unsigned char)str[i]];
+    h = hash_str(str, len);
+    struct shard* shard = shard_for_hash(h);
+
+    pthread_mutex_lock(&shard->lock);
+    if (shard->size == 0) {
+        grow(shard);
     }
-    /* end: hash str */
 
-    h %= NELEMS(buckets);
-    for (p = buckets[h]; p; p = p->link) {
-        if (len == p->len) {
+    for (p = shard->buckets[bucket_for_hash(shard, h)]; p; p = p->link) {
+        if (h == p->hash && len == p->len) {
             for (i = 0; i < len && p->str[i] == str[i]; ) {
                 i++;
             }
             if (i == len) {
+                pthread_mutex_unlock(&shard->lock);
                 return p->str;
             }
         }
     }
 
+    if (shard->count >= 2 * shard->size) {
+        grow(shard);
+    }
+
     /* start: allocate new entry */
     p = malloc(sizeof *p + len + 1);
     assert(p);
+    p->hash = h;
     p->len = len;
     p->str = (char*)(p + 1);
     if (len > 0) {
         memcpy(p->str, str, len);
     }
     p->str[len] = '\0';
-    p->link = buckets[h];
-    buckets[h] = p;
+    unsigned long b = bucket_for_hash(shard, h);
+    p->link = shard->buckets[b];
+    shard->buckets[b] = p;
+    shard->count++;
 
     /* end: allocate new entry */
+    pthread_mutex_unlock(&shard->lock);
     return p->str;
 }
 
@@ -140,16 +220,70 @@ const char* Atom_new(const char* str, int len)
 int Atom_length(const char* str)
 {
     struct atom *p;
-    int i;
+    unsigned long i;
 
     assert(str);
-    for (i = 0; i < NELEMS(buckets); i++) {
-        for (p = buckets[i]; p; p = p->link) {
-            if (p->str == str) {
-                return p->len;
+    for (int s = 0; s < NSHARDS; s++) {
+        struct shard* shard = &shards[s];
+        pthread_mutex_lock(&shard->lock);
+        for (i = 0; i < shard->size; i++) {
+            for (p = shard->buckets[i]; p; p = p->link) {
+                if (p->str == str) {
+                    pthread_mutex_unlock(&shard->lock);
+                    return p->len;
+                }
             }
         }
+        pthread_mutex_unlock(&shard->lock);
     }
     assert(0);
     return 0;
 }
+
+
+#include "../test_harness.h"
+
+enum { TEST_ATOM_THREADS = 4, TEST_ATOM_COUNT = 5000 };
+
+static void* test_atom_intern_ints(void* arg)
+{
+    const char** results = arg;
+    for (int i = 0; i < TEST_ATOM_COUNT; i++) {
+        results[i] = Atom_int(i);
+    }
+    return NULL;
+}
+
+void
+test_Atom()
+{
+    const char* a = Atom_string("hello");
+    assert(a == Atom_new("hello world", 5));
+    assert(a != Atom_string("hello world"));
+    assert(Atom_length(a) == 5);
+    assert(Atom_new("", 0) == Atom_string(""));
+
+    // Enough atoms that every shard has to grow, interned concurrently
+    static const char* results[TEST_ATOM_THREADS][TEST_ATOM_COUNT];
+    pthread_t threads[TEST_ATOM_THREADS];
+    for (int t = 0; t < TEST_ATOM_THREADS; t++) {
+        pthread_create(&threads[t], NULL, test_atom_intern_ints, results[t]);
+    }
+    for (int t = 0; t < TEST_ATOM_THREADS; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    for (int i = 0; i < TEST_ATOM_COUNT; i++) {
+        for (int t = 1; t < TEST_ATOM_THREADS; t++) {
+            assert(results[t][i] == results[0][i]);
+        }
+        assert(results[0][i] == Atom_int(i));
+    }
+}
+
+static void register_tests() __attribute__((constructor));
+void
+register_tests() {
+
+    REGISTER_TEST(test_Atom);
+
+}
@@ -1,14 +1,19 @@
 #include "liveness.h"
 #include "list.h"
-#include <assert.h>
+#include "array.h"
+#include "assertions.h"
 #include <inttypes.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#endif
 
 #define var __auto_type
+#define NELEMS(A) ((sizeof A) / sizeof A[0])
 #define Alloc(ar, size) Arena_alloc(ar, size, __FILE__, __LINE__)
 
 static temp_list_t* temp_list_sort(temp_list_t* tl, Arena_T);
@@ -20,9 +25,8 @@ static temp_list_t* temp_list_sort(temp_list_t* tl, Arena_T);
  *
  * Suppose there are 72 temporaries used within an example function.
  * This will require two 64-bit words to represent each set.
- * FIXME: we should talk about the number of control flow graph nodes.
- * So we would allocate 72 * 2 (= 144) 64-bit words to store a map
- * of sets for the interference graph.
+ * So for a function of 10 basic blocks, we would allocate 10 * 2 (= 20)
+ * 64-bit words to store a map from each block to its live-in set.
  */
 
 #define BitsetLen(len) (((len) + 63) / 64)
@@ -71,57 +75,217 @@ static node_set2_t node_set_table_get(node_set_table_t table, int idx)
     return result;
 }
 
-static node_set2_t Table_NST_get(node_set_table_t table, lv_node_t* node)
+/* overwrites dst with the value of src */
+static void node_set2_copy(node_set2_t dst, const node_set2_t src)
 {
-    return node_set_table_get(table, node->lvn_idx);
+    assert(dst.len == src.len);
+    memcpy(dst.bits, src.bits, BitsetBytes(dst.len));
 }
 
-/* overwrites the set for node with the value of to_copy */
-static void Table_NST_put(node_set_table_t table, lv_node_t* node, node_set2_t to_copy)
+static void node_set2_clear(node_set2_t dst)
 {
-    assert(table.len == to_copy.len);
-    node_set2_t dst = Table_NST_get(table, node);
-    memcpy(dst.bits, to_copy.bits, BitsetBytes(table.len));
+    memset(dst.bits, 0, BitsetBytes(dst.len));
 }
 
-static void node_set2_clear(node_set2_t dst)
+/*
+ * The loops over the words of the sets are the inner loop of the dataflow
+ * analysis. Where the CPU has them, we use kernels that do two or four
+ * words at a time, chosen once at start up. n is the number of words.
+ */
+typedef struct bitset_kernels_t {
+    void (*bk_union)(
+            uint64_t* dst, const uint64_t* a, const uint64_t* b, size_t n);
+    void (*bk_minus)(
+            uint64_t* dst, const uint64_t* a, const uint64_t* b, size_t n);
+    /* in = gen | (out & ~kill), returning whether in changed */
+    bool (*bk_update_in)(uint64_t* in, const uint64_t* gen,
+            const uint64_t* out, const uint64_t* kill, size_t n);
+} bitset_kernels_t;
+
+static void
+union_portable(uint64_t* dst, const uint64_t* a, const uint64_t* b, size_t n)
 {
-    memset(dst.bits, 0, BitsetBytes(dst.len));
+    for (size_t i = 0; i < n; i++) {
+        dst[i] = a[i] | b[i];
+    }
 }
 
 static void
-node_set2_union(node_set2_t dst, const node_set2_t src1, const node_set2_t src2)
+minus_portable(uint64_t* dst, const uint64_t* a, const uint64_t* b, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        dst[i] = a[i] & ~b[i];
+    }
+}
+
+static bool
+update_in_portable(uint64_t* in, const uint64_t* gen, const uint64_t* out,
+        const uint64_t* kill, size_t n)
 {
-    for (int i = BitsetLen(dst.len); --i >= 0; ) {
-        dst.bits[i] = src1.bits[i] | src2.bits[i];
+    uint64_t changed = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint64_t word = gen[i] | (out[i] & ~kill[i]);
+        changed |= word ^ in[i];
+        in[i] = word;
     }
+    return changed != 0;
 }
 
+static const bitset_kernels_t portable_kernels = {
+    .bk_union = union_portable,
+    .bk_minus = minus_portable,
+    .bk_update_in = update_in_portable,
+};
+
+#if defined(__x86_64__) && defined(__GNUC__)
+
+/* SSE2 is part of x86-64, so these need no check */
+
 static void
-node_set2_minus(node_set2_t dst, const node_set2_t src1, const node_set2_t src2)
+union_sse2(uint64_t* dst, const uint64_t* a, const uint64_t* b, size_t n)
+{
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(a + i));
+        __m128i y = _mm_loadu_si128((const __m128i*)(b + i));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_or_si128(x, y));
+    }
+    union_portable(dst + i, a + i, b + i, n - i);
+}
+
+static void
+minus_sse2(uint64_t* dst, const uint64_t* a, const uint64_t* b, size_t n)
+{
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(a + i));
+        __m128i y = _mm_loadu_si128((const __m128i*)(b + i));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_andnot_si128(y, x));
+    }
+    minus_portable(dst + i, a + i, b + i, n - i);
+}
+
+static bool
+update_in_sse2(uint64_t* in, const uint64_t* gen, const uint64_t* out,
+        const uint64_t* kill, size_t n)
+{
+    __m128i changed = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128i g = _mm_loadu_si128((const __m128i*)(gen + i));
+        __m128i o = _mm_loadu_si128((const __m128i*)(out + i));
+        __m128i k = _mm_loadu_si128((const __m128i*)(kill + i));
+        __m128i old = _mm_loadu_si128((const __m128i*)(in + i));
+        __m128i word = _mm_or_si128(g, _mm_andnot_si128(k, o));
+        changed = _mm_or_si128(changed, _mm_xor_si128(word, old));
+        _mm_storeu_si128((__m128i*)(in + i), word);
+    }
+    bool tail_changed =
+        update_in_portable(in + i, gen + i, out + i, kill + i, n - i);
+    __m128i zero = _mm_setzero_si128();
+    return tail_changed
+        || _mm_movemask_epi8(_mm_cmpeq_epi8(changed, zero)) != 0xFFFF;
+}
+
+static const bitset_kernels_t sse2_kernels = {
+    .bk_union = union_sse2,
+    .bk_minus = minus_sse2,
+    .bk_update_in = update_in_sse2,
+};
+
+__attribute__((target("avx2")))
+static void
+union_avx2(uint64_t* dst, const uint64_t* a, const uint64_t* b, size_t n)
+{
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i y = _mm256_loadu_si256((const __m256i*)(b + i));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_or_si256(x, y));
+    }
+    union_sse2(dst + i, a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void
+minus_avx2(uint64_t* dst, const uint64_t* a, const uint64_t* b, size_t n)
 {
-    for (int i = BitsetLen(dst.len); --i >= 0; ) {
-        dst.bits[i] = src1.bits[i] & ~src2.bits[i];
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i y = _mm256_loadu_si256((const __m256i*)(b + i));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_andnot_si256(y, x));
     }
+    minus_sse2(dst + i, a + i, b + i, n - i);
 }
 
-static int node_set2_count(const node_set2_t s)
+__attribute__((target("avx2")))
+static bool
+update_in_avx2(uint64_t* in, const uint64_t* gen, const uint64_t* out,
+        const uint64_t* kill, size_t n)
 {
-    int total = 0;
-    for (int i = BitsetLen(s.len); --i >= 0; ) {
-        total += __builtin_popcountll(s.bits[i]);
+    __m256i changed = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i g = _mm256_loadu_si256((const __m256i*)(gen + i));
+        __m256i o = _mm256_loadu_si256((const __m256i*)(out + i));
+        __m256i k = _mm256_loadu_si256((const __m256i*)(kill + i));
+        __m256i old = _mm256_loadu_si256((const __m256i*)(in + i));
+        __m256i word = _mm256_or_si256(g, _mm256_andnot_si256(k, o));
+        changed = _mm256_or_si256(changed, _mm256_xor_si256(word, old));
+        _mm256_storeu_si256((__m256i*)(in + i), word);
     }
-    return total;
+    bool tail_changed =
+        update_in_sse2(in + i, gen + i, out + i, kill + i, n - i);
+    return tail_changed || !_mm256_testz_si256(changed, changed);
 }
 
-static bool node_set2_eq(const node_set2_t s, const node_set2_t t)
+static const bitset_kernels_t avx2_kernels = {
+    .bk_union = union_avx2,
+    .bk_minus = minus_avx2,
+    .bk_update_in = update_in_avx2,
+};
+
+static const bitset_kernels_t* kernels = &sse2_kernels;
+
+static void select_bitset_kernels() __attribute__((constructor));
+void
+select_bitset_kernels()
 {
-    assert(s.len == t.len);
-    for (int i = BitsetLen(s.len); --i >= 0; ) {
-        if (s.bits[i] != t.bits[i])
-            return false;
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        kernels = &avx2_kernels;
     }
-    return true;
+}
+
+#else
+/* On arm64, the compiler vectorises the portable loops with NEON */
+static const bitset_kernels_t* kernels = &portable_kernels;
+#endif
+
+static void
+node_set2_union(node_set2_t dst, const node_set2_t src1, const node_set2_t src2)
+{
+    kernels->bk_union(dst.bits, src1.bits, src2.bits, BitsetLen(dst.len));
+}
+
+static void
+node_set2_minus(node_set2_t dst, const node_set2_t src1, const node_set2_t src2)
+{
+    kernels->bk_minus(dst.bits, src1.bits, src2.bits, BitsetLen(dst.len));
+}
+
+/*
+ * in = gen union (out setminus kill), in one pass over the sets. Returns
+ * whether in changed.
+ */
+static bool
+node_set2_update_in(node_set2_t in, const node_set2_t gen,
+        const node_set2_t out, const node_set2_t kill)
+{
+    assert(in.len == out.len);
+    return kernels->bk_update_in(
+            in.bits, gen.bits, out.bits, kill.bits, BitsetLen(in.len));
 }
 
 static void node_set2_add(node_set2_t s, const lv_node_t* node)
@@ -134,20 +298,20 @@ static void node_set2_remove(node_set2_t s, const lv_node_t* node)
     ClearBit(s.bits, node->lvn_idx);
 }
 
-static bool node_set2_member(node_set2_t s, const lv_node_t* node)
-{
-    return IsBitSet(s.bits, node->lvn_idx);
-}
-
-static int node_set2_first_idx(node_set2_t s)
+/* The index of the first member of s that is at least from, or -1 */
+static int node_set2_next_idx(const node_set2_t s, int from)
 {
-    for (int i = 0, n = BitsetLen(s.len); i < n; i++) {
-        if (s.bits[i] != 0) {
-            return __builtin_ctzll(s.bits[i]) + (64 * i);
+    if (from >= s.len) {
+        return -1;
+    }
+    int i = from >> 6;
+    uint64_t word = s.bits[i] & (~0ULL << (from & 63));
+    for (int n = BitsetLen(s.len); word == 0; word = s.bits[i]) {
+        if (++i == n) {
+            return -1;
         }
     }
-    assert(!"set is empty");
-    abort();
+    return __builtin_ctzll(word) + (64 * i);
 }
 
 // https://nullprogram.com/blog/2018/07/31/
@@ -186,19 +350,6 @@ temp_list_t* nt_get(lv_node_temps_map_t *m, lv_node_t* key)
 }
 
 
-static int cmpnode(const void* x, const void* y)
-{
-    if (lv_eq(x, y)) {
-        return 0;
-    }
-    return 1;
-}
-static unsigned hashnode(const void* key)
-{
-    const lv_node_t* k = key;
-    return k->lvn_idx;
-}
-
 struct flowgraph_and_node_list
 instrs2graph(const assm_instr_t* instrs, Arena_T arena)
 {
@@ -297,11 +448,6 @@ static int cmptemp(const void* x, const void* y)
     const temp_t* yy = y;
     return xx->temp_id - yy->temp_id;
 }
-static unsigned hashtemp(const void* key)
-{
-    const temp_t* k = key;
-    return k->temp_id;
-}
 
 // prove that we can use the list.h routines on it
 static_assert(sizeof(temp_list_t) == sizeof(struct list_t), "temp_list_t size");
@@ -366,86 +512,367 @@ bool lv_node_pair_eq(const lv_node_pair_t* lhs, const lv_node_pair_t* rhs)
 }
 
 
+/*
+ * The temp is copied, since the interference graph can outlive the flow
+ * graph, and the temp lists of the instructions are rewritten by spilling.
+ */
 static lv_node_t*
 ig_get_node_for_temp(lv_igraph_t* igraph, temp_t* ptemp, Arena_T ar)
 {
-    lv_node_t* ig_node = Table_get(igraph->lvig_tnode, ptemp);
+    assert(ptemp->temp_id >= 0);
+    while (igraph->lvig_tnode.len <= ptemp->temp_id) {
+        arrpush(&igraph->lvig_tnode, ar, NULL);
+    }
+    lv_node_t* ig_node = igraph->lvig_tnode.data[ptemp->temp_id];
     if (!ig_node) {
         ig_node = lv_new_node(igraph->lvig_graph, ar);
-        Table_put(igraph->lvig_tnode, ptemp, ig_node);
-        Table_put(igraph->lvig_gtemp, ig_node, ptemp);
+        temp_t* temp = Alloc(ar, sizeof *temp);
+        *temp = *ptemp;
+        igraph->lvig_tnode.data[temp->temp_id] = ig_node;
+        assert(igraph->lvig_gtemp.len == ig_node->lvn_idx);
+        arrpush(&igraph->lvig_gtemp, ar, temp);
+        igraph->lvig_num_temps++;
     }
     return ig_node;
 }
 
 
-static lv_node_t*
-ig_get_node_by_idx(lv_igraph_t* igraph, int i, Arena_T ar)
+/*
+ * The dataflow equations are solved for basic blocks rather than for each
+ * instruction. A block is a run of flow graph nodes in which each node,
+ * other than the last, has the next as its only successor, and each node,
+ * other than the first, has the previous as its only predecessor.
+ */
+typedef struct lv_blocks {
+    int count;
+    int* first; /* the index of the first node in each block */
+    int* last; /* the index of the last node in each block */
+    int* block_of; /* the block that each node is in */
+    /*
+     * The blocks in reverse postorder of a depth first search that goes
+     * backwards from the exit, i.e. along the predecessors. Liveness flows
+     * backwards, so visiting blocks in this order settles the equations
+     * quickest.
+     */
+    int* order;
+    int* rank; /* the position of each block in order */
+} lv_blocks_t;
+
+/* whether the edge from prev to node is the only way out of prev and
+ * the only way in to node */
+static bool only_edge_between(lv_node_t* prev, lv_node_t* node)
 {
-    lv_node_t fake_node = {.lvn_graph=igraph->lvig_graph, .lvn_idx=i};
-    var ptemp = Table_get(igraph->lvig_gtemp, &fake_node);
-    return ig_get_node_for_temp(igraph, ptemp, ar);
+    var succ = lv_succ(prev);
+    if (!lv_node_it_next(&succ) || !lv_eq(&succ.lvni_node, node)
+            || lv_node_it_next(&succ)) {
+        return false;
+    }
+    var pred = lv_pred(node);
+    lv_node_it_next(&pred); // this is prev
+    return !lv_node_it_next(&pred);
 }
 
+/* The blocks that come after b, or before it if not forwards */
+static lv_node_it_arr
+block_edges(const lv_blocks_t* blocks, lv_node_t** nodes, int b,
+        bool forwards)
+{
+    return forwards
+        ? lv_succ(nodes[blocks->last[b]])
+        : lv_pred(nodes[blocks->first[b]]);
+}
 
+/*
+ * Appends the blocks reachable backwards, or forwards, from root, that
+ * are not yet marked, to postorder.
+ */
 static void
-depth_first_search(int* N, lv_node_t* i, bool* mark, lv_node_t* sorted)
+postorder_from(const lv_blocks_t* blocks, lv_node_t** nodes, int root,
+        bool forwards, bool* mark, int* postorder, int* n, Arena_T ar)
+{
+    typedef struct { int block; lv_node_it_arr edges; } frame_t;
+    frame_t* stack = Alloc(ar, blocks->count * sizeof *stack);
+    int depth = 0;
+
+    mark[root] = true;
+    stack[depth++] =
+        (frame_t){root, block_edges(blocks, nodes, root, forwards)};
+    while (depth > 0) {
+        var top = &stack[depth - 1];
+        if (lv_node_it_next(&top->edges)) {
+            int p = blocks->block_of[top->edges.lvni_node.lvn_idx];
+            if (!mark[p]) {
+                mark[p] = true;
+                stack[depth++] =
+                    (frame_t){p, block_edges(blocks, nodes, p, forwards)};
+            }
+        } else {
+            postorder[(*n)++] = top->block;
+            depth--;
+        }
+    }
+}
+
+/* Splits the nodes into blocks, without ordering them */
+static lv_blocks_t
+split_blocks(lv_node_t** nodes, int fg_len, Arena_T ar)
 {
-    // TODO: change this into a work-stack based algorithm
-    // instead of recursive function
-    if (mark[i->lvn_idx] == false) {
-        mark[i->lvn_idx] = true;
-        for (var it = lv_pred(i); lv_node_it_next(&it);) {
-            depth_first_search(N, &it.lvni_node, mark, sorted);
+    lv_blocks_t blocks = {};
+    blocks.first = Alloc(ar, fg_len * sizeof *blocks.first);
+    blocks.block_of = Alloc(ar, fg_len * sizeof *blocks.block_of);
+    for (int i = 0; i < fg_len; i++) {
+        if (i == 0 || !only_edge_between(nodes[i - 1], nodes[i])) {
+            blocks.first[blocks.count++] = i;
         }
-        sorted[*N - 1] = *i;
-        *N = *N - 1;
+        blocks.block_of[i] = blocks.count - 1;
+    }
+    blocks.last = Alloc(ar, blocks.count * sizeof *blocks.last);
+    for (int b = 0; b < blocks.count - 1; b++) {
+        blocks.last[b] = blocks.first[b + 1] - 1;
     }
+    blocks.last[blocks.count - 1] = fg_len - 1;
+    return blocks;
 }
 
-static lv_node_t*
-topological_sort(int flowgraph_length, lv_node_list_t* cg_nodes, Arena_T ar)
+static lv_blocks_t
+find_blocks(lv_node_t** nodes, int fg_len, lv_node_t* exit_node, Arena_T ar)
 {
-    int N = flowgraph_length;
-    bool* mark = Alloc(ar, N * sizeof *mark);
-    lv_node_t* sorted = Alloc(ar, N * sizeof *sorted);
+    var blocks = split_blocks(nodes, fg_len, ar);
+
+    // Blocks that cannot reach the exit, such as those in a loop without
+    // a break, are searched from afterwards.
+    bool* mark = Alloc(ar, blocks.count * sizeof *mark);
+    int* postorder = Alloc(ar, blocks.count * sizeof *postorder);
+    int n = 0;
+    postorder_from(&blocks, nodes, blocks.block_of[exit_node->lvn_idx],
+            false, mark, postorder, &n, ar);
+    for (int b = blocks.count - 1; b >= 0; b--) {
+        if (!mark[b]) {
+            postorder_from(&blocks, nodes, b, false, mark, postorder, &n, ar);
+        }
+    }
+    assert(n == blocks.count);
 
-    lv_node_t* exit_node = NULL;
-    for (var n = cg_nodes; n; n = n->nl_list) {
-        int k = 0;
-        for (var it = lv_succ(n->nl_node); lv_node_it_next(&it);) {
-            k++; }
-        if (k == 0) {
-            exit_node = n->nl_node;
-            break;
+    blocks.order = Alloc(ar, blocks.count * sizeof *blocks.order);
+    blocks.rank = Alloc(ar, blocks.count * sizeof *blocks.rank);
+    for (int k = 0; k < blocks.count; k++) {
+        blocks.order[k] = postorder[blocks.count - 1 - k];
+        blocks.rank[blocks.order[k]] = k;
+    }
+    return blocks;
+}
+
+/* The block that dominates both a and b, given the dominators so far */
+static int
+intersect_dominators(const int* idom, const int* rpo_num, int a, int b)
+{
+    while (a != b) {
+        while (rpo_num[a] > rpo_num[b]) {
+            a = idom[a];
+        }
+        while (rpo_num[b] > rpo_num[a]) {
+            b = idom[b];
         }
     }
-    assert(exit_node);
+    return a;
+}
 
-    depth_first_search(&N, exit_node, mark, sorted);
-    return sorted;
+static bool
+dominates(const int* idom, int d, int b)
+{
+    for (; b != d && idom[b] != b; b = idom[b]) {
+    }
+    return b == d;
 }
 
 /*
- * Given a control flow graph (and its associated nodes), compute
- * the interference graph and the Live Outs for each flow graph node.
+ * The loops are found from the back edges, those from a block to one that
+ * dominates it. The body of the loop is then the blocks that can reach
+ * the back edge without going through the header. The dominators are
+ * found by the algorithm of Cooper, Harvey and Kennedy, in "A Simple, Fast
+ * Dominance Algorithm". Blocks that cannot be reached from the entry are
+ * not in any loop.
  */
-struct igraph_and_table
-interference_graph(
-        lv_flowgraph_t* flow, lv_node_list_t* cg_nodes, Arena_T arena)
+int*
+lv_loop_depths(lv_flowgraph_t* flow, Arena_T arena)
 {
+    size_t fg_len = lv_graph_length(flow->lvfg_control);
+    int* depths = Alloc(arena, fg_len * sizeof *depths);
+    if (fg_len == 0) {
+        return depths;
+    }
     Arena_T scratch = Arena_new();
-    // First ensure that there is an interference graph node for
-    // each temporary
-    lv_igraph_t* igraph = Alloc(arena, sizeof *igraph);
-    igraph->lvig_graph = lv_new_graph(arena);
-    igraph->lvig_tnode = Table_new(0, cmptemp, hashtemp);
-    igraph->lvig_gtemp = Table_new(0, cmpnode, hashnode);
-    igraph->lvig_moves = NULL;
 
-    /*
-     * Add nodes to the interference graph for each temporary
-     */
+    lv_node_t* node_array = Alloc(scratch, fg_len * sizeof *node_array);
+    lv_node_t** nodes = Alloc(scratch, fg_len * sizeof *nodes);
+    for (var it = lv_nodes(flow->lvfg_control); lv_node_it_next(&it); ) {
+        int i = it.lvni_node.lvn_idx;
+        node_array[i] = it.lvni_node;
+        nodes[i] = &node_array[i];
+    }
+    var blocks = split_blocks(nodes, fg_len, scratch);
+    const int count = blocks.count;
+
+    bool* mark = Alloc(scratch, count * sizeof *mark);
+    int* postorder = Alloc(scratch, count * sizeof *postorder);
+    int reached = 0;
+    postorder_from(&blocks, nodes, 0, true, mark, postorder, &reached,
+            scratch);
+    int* rpo_num = Alloc(scratch, count * sizeof *rpo_num);
+    int* idom = Alloc(scratch, count * sizeof *idom);
+    for (int b = 0; b < count; b++) {
+        rpo_num[b] = -1;
+        idom[b] = -1;
+    }
+    for (int k = 0; k < reached; k++) {
+        rpo_num[postorder[reached - 1 - k]] = k;
+    }
+
+    idom[0] = 0;
+    for (bool changed = true; changed; ) {
+        changed = false;
+        for (int k = reached - 2; k >= 0; k--) {
+            int b = postorder[k];
+            int new_idom = -1;
+            for (var it = block_edges(&blocks, nodes, b, false);
+                    lv_node_it_next(&it);) {
+                int p = blocks.block_of[it.lvni_node.lvn_idx];
+                if (idom[p] < 0) {
+                    continue;
+                }
+                new_idom = (new_idom < 0)
+                    ? p : intersect_dominators(idom, rpo_num, p, new_idom);
+            }
+            if (idom[b] != new_idom) {
+                idom[b] = new_idom;
+                changed = true;
+            }
+        }
+    }
+
+    // The loops with the same header are counted as one
+    int* block_depth = Alloc(scratch, count * sizeof *block_depth);
+    int* in_loop_of = Alloc(scratch, count * sizeof *in_loop_of);
+    int* stack = Alloc(scratch, count * sizeof *stack);
+    for (int b = 0; b < count; b++) {
+        in_loop_of[b] = -1;
+    }
+    for (int h = 0; h < count; h++) {
+        if (rpo_num[h] < 0) {
+            continue;
+        }
+        bool is_header = false;
+        int top = 0;
+        in_loop_of[h] = h;
+        for (var it = block_edges(&blocks, nodes, h, false);
+                lv_node_it_next(&it);) {
+            int p = blocks.block_of[it.lvni_node.lvn_idx];
+            if (rpo_num[p] >= 0 && dominates(idom, h, p)) {
+                is_header = true;
+                if (in_loop_of[p] != h) {
+                    in_loop_of[p] = h;
+                    stack[top++] = p;
+                }
+            }
+        }
+        if (!is_header) {
+            continue;
+        }
+        block_depth[h] += 1;
+        while (top > 0) {
+            int b = stack[--top];
+            block_depth[b] += 1;
+            for (var it = block_edges(&blocks, nodes, b, false);
+                    lv_node_it_next(&it);) {
+                int p = blocks.block_of[it.lvni_node.lvn_idx];
+                if (rpo_num[p] >= 0 && in_loop_of[p] != h) {
+                    in_loop_of[p] = h;
+                    stack[top++] = p;
+                }
+            }
+        }
+    }
+
+    for (int i = 0; i < fg_len; i++) {
+        depths[i] = block_depth[blocks.block_of[i]];
+    }
+    Arena_dispose(&scratch);
+    return depths;
+}
+
+/*
+ * A priority queue of positions in the block order, so that the block
+ * taken from the worklist is always the one earliest in the order.
+ */
+typedef struct lv_worklist {
+    int len;
+    int* heap;
+    bool* queued;
+} lv_worklist_t;
+
+static void worklist_push(lv_worklist_t* wl, int rank)
+{
+    if (wl->queued[rank]) {
+        return;
+    }
+    wl->queued[rank] = true;
+    int i = wl->len++;
+    for (; i > 0 && wl->heap[(i - 1) / 2] > rank; i = (i - 1) / 2) {
+        wl->heap[i] = wl->heap[(i - 1) / 2];
+    }
+    wl->heap[i] = rank;
+}
+
+static int worklist_pop(lv_worklist_t* wl)
+{
+    assert(wl->len > 0);
+    int top = wl->heap[0];
+    int last = wl->heap[--wl->len];
+    int i = 0;
+    for (int c; (c = 2 * i + 1) < wl->len; i = c) {
+        if (c + 1 < wl->len && wl->heap[c + 1] < wl->heap[c]) {
+            c++;
+        }
+        if (last <= wl->heap[c]) {
+            break;
+        }
+        wl->heap[i] = wl->heap[c];
+    }
+    wl->heap[i] = last;
+    wl->queued[top] = false;
+    return top;
+}
+
+/*
+ * Moves live from the live-outs of node to its live-ins.
+ * i.e. live = use[n] union (live setminus def[n])
+ * The defs are also added to killed, if it's given.
+ */
+static void
+step_backwards(lv_igraph_t* igraph, lv_flowgraph_t* flow, lv_node_t* node,
+        node_set2_t live, node_set2_t* killed)
+{
+    for (var d = nt_get(flow->lvfg_def, node); d; d = d->tmp_list) {
+        lv_node_t* d_node = lv_temp_node(igraph, d->tmp_temp);
+        node_set2_remove(live, d_node);
+        if (killed) {
+            node_set2_add(*killed, d_node);
+        }
+    }
+    for (var u = nt_get(flow->lvfg_use, node); u; u = u->tmp_list) {
+        lv_node_t* u_node = lv_temp_node(igraph, u->tmp_temp);
+        node_set2_add(live, u_node);
+    }
+}
+
+/*
+ * Makes sure there is a node in the interference graph for each temporary
+ * in the flow graph.
+ */
+static void
+add_igraph_nodes(lv_igraph_t* igraph, lv_flowgraph_t* flow,
+        lv_node_list_t* cg_nodes, Arena_T arena)
+{
     for (var n = cg_nodes; n; n = n->nl_list) {
         temp_list_t* def_n = nt_get(flow->lvfg_def, n->nl_node);
         for (var d = def_n; d; d = d->tmp_list) {
@@ -456,190 +883,609 @@ interference_graph(
             ig_get_node_for_temp(igraph, &u->tmp_temp, arena);
         }
     }
+}
 
-    // compute live outs
-    size_t igraph_len = lv_graph_length(igraph->lvig_graph);
-    size_t fg_len = lv_graph_length(flow->lvfg_control);
+/*
+ * Creates an interference graph, without edges yet, with a node for each
+ * temporary in the flow graph.
+ */
+static lv_igraph_t*
+new_igraph(lv_flowgraph_t* flow, lv_node_list_t* cg_nodes, Arena_T arena)
+{
+    lv_igraph_t* igraph = Alloc(arena, sizeof *igraph);
+    igraph->lvig_graph = lv_new_undirected_graph(arena);
+    igraph->lvig_moves = NULL;
+    add_igraph_nodes(igraph, flow, cg_nodes, arena);
+    return igraph;
+}
 
-    // using a topological sort means we navigate the control flow graph
-    // from the end backwards. The speeds up the settling of iterative
-    // equations.
-    // FIXME: this should use scratch, but we are leaking the references into
-    // our graph.
-    lv_node_t* sorted = topological_sort(fg_len, cg_nodes, arena);
+/*
+ * The solution of the dataflow equations, for each block. The sets are of
+ * interference graph nodes, i.e. temporaries.
+ */
+typedef struct lv_dataflow {
+    lv_node_t** nodes; /* the flow graph nodes, by index */
+    /*
+     * The interference graph nodes, by index, and the temp of each. Both
+     * are NULL for a temp that has been spilled.
+     */
+    lv_node_t** ig_nodes;
+    temp_t** ig_temps;
+    lv_blocks_t blocks;
+    node_set_table_t live_in_map;
+    node_set_table_t live_out_map;
+    int iterations;
+} lv_dataflow_t;
 
-    node_set_table_t live_in_map = node_set_table_new(fg_len, igraph_len, scratch);
-    node_set_table_t live_out_map = node_set_table_new(fg_len, igraph_len, scratch);
-    node_set_table_t def_map = node_set_table_new(fg_len, igraph_len, scratch);
-    node_set_table_t use_map = node_set_table_new(fg_len, igraph_len, scratch);
+/*
+ * Finds the blocks of the flow graph, and indexes the nodes of both
+ * graphs, ready for the dataflow equations to be solved.
+ */
+static lv_dataflow_t
+dataflow_init(lv_igraph_t* igraph, lv_flowgraph_t* flow,
+        lv_node_list_t* cg_nodes, Arena_T scratch)
+{
+    size_t igraph_len = lv_graph_length(igraph->lvig_graph);
+    size_t fg_len = lv_graph_length(flow->lvfg_control);
+    lv_dataflow_t df = {};
 
-    for (int i = 0; i < fg_len; i++) {
-        var node = &sorted[i];
-        var def_ns = Table_NST_get(def_map, node);
-        var use_ns = Table_NST_get(use_map, node);
+    df.nodes = Alloc(scratch, fg_len * sizeof *df.nodes);
+    lv_node_t* exit_node = NULL;
+    for (var n = cg_nodes; n; n = n->nl_list) {
+        df.nodes[n->nl_node->lvn_idx] = n->nl_node;
 
-        temp_list_t* def_n = nt_get(flow->lvfg_def, node);
-        for (var d = def_n; d; d = d->tmp_list) {
-            var d_node = ig_get_node_for_temp(igraph, &d->tmp_temp, arena);
-            node_set2_add(def_ns, d_node);
-        }
-        temp_list_t* use_n = nt_get(flow->lvfg_use, node);
-        for (var u = use_n; u; u = u->tmp_list) {
-            var u_node = ig_get_node_for_temp(igraph, &u->tmp_temp, arena);
-            node_set2_add(use_ns, u_node);
+        var it = lv_succ(n->nl_node);
+        if (!exit_node && !lv_node_it_next(&it)) {
+            exit_node = n->nl_node;
         }
     }
+    assert(exit_node);
 
+    df.ig_nodes = Alloc(scratch, igraph_len * sizeof *df.ig_nodes);
+    df.ig_temps = Alloc(scratch, igraph_len * sizeof *df.ig_temps);
+    for (int j = 0; j < igraph_len; j++) {
+        df.ig_temps[j] = igraph->lvig_gtemp.data[j];
+        if (df.ig_temps[j]) {
+            df.ig_nodes[j] = lv_temp_node(igraph, *df.ig_temps[j]);
+        }
+    }
 
-    node_set_table_t live_in_map_ = node_set_table_new(fg_len, igraph_len, scratch);
-    node_set_table_t live_out_map_ = node_set_table_new(fg_len, igraph_len, scratch);
+    df.blocks = find_blocks(df.nodes, fg_len, exit_node, scratch);
+    return df;
+}
 
-    // space allocated for sets that we use within our loop.
-    node_set_table_t loop_statics = node_set_table_new(3, igraph_len, scratch);
-    node_set2_t out_n = node_set_table_get(loop_statics, 0);
-    node_set2_t in_n = node_set_table_get(loop_statics, 1);
-    node_set2_t out_minus_def = node_set_table_get(loop_statics, 2);
+static lv_dataflow_t
+solve_dataflow(lv_igraph_t* igraph, lv_flowgraph_t* flow,
+        lv_node_list_t* cg_nodes, Arena_T scratch)
+{
+    size_t igraph_len = lv_graph_length(igraph->lvig_graph);
+    var df = dataflow_init(igraph, flow, cg_nodes, scratch);
+    var blocks = df.blocks;
+    assert(blocks.count >= 1); // there is always the exit
+
+    df.live_in_map = node_set_table_new(blocks.count, igraph_len, scratch);
+    df.live_out_map = node_set_table_new(blocks.count, igraph_len, scratch);
+    node_set_table_t gen_map =
+        node_set_table_new(blocks.count, igraph_len, scratch);
+    node_set_table_t kill_map =
+        node_set_table_new(blocks.count, igraph_len, scratch);
+
+    // gen[b] are the temps used in b before any def of them in b, and
+    // kill[b] are the temps defined in b
+    for (int b = 0; b < blocks.count; b++) {
+        node_set2_t kill_b = node_set_table_get(kill_map, b);
+        for (int i = blocks.last[b]; i >= blocks.first[b]; i--) {
+            step_backwards(igraph, flow, df.nodes[i],
+                    node_set_table_get(gen_map, b), &kill_b);
+        }
+    }
 
-    node_set_table_t fgraph_sets = node_set_table_new(3, fg_len, scratch);
     // Algo 17.6 from the book adapted for liveness - i.e. we run it backwards
-    node_set2_t worklist = node_set_table_get(fgraph_sets, 0);
-
-    for (int i = 0; i < fg_len; i++) {
-        var node = &sorted[i];
-        node_set2_add(worklist, node);
+    lv_worklist_t worklist = {
+        .heap = Alloc(scratch, blocks.count * sizeof *worklist.heap),
+        .queued = Alloc(scratch, blocks.count * sizeof *worklist.queued),
+    };
+    for (int k = 0; k < blocks.count; k++) {
+        worklist_push(&worklist, k);
     }
 
     // calculate live-in and live-out sets iteratively
-    int iterations = 0;
-    for (; node_set2_count(worklist) > 0; iterations++) {
-        // todo: Investigate if priority queue / treap might be better for
-        // retrieval.
-        lv_node_t* node = NULL;
-        for (int i = 0; i < fg_len; i++) {
-            node = &sorted[i];
-            if (node_set2_member(worklist, node)) {
-                break;
+    for (; worklist.len > 0; df.iterations++) {
+        int b = blocks.order[worklist_pop(&worklist)];
+
+        // out[b] = union {in[s] for s in succ[b]}
+        node_set2_t out_b = node_set_table_get(df.live_out_map, b);
+        bool first_succ = true;
+        for (var it = lv_succ(df.nodes[blocks.last[b]]);
+                lv_node_it_next(&it);) {
+            int s = blocks.block_of[it.lvni_node.lvn_idx];
+            node_set2_t in_s = node_set_table_get(df.live_in_map, s);
+            if (first_succ) {
+                node_set2_copy(out_b, in_s);
+                first_succ = false;
+            } else {
+                node_set2_union(out_b, out_b, in_s);
             }
         }
-        node_set2_remove(worklist, node);
+        if (first_succ) {
+            node_set2_clear(out_b);
+        }
 
-        // copy the previous iteration
-        // in'[n] = in[n]; out'[n] = out[n]
-        Table_NST_put(live_in_map_, node, Table_NST_get(live_in_map, node));
-        node_set2_t out_ns = Table_NST_get(live_out_map, node);
-        Table_NST_put(live_out_map_, node, out_ns);
+        // in[b] = gen[b] union (out[b] setminus kill[b])
+        node_set2_t in_b = node_set_table_get(df.live_in_map, b);
+        if (node_set2_update_in(in_b, node_set_table_get(gen_map, b), out_b,
+                    node_set_table_get(kill_map, b))) {
+            for (var it = lv_pred(df.nodes[blocks.first[b]]);
+                    lv_node_it_next(&it);) {
+                int p = blocks.block_of[it.lvni_node.lvn_idx];
+                worklist_push(&worklist, blocks.rank[p]);
+            }
+        }
+    }
+    if (debug) {
+        fprintf(stderr, "## iterations = %d, blocks = %d, fglen = %lu\n",
+                df.iterations, blocks.count,
+                lv_graph_length(flow->lvfg_control));
+    }
+    return df;
+}
 
-        // in[n] = use[n] union (out[n] setminus def[n])
-        node_set2_t use_n = Table_NST_get(use_map, node);
-        node_set2_t def_n = Table_NST_get(def_map, node);
+/* The temps in live as a temp_list */
+static temp_list_t*
+live_temp_list(const lv_dataflow_t* df, node_set2_t live, Arena_T arena)
+{
+    temp_list_t* temps = NULL;
+    for (int j = node_set2_next_idx(live, 0); j >= 0;
+            j = node_set2_next_idx(live, j + 1)) {
+        temps = temp_list_cons(*df->ig_temps[j], temps, arena);
+    }
+    return temps;
+}
 
-        node_set2_minus(out_minus_def, out_ns, def_n);
-        node_set2_union(in_n, use_n, out_minus_def);
+/*
+ * Makes the edges and moves of the interference graph at a flow graph
+ * node, given the temps that are live out of it.
+ *
+ * 1. At any non-move instruction the defs from that instruction
+ * interfere with the live-outs at that instruction
+ * 2. At any move instruction a <- c , b in live-outs interferes with a
+ * if b != c.
+ *
+ * Only the edges and moves that involve a temp with an index of at least
+ * first_new, or one of the older temps in grown, are made, the others
+ * being in the graph already.
+ */
+static void
+interfere_at_node(lv_igraph_t* igraph, lv_flowgraph_t* flow,
+        const lv_dataflow_t* df, lv_node_t* node, node_set2_t live,
+        node_set2_t def_n, int first_new, const int* grown, int num_grown,
+        Arena_T arena)
+{
+    temp_list_t* defs = nt_get(flow->lvfg_def, node);
+    for (var d = defs; d; d = d->tmp_list) {
+        node_set2_add(def_n, lv_temp_node(igraph, d->tmp_temp));
+    }
 
-        // out[n] = union {in[s] for s in succ[n]}
-        node_set2_clear(out_n);
-        for (var it = lv_succ(node); lv_node_it_next(&it);) {
-            node_set2_t in_s = Table_NST_get(live_in_map, &it.lvni_node);
-            node_set2_union(out_n, out_n, in_s);
+    lv_node_t* u_node = NULL;
+    if (nodeset_ismember(flow->lvfg_ismove, node)) {
+        temp_list_t* uses = nt_get(flow->lvfg_use, node);
+        assert(uses && !uses->tmp_list);
+        u_node = lv_temp_node(igraph, uses->tmp_temp);
+    }
+
+    for (int d = node_set2_next_idx(def_n, 0); d >= 0;
+            d = node_set2_next_idx(def_n, d + 1)) {
+        lv_node_t* d_node = df->ig_nodes[d];
+        bool is_new = d >= first_new;
+        if (u_node && (is_new || u_node->lvn_idx >= first_new)) {
+            igraph->lvig_moves = lv_node_pair_cons(
+                    lv_node_pair(d_node, u_node, arena),
+                    igraph->lvig_moves, arena);
+        }
+        for (int j = node_set2_next_idx(live, is_new ? 0 : first_new);
+                j >= 0; j = node_set2_next_idx(live, j + 1)) {
+            lv_node_t* t_node = df->ig_nodes[j];
+            // self moves don't interfere
+            if (u_node && lv_eq(t_node, u_node)) {
+                continue;
+            }
+            lv_mk_edge(d_node, t_node);
+        }
+        for (int g = 0; !is_new && g < num_grown; g++) {
+            lv_node_t* t_node = df->ig_nodes[grown[g]];
+            if (IsBitSet(live.bits, grown[g])
+                    && !(u_node && lv_eq(t_node, u_node))) {
+                lv_mk_edge(d_node, t_node);
+            }
         }
+    }
+    for (var d = defs; d; d = d->tmp_list) {
+        node_set2_remove(def_n, lv_temp_node(igraph, d->tmp_temp));
+    }
+}
+
+/*
+ * Walks backwards through each block, from its live-outs, to find the
+ * live-outs at each instruction, and from those, the interference graph.
+ */
+static lv_node_temps_map_t*
+interfere_in_blocks(lv_igraph_t* igraph, lv_flowgraph_t* flow,
+        const lv_dataflow_t* df, nodeset_t* want_live_outs, int first_new,
+        const int* grown, int num_grown, Arena_T arena, Arena_T scratch)
+{
+    size_t igraph_len = lv_graph_length(igraph->lvig_graph);
+    var blocks = df->blocks;
+
+    node_set_table_t loop_statics = node_set_table_new(2, igraph_len, scratch);
+    node_set2_t live = node_set_table_get(loop_statics, 0);
+    node_set2_t def_n = node_set_table_get(loop_statics, 1);
 
-        // store results back into live_in_map and live_out_map
-        Table_NST_put(live_out_map, node, out_n);
-        Table_NST_put(live_in_map, node, in_n);
+    lv_node_temps_map_t* live_outs = NULL;
 
-        // check for changes
-        node_set2_t in_ns_ = Table_NST_get(live_in_map_, node);
-        node_set2_t in_ns = Table_NST_get(live_in_map, node);
-        node_set2_t out_ns_ = Table_NST_get(live_out_map_, node);
+    for (int k = 0; k < blocks.count; k++) {
+        int b = blocks.order[k];
+        node_set2_copy(live, node_set_table_get(df->live_out_map, b));
 
-        if (!node_set2_eq(in_ns_, in_ns) || !node_set2_eq(out_ns_, out_ns)) {
+        for (int i = blocks.last[b]; i >= blocks.first[b]; i--) {
+            var node = df->nodes[i];
+            interfere_at_node(igraph, flow, df, node, live, def_n,
+                    first_new, grown, num_grown, arena);
 
-            node_set2_add(worklist, node);
-            for (var it = lv_pred(node); lv_node_it_next(&it);) {
-                node_set2_add(worklist, &it.lvni_node);
+            if (!want_live_outs || nodeset_ismember(want_live_outs, node)) {
+                temp_list_t* out_temps = live_temp_list(df, live, arena);
+                if (out_temps) {
+                    *nt_upsert(&live_outs, node, arena) = out_temps;
+                }
             }
+
+            step_backwards(igraph, flow, node, live, NULL);
         }
     }
-    if (debug) {
-        fprintf(stderr, "## iterations = %d, fglen = %lu\n", iterations,
-                fg_len);
-    }
+    return live_outs;
+}
 
-    // Now we have the live-out sets, we can compute the interference graph
+/* Copies the live-outs of the blocks, to be kept with the graph */
+static node_set_table_t*
+keep_block_live_outs(const lv_dataflow_t* df, Arena_T arena)
+{
+    node_set_table_t* table = Alloc(arena, sizeof *table);
+    *table = node_set_table_new(df->live_out_map.count,
+            df->live_out_map.len, arena);
+    memcpy(table->bits, df->live_out_map.bits,
+            table->count * BitsetBytes(table->len));
+    return table;
+}
 
-    // ok, now we need a node in the graph for each temp?
-    // and a way of associating them
+/*
+ * Given a control flow graph (and its associated nodes), compute
+ * the interference graph and the Live Outs at each flow graph node in
+ * want_live_outs, or at every node if it is NULL.
+ */
+struct igraph_and_table
+interference_graph(
+        lv_flowgraph_t* flow, lv_node_list_t* cg_nodes,
+        nodeset_t* want_live_outs, Arena_T arena)
+{
+    Arena_T scratch = Arena_new();
+    // First ensure that there is an interference graph node for
+    // each temporary
+    lv_igraph_t* igraph = new_igraph(flow, cg_nodes, arena);
 
-    // 1. At any non-move instruction the defs from that instruction
-    // interfere with the live-outs at that instruction
-    // 2. At any move instruction a <- c , b in live-outs interferes with a
-    // if b != c.
-    for (int i = 0; i < fg_len; i++) {
-        var node = &sorted[i];
-        node_set2_t def_n = Table_NST_get(def_map, node);
-        node_set2_t use_n = Table_NST_get(use_map, node);
-        node_set2_t out_ns = Table_NST_get(live_out_map, node);
-
-        for (int i = 0; i < def_n.len; i++) {
-            if (IsBitSet(def_n.bits, i)) {
-                lv_node_t* d_node = ig_get_node_by_idx(igraph, i, arena);
-
-                if (!nodeset_ismember(flow->lvfg_ismove, node)) {
-                    for (int j = 0; j < out_ns.len; j++) {
-                        if (IsBitSet(out_ns.bits, j)) {
-                            lv_node_t* t_node =
-                                ig_get_node_by_idx(igraph, j, arena);
-                            lv_mk_edge(d_node, t_node);
-                        }
-                    }
-                } else {
-                    assert(node_set2_count(use_n) == 1);
-                    var u_idx = node_set2_first_idx(use_n);
-
-                    lv_node_t* u_node = ig_get_node_by_idx(igraph, u_idx, arena);
-                    igraph->lvig_moves = lv_node_pair_cons(
-                            lv_node_pair(d_node, u_node, arena),
-                            igraph->lvig_moves, arena);
-
-                    for (int j = 0; j < out_ns.len; j++) {
-                        if (IsBitSet(out_ns.bits, j)) {
-                            lv_node_t* t_node =
-                                ig_get_node_by_idx(igraph, j, arena);
-                            // self moves don't interfere
-                            if (lv_eq(t_node, u_node)) {
-                                continue;
-                            }
-                            lv_mk_edge(d_node, t_node);
-                        }
-                    }
-                }
+    // compute live outs
+    var df = solve_dataflow(igraph, flow, cg_nodes, scratch);
+
+    var live_outs = interfere_in_blocks(igraph, flow, &df, want_live_outs,
+            0, NULL, 0, arena, scratch);
+    lv_finish_edges(igraph->lvig_graph);
+
+    struct igraph_and_table result = {
+        .igraph = igraph,
+        .live_outs = live_outs,
+        .iterations = df.iterations,
+        .block_live_outs = keep_block_live_outs(&df, arena),
+    };
+    Arena_dispose(&scratch);
+    return result;
+}
+
+/*
+ * The spill code only adds temps that are live within a single block:
+ * from a load to the instruction that uses it, or from the instruction
+ * that defines it to a store. So the blocks are the same as before, and
+ * the live-outs of each are as before, less the spilled temps. The rest
+ * of the graph stays as it is, and only the edges and moves of the new
+ * temps need to be found. The loads and stores also use the frame
+ * pointer, which may now be live where it was not, e.g. in a loop with no
+ * way out, so the edges of the older temps used next to the new ones are
+ * made again too.
+ */
+struct igraph_and_table
+interference_graph_after_spills(
+        struct igraph_and_table* prev, lv_flowgraph_t* flow,
+        lv_node_list_t* cg_nodes, nodeset_t* want_live_outs,
+        temp_list_t* spilled, Arena_T arena)
+{
+    Arena_T scratch = Arena_new();
+    lv_igraph_t* igraph = prev->igraph;
+    const size_t first_new = lv_graph_length(igraph->lvig_graph);
+
+    // The spilled temps no longer interfere with anything, and have no
+    // moves
+    bool* is_spilled = Alloc(scratch, first_new * sizeof *is_spilled);
+    lv_node_list_t* spilled_nodes = NULL;
+    for (var s = spilled; s; s = s->tmp_list) {
+        lv_node_t* node = lv_temp_node(igraph, s->tmp_temp);
+        assert(node);
+        igraph->lvig_tnode.data[s->tmp_temp.temp_id] = NULL;
+        igraph->lvig_gtemp.data[node->lvn_idx] = NULL;
+        igraph->lvig_num_temps--;
+        is_spilled[node->lvn_idx] = true;
+        spilled_nodes = list_cons(node, spilled_nodes, scratch);
+    }
+    lv_isolate_nodes(spilled_nodes, scratch);
+    for (var pm = &igraph->lvig_moves; *pm; ) {
+        var move = (*pm)->npl_node;
+        if (is_spilled[move->np_node0->lvn_idx]
+                || is_spilled[move->np_node1->lvn_idx]) {
+            *pm = (*pm)->npl_list;
+        } else {
+            pm = &(*pm)->npl_list;
+        }
+    }
+
+    add_igraph_nodes(igraph, flow, cg_nodes, arena);
+    size_t igraph_len = lv_graph_length(igraph->lvig_graph);
+
+    int* grown = Alloc(scratch, first_new * sizeof *grown);
+    int num_grown = 0;
+    bool* is_grown = Alloc(scratch, first_new * sizeof *is_grown);
+    for (var n = cg_nodes; n; n = n->nl_list) {
+        temp_list_t* defs = nt_get(flow->lvfg_def, n->nl_node);
+        temp_list_t* uses = nt_get(flow->lvfg_use, n->nl_node);
+        bool has_new = false;
+        for (var t = defs; t && !has_new; t = t->tmp_list) {
+            lv_node_t* t_node = lv_temp_node(igraph, t->tmp_temp);
+            has_new = t_node->lvn_idx >= first_new;
+        }
+        for (var t = uses; t && !has_new; t = t->tmp_list) {
+            lv_node_t* t_node = lv_temp_node(igraph, t->tmp_temp);
+            has_new = t_node->lvn_idx >= first_new;
+        }
+        for (var t = uses; t && has_new; t = t->tmp_list) {
+            lv_node_t* t_node = lv_temp_node(igraph, t->tmp_temp);
+            int j = t_node->lvn_idx;
+            if (j < first_new && !is_grown[j]) {
+                is_grown[j] = true;
+                grown[num_grown++] = j;
             }
         }
     }
 
+    var df = dataflow_init(igraph, flow, cg_nodes, scratch);
+    var prev_live_outs = prev->block_live_outs;
+    assert(df.blocks.count == prev_live_outs->count);
+
+    node_set_table_t spilled_table = node_set_table_new(1, igraph_len, scratch);
+    node_set2_t spilled_set = node_set_table_get(spilled_table, 0);
+    for (var n = spilled_nodes; n; n = n->nl_list) {
+        node_set2_add(spilled_set, n->nl_node);
+    }
+    df.live_out_map = node_set_table_new(df.blocks.count, igraph_len, arena);
+    for (int b = 0; b < df.blocks.count; b++) {
+        node_set2_t out_b = node_set_table_get(df.live_out_map, b);
+        memcpy(out_b.bits, node_set_table_get(*prev_live_outs, b).bits,
+                BitsetBytes(prev_live_outs->len));
+        node_set2_minus(out_b, out_b, spilled_set);
+    }
+
+    var live_outs = interfere_in_blocks(igraph, flow, &df, want_live_outs,
+            first_new, grown, num_grown, arena, scratch);
+
+    node_set_table_t* block_live_outs = Alloc(arena, sizeof *block_live_outs);
+    *block_live_outs = df.live_out_map;
+    Arena_dispose(&scratch);
+    struct igraph_and_table result = {
+        .igraph = igraph,
+        .live_outs = live_outs,
+        .block_live_outs = block_live_outs,
+    };
+    return result;
+}
+
+/* A range in which the temp with interference graph index lvs_idx is live */
+typedef struct lv_segment_t {
+    int lvs_idx;
+    lv_range_t lvs_range;
+} lv_segment_t;
+
+static int cmp_segment(const void* x, const void* y)
+{
+    const lv_segment_t* xx = x;
+    const lv_segment_t* yy = y;
+    if (xx->lvs_idx != yy->lvs_idx) {
+        return xx->lvs_idx - yy->lvs_idx;
+    }
+    return xx->lvs_range.lvr_start - yy->lvs_range.lvr_start;
+}
+
+static int cmp_interval_start(const void* x, const void* y)
+{
+    const lv_interval_t* xx = x;
+    const lv_interval_t* yy = y;
+    if (xx->lvi_start != yy->lvi_start) {
+        return xx->lvi_start - yy->lvi_start;
+    }
+    return xx->lvi_temp.temp_id - yy->lvi_temp.temp_id;
+}
+
+static int cmp_interval_temp(const void* x, const void* y)
+{
+    const lv_interval_t* xx = x;
+    const lv_interval_t* yy = y;
+    return xx->lvi_temp.temp_id - yy->lvi_temp.temp_id;
+}
+
+/*
+ * Collects the ranges of each temp while walking backwards over a block.
+ * A range is open from the last use of the temp until its def, or the
+ * start of the block, is found.
+ */
+typedef struct lv_interval_builder {
+    int* open_end; /* by interference graph index: the end, or -1 */
+    arrtype(lv_segment_t) segments;
+    Arena_T arena;
+} lv_interval_builder_t;
+
+/* Records that the temp with interference graph index j is live at pos */
+static void
+ib_extend(lv_interval_builder_t* ib, int j, int pos)
+{
+    if (ib->open_end[j] < 0) {
+        ib->open_end[j] = pos;
+    }
+}
+
+static void
+ib_close(lv_interval_builder_t* ib, int j, int pos)
+{
+    int end = (ib->open_end[j] < 0) ? pos : ib->open_end[j];
+    lv_segment_t segment = {.lvs_idx = j, .lvs_range = {pos, end}};
+    arrpush(&ib->segments, ib->arena, segment);
+    ib->open_end[j] = -1;
+}
+
+/*
+ * Computes the live interval of each temporary, for linear scan register
+ * allocation, and the Live Outs at the flow graph nodes in want_live_outs.
+ */
+struct intervals_and_table
+live_intervals(lv_flowgraph_t* flow, lv_node_list_t* cg_nodes,
+        nodeset_t* want_live_outs, Arena_T arena)
+{
+    Arena_T scratch = Arena_new();
+    lv_igraph_t* igraph = new_igraph(flow, cg_nodes, scratch);
+    size_t igraph_len = lv_graph_length(igraph->lvig_graph);
+
+    var df = solve_dataflow(igraph, flow, cg_nodes, scratch);
+    var blocks = df.blocks;
+
+    lv_interval_builder_t ib = {
+        .open_end = Alloc(scratch, igraph_len * sizeof *ib.open_end),
+        .arena = scratch,
+    };
+    temp_t* hint = Alloc(scratch, igraph_len * sizeof *hint);
+    for (int j = 0; j < igraph_len; j++) {
+        ib.open_end[j] = -1;
+        hint[j].temp_id = -1;
+    }
+
+    node_set_table_t loop_statics = node_set_table_new(1, igraph_len, scratch);
+    node_set2_t live = node_set_table_get(loop_statics, 0);
     lv_node_temps_map_t* live_outs = NULL;
 
-    // convert the live outs into a map just to temp_list
-    for (int i = 0; i < fg_len; i++) {
-        var node = &sorted[i];
-        node_set2_t out_ns = Table_NST_get(live_out_map, node);
-        if (node_set2_count(out_ns) > 0) {
-            temp_list_t* out_temps = NULL;
-            for (int j = 0; j < out_ns.len; j++) {
-                if (IsBitSet(out_ns.bits, j)) {
-                    lv_node_t fake_node = {.lvn_graph=igraph->lvig_graph, .lvn_idx=j};
-                    temp_t* ptemp = Table_get(igraph->lvig_gtemp, &fake_node);
-                    out_temps = temp_list_cons(*ptemp, out_temps, arena);
+    // Each instruction i reads its uses at position 2i and writes its defs
+    // at 2i + 1, so that the source and destination of a move do not
+    // overlap unless the source is still live afterwards.
+    for (int b = 0; b < blocks.count; b++) {
+        node_set2_copy(live, node_set_table_get(df.live_out_map, b));
+        for (int j = node_set2_next_idx(live, 0); j >= 0;
+                j = node_set2_next_idx(live, j + 1)) {
+            ib_extend(&ib, j, 2 * blocks.last[b] + 1);
+        }
+
+        for (int i = blocks.last[b]; i >= blocks.first[b]; i--) {
+            var node = df.nodes[i];
+            if (nodeset_ismember(want_live_outs, node)) {
+                *nt_upsert(&live_outs, node, arena) =
+                    live_temp_list(&df, live, arena);
+            }
+
+            temp_list_t* defs = nt_get(flow->lvfg_def, node);
+            temp_list_t* uses = nt_get(flow->lvfg_use, node);
+            for (var d = defs; d; d = d->tmp_list) {
+                lv_node_t* d_node =
+                    lv_temp_node(igraph, d->tmp_temp);
+                ib_close(&ib, d_node->lvn_idx, 2 * i + 1);
+            }
+            for (var u = uses; u; u = u->tmp_list) {
+                lv_node_t* u_node =
+                    lv_temp_node(igraph, u->tmp_temp);
+                ib_extend(&ib, u_node->lvn_idx, 2 * i);
+            }
+            if (nodeset_ismember(flow->lvfg_ismove, node)) {
+                lv_node_t* d_node =
+                    lv_temp_node(igraph, defs->tmp_temp);
+                lv_node_t* u_node =
+                    lv_temp_node(igraph, uses->tmp_temp);
+                hint[d_node->lvn_idx] = uses->tmp_temp;
+                hint[u_node->lvn_idx] = defs->tmp_temp;
+            }
+
+            step_backwards(igraph, flow, node, live, NULL);
+        }
+
+        // live is now the live-ins of the block
+        for (int j = node_set2_next_idx(live, 0); j >= 0;
+                j = node_set2_next_idx(live, j + 1)) {
+            ib_close(&ib, j, 2 * blocks.first[b]);
+        }
+    }
+
+    int num_machine = 0;
+    for (int j = 0; j < igraph_len; j++) {
+        num_machine += temp_is_machine(*df.ig_temps[j]);
+    }
+    lv_interval_t* intervals =
+        Alloc(arena, (igraph_len - num_machine) * sizeof *intervals);
+    lv_interval_t* fixed = Alloc(arena, num_machine * sizeof *fixed);
+    int num_intervals = 0;
+    int num_fixed = 0;
+
+    // Join up the ranges of each temp, which come from each block in turn
+    const int num_segments = ib.segments.len;
+    lv_segment_t* segments = ib.segments.data;
+    qsort(segments, num_segments, sizeof *segments, cmp_segment);
+    lv_range_t* ranges = Alloc(arena, num_segments * sizeof *ranges);
+    int num_ranges = 0;
+    for (int s = 0; s < num_segments; ) {
+        int j = segments[s].lvs_idx;
+        int first = num_ranges;
+        for (; s < num_segments && segments[s].lvs_idx == j; s++) {
+            var range = segments[s].lvs_range;
+            if (num_ranges > first
+                    && range.lvr_start <= ranges[num_ranges - 1].lvr_end + 1) {
+                if (range.lvr_end > ranges[num_ranges - 1].lvr_end) {
+                    ranges[num_ranges - 1].lvr_end = range.lvr_end;
                 }
+            } else {
+                ranges[num_ranges++] = range;
             }
-            *nt_upsert(&live_outs, node, arena) = out_temps;
+        }
+        lv_interval_t interval = {
+            .lvi_temp = *df.ig_temps[j],
+            .lvi_start = ranges[first].lvr_start,
+            .lvi_end = ranges[num_ranges - 1].lvr_end,
+            .lvi_hint = hint[j],
+            .lvi_ranges = &ranges[first],
+            .lvi_num_ranges = num_ranges - first,
+        };
+        if (temp_is_machine(interval.lvi_temp)) {
+            fixed[num_fixed++] = interval;
+        } else {
+            intervals[num_intervals++] = interval;
         }
     }
+    qsort(intervals, num_intervals, sizeof *intervals, cmp_interval_start);
+    qsort(fixed, num_fixed, sizeof *fixed, cmp_interval_temp);
 
     Arena_dispose(&scratch);
-    struct igraph_and_table result = {
-        .igraph = igraph,
+    struct intervals_and_table result = {
+        .intervals = intervals,
+        .num_intervals = num_intervals,
+        .fixed = fixed,
+        .num_fixed = num_fixed,
         .live_outs = live_outs,
+        .iterations = df.iterations,
     };
     return result;
 }
@@ -649,16 +1495,14 @@ lv_free_interference_and_flow_graph(
         struct igraph_and_table* igraph_and_live_outs,
         struct flowgraph_and_node_list* flow_and_nodes)
 {
-    // Free interference graph
-    Table_free(&igraph_and_live_outs->igraph->lvig_tnode);
-    Table_free(&igraph_and_live_outs->igraph->lvig_gtemp);
+    // Everything is in the arenas, which the caller disposes of
 }
 
 // Yeah... so... the return value must be used immediately, or copied by the
 // caller
 char* lv_nodename(lv_node_t* node)
 {
-    static char buf[64] = {};
+    static _Thread_local char buf[64] = {};
     snprintf(buf, 64, "%lu", node->lvn_idx);
     return buf;
 }
@@ -670,6 +1514,8 @@ flowgraph_print(
         const target_t* target)
 {
     fprintf(out, "# ---- Control Flow Graph ----\n");
+    writer_t w;
+    wr_init(&w, out);
     var nd = node_list;
     for (var instr = instrs; instr; instr = instr->ai_list, nd = nd->nl_list) {
         var node = nd->nl_node;
@@ -681,11 +1527,10 @@ flowgraph_print(
             fmt = ", %2lu";
         }
         fprintf(out, "] ");
-        char buf[128];
-        assm_format(buf, 128, instr,
-                target->tgt_temp_map(), target);
-        fprintf(out, "%s", buf);
+        assm_format(&w, instr, target->tgt_temp_map(), target);
+        wr_flush(&w);
     }
+    wr_dispose(&w);
     fprintf(out, "# ----------------------------\n");
 }
 
@@ -694,9 +1539,11 @@ temps_for_graph_nodes(lv_igraph_t* igraph, Arena_T ar)
 {
     temp_list_t* temps = NULL;
     for (var it = lv_nodes(igraph->lvig_graph); lv_node_it_next(&it); ) {
-        temp_t* temp_for_node = Table_get(igraph->lvig_gtemp, &it.lvni_node);
-        assert(temp_for_node);
-        temps = temp_list_cons(*temp_for_node, temps, ar);
+        temp_t* temp_for_node = lv_node_temp(igraph, &it.lvni_node);
+        // there is none for a temp that has been spilled
+        if (temp_for_node) {
+            temps = temp_list_cons(*temp_for_node, temps, ar);
+        }
     }
     return temps;
 }
@@ -707,7 +1554,7 @@ temps_for_adj(lv_igraph_t* igraph, lv_node_t* node, Arena_T ar)
     temp_list_t* temps = NULL;
     for (var it = lv_nodes(igraph->lvig_graph); lv_node_it_next(&it); ) {
         if (lv_is_adj(node, &it.lvni_node)) {
-            temp_t* temp_for_node = Table_get(igraph->lvig_gtemp, &it.lvni_node);
+            temp_t* temp_for_node = lv_node_temp(igraph, &it.lvni_node);
             assert(temp_for_node);
             temps = temp_list_cons(*temp_for_node, temps, ar);
         }
@@ -727,7 +1574,7 @@ void igraph_show(FILE* out, lv_igraph_t* igraph)
 
         fprintf(out, "# %d [", t->tmp_temp.temp_id);
 
-        var node = Table_get(igraph->lvig_tnode, &t->tmp_temp);
+        var node = lv_temp_node(igraph, t->tmp_temp);
 
         var sorted_adj_temps = temp_list_sort(
             temps_for_adj(igraph, node, scratch), scratch);
@@ -744,16 +1591,436 @@ void igraph_show(FILE* out, lv_igraph_t* igraph)
         var m = mm->npl_node;
         {
             var dst_node = m->np_node0;
-            temp_t* temp_for_node = Table_get(igraph->lvig_gtemp, dst_node);
+            temp_t* temp_for_node = lv_node_temp(igraph, dst_node);
             assert(temp_for_node);
             fprintf(out, "# %d <- ", temp_for_node->temp_id);
         }
         {
             var src_node = m->np_node1;
-            temp_t* temp_for_node = Table_get(igraph->lvig_gtemp, src_node);
+            temp_t* temp_for_node = lv_node_temp(igraph, src_node);
             assert(temp_for_node);
             fprintf(out, "%d\n", temp_for_node->temp_id);
         }
     }
     fprintf(out, "# ----------------------------\n");
 }
+
+
+static void
+interval_show(FILE* out, const lv_interval_t* interval)
+{
+    fprintf(out, "# %d", interval->lvi_temp.temp_id);
+    for (int r = 0; r < interval->lvi_num_ranges; r++) {
+        fprintf(out, " [%d, %d]", interval->lvi_ranges[r].lvr_start,
+                interval->lvi_ranges[r].lvr_end);
+    }
+    if (interval->lvi_hint.temp_id >= 0) {
+        fprintf(out, " ~%d", interval->lvi_hint.temp_id);
+    }
+    fprintf(out, "\n");
+}
+
+void intervals_show(FILE* out, const struct intervals_and_table* live)
+{
+    fprintf(out, "# ----   Live Intervals   ----\n");
+    for (int k = 0; k < live->num_intervals; k++) {
+        interval_show(out, &live->intervals[k]);
+    }
+    fprintf(out, "# ----------------------------\n");
+    fprintf(out, "# ----     Registers      ----\n");
+    for (int k = 0; k < live->num_fixed; k++) {
+        interval_show(out, &live->fixed[k]);
+    }
+    fprintf(out, "# ----------------------------\n");
+}
+
+#include "test_harness.h"
+
+static bool temps_contain(temp_list_t* tl, temp_t t)
+{
+    for (; tl; tl = tl->tmp_list) {
+        if (tl->tmp_temp.temp_id == t.temp_id) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool
+interferes(lv_igraph_t* igraph, temp_t t, temp_t u)
+{
+    lv_node_t* t_node = lv_temp_node(igraph, t);
+    lv_node_t* u_node = lv_temp_node(igraph, u);
+    return lv_is_adj(t_node, u_node);
+}
+
+/* Checks the kernels in use against the portable ones */
+void
+test_bitset_kernels()
+{
+    enum { max_words = 13 };
+    uint64_t a[max_words], b[max_words], c[max_words];
+    uint64_t want[max_words], got[max_words];
+    uint64_t seed = 0x9E3779B97F4A7C15ULL;
+    for (int i = 0; i < max_words; i++) {
+        // xorshift, so that the words have a mix of bits
+        seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17;
+        a[i] = seed;
+        seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17;
+        b[i] = seed;
+        seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17;
+        c[i] = seed;
+    }
+
+    for (size_t n = 0; n <= max_words; n++) {
+        portable_kernels.bk_union(want, a, b, n);
+        kernels->bk_union(got, a, b, n);
+        assert(memcmp(want, got, n * sizeof *got) == 0);
+
+        portable_kernels.bk_minus(want, a, b, n);
+        kernels->bk_minus(got, a, b, n);
+        assert(memcmp(want, got, n * sizeof *got) == 0);
+
+        memset(want, 0, sizeof want);
+        memset(got, 0, sizeof got);
+        bool want_changed =
+            portable_kernels.bk_update_in(want, a, b, c, n);
+        bool got_changed = kernels->bk_update_in(got, a, b, c, n);
+        assert(want_changed == got_changed);
+        assert(want_changed == (n > 0));
+        assert(memcmp(want, got, n * sizeof *got) == 0);
+
+        // the same again changes nothing
+        assert(!kernels->bk_update_in(got, a, b, c, n));
+
+        // a change only in the last word is seen
+        if (n > 0) {
+            got[n - 1] ^= 1ULL << 63;
+            assert(kernels->bk_update_in(got, a, b, c, n));
+            assert(memcmp(want, got, n * sizeof *got) == 0);
+        }
+    }
+}
+
+void
+test_block_liveness()
+{
+    Arena_T ar = Arena_new();
+    var ts = temp_state_new(ar);
+    var a = temp_newtemp(ts, 8, TEMP_DISP_NOT_PTR);
+    var b = temp_newtemp(ts, 8, TEMP_DISP_NOT_PTR);
+    var c = temp_newtemp(ts, 8, TEMP_DISP_NOT_PTR);
+    var d = temp_newtemp(ts, 8, TEMP_DISP_NOT_PTR);
+    var loop = temp_newlabel(ts);
+    var done = temp_newlabel(ts);
+    sl_sym_t* jumps = Alloc(ar, 3 * sizeof *jumps);
+    jumps[0] = loop;
+    jumps[1] = done;
+
+    /*
+     * 0     a, c <- ...
+     * 1 loop:
+     * 2     b <- a
+     * 3     a <- b
+     * 4     d <- b
+     * 5     if a goto loop else done
+     * 6 done:
+     * 7     ret a, c
+     */
+    assm_instr_t* instrs[] = {
+        assm_oper("", temp_list_cons(a, temp_list(c, ar), ar), NULL, NULL, ar),
+        assm_label("", loop, ar),
+        assm_oper("", temp_list(b, ar), temp_list(a, ar), NULL, ar),
+        assm_move("", a, b, ar),
+        assm_oper("", temp_list(d, ar), temp_list(b, ar), NULL, ar),
+        assm_oper("", NULL, temp_list(a, ar), jumps, ar),
+        assm_label("", done, ar),
+        assm_oper("", NULL, temp_list_cons(a, temp_list(c, ar), ar), NULL, ar),
+    };
+    for (int i = 0; i < NELEMS(instrs) - 1; i++) {
+        instrs[i]->ai_list = instrs[i + 1];
+    }
+
+    var flow_and_nodes = instrs2graph(instrs[0], ar);
+    var igraph_and_table = interference_graph(
+            flow_and_nodes.flowgraph, flow_and_nodes.node_list, NULL, ar);
+    var igraph = igraph_and_table.igraph;
+
+    // The live outs of each instruction
+    temp_list_t* live_outs[NELEMS(instrs)] = {};
+    int i = 0;
+    for (var n = flow_and_nodes.node_list; n; n = n->nl_list, i++) {
+        live_outs[i] = nt_get(igraph_and_table.live_outs, n->nl_node);
+    }
+    int expected_lens[NELEMS(instrs)] = {2, 2, 2, 3, 2, 2, 2, 0};
+    for (int i = 0; i < NELEMS(instrs); i++) {
+        assert(list_length(live_outs[i]) == expected_lens[i]);
+    }
+    assert(temps_contain(live_outs[0], a) && temps_contain(live_outs[0], c));
+    assert(temps_contain(live_outs[2], b) && temps_contain(live_outs[2], c));
+    assert(temps_contain(live_outs[3], a) && temps_contain(live_outs[3], b));
+    assert(temps_contain(live_outs[5], a) && temps_contain(live_outs[5], c));
+
+    // c is live throughout
+    assert(interferes(igraph, a, c));
+    assert(interferes(igraph, b, c));
+    assert(interferes(igraph, d, c));
+    // d is defined while a is live
+    assert(interferes(igraph, d, a));
+    // a <- b is a move, so a does not interfere with b there
+    assert(!interferes(igraph, a, b));
+    assert(list_length(igraph->lvig_moves) == 1);
+
+    lv_free_interference_and_flow_graph(&igraph_and_table, &flow_and_nodes);
+    Arena_dispose(&ar);
+}
+
+void
+test_loop_depths()
+{
+    Arena_T ar = Arena_new();
+    var ts = temp_state_new(ar);
+    var a = temp_newtemp(ts, 8, TEMP_DISP_NOT_PTR);
+    var body = temp_newlabel(ts);
+    var inner = temp_newlabel(ts);
+    var next = temp_newlabel(ts);
+    var done = temp_newlabel(ts);
+    sl_sym_t* no_jumps = Alloc(ar, sizeof *no_jumps);
+    sl_sym_t* to_body = Alloc(ar, 2 * sizeof *to_body);
+    to_body[0] = body;
+    sl_sym_t* inner_branch = Alloc(ar, 3 * sizeof *inner_branch);
+    inner_branch[0] = inner;
+    inner_branch[1] = next;
+    sl_sym_t* outer_branch = Alloc(ar, 3 * sizeof *outer_branch);
+    outer_branch[0] = body;
+    outer_branch[1] = done;
+
+    /*
+     * 0     a <- ...
+     * 1     goto body
+     * 2 done:
+     * 3     ret a
+     * 4 body:
+     * 5 inner:
+     * 6     a <- a
+     * 7     if a goto inner else next
+     * 8 next:
+     * 9     if a goto body else done
+     *
+     * The jump back to done is not a loop, since done does not dominate it
+     */
+    assm_instr_t* instrs[] = {
+        assm_oper("", temp_list(a, ar), NULL, NULL, ar),
+        assm_oper("", NULL, NULL, to_body, ar),
+        assm_label("", done, ar),
+        assm_oper("", NULL, temp_list(a, ar), no_jumps, ar),
+        assm_label("", body, ar),
+        assm_label("", inner, ar),
+        assm_oper("", temp_list(a, ar), temp_list(a, ar), NULL, ar),
+        assm_oper("", NULL, temp_list(a, ar), inner_branch, ar),
+        assm_label("", next, ar),
+        assm_oper("", NULL, temp_list(a, ar), outer_branch, ar),
+    };
+    for (int i = 0; i < NELEMS(instrs) - 1; i++) {
+        instrs[i]->ai_list = instrs[i + 1];
+    }
+
+    var flow_and_nodes = instrs2graph(instrs[0], ar);
+    int* depths = lv_loop_depths(flow_and_nodes.flowgraph, ar);
+    int expected[NELEMS(instrs)] = {0, 0, 0, 0, 1, 2, 2, 2, 1, 1};
+    for (int i = 0; i < NELEMS(instrs); i++) {
+        assert(depths[i] == expected[i]);
+    }
+
+    Arena_dispose(&ar);
+}
+
+static void
+link_instrs(assm_instr_t** instrs, int n)
+{
+    for (int i = 0; i < n - 1; i++) {
+        instrs[i]->ai_list = instrs[i + 1];
+    }
+}
+
+void
+test_interference_after_spills()
+{
+    Arena_T ar = Arena_new();
+    var ts = temp_state_new(ar);
+    var a = temp_newtemp(ts, 8, TEMP_DISP_NOT_PTR);
+    var b = temp_newtemp(ts, 8, TEMP_DISP_NOT_PTR);
+    var c = temp_newtemp(ts, 8, TEMP_DISP_NOT_PTR);
+    var d = temp_newtemp(ts, 8, TEMP_DISP_NOT_PTR);
+    var fp = temp_newtemp(ts, 8, TEMP_DISP_NOT_PTR);
+    var loop = temp_newlabel(ts);
+    var done = temp_newlabel(ts);
+    sl_sym_t* jumps = Alloc(ar, 3 * sizeof *jumps);
+    jumps[0] = loop;
+    jumps[1] = done;
+
+    // As in test_block_liveness, with a frame pointer
+    assm_instr_t* instrs[] = {
+        assm_oper("", temp_list_cons(a, temp_list(c, ar), ar), NULL, NULL, ar),
+        assm_label("", loop, ar),
+        assm_oper("", temp_list(b, ar), temp_list(a, ar), NULL, ar),
+        assm_move("", a, b, ar),
+        assm_oper("", temp_list(d, ar), temp_list(b, ar), NULL, ar),
+        assm_oper("", NULL, temp_list(a, ar), jumps, ar),
+        assm_label("", done, ar),
+        assm_oper("", NULL,
+                temp_list_cons(a, temp_list_cons(c, temp_list(fp, ar), ar),
+                    ar), NULL, ar),
+    };
+    link_instrs(instrs, NELEMS(instrs));
+    var flow_and_nodes = instrs2graph(instrs[0], ar);
+    var prev = interference_graph(
+            flow_and_nodes.flowgraph, flow_and_nodes.node_list, NULL, ar);
+
+    // a spilled, with a new temp at each def and use
+    temp_t as[5];
+    for (int i = 0; i < NELEMS(as); i++) {
+        as[i] = temp_newtemp(ts, 8, TEMP_DISP_NOT_PTR);
+    }
+#define STORE(t) \
+    assm_oper("", NULL, temp_list_cons(t, temp_list(fp, ar), ar), NULL, ar)
+#define LOAD(t) assm_oper("", temp_list(t, ar), temp_list(fp, ar), NULL, ar)
+    assm_instr_t* spilled_instrs[] = {
+        assm_oper("", temp_list_cons(as[0], temp_list(c, ar), ar), NULL, NULL,
+                ar),
+        STORE(as[0]),
+        assm_label("", loop, ar),
+        LOAD(as[1]),
+        assm_oper("", temp_list(b, ar), temp_list(as[1], ar), NULL, ar),
+        assm_move("", as[2], b, ar),
+        STORE(as[2]),
+        assm_oper("", temp_list(d, ar), temp_list(b, ar), NULL, ar),
+        LOAD(as[3]),
+        assm_oper("", NULL, temp_list(as[3], ar), jumps, ar),
+        assm_label("", done, ar),
+        LOAD(as[4]),
+        assm_oper("", NULL,
+                temp_list_cons(as[4],
+                    temp_list_cons(c, temp_list(fp, ar), ar), ar),
+                NULL, ar),
+    };
+#undef LOAD
+#undef STORE
+    link_instrs(spilled_instrs, NELEMS(spilled_instrs));
+    var spilled_flow = instrs2graph(spilled_instrs[0], ar);
+    var updated = interference_graph_after_spills(&prev,
+            spilled_flow.flowgraph, spilled_flow.node_list, NULL,
+            temp_list(a, ar), ar);
+    var rebuilt = interference_graph(
+            spilled_flow.flowgraph, spilled_flow.node_list, NULL, ar);
+
+    // The same as analysing the rewritten instructions from scratch
+    assert(updated.iterations == 0);
+    assert(!lv_temp_node(updated.igraph, a));
+    temp_t temps[] = {as[0], as[1], as[2], as[3], as[4], b, c, d, fp};
+    for (int i = 0; i < NELEMS(temps); i++) {
+        for (int j = 0; j < NELEMS(temps); j++) {
+            assert(interferes(updated.igraph, temps[i], temps[j])
+                    == interferes(rebuilt.igraph, temps[i], temps[j]));
+        }
+    }
+    assert(list_length(updated.igraph->lvig_moves)
+            == list_length(rebuilt.igraph->lvig_moves));
+    for (var n = spilled_flow.node_list; n; n = n->nl_list) {
+        assert(list_length(nt_get(updated.live_outs, n->nl_node))
+                == list_length(nt_get(rebuilt.live_outs, n->nl_node)));
+    }
+
+    lv_free_interference_and_flow_graph(&updated, &spilled_flow);
+    lv_free_interference_and_flow_graph(&rebuilt, &spilled_flow);
+    Arena_dispose(&ar);
+}
+
+void
+test_live_intervals()
+{
+    Arena_T ar = Arena_new();
+    var ts = temp_state_new(ar);
+    var a = temp_newtemp(ts, 8, TEMP_DISP_NOT_PTR);
+    var b = temp_newtemp(ts, 8, TEMP_DISP_NOT_PTR);
+    var c = temp_newtemp(ts, 8, TEMP_DISP_NOT_PTR);
+    var next = temp_newlabel(ts);
+    var skip = temp_newlabel(ts);
+    var join = temp_newlabel(ts);
+    sl_sym_t* branch = Alloc(ar, 3 * sizeof *branch);
+    branch[0] = skip;
+    branch[1] = next;
+    sl_sym_t* jump = Alloc(ar, 2 * sizeof *jump);
+    jump[0] = join;
+
+    /*
+     * 0     a, b <- ...
+     * 1     if a goto skip else next
+     * 2 next:
+     * 3     c <- b
+     * 4     goto join
+     * 5 skip:
+     * 6     c <- a
+     * 7 join:
+     * 8     ret c
+     */
+    assm_instr_t* instrs[] = {
+        assm_oper("", temp_list_cons(a, temp_list(b, ar), ar), NULL, NULL, ar),
+        assm_oper("", NULL, temp_list(a, ar), branch, ar),
+        assm_label("", next, ar),
+        assm_move("", c, b, ar),
+        assm_oper("", NULL, NULL, jump, ar),
+        assm_label("", skip, ar),
+        assm_move("", c, a, ar),
+        assm_label("", join, ar),
+        assm_oper("", NULL, temp_list(c, ar), NULL, ar),
+    };
+    for (int i = 0; i < NELEMS(instrs) - 1; i++) {
+        instrs[i]->ai_list = instrs[i + 1];
+    }
+
+    var flow_and_nodes = instrs2graph(instrs[0], ar);
+    var live = live_intervals(flow_and_nodes.flowgraph,
+            flow_and_nodes.node_list, NULL, ar);
+
+    assert(live.num_intervals == 3);
+    assert(live.num_fixed == 0);
+    var a_interval = &live.intervals[0];
+    var b_interval = &live.intervals[1];
+    var c_interval = &live.intervals[2];
+    assert(a_interval->lvi_temp.temp_id == a.temp_id);
+    assert(b_interval->lvi_temp.temp_id == b.temp_id);
+    assert(c_interval->lvi_temp.temp_id == c.temp_id);
+
+    // a is live out of the branch, for skip, but not in the block at next
+    assert(a_interval->lvi_num_ranges == 2);
+    assert(a_interval->lvi_ranges[0].lvr_start == 1);
+    assert(a_interval->lvi_ranges[0].lvr_end == 3);
+    assert(a_interval->lvi_ranges[1].lvr_start == 10);
+    assert(a_interval->lvi_ranges[1].lvr_end == 12);
+
+    assert(b_interval->lvi_num_ranges == 1);
+    assert(b_interval->lvi_start == 1 && b_interval->lvi_end == 6);
+    assert(b_interval->lvi_hint.temp_id == c.temp_id);
+
+    // c is only live where it is defined, and after join
+    assert(c_interval->lvi_num_ranges == 2);
+    assert(c_interval->lvi_ranges[0].lvr_start == 7);
+    assert(c_interval->lvi_ranges[0].lvr_end == 9);
+    assert(c_interval->lvi_ranges[1].lvr_start == 13);
+    assert(c_interval->lvi_ranges[1].lvr_end == 16);
+
+    Arena_dispose(&ar);
+}
+
+static void register_tests() __attribute__((constructor));
+void
+register_tests() {
+
+    REGISTER_TEST(test_bitset_kernels);
+    REGISTER_TEST(test_block_liveness);
+    REGISTER_TEST(test_loop_depths);
+    REGISTER_TEST(test_interference_after_spills);
+    REGISTER_TEST(test_live_intervals);
+
+}
@@ -7,6 +7,7 @@
 #include "interfaces/arena.h"
 #include "interfaces/table.h"
 #include "assem.h" // assm_instr_t
+#include "array.h"
 
 // TODO: define wrapper types around these graphs to improve type safety.
 
@@ -69,10 +70,22 @@ lv_eq(const lv_node_t* a, const lv_node_t* b)
 }
 
 extern lv_graph_t* lv_new_graph(Arena_T);
+/*
+ * For interference graphs. lv_finish_edges must be called after the edges
+ * are made and before the graph is walked. lv_succ and lv_adj then give
+ * the adjacent nodes in order, followed by any from edges made later.
+ */
+extern lv_graph_t* lv_new_undirected_graph(Arena_T);
+extern void lv_finish_edges(lv_graph_t*);
 extern size_t lv_graph_length(const lv_graph_t*);
 extern lv_node_t* lv_new_node(lv_graph_t* graph, Arena_T);
 extern void lv_mk_edge(lv_node_t* from, lv_node_t* to);
 extern void lv_rm_edge(lv_node_t* from, lv_node_t* to);
+/*
+ * Removes all the edges of the nodes of an undirected graph, e.g. of the
+ * temps that have been spilled.
+ */
+extern void lv_isolate_nodes(lv_node_list_t*, Arena_T scratch);
 
 extern void lv_print_graph(lv_graph_t*);
 
@@ -116,6 +129,12 @@ struct flowgraph_and_node_list {
     lv_node_list_t* node_list;
 } instrs2graph(const assm_instr_t*, Arena_T);
 
+/*
+ * The loop nesting depth of each flow graph node, by index, with 0 being
+ * outside of any loop.
+ */
+int* lv_loop_depths(lv_flowgraph_t*, Arena_T);
+
 /*
  * Liveness
  */
@@ -140,14 +159,16 @@ struct lv_igraph_t {
     lv_graph_t* lvig_graph;
 
     /*
-     * lvig_tnode is a map from temp_t* -> lv_node_t*
-     * It gives the interference graph node for a given register or temporary
+     * lvig_tnode is indexed by temp_id. It gives the interference graph node
+     * for a given register or temporary, or NULL. Use lv_temp_node.
      */
-    Table_T lvig_tnode; // should be a function?
+    arrtype(lv_node_t*) lvig_tnode;
     /*
-     * lvig_gtemp is a map from lv_node_t* -> temp_t*
+     * lvig_gtemp is indexed by node. It gives the temp of each node, or NULL
+     * for a temp that has been spilled. Use lv_node_temp.
      */
-    Table_T lvig_gtemp;
+    arrtype(temp_t*) lvig_gtemp;
+    int lvig_num_temps; // not counting the spilled ones
     /*
      * lvig_moves is a list of node pairs ((d0, s0), (d1, s2), ...)
      * for each move in the program, with dₙ, sₙ being interference graph
@@ -156,6 +177,19 @@ struct lv_igraph_t {
     lv_node_pair_list_t* lvig_moves;
 };
 
+static inline lv_node_t*
+lv_temp_node(const lv_igraph_t* igraph, temp_t t)
+{
+    return ((unsigned)t.temp_id < (unsigned)igraph->lvig_tnode.len)
+        ? igraph->lvig_tnode.data[t.temp_id] : NULL;
+}
+
+static inline temp_t*
+lv_node_temp(const lv_igraph_t* igraph, const lv_node_t* node)
+{
+    return igraph->lvig_gtemp.data[node->lvn_idx];
+}
+
 struct igraph_and_table {
     lv_igraph_t* igraph; // The interference graph
     /*
@@ -163,14 +197,78 @@ struct igraph_and_table {
      * that are Live Out at that node
      */
     lv_node_temps_map_t* live_outs;
+    int iterations; // of the dataflow worklist, for statistics
+    // The live-outs of each basic block, for interference_graph_after_spills
+    struct node_set_table* block_live_outs;
 };
 
+/*
+ * Computes the interference graph, and the Live Outs at the flow graph
+ * nodes in want_live_outs, or at all of them if it is NULL.
+ */
 struct igraph_and_table interference_graph(
-        lv_flowgraph_t*, lv_node_list_t* cg_nodes, Arena_T);
+        lv_flowgraph_t*, lv_node_list_t* cg_nodes,
+        nodeset_t* want_live_outs, Arena_T);
+
+/*
+ * Updates the interference graph of prev, made by interference_graph, for
+ * the flow graph of the instructions after the temps in spilled have been
+ * spilled. Only the new temps are analysed; the dataflow equations are not
+ * solved again. prev is no longer valid afterwards, and the arena must be
+ * the one that it was made in.
+ */
+struct igraph_and_table interference_graph_after_spills(
+        struct igraph_and_table* prev, lv_flowgraph_t*,
+        lv_node_list_t* cg_nodes, nodeset_t* want_live_outs,
+        temp_list_t* spilled, Arena_T);
 
 void lv_free_interference_and_flow_graph(
         struct igraph_and_table*, struct flowgraph_and_node_list*);
 
+/*
+ * The positions from lvr_start to lvr_end inclusive. Instruction i uses its
+ * sources at position 2i and defines its destinations at position 2i + 1.
+ */
+typedef struct lv_range_t {
+    int lvr_start;
+    int lvr_end;
+} lv_range_t;
+
+/*
+ * The live interval of a temporary, from the first to the last position at
+ * which it is live. It is made of the ranges in which the temporary is
+ * live; the holes between them are where another temporary can have the
+ * same register. Positions follow the order of the instructions, so e.g.
+ * a temporary that is live only in the blocks either side of an if has a
+ * hole at the blocks of the other branch.
+ */
+typedef struct lv_interval_t {
+    temp_t lvi_temp;
+    int lvi_start;
+    int lvi_end;
+    temp_t lvi_hint; // moved to or from lvi_temp, or temp_id is -1
+    lv_range_t* lvi_ranges; // in order, and neither overlapping nor touching
+    int lvi_num_ranges;
+} lv_interval_t;
+
+struct intervals_and_table {
+    lv_interval_t* intervals; // of the temporaries, in order of start
+    int num_intervals;
+    lv_interval_t* fixed; // of the machine registers, in order of register
+    int num_fixed;
+    // The Live Outs, only at the flow graph nodes asked for
+    lv_node_temps_map_t* live_outs;
+    int iterations; // of the dataflow worklist, for statistics
+};
+
+/*
+ * Computes the live intervals for linear scan register allocation. This
+ * is much cheaper than building the interference graph.
+ */
+struct intervals_and_table live_intervals(
+        lv_flowgraph_t*, lv_node_list_t* cg_nodes,
+        nodeset_t* want_live_outs, Arena_T);
+
 #include <stdio.h>
 
 void
@@ -186,5 +284,10 @@ flowgraph_print(
  */
 void igraph_show(FILE* out, lv_igraph_t* igraph);
 
+/*
+ * Prints the live intervals, for debugging, in the same way.
+ */
+void intervals_show(FILE* out, const struct intervals_and_table*);
+
 
 #endif /* __LIVENESS_H__ */
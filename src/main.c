@@ -3,7 +3,7 @@
 #include <stdio.h>
 #include <string.h> // strcmp
 #include <stdbool.h>
-#include <assert.h>
+#include "assertions.h"
 #include "colours.h"
 #include "ast.h"
 #include "semantics.h"
@@ -11,34 +11,65 @@
 #include "activation.h"
 #include "temp.h"
 #include "translate.h"
+#include "inliner.h"
+#include "simplify.h"
 #include "canonical.h"
+#include "codegen_cache.h"
 #include "x86_64.h"
 #include "arm64.h"
 #include "liveness.h"
 #include "reg_alloc.h"
+#include "worker_pool.h"
+#include "array.h"
+#include "stats.h"
+#include "mem.h" // xmalloc
 
 #define var __auto_type
+#define Alloc(arena, size) Arena_alloc(arena, size, __FILE__, __LINE__)
 
 static void print_usage_and_exit(int exit_code) __attribute__((noreturn));
 static void print_usage_and_exit(int exit_code)
 {
     fprintf(stderr, "usage: structlangc [options] <input>\n");
+    fprintf(stderr,
+            "       structlangc [options] --output-dir=<dir> <input>...\n");
     fputs("\
 \n\
 if '-' is given as an input, then stdin is read.\n\
 \n\
 options:\n\
   -o                Output filename\n\
+  --output-dir=<dir>\n\
+                    Compile each input into <dir>, naming the output after\n\
+                    the input, e.g. a/b.sl into <dir>/b.s\n\
+  -j N              Allocate registers for N functions at a time or, with\n\
+                    --output-dir, compile N files at a time\n\
+  --stream          Translate and compile one function at a time, so that\n\
+                    memory use is bounded by the largest function rather\n\
+                    than the whole program. No calls are inlined\n\
+  --cache-dir=<dir> Keep the assembly for each function in <dir> and reuse\n\
+                    it when the function is compiled again unchanged\n\
+  --regalloc=graph  Allocate registers by graph colouring (the default)\n\
+  --regalloc=linear Allocate registers by linear scan, which is faster but\n\
+                    gives slower code\n\
+  --regalloc=auto   Use linear scan only for very large functions\n\
   --target=arm64    Produce arm64 assembly for macOS\n\
   --target=x86_64   Produce x86_64 GAS syntax assembly for Linux\n\
   -S                Not yet implemented.\n\
+  --time-passes     Report the time and memory used by each pass, and\n\
+                    statistics for each function, on stderr\n\
+  --time-passes=json\n\
+                    The same, but as JSON\n\
+  --no-simplify     Leave out the folding of constants and the other\n\
+                    simplifications of the tree IR\n\
+  --no-inline       Leave out the inlining of calls to small functions\n\
 \n\
 debug options:\n\
   -p    Parse only (print ast)\n\
   -t    Stop after type checking\n\
   -r    Stop after rewrites and print ast\n\
   -a    Stop after calculating activation records\n\
-  -T    Stop after translating into the tree IR\n\
+  -T    Stop after translating into the tree IR, inlining and simplifying\n\
   -C    Stop after canonicalising the tree IR\n\
   -i    Stop after instruction selection\n\
   -l    Stop after liveness analysis\n\
@@ -46,309 +77,909 @@ debug options:\n\
     exit(exit_code);
 }
 
-bool
-is_test_binary(const char* prog_name)
+/*
+ * The register allocation and emission of a single function, after
+ * instruction selection. In parallel mode, this is run on a worker thread
+ * and out is a memory stream that is copied to the real output, in
+ * fragment order, once the job is complete.
+ */
+typedef struct backend_job {
+    sl_fragment_t* frag; // the FR_CODE fragment
+    assm_instr_t* body_instrs;
+    temp_state_t* temp_state; // forked for this function
+    bool stop_after_liveness_analysis;
+    enum ra_algorithm regalloc;
+    bool emit_header;
+
+    FILE* out;
+    char* out_buf; // for the memory stream, in parallel mode
+    size_t out_len;
+    Arena_T instr_arena;
+    Table_T label_to_cs_bitmap;
+    Arena_T* worker_frag_arenas; // indexed by worker
+    st_func_stats_t stats;
+
+    cc_key_t* cache_key; // when the result should be stored in the cache
+    cc_cache_t* cache;
+    bool cache_hit;
+    writer_t cached_text; // the assembly from the cache, on a hit
+
+    // In streaming mode, the frame maps are moved here once the function
+    // is done, since the fragment is freed along with its instructions.
+    sl_fragment_t** frame_maps;
+} backend_job_t;
+
+static void run_backend(backend_job_t* job, Arena_T frag_arena)
 {
-    const char* suffix = strrchr(prog_name, '.');
-    return suffix != NULL && (strcmp(suffix, ".test") == 0);
-}
+    var frag = job->frag;
+    var target = frag->fr_frame->acf_target;
+    var out = job->out;
+    if (job->cache_hit) {
+        if (job->emit_header) {
+            target->tgt_backend->emit_text_segment_header(out);
+        }
+        job->cached_text.wr_file = out;
+        wr_dispose(&job->cached_text);
+        return;
+    }
+    Table_T label_to_spill_liveness = Table_new(0, NULL, NULL);
+
+    var instrs_and_allocation =
+        ra_alloc(out, job->temp_state, job->body_instrs, frag->fr_frame,
+                job->regalloc, job->stop_after_liveness_analysis,
+                job->label_to_cs_bitmap, label_to_spill_liveness,
+                job->instr_arena, job->instr_arena, job->instr_arena,
+                frag_arena);
+    var body_instrs = instrs_and_allocation.ra_instrs;
+    var ra_stats = instrs_and_allocation.ra_stats;
+    job->stats.stf_flow_nodes = ra_stats.ras_flow_nodes;
+    job->stats.stf_interference_nodes = ra_stats.ras_interference_nodes;
+    job->stats.stf_liveness_iterations = ra_stats.ras_liveness_iterations;
+    job->stats.stf_regalloc_rounds = ra_stats.ras_rounds;
+    job->stats.stf_spills = ra_stats.ras_spills;
+    if (job->stop_after_liveness_analysis) {
+        goto cleanup;
+    }
 
-extern int test_main(int argc, char* argv[]);
+    var emit_timer = st_begin(ST_PASS_EMIT);
+    var final_fragment = target->tgt_backend->proc_entry_exit_3(
+            frag->fr_frame, body_instrs, job->instr_arena);
 
-int main(int argc, char* argv[])
-{
-    if (is_test_binary(argv[0])) {
-        exit(test_main(argc, argv));
+    if (job->emit_header) {
+        target->tgt_backend->emit_text_segment_header(out);
     }
 
-    bool parse_only = 0;
-    bool stop_after_type_checking = 0;
-    bool stop_after_rewrites = 0;
-    bool stop_after_activation_calculation = 0;
-    bool stop_after_translation = 0;
-    bool stop_after_canonicalisation = 0;
-    bool stop_after_instruction_selection = 0;
-    bool warn_about_multiple_files = 0;
-    bool stop_after_liveness_analysis = 0;
-    char* inarg = NULL;
-    char* outarg = NULL;
-    const target_t* target = &TARGET_DEFAULT;
-
-    bool optsdone = false;
-    for (int i = 1; i < argc; i++) {
-        if (!optsdone && argv[i][0] == '-' && argv[i][1] != '\0') {
-            if (argv[i][1] == '-') {
-                if (argv[i][2] == '\0') {
-                    optsdone = true;
-                    continue;
-                }
-                // Long options
-                const char* target_opt = "--target=";
-                const size_t target_opt_len = strlen(target_opt);
-                if (strncmp(argv[i], "--target=", target_opt_len) == 0) {
-                    const char* target_value = argv[i] + target_opt_len;
-                    if (strcmp(target_value, "x86_64") == 0) {
-                        target = &target_x86_64;
-                    } else if (strcmp(target_value, "arm64") == 0) {
-                        target = &target_arm64;
-                    } else {
-                        fprintf(stderr, "unknown target: %s\n", target_value);
-                        exit(1);
-                    }
-                } else {
-                    fprintf(stderr, "unknown option: %s\n", argv[i]);
-                    exit(1);
-                }
-                continue;
-            }
-            // Short options
-            for (char* pc = &argv[i][1]; *pc; pc++) {
-                switch (*pc) {
-                    case 'p': parse_only = 1; break;
-                    case 't': stop_after_type_checking = 1; break;
-                    case 'r': stop_after_rewrites = 1; break;
-                    case 'a': stop_after_activation_calculation = 1; break;
-                    case 'T': stop_after_translation = 1; break;
-                    case 'C': stop_after_canonicalisation = 1; break;
-                    case 'i': stop_after_instruction_selection = 1; break;
-                    case 'l': stop_after_liveness_analysis = 1; break;
-                    case 'o':
-                       if (!(i + 1 < argc)) {
-                           fprintf(stderr, "argument to '-o' is missing\n");
-                           print_usage_and_exit(1);
-                       }
-                       if (*(pc + 1)) {
-                           fprintf(stderr, "no short args may follow '-o'\n");
-                           print_usage_and_exit(1);
-                       }
-                       i += 1;
-                       outarg = argv[i];
-                       break;
-                    // S will become our option to emit assembly and no option
-                    // will mean calling out to the assembler and linker.
-                    case 'S': break;
-                    case 'h': print_usage_and_exit(0);
-                    default: fprintf(stderr, "unknown option '%c'\n", *pc);
-                             print_usage_and_exit(1);
-                }
-            }
-        } else if (!inarg) {
-            inarg = argv[i];
-        } else {
-            warn_about_multiple_files = 1;
-        }
+    // When caching, the text is kept until the frame maps are complete,
+    // so that it can be stored along with them.
+    writer_t w;
+    wr_init(&w, job->cache_key ? NULL : out);
+    wr_puts(&w, final_fragment.asf_prologue);
+    for (var i = final_fragment.asf_instrs; i; i = i->ai_list) {
+        assm_format(&w, i, instrs_and_allocation.ra_allocation, target);
     }
-    if (inarg == NULL) {
-        print_usage_and_exit(1);
+    wr_puts(&w, final_fragment.asf_epilogue);
+
+    // peek through upcoming non-code frags
+    // this abuses some knowledge about how they are added
+    for (; frag->fr_list && frag->fr_list->fr_tag != FR_CODE;
+            ) {
+        frag = frag->fr_list;
+        if (frag->fr_tag != FR_FRAME_MAP) {
+            continue;
+        }
+
+        temp_list_t* spill_live_outs =
+            Table_get(label_to_spill_liveness, frag->fr_ret_label);
+        ac_extend_frame_map_for_spills(frag->fr_map, spill_live_outs,
+                instrs_and_allocation.ra_allocation, frag_arena);
     }
-    if (warn_about_multiple_files) {
-        fprintf(stderr, "%swarning:%s only %s will be considered for input\n",
-                term_colours.magenta, term_colours.clear, inarg);
+
+    if (job->cache_key) {
+        cc_store(job->cache, job->cache_key, job->frag,
+                final_fragment.asf_instrs, w.wr_buf, w.wr_len,
+                job->label_to_cs_bitmap);
+        cc_key_dispose(job->cache_key);
+        job->cache_key = NULL;
+        w.wr_file = out;
     }
+    wr_dispose(&w);
 
-    FILE* out = stdout;
-    if (outarg != NULL && strcmp(outarg, "-") != 0) {
-        out = fopen(outarg, "w");
-        if (out == NULL) {
-            perror(outarg);
-            return 1;
-        }
+    st_end(&emit_timer);
+
+    // Free final fragment strings?
+cleanup:
+    Table_free(&label_to_spill_liveness);
+}
+
+static void keep_frame_maps(backend_job_t* job)
+{
+    if (job->frame_maps && job->frag->fr_list) {
+        *job->frame_maps = fr_append(*job->frame_maps, job->frag->fr_list);
+        job->frag->fr_list = NULL;
     }
+}
+
+static void run_backend_task(void* task, int worker_idx)
+{
+    backend_job_t* job = task;
+    run_backend(job, job->worker_frag_arenas[worker_idx]);
+}
+
+static void
+copy_cs_bitmap(const void* key, void** value, void* cl)
+{
+    Table_T label_to_cs_bitmap = cl;
+    Table_put(label_to_cs_bitmap, key, *value);
+}
+
+/*
+ * Once a parallel job is complete, copy its output and results into the
+ * shared ones and release its memory.
+ */
+static void
+write_parallel_job(FILE* out, backend_job_t* job, Table_T label_to_cs_bitmap)
+{
+    fclose(job->out);
+    job->out = NULL;
+    fwrite(job->out_buf, 1, job->out_len, out);
+    free(job->out_buf);
+    job->out_buf = NULL;
+
+    st_record_function(&job->stats);
+    Table_map(job->label_to_cs_bitmap, copy_cs_bitmap, label_to_cs_bitmap);
+    Table_free(&job->label_to_cs_bitmap);
+    keep_frame_maps(job);
+    Arena_dispose(&job->instr_arena);
+}
 
-    Arena_T ast_arena = Arena_new();
+/* Options that apply to the compilation of each file */
+typedef struct compile_options {
+    bool parse_only;
+    bool stop_after_type_checking;
+    bool stop_after_rewrites;
+    bool stop_after_activation_calculation;
+    bool stop_after_translation;
+    bool stop_after_canonicalisation;
+    bool stop_after_instruction_selection;
+    bool stop_after_liveness_analysis;
+    bool no_simplify;
+    bool no_inline;
+    int num_jobs; // workers for register allocation
+    const target_t* target;
+    const char* cache_dir; // NULL when not caching
+    bool streaming;
+    enum ra_algorithm regalloc;
+} compile_options_t;
+
+/*
+ * The arenas used while compiling a file. In batch mode, these are cleared
+ * and reused for the next file, rather than being created afresh.
+ */
+typedef struct compile_arenas {
+    Arena_T ca_ast;
+    Arena_T ca_frag;
+    Arena_T ca_instr_loop;
+} compile_arenas_t;
+
+/*
+ * Compiles inarg, writing the assembly (or the debug output requested) to
+ * out. Returns the exit code. The caller should clear the arenas before
+ * they are used again.
+ */
+static int
+compile_file(const compile_options_t* opts, const char* inarg, FILE* out,
+        compile_arenas_t* arenas)
+{
+    const target_t* target = opts->target;
+    var timer = st_begin(ST_PASS_PARSE);
+    Arena_T ast_arena = arenas->ca_ast;
     sl_decl_t* program = parse_file(ast_arena, inarg);
+    st_end(&timer);
     if (!program) {
         return 1;
     }
 
-    if (parse_only) {
+    if (opts->parse_only) {
         for (sl_decl_t* decl = program; decl; decl = decl->dl_list) {
             dl_print(out, decl);
             fprintf(out, "\n");
         }
-        Arena_dispose(&ast_arena);
         return 0;
     }
 
+    timer = st_begin(ST_PASS_SEMANTICS);
     int sem_result = sem_verify_and_type_program(ast_arena, inarg, program);
+    st_end(&timer);
     if (sem_result < 0) {
         fprintf(stderr, "%d errors\n", -sem_result);
         return 1;
     }
 
-    if (stop_after_type_checking) {
+    if (opts->stop_after_type_checking) {
         // Print typed tree?
-        Arena_dispose(&ast_arena);
         return 0;
     }
 
     // make some small transformations that make it easier to transform the
     // program into the lower level language
+    timer = st_begin(ST_PASS_REWRITES);
     rewrite_decompose_equal(ast_arena, program);
+    st_end(&timer);
 
-    if (stop_after_rewrites) {
+    if (opts->stop_after_rewrites) {
         for (sl_decl_t* decl = program; decl; decl = decl->dl_list) {
             dl_print(out, decl);
             fprintf(out, "\n");
         }
-        Arena_dispose(&ast_arena);
         return 0;
     }
 
-    Arena_T frag_arena = Arena_new();
+    timer = st_begin(ST_PASS_ACTIVATION);
+    Arena_T frag_arena = arenas->ca_frag;
     temp_state_t* temp_state = temp_state_new(frag_arena);
-    ac_frame_t* frames =
-        calculate_activation_records(frag_arena, target, temp_state, program);
+    translate_types_t* types = translate_types_new(frag_arena, program);
+    ac_frame_t* frames = calculate_activation_records(
+            frag_arena, target, temp_state, program, types);
+    st_end(&timer);
     if(!frames) {
         // TODO: consider a module with only struct definitions?
         fprintf(stderr, "internal error: failed to calculate frames\n");
         return 1;
     }
 
-    if (stop_after_activation_calculation) {
-        Arena_dispose(&frag_arena);
-        Arena_dispose(&ast_arena);
+    if (opts->stop_after_activation_calculation) {
         return 0;
     }
 
-    sl_fragment_t* fragments =
-        translate_program(frag_arena, temp_state, program, frames);
-    // ^ after this we can free up the ast structures
-    if (!fragments) {
-        fprintf(stderr, "internal error: failed to translate into trees\n");
-        return 1;
-    }
-    // Our AST is now converted into the Tree IR.
-    program = NULL;
-    Arena_dispose(&ast_arena);
-    frames = NULL; // now owned by fragments.
-
-    if (stop_after_translation) {
-        for (var frag = fragments; frag; frag = frag->fr_list) {
-            if (frag->fr_tag == FR_CODE) {
-                fprintf(out, "# %s\n", frag->fr_frame->acf_name);
-                tree_printf(out, "%S\n", frag->fr_body);
-            } else {
-                assert(frag->fr_tag == FR_STRING);
-                fr_string_print(out, frag);
+    // In streaming mode, each function is translated and canonicalised
+    // just before instruction selection, and its trees are freed along with
+    // its instructions. The debug output of -T and -C is for the whole
+    // program, so they do not stream.
+    bool streaming = opts->streaming && !opts->stop_after_translation
+        && !opts->stop_after_canonicalisation;
+    sl_fragment_t* fragments = NULL;
+    translate_info_t* translate_info = NULL;
+    if (streaming) {
+        translate_info =
+            translate_begin(frag_arena, temp_state, program, types);
+    } else {
+        timer = st_begin(ST_PASS_TRANSLATE);
+        fragments =
+            translate_program(frag_arena, temp_state, program, types, frames);
+        st_end(&timer);
+        // ^ after this we can free up the ast structures
+        if (!fragments) {
+            fprintf(stderr,
+                    "internal error: failed to translate into trees\n");
+            return 1;
+        }
+        if (!opts->no_inline) {
+            timer = st_begin(ST_PASS_INLINE);
+            inline_calls(frag_arena, temp_state, fragments);
+            st_end(&timer);
+        }
+        if (!opts->no_simplify) {
+            timer = st_begin(ST_PASS_SIMPLIFY);
+            simplify_tree(frag_arena, fragments);
+            st_end(&timer);
+        }
+        // Our AST is now converted into the Tree IR.
+        program = NULL;
+        Arena_clear(ast_arena);
+        frames = NULL; // now owned by fragments.
+
+        if (opts->stop_after_translation) {
+            for (var frag = fragments; frag; frag = frag->fr_list) {
+                if (frag->fr_tag == FR_CODE) {
+                    fprintf(out, "# %s\n", frag->fr_frame->acf_name);
+                    tree_printf(out, "%S\n", frag->fr_body);
+                } else {
+                    assert(frag->fr_tag == FR_STRING);
+                    fr_string_print(out, frag);
+                }
             }
+            return 0;
         }
-        Arena_dispose(&frag_arena);
-        return 0;
-    }
 
-    canonicalise_tree(frag_arena, target, temp_state, fragments);
-    if (stop_after_canonicalisation) {
-        for (var frag = fragments; frag; frag = frag->fr_list) {
-            if (frag->fr_tag == FR_CODE) {
-                fprintf(out, "# %s\n", frag->fr_frame->acf_name);
-                for (var s = frag->fr_body; s; s = s->tst_list) {
-                    tree_printf(out, "%S\n", s);
+        timer = st_begin(ST_PASS_CANONICALISE);
+        canonicalise_tree(frag_arena, target, temp_state, fragments);
+        st_end(&timer);
+        if (opts->stop_after_canonicalisation) {
+            for (var frag = fragments; frag; frag = frag->fr_list) {
+                if (frag->fr_tag == FR_CODE) {
+                    fprintf(out, "# %s\n", frag->fr_frame->acf_name);
+                    for (var s = frag->fr_body; s; s = s->tst_list) {
+                        tree_printf(out, "%S\n", s);
+                    }
+                    fprintf(out, "\n");
+                } else {
+                    assert(frag->fr_tag == FR_STRING);
+                    fr_string_print(out, frag);
                 }
-                fprintf(out, "\n");
-            } else {
-                assert(frag->fr_tag == FR_STRING);
-                fr_string_print(out, frag);
             }
+            return 0;
         }
-        Arena_dispose(&frag_arena);
-        return 0;
     }
 
     Table_T label_to_cs_bitmap = Table_new(0, NULL, NULL);
     bool emitted_header = false;
-    var instr_loop_arena = Arena_new();
-
-    for (var frag = fragments; frag; frag = frag->fr_list) {
-        if (frag->fr_tag != FR_CODE) {
+    cc_cache_t* cache = NULL;
+    // The debug output of -i and -l would be missing for cached functions
+    if (opts->cache_dir && !opts->stop_after_instruction_selection
+            && !opts->stop_after_liveness_analysis) {
+        cache = cc_new(opts->cache_dir, target, opts->regalloc, frag_arena);
+        if (!cache) {
+            return 1;
+        }
+        cc_add_strings(cache, fragments);
+    }
+    var instr_loop_arena = arenas->ca_instr_loop;
+
+    // In parallel mode, instruction selection still happens here on the
+    // main thread, since it creates labels, which must be unique across the
+    // program. Allocation and formatting of each function is done by the
+    // workers and the results are written out in fragment order.
+    worker_pool_t* pool = NULL;
+    Arena_T* worker_frag_arenas = NULL;
+    if (opts->num_jobs > 1 && !opts->stop_after_instruction_selection) {
+        pool = wp_new(opts->num_jobs, run_backend_task);
+        worker_frag_arenas =
+            Alloc(frag_arena, opts->num_jobs * sizeof(Arena_T));
+        for (int i = 0; i < opts->num_jobs; i++) {
+            worker_frag_arenas[i] = Arena_new();
+        }
+    }
+    arrtype(backend_job_t*) jobs = {};
+    int num_written = 0;
+    // Bound the number of functions in flight, so that we don't hold all
+    // the instructions of the program in memory at once.
+    const int max_jobs_in_flight = 4 * opts->num_jobs;
+
+    sl_fragment_t* next_frag = fragments;
+    const sl_decl_t* next_decl = program; // in streaming mode
+    ac_frame_t* next_frame = frames;
+    sl_fragment_t* frame_maps = NULL;
+    sl_fragment_t* last_string = NULL;
+    for (;;) {
+        if (streaming) {
+            while (next_decl && next_decl->dl_tag != SL_DECL_FUNC) {
+                next_decl = next_decl->dl_list;
+            }
+            if (!next_decl) {
+                break;
+            }
+        } else {
             // data is handled below
-            continue;
+            while (next_frag && next_frag->fr_tag != FR_CODE) {
+                next_frag = next_frag->fr_list;
+            }
+            if (!next_frag) {
+                break;
+            }
+        }
+
+        backend_job_t serial_job = {};
+        backend_job_t* job = &serial_job;
+        if (pool) {
+            job = Alloc(frag_arena, sizeof *job);
+            job->out = open_memstream(&job->out_buf, &job->out_len);
+            if (!job->out) {
+                perror("open_memstream");
+                // The jobs in flight use frag_arena and the worker arenas,
+                // so they must finish before we give up.
+                for (; num_written < jobs.len; num_written++) {
+                    wp_wait(pool, num_written);
+                    write_parallel_job(out, jobs.data[num_written],
+                            label_to_cs_bitmap);
+                }
+                wp_dispose(&pool);
+                for (int i = 0; i < opts->num_jobs; i++) {
+                    Arena_dispose(&worker_frag_arenas[i]);
+                }
+                return 1;
+            }
+            job->instr_arena = Arena_new();
+            job->label_to_cs_bitmap = Table_new(0, NULL, NULL);
+            job->worker_frag_arenas = worker_frag_arenas;
+        } else {
+            job->out = out;
+            job->instr_arena = instr_loop_arena;
+            job->label_to_cs_bitmap = label_to_cs_bitmap;
+            job->worker_frag_arenas = &frag_arena;
+        }
+
+        sl_fragment_t* frag = next_frag;
+        if (streaming) {
+            timer = st_begin(ST_PASS_TRANSLATE);
+            frag = translate_function(translate_info, next_decl, next_frame,
+                    job->instr_arena);
+            st_end(&timer);
+            if (!opts->no_simplify) {
+                timer = st_begin(ST_PASS_SIMPLIFY);
+                simplify_fragment(job->instr_arena, frag);
+                st_end(&timer);
+            }
+            timer = st_begin(ST_PASS_CANONICALISE);
+            canonicalise_fragment(job->instr_arena, target, temp_state, frag);
+            st_end(&timer);
+            next_decl = next_decl->dl_list;
+            next_frame = next_frame->acf_link;
+            job->frame_maps = &frame_maps;
+
+            if (cache) {
+                // Only the strings added by this function are new
+                var strings = last_string
+                    ? last_string->fr_list : translate_strings(translate_info);
+                cc_add_strings(cache, strings);
+                for (; strings; strings = strings->fr_list) {
+                    last_string = strings;
+                }
+            }
+        } else {
+            next_frag = frag->fr_list;
         }
-        Table_T label_to_spill_liveness = Table_new(0, NULL, NULL);
+        job->frag = frag;
+        job->stats.stf_name = frag->fr_frame->acf_name;
 
+        timer = st_begin(ST_PASS_CODEGEN);
         assm_instr_t* body_instrs = NULL;
-        fprintf(out, "# %s\n", frag->fr_frame->acf_name); // TODO: remove
+        fprintf(job->out, "# %s\n", frag->fr_frame->acf_name); // TODO: remove
+        if (cache) {
+            // The key must be taken before instruction selection, which
+            // adds to the frame
+            job->cache = cache;
+            job->cache_key = cc_key(cache, frag, job->instr_arena);
+            wr_init(&job->cached_text, NULL);
+            if (cc_lookup(cache, job->cache_key, frag, temp_state,
+                        job->label_to_cs_bitmap, &job->cached_text,
+                        frag_arena)) {
+                job->cache_hit = true;
+                cc_key_dispose(job->cache_key);
+                job->cache_key = NULL;
+                st_end(&timer);
+                goto dispatch;
+            }
+            wr_dispose(&job->cached_text);
+        }
         for (var s = frag->fr_body; s; s = s->tst_list) {
 
-            if (stop_after_instruction_selection) {
+            if (opts->stop_after_instruction_selection) {
                 tree_printf(out, "## %S\n", s);
             }
 
             assm_instr_t* instrs = target->tgt_backend->codegen(
-                    instr_loop_arena, frag_arena, temp_state, frag, s);
-            if (stop_after_instruction_selection) {
+                    job->instr_arena, frag_arena, temp_state, frag, s);
+            if (opts->stop_after_instruction_selection) {
+                writer_t w;
+                wr_init(&w, out);
                 for (var i = instrs; i; i = i->ai_list) {
-                    char buf[128];
-                    assm_format(buf, 128, i, frag->fr_frame->acf_temp_map, target);
-                    fprintf(out, "%s", buf);
+                    assm_format(&w, i, frag->fr_frame->acf_temp_map, target);
                 }
+                wr_dispose(&w);
             }
             body_instrs = assm_list_chain(body_instrs, instrs);
         }
-        if (stop_after_instruction_selection) {
+        st_end(&timer);
+        if (opts->stop_after_instruction_selection) {
             fprintf(out, "\n");
-            goto instr_loop_cleanup; // continue
+            Arena_clear(instr_loop_arena);
+            continue;
         }
         assert(body_instrs);
-        body_instrs = target->tgt_backend->proc_entry_exit_2(
-                frag->fr_frame, body_instrs, instr_loop_arena);
-
-
-        var instrs_and_allocation =
-            ra_alloc(out, temp_state, body_instrs, frag->fr_frame,
-                    stop_after_liveness_analysis, label_to_cs_bitmap,
-                    label_to_spill_liveness, instr_loop_arena,
-                    instr_loop_arena, instr_loop_arena, frag_arena);
-        body_instrs = instrs_and_allocation.ra_instrs;
-        if (stop_after_liveness_analysis) {
-            goto instr_loop_cleanup; // continue
+        job->body_instrs = target->tgt_backend->proc_entry_exit_2(
+                frag->fr_frame, body_instrs, job->instr_arena);
+        if (st_enabled) {
+            for (var i = job->body_instrs; i; i = i->ai_list) {
+                job->stats.stf_instrs++;
+            }
         }
-
-        var final_fragment = target->tgt_backend->proc_entry_exit_3(
-                frag->fr_frame, body_instrs, instr_loop_arena);
-
-        if (!emitted_header) {
-            target->tgt_backend->emit_text_segment_header(out);
-            emitted_header = true;
+        // The temps that the register allocator creates when spilling only
+        // need to be unique within this function. Forking keeps the
+        // numbering the same whether or not we are running in parallel.
+        job->temp_state = temp_state_fork(temp_state, job->instr_arena);
+dispatch:
+        job->stop_after_liveness_analysis = opts->stop_after_liveness_analysis;
+        job->regalloc = opts->regalloc;
+        job->emit_header =
+            !emitted_header && !opts->stop_after_liveness_analysis;
+        emitted_header = emitted_header || job->emit_header;
+
+        if (!pool) {
+            run_backend(job, frag_arena);
+            st_record_function(&job->stats);
+            keep_frame_maps(job);
+            Arena_clear(instr_loop_arena);
+            continue;
         }
 
-        fputs(final_fragment.asf_prologue, out);
-        for (var i = final_fragment.asf_instrs; i; i = i->ai_list) {
-            char buf[128];
-            assm_format(buf, 128, i, instrs_and_allocation.ra_allocation, target);
-            fprintf(out, "%s", buf);
+        arrpush(&jobs, frag_arena, job);
+        int ticket = wp_submit(pool, job);
+        assert(ticket == jobs.len - 1);
+        while (jobs.len - num_written > max_jobs_in_flight) {
+            wp_wait(pool, num_written);
+            write_parallel_job(out, jobs.data[num_written++],
+                    label_to_cs_bitmap);
         }
-        fputs(final_fragment.asf_epilogue, out);
-
-        // peek through upcoming non-code frags
-        // this abuses some knowledge about how they are added
-        for (; frag->fr_list && frag->fr_list->fr_tag != FR_CODE;
-                ) {
-            frag = frag->fr_list;
-            if (frag->fr_tag != FR_FRAME_MAP) {
-                continue;
-            }
-
-            temp_list_t* spill_live_outs =
-                Table_get(label_to_spill_liveness, frag->fr_ret_label);
-            ac_extend_frame_map_for_spills(frag->fr_map, spill_live_outs,
-                    instrs_and_allocation.ra_allocation, frag_arena);
+    }
+    if (pool) {
+        for (; num_written < jobs.len; num_written++) {
+            wp_wait(pool, num_written);
+            write_parallel_job(out, jobs.data[num_written],
+                    label_to_cs_bitmap);
         }
+        wp_dispose(&pool);
+    }
 
-
-        // Free final fragment strings?
-        Table_free(&instrs_and_allocation.ra_allocation);
-instr_loop_cleanup:
-        Table_free(&label_to_spill_liveness);
-        Arena_clear(instr_loop_arena);
+    if (streaming) {
+        assert(!next_frame);
+        fragments = fr_append(translate_strings(translate_info), frame_maps);
+        translate_end(&translate_info);
     }
-    Arena_dispose(&instr_loop_arena);
 
     if (emitted_header) {
+        timer = st_begin(ST_PASS_EMIT);
         target->tgt_backend->emit_data_segment(
                 out, fragments, label_to_cs_bitmap);
+        st_end(&timer);
     }
     Table_free(&label_to_cs_bitmap);
+    if (cache) {
+        cc_dispose(&cache);
+    }
 
-    Arena_dispose(&frag_arena);
+    // The worker arenas hold frame variables for spills and the extended
+    // frame maps, which are needed until the data segment has been emitted.
+    if (worker_frag_arenas) {
+        for (int i = 0; i < opts->num_jobs; i++) {
+            Arena_dispose(&worker_frag_arenas[i]);
+        }
+    }
+    return 0;
+}
+
+static void clear_arenas(compile_arenas_t* arenas)
+{
+    Arena_clear(arenas->ca_instr_loop);
+    Arena_clear(arenas->ca_frag);
+    Arena_clear(arenas->ca_ast);
+}
+
+/*
+ * In batch mode, the output for each input is written into the output
+ * directory, with the same name but with a .s extension in place of .sl
+ */
+static char* batch_output_path(const char* outdir, const char* inarg)
+{
+    const char* base = strrchr(inarg, '/');
+    base = base ? base + 1 : inarg;
+    int base_len = strlen(base);
+    if (base_len > 3 && strcmp(base + base_len - 3, ".sl") == 0) {
+        base_len -= 3;
+    }
+    size_t len = strlen(outdir) + 1 + base_len + strlen(".s") + 1;
+    char* path = xmalloc(len);
+    snprintf(path, len, "%s/%.*s.s", outdir, base_len, base);
+    return path;
+}
+
+typedef struct batch_file {
+    const compile_options_t* opts;
+    const char* inarg;
+    char* outpath;
+    compile_arenas_t* worker_arenas; // indexed by worker
+    int result;
+} batch_file_t;
+
+/*
+ * Inputs with the same name in different directories would be compiled
+ * into the same output, so this reports them before anything is compiled
+ */
+static bool outputs_are_distinct(batch_file_t* files, int num_inputs)
+{
+    bool distinct = true;
+    Table_T by_outpath = Table_new(num_inputs, NULL, NULL);
+    for (int i = 0; i < num_inputs; i++) {
+        const char* outpath = Atom_string(files[i].outpath);
+        batch_file_t* other = Table_put(by_outpath, outpath, &files[i]);
+        if (other) {
+            fprintf(stderr, "'%s' and '%s' would both be compiled into '%s'\n",
+                    other->inarg, files[i].inarg, files[i].outpath);
+            distinct = false;
+        }
+    }
+    Table_free(&by_outpath);
+    return distinct;
+}
+
+static int compile_batch_file(batch_file_t* file, compile_arenas_t* arenas)
+{
+    FILE* out = fopen(file->outpath, "w");
+    if (out == NULL) {
+        perror(file->outpath);
+        return 1;
+    }
+    int result = compile_file(file->opts, file->inarg, out, arenas);
+    // a failed write by the emitter leaves the stream's error set
+    bool write_failed = ferror(out);
+    if (fclose(out) != 0 || write_failed) {
+        perror(file->outpath);
+        result = 1;
+    }
+    clear_arenas(arenas);
+    return result;
+}
+
+static void compile_batch_task(void* task, int worker_idx)
+{
+    batch_file_t* file = task;
+    file->result = compile_batch_file(file, &file->worker_arenas[worker_idx]);
+}
+
+/*
+ * Compiles each of the inputs into outdir. A failure in one file does
+ * not stop the others being compiled.
+ *
+ * With -j, whole files are compiled in parallel instead of functions. The
+ * arenas, and the atoms, are kept from one file to the next so that the
+ * cost of warming them up is only paid once.
+ */
+static int
+compile_batch(const compile_options_t* opts, const char** inargs,
+        int num_inputs, const char* outdir)
+{
+    for (int i = 0; i < num_inputs; i++) {
+        if (strcmp(inargs[i], "-") == 0) {
+            fprintf(stderr, "stdin cannot be read with '--output-dir'\n");
+            return 1;
+        }
+    }
+
+    compile_options_t file_opts = *opts;
+    int num_workers = 1;
+    if (opts->num_jobs > 1 && num_inputs > 1) {
+        num_workers = opts->num_jobs < num_inputs
+            ? opts->num_jobs : num_inputs;
+        file_opts.num_jobs = 1;
+    }
+
+    compile_arenas_t* worker_arenas =
+        xmalloc(num_workers * sizeof *worker_arenas);
+    for (int i = 0; i < num_workers; i++) {
+        worker_arenas[i] = (compile_arenas_t){
+            .ca_ast = Arena_new(),
+            .ca_frag = Arena_new(),
+            .ca_instr_loop = Arena_new(),
+        };
+    }
+    batch_file_t* files = xmalloc(num_inputs * sizeof *files);
+    for (int i = 0; i < num_inputs; i++) {
+        files[i] = (batch_file_t){
+            .opts = &file_opts,
+            .inarg = inargs[i],
+            .outpath = batch_output_path(outdir, inargs[i]),
+            .worker_arenas = worker_arenas,
+        };
+    }
+
+    int result = 0;
+    if (!outputs_are_distinct(files, num_inputs)) {
+        result = 1;
+    } else if (num_workers > 1) {
+        var pool = wp_new(num_workers, compile_batch_task);
+        for (int i = 0; i < num_inputs; i++) {
+            wp_submit(pool, &files[i]);
+        }
+        wp_dispose(&pool);
+    } else {
+        for (int i = 0; i < num_inputs; i++) {
+            files[i].result = compile_batch_file(&files[i], &worker_arenas[0]);
+        }
+    }
+
+    for (int i = 0; i < num_inputs; i++) {
+        if (files[i].result != 0) {
+            result = files[i].result;
+        }
+        free(files[i].outpath);
+    }
+    free(files);
+    for (int i = 0; i < num_workers; i++) {
+        Arena_dispose(&worker_arenas[i].ca_instr_loop);
+        Arena_dispose(&worker_arenas[i].ca_frag);
+        Arena_dispose(&worker_arenas[i].ca_ast);
+    }
+    free(worker_arenas);
+    return result;
+}
+
+bool
+is_test_binary(const char* prog_name)
+{
+    const char* suffix = strrchr(prog_name, '.');
+    return suffix != NULL && (strcmp(suffix, ".test") == 0);
+}
+
+extern int test_main(int argc, char* argv[]);
+
+int main(int argc, char* argv[])
+{
+    if (is_test_binary(argv[0])) {
+        exit(test_main(argc, argv));
+    }
+
+    compile_options_t opts = {
+        .num_jobs = 1,
+        .target = &TARGET_DEFAULT,
+    };
+    const char** inargs = xmalloc(argc * sizeof *inargs);
+    int num_inputs = 0;
+    char* outarg = NULL;
+    const char* outdir = NULL;
+
+    bool optsdone = false;
+    for (int i = 1; i < argc; i++) {
+        if (!optsdone && argv[i][0] == '-' && argv[i][1] != '\0') {
+            if (argv[i][1] == '-') {
+                if (argv[i][2] == '\0') {
+                    optsdone = true;
+                    continue;
+                }
+                // Long options
+                const char* target_opt = "--target=";
+                const size_t target_opt_len = strlen(target_opt);
+                if (strncmp(argv[i], "--target=", target_opt_len) == 0) {
+                    const char* target_value = argv[i] + target_opt_len;
+                    if (strcmp(target_value, "x86_64") == 0) {
+                        opts.target = &target_x86_64;
+                    } else if (strcmp(target_value, "arm64") == 0) {
+                        opts.target = &target_arm64;
+                    } else {
+                        fprintf(stderr, "unknown target: %s\n", target_value);
+                        exit(1);
+                    }
+                } else if (strncmp(argv[i], "--output-dir=",
+                            strlen("--output-dir=")) == 0) {
+                    outdir = argv[i] + strlen("--output-dir=");
+                    if (*outdir == '\0') {
+                        fprintf(stderr,
+                                "argument to '--output-dir' is missing\n");
+                        print_usage_and_exit(1);
+                    }
+                } else if (strncmp(argv[i], "--cache-dir=",
+                            strlen("--cache-dir=")) == 0) {
+                    opts.cache_dir = argv[i] + strlen("--cache-dir=");
+                    if (*opts.cache_dir == '\0') {
+                        fprintf(stderr,
+                                "argument to '--cache-dir' is missing\n");
+                        print_usage_and_exit(1);
+                    }
+                } else if (strncmp(argv[i], "--regalloc=",
+                            strlen("--regalloc=")) == 0) {
+                    const char* name = argv[i] + strlen("--regalloc=");
+                    if (strcmp(name, "graph") == 0) {
+                        opts.regalloc = RA_GRAPH_COLORING;
+                    } else if (strcmp(name, "linear") == 0) {
+                        opts.regalloc = RA_LINEAR_SCAN;
+                    } else if (strcmp(name, "auto") == 0) {
+                        opts.regalloc = RA_AUTO;
+                    } else {
+                        fprintf(stderr, "unknown register allocator: %s\n",
+                                name);
+                        exit(1);
+                    }
+                } else if (strcmp(argv[i], "--stream") == 0) {
+                    opts.streaming = true;
+                } else if (strcmp(argv[i], "--no-simplify") == 0) {
+                    opts.no_simplify = true;
+                } else if (strcmp(argv[i], "--no-inline") == 0) {
+                    opts.no_inline = true;
+                } else if (strcmp(argv[i], "--time-passes") == 0) {
+                    st_enable(stderr, ST_FORMAT_TEXT);
+                } else if (strcmp(argv[i], "--time-passes=json") == 0) {
+                    st_enable(stderr, ST_FORMAT_JSON);
+                } else {
+                    fprintf(stderr, "unknown option: %s\n", argv[i]);
+                    exit(1);
+                }
+                continue;
+            }
+            // Short options
+            for (char* pc = &argv[i][1]; *pc; pc++) {
+                switch (*pc) {
+                    case 'p': opts.parse_only = 1; break;
+                    case 't': opts.stop_after_type_checking = 1; break;
+                    case 'r': opts.stop_after_rewrites = 1; break;
+                    case 'a': opts.stop_after_activation_calculation = 1; break;
+                    case 'T': opts.stop_after_translation = 1; break;
+                    case 'C': opts.stop_after_canonicalisation = 1; break;
+                    case 'i': opts.stop_after_instruction_selection = 1; break;
+                    case 'l': opts.stop_after_liveness_analysis = 1; break;
+                    case 'o':
+                       if (!(i + 1 < argc)) {
+                           fprintf(stderr, "argument to '-o' is missing\n");
+                           print_usage_and_exit(1);
+                       }
+                       if (*(pc + 1)) {
+                           fprintf(stderr, "no short args may follow '-o'\n");
+                           print_usage_and_exit(1);
+                       }
+                       i += 1;
+                       outarg = argv[i];
+                       break;
+                    case 'j':
+                    {
+                       if (!(i + 1 < argc)) {
+                           fprintf(stderr, "argument to '-j' is missing\n");
+                           print_usage_and_exit(1);
+                       }
+                       if (*(pc + 1)) {
+                           fprintf(stderr, "no short args may follow '-j'\n");
+                           print_usage_and_exit(1);
+                       }
+                       i += 1;
+                       char* end = NULL;
+                       long n = strtol(argv[i], &end, 10);
+                       if (*end != '\0' || n < 1 || n > 256) {
+                           fprintf(stderr, "invalid argument to '-j': %s\n",
+                                   argv[i]);
+                           print_usage_and_exit(1);
+                       }
+                       opts.num_jobs = n;
+                       break;
+                    }
+                    // S will become our option to emit assembly and no option
+                    // will mean calling out to the assembler and linker.
+                    case 'S': break;
+                    case 'h': print_usage_and_exit(0);
+                    default: fprintf(stderr, "unknown option '%c'\n", *pc);
+                             print_usage_and_exit(1);
+                }
+            }
+        } else {
+            inargs[num_inputs++] = argv[i];
+        }
+    }
+    if (num_inputs == 0) {
+        print_usage_and_exit(1);
+    }
+    if (outdir) {
+        if (outarg) {
+            fprintf(stderr, "'-o' cannot be used with '--output-dir'\n");
+            print_usage_and_exit(1);
+        }
+        int result = compile_batch(&opts, inargs, num_inputs, outdir);
+        free(inargs);
+        return result;
+    }
+    if (num_inputs > 1) {
+        fprintf(stderr,
+                "'--output-dir' is required to compile more than one file\n");
+        print_usage_and_exit(1);
+    }
+    const char* inarg = inargs[0];
+    free(inargs);
+
+    FILE* out = stdout;
+    if (outarg != NULL && strcmp(outarg, "-") != 0) {
+        out = fopen(outarg, "w");
+        if (out == NULL) {
+            perror(outarg);
+            return 1;
+        }
+    }
+
+    compile_arenas_t arenas = {
+        .ca_ast = Arena_new(),
+        .ca_frag = Arena_new(),
+        .ca_instr_loop = Arena_new(),
+    };
+    int result = compile_file(&opts, inarg, out, &arenas);
+    if (fflush(out) != 0 || ferror(out)) {
+        perror(out == stdout ? "stdout" : outarg);
+        result = 1;
+    }
+    Arena_dispose(&arenas.ca_instr_loop);
+    Arena_dispose(&arenas.ca_frag);
+    Arena_dispose(&arenas.ca_ast);
+    return result;
 }
@@ -1,11 +1,15 @@
 #include "reg_alloc.h"
 #include "liveness.h"
 #include <string.h>
+#include <math.h> // INFINITY
 #include "list.h"
+#include "array.h"
 #include "codegen.h"
 #include "assertions.h"
+#include "stats.h"
 
 #define var __auto_type
+#define NELEMS(A) ((sizeof A) / sizeof A[0])
 
 #define BitsetLen(len) (((len) + 63) / 64)
 #define IsBitSet(x, i) (( (x)[(i)>>6] & (1ULL<<((i)&63)) ) != 0ULL)
@@ -27,58 +31,91 @@ enum worklist_mem : unsigned char {
     WL_COALESCED,
     WL_COLORED,
     WL_SELECT,
+    NUM_WORKLISTS
 };
 
+/*
+ * The move sets. Each move is in exactly one of them.
+ */
+enum move_mem : unsigned char {
+    MV_WORKLIST = 0, // enabled for possible coalescing
+    MV_ACTIVE, // not yet ready for coalescing
+    MV_COALESCED,
+    MV_CONSTRAINED, // source and target interfere
+    MV_FROZEN, // no longer considered for coalescing
+};
+
+/*
+ * A list of moves, by index into the moves array
+ */
+typedef struct move_list_t {
+    int ml_move;
+    struct move_list_t* ml_list;
+} move_list_t;
+
 /*
  * Holds all of our worklists and state, etc for the graph colouring
  * algorithm.
+ *
+ * The node worklists, sets, and stacks are doubly linked lists threaded
+ * through wl_next and wl_prev by node index, so that a node can be taken
+ * out of the middle of one in constant time. Since a node is always in
+ * exactly one of them, worklist[n] says which. Nodes are added at the
+ * front, and the front is what is taken next. The exceptions are the
+ * nodes of temps spilled in an earlier round, which are in none.
  */
 typedef struct reg_alloc_info_t {
 
     const int K; // The number of registers on the machine
 
-    // Node worklists, sets, and stacks
-    lv_node_list_t* precolored; // machine registers, preassigned a colour.
-    lv_node_list_t* initial; // temps, not coloured and not yet processed
-    lv_node_list_t* simplify_worklist; // low-degree non-move-related nodes
-    lv_node_list_t* freeze_worklist; // low degree move-related nodes
-    lv_node_list_t* spill_worklist; // high degree nodes
-    lv_node_list_t* spilled_nodes;
-    lv_node_list_t* coalesced_nodes; // registers that been coalesced. a set
-    lv_node_list_t* colored_nodes;
-    lv_node_list_t* select_stack;
-
-    // Move sets
-    lv_node_pair_list_t* coalesced_moves;
-    lv_node_pair_list_t* constrained_moves;
-    lv_node_pair_list_t* frozen_moves;
-    lv_node_pair_list_t* worklist_moves;
-    lv_node_pair_list_t* active_moves;
+    lv_node_t* nodes; // the nodes, by index
+    int wl_head[NUM_WORKLISTS]; // the first node in each, or -1
+    int* wl_next;
+    int* wl_prev;
+    enum worklist_mem* worklist; // array of worklist membership for node ID
+
+    // The moves of the interference graph, by index, and the set each is in
+    lv_node_pair_t** moves;
+    enum move_mem* move_set;
+    // worklist_moves is a stack threaded through move_next
+    int worklist_moves; // the first move, or -1
+    int* move_next;
+    // when each move in active_moves was made active. a later move has a
+    // larger stamp
+    int* active_stamp;
+    int next_active_stamp;
+    int* move_buf; // scratch space for enable_moves_node
 
     int* degree; // an array containing the degree of each node.
+    double* spill_cost; // of each node, see compute_spill_costs
+    // The nodes from here on are of temps made by spilling
+    size_t first_spill_node;
     int* color; // colours assigned to the node with ID idx;
     lv_node_list_t** adj_list; // a list of non-precoloured adjacents
     // an array mapping each node to the list of moves it is associated with
-    lv_node_pair_list_t** move_list;
-    Table_T alias; // lv_node_t* -> lv_node_t*
+    move_list_t** move_list;
+    // for a coalesced node, the node it was coalesced into. get_alias
+    // compresses the paths
+    int* alias;
 
-    enum worklist_mem* worklist; // array of worklist membership for node ID
+    // for conservative_adj: the nodes marked with the current generation
+    // have been seen
+    int* seen;
+    int seen_gen;
 
     lv_flowgraph_t* flowgraph;
     lv_igraph_t* interference;
+    // the edges added to the interference graph by coalescing, latest
+    // first, to be removed before the graph is used again
+    lv_node_pair_list_t* added_edges;
 
     Arena_T scratch; // deallocated at end of ra_color
 
 } reg_alloc_info_t;
 
-static_assert(
-        offsetof(reg_alloc_info_t, precolored) + (WL_SELECT * sizeof(void*)) ==
-        offsetof(reg_alloc_info_t, select_stack),
-        "offsetof(..., select_stack)");
-
 static temp_t* temp_for_node(reg_alloc_info_t* info, lv_node_t* node)
 {
-    temp_t* result = Table_get(info->interference->lvig_gtemp, node);
+    temp_t* result = lv_node_temp(info->interference, node);
     assert(result);
     return result;
 }
@@ -104,98 +141,111 @@ static void print_ok_colors(reg_alloc_info_t* info, uint64_t* ok_colors)
     fprintf(stderr, "]\n");
 }
 
-/*static*/ void
-print_node_list(reg_alloc_info_t* info, lv_node_list_t* node_list)
+/*
+ * The first node in the worklist, or NULL when it is empty
+ */
+static lv_node_t*
+worklist_first(reg_alloc_info_t* info, enum worklist_mem wl)
 {
-    fprintf(stderr, "[");
-    for (var w = node_list; w; w = w->nl_list) {
-        temp_t* t = temp_for_node(info, w->nl_node);
-        fprintf(stderr, " %d.%d,", t->temp_id, t->temp_size);
-    }
-    fprintf(stderr, "]\n");
+    int i = info->wl_head[wl];
+    return (i < 0) ? NULL : &info->nodes[i];
 }
 
 /*
- * node_list_remove removes the list cell from the worklist, for the
- * node. it then returns it to the caller.
+ * The node after node in its worklist, or NULL
  */
-static lv_node_list_t*
-node_list_remove(lv_node_list_t** pworklist, const lv_node_t* node)
+static lv_node_t*
+worklist_next(reg_alloc_info_t* info, const lv_node_t* node)
 {
-    var p = pworklist;
-    for (; *p; p = &((*p)->nl_list)) {
-        if (lv_eq((*p)->nl_node, node)) {
+    int i = info->wl_next[node->lvn_idx];
+    return (i < 0) ? NULL : &info->nodes[i];
+}
 
-            var found = *p;
-            // unchain the cell we found
-            *p = found->nl_list;
-            // for sanity, ensure our cell is detached
-            found->nl_list = NULL;
-            return found;
-        }
+/*static*/ void
+print_node_list(reg_alloc_info_t* info, enum worklist_mem wl)
+{
+    fprintf(stderr, "[");
+    for (var n = worklist_first(info, wl); n; n = worklist_next(info, n)) {
+        temp_t* t = temp_for_node(info, n);
+        fprintf(stderr, " %d.%d,", t->temp_id, t->temp_size);
     }
-    assert(!"not found");
+    fprintf(stderr, "]\n");
 }
 
-static void
-node_list_prepend(lv_node_list_t** pworklist, lv_node_list_t* cell)
+static int
+worklist_length(reg_alloc_info_t* info, enum worklist_mem wl)
 {
-    cell->nl_list = *pworklist;
-    *pworklist = cell;
+    int len = 0;
+    for (var n = worklist_first(info, wl); n; n = worklist_next(info, n)) {
+        len += 1;
+    }
+    return len;
 }
 
 static void
 worklist_prepend(
-        reg_alloc_info_t* info, enum worklist_mem wl, lv_node_list_t* cell)
+        reg_alloc_info_t* info, enum worklist_mem wl, const lv_node_t* node)
 {
-    // This will make refactoring harder...
-    lv_node_list_t** pnl =
-        (lv_node_list_t**)(
-                    (char*)info
-                    + offsetof(reg_alloc_info_t, precolored)
-                    + (wl * sizeof(void*)));
-    node_list_prepend(pnl, cell);
-    info->worklist[cell->nl_node->lvn_idx] = wl;
+    int i = node->lvn_idx;
+    int head = info->wl_head[wl];
+    info->wl_prev[i] = -1;
+    info->wl_next[i] = head;
+    if (head >= 0) {
+        info->wl_prev[head] = i;
+    }
+    info->wl_head[wl] = i;
+    info->worklist[i] = wl;
 }
 
-static bool
-worklist_contains(
+/*
+ * worklist_remove unlinks node from the worklist wl, which it must be in.
+ */
+static void
+worklist_remove(
         reg_alloc_info_t* info, enum worklist_mem wl, const lv_node_t* node)
 {
-    return info->worklist[node->lvn_idx] == wl;
+    int i = node->lvn_idx;
+    assert(info->worklist[i] == wl);
+    int prev = info->wl_prev[i];
+    int next = info->wl_next[i];
+    if (prev >= 0) {
+        info->wl_next[prev] = next;
+    } else {
+        info->wl_head[wl] = next;
+    }
+    if (next >= 0) {
+        info->wl_prev[next] = prev;
+    }
 }
 
+/*
+ * Moves node from the worklist from to the front of the worklist to
+ */
+static void
+worklist_move(
+        reg_alloc_info_t* info, const lv_node_t* node,
+        enum worklist_mem from, enum worklist_mem to)
+{
+    worklist_remove(info, from, node);
+    worklist_prepend(info, to, node);
+}
 
 static bool
-node_pair_list_contains(const lv_node_pair_list_t* haystack, const lv_node_pair_t* node_pair)
+worklist_contains(
+        reg_alloc_info_t* info, enum worklist_mem wl, const lv_node_t* node)
 {
-    for (var h = haystack; h; h = h->npl_list) {
-        if (lv_node_pair_eq(h->npl_node, node_pair)) {
-            return true;
-        }
-    }
-    return false;
+    return info->worklist[node->lvn_idx] == wl;
 }
 
 /*
- * similar to node_list_remove but for pair list
+ * Pushes the move onto the front of worklist_moves
  */
-static lv_node_pair_list_t*
-node_pair_list_remove(lv_node_pair_list_t** pworklist, const lv_node_pair_t* pair)
+static void
+move_worklist_push(reg_alloc_info_t* info, int m)
 {
-    var p = pworklist;
-    for (; *p; p = &((*p)->npl_list)) {
-        if (lv_node_pair_eq((*p)->npl_node, pair)) {
-
-            var found = *p;
-            // unchain the cell we found
-            *p = found->npl_list;
-            // for sanity, ensure our cell is detached
-            found->npl_list = NULL;
-            return found;
-        }
-    }
-    assert(!"not found");
+    info->move_set[m] = MV_WORKLIST;
+    info->move_next[m] = info->worklist_moves;
+    info->worklist_moves = m;
 }
 
 /*
@@ -212,22 +262,6 @@ static unsigned hashtemp(const void* key)
     const temp_t* k = key;
     return k->temp_id;
 }
-/*
- * For Tables using nodes as keys
- */
-static int cmpnode(const void* x, const void* y)
-{
-    if (lv_eq(x, y)) {
-        return 0;
-    }
-    return 1;
-}
-static unsigned hashnode(const void* key)
-{
-    const lv_node_t* k = key;
-    return k->lvn_idx;
-}
-
 static bool
 temp_eq(temp_t a, temp_t b)
 {
@@ -289,12 +323,18 @@ get_degree(reg_alloc_info_t* info, lv_node_t* n)
 static lv_node_t*
 get_alias(reg_alloc_info_t* info, lv_node_t* n)
 {
-    if (worklist_contains(info, WL_COALESCED, n)) {
-        var alias = Table_get(info->alias, n);
-        assert(alias);
-        return get_alias(info, alias);
-    }
-    return n;
+    int root = n->lvn_idx;
+    while (info->worklist[root] == WL_COALESCED) {
+        root = info->alias[root];
+    }
+    // Point everything on the way directly at the root, so that the next
+    // lookup is quicker
+    for (int i = n->lvn_idx; i != root; ) {
+        int next = info->alias[i];
+        info->alias[i] = root;
+        i = next;
+    }
+    return &info->nodes[root];
 }
 
 static void
@@ -302,9 +342,10 @@ print_coalesced_nodes(reg_alloc_info_t* info)
 {
 
     fprintf(stderr, "coalesced_nodes = [");
-    for (var w = info->coalesced_nodes; w; w = w->nl_list) {
-        temp_t* t = temp_for_node(info, w->nl_node);
-        var alias_node = get_alias(info, w->nl_node);
+    for (var n = worklist_first(info, WL_COALESCED); n;
+            n = worklist_next(info, n)) {
+        temp_t* t = temp_for_node(info, n);
+        var alias_node = get_alias(info, n);
         temp_t* alias = temp_for_node(info, alias_node);
         fprintf(stderr, " %d.%d -> %d.%d,",
                 t->temp_id, t->temp_size,
@@ -313,9 +354,22 @@ print_coalesced_nodes(reg_alloc_info_t* info)
     fprintf(stderr, "]\n");
 }
 
+/*
+ * Whether the move is in active_moves or worklist_moves
+ */
+static bool
+is_move_unprocessed(reg_alloc_info_t* info, int m)
+{
+    return info->move_set[m] == MV_ACTIVE
+        || info->move_set[m] == MV_WORKLIST;
+}
+
+/*
+ * An iterator for moveList[n] ∩ (activeMoves ∪ worklistMoves)
+ */
 typedef struct node_move_it {
     reg_alloc_info_t* info;
-    lv_node_pair_list_t* next;
+    move_list_t* next;
 } node_move_it_t;
 
 static void
@@ -325,28 +379,21 @@ node_move_it_init(node_move_it_t* it, reg_alloc_info_t* info, lv_node_t* node)
     it->next = info->move_list[node->lvn_idx];
 }
 
-static lv_node_pair_t*
+/*
+ * Returns the index of the next move, or -1
+ */
+static int
 node_move_it_next(node_move_it_t* it)
 {
     for (;it->next; ) {
-        var nln = it->next;
-        it->next = it->next->npl_list; /* prepare for next iteration in advance */
+        var mln = it->next;
+        it->next = it->next->ml_list; /* prepare for next iteration in advance */
 
-        var m = nln->npl_node;
-        if (node_pair_list_contains(it->info->active_moves, m)
-                || node_pair_list_contains(it->info->worklist_moves, m)) {
-            return m;
+        if (is_move_unprocessed(it->info, mln->ml_move)) {
+            return mln->ml_move;
         }
     }
-    return NULL;
-}
-
-
-static lv_node_pair_list_t*
-node_moves(reg_alloc_info_t* info, lv_node_t* node)
-{
-    // moveList[n] ∩ (activeMoves ∪ worklistMoves)
-    assert(!"TODO");
+    return -1;
 }
 
 /*
@@ -355,17 +402,9 @@ node_moves(reg_alloc_info_t* info, lv_node_t* node)
 static bool
 is_move_related(reg_alloc_info_t* info, lv_node_t* node)
 {
-    // TODO: it might be quicker to simply iterate through the
-    // active and worklist and see if node is the src or dst
-
     node_move_it_t it = {};
     node_move_it_init(&it, info, node);
-    var m = node_move_it_next(&it);
-    return m != NULL;
-
-    // This is implementation from the book, but it does not think about
-    // memory.
-    return node_moves(info, node) != NULL;
+    return node_move_it_next(&it) >= 0;
 }
 
 /*
@@ -412,32 +451,40 @@ enable_moves_node(reg_alloc_info_t* info, lv_node_t* node)
     //     move m from activeMoves to worklistMoves
 
     /*
-     * step through the active_moves and move nodes to worklist_moves
-     * if they relate to our node
+     * Every move with the alias as its source or target is in the alias's
+     * move_list. We pick out the active ones...
      */
     lv_node_t* alias = get_alias(info, node);
-    lv_node_pair_list_t** p = &info->active_moves;
-    for (; *p; ) {
-        lv_node_pair_t* np = (*p)->npl_node;
-        if (lv_eq(np->np_node0, alias) || lv_eq(np->np_node1, alias)) {
-
-            var found = *p;
-            // unchain from active_moves cell
-            *p = found->npl_list;
-
-            // stick onto the front of worklist_moves
-            found->npl_list = info->worklist_moves;
-            info->worklist_moves = found;
-
-            // in this case we have already changed what *p is to be the
-            // next item in active_moves, so we don't execute what
-            // would usually be the iteration statement of the for loop.
-            // (i.e. what you see in the else).
-        } else {
-            // adjust p to point to the next cell in the active_moves list
-            p = &((*p)->npl_list);
+    int* found = info->move_buf;
+    int num_found = 0;
+    for (var ml = info->move_list[alias->lvn_idx]; ml; ml = ml->ml_list) {
+        int m = ml->ml_move;
+        lv_node_pair_t* np = info->moves[m];
+        if (info->move_set[m] == MV_ACTIVE
+                && (lv_eq(np->np_node0, alias) || lv_eq(np->np_node1, alias))) {
+            // so that a move that is in the list twice is only found once
+            info->move_set[m] = MV_WORKLIST;
+            found[num_found++] = m;
         }
     }
+
+    /*
+     * ... and push them onto worklist_moves latest activated first, which
+     * is the order they would be met in walking a list of active_moves.
+     * There are seldom more than a handful.
+     */
+    var stamp = info->active_stamp;
+    for (int i = 1; i < num_found; i++) {
+        int m = found[i];
+        int j = i;
+        for (; j > 0 && stamp[found[j - 1]] < stamp[m]; j--) {
+            found[j] = found[j - 1];
+        }
+        found[j] = m;
+    }
+    for (int i = 0; i < num_found; i++) {
+        move_worklist_push(info, found[i]);
+    }
 }
 
 /*
@@ -477,11 +524,10 @@ decrement_degree(reg_alloc_info_t* info, lv_node_t* m)
             return;
         }
 
-        var m_cell = node_list_remove(&info->spill_worklist, m);
-        if (is_move_related(info, m_cell->nl_node)) {
-            worklist_prepend(info, WL_FREEZE, m_cell);
+        if (is_move_related(info, m)) {
+            worklist_move(info, m, WL_SPILL, WL_FREEZE);
         } else {
-            worklist_prepend(info, WL_SIMPLIFY, m_cell);
+            worklist_move(info, m, WL_SPILL, WL_SIMPLIFY);
         }
     }
 }
@@ -494,17 +540,11 @@ decrement_degree(reg_alloc_info_t* info, lv_node_t* m)
 static void
 simplify(reg_alloc_info_t* info)
 {
-    // Remove node from simplify_worklist
-    // We take the first cell of the list and cons
-    // it onto the selectStack instead of actually pulling out the node
-    assert(info->simplify_worklist != NULL);
+    var n = worklist_first(info, WL_SIMPLIFY);
+    assert(n != NULL);
 
-    // remove from simplify_worklist
-    var n = info->simplify_worklist->nl_node;
-    var n_cell = node_list_remove(&info->simplify_worklist, n);
-
-    // push onto the select_stack
-    worklist_prepend(info, WL_SELECT, n_cell);
+    // remove from simplify_worklist and push onto the select_stack
+    worklist_move(info, n, WL_SIMPLIFY, WL_SELECT);
 
     adj_it_t it = {};
     adj_it_init(&it, info, n);
@@ -544,14 +584,15 @@ all_adjacent_ok(reg_alloc_info_t* info, lv_node_t* u, lv_node_t* v)
 static bool
 conservative_adj(reg_alloc_info_t* info, lv_node_t* u, lv_node_t* v)
 {
-    // TODO: consider some sort of arena checkpoint and restore
-    nodeset_t* seen = NULL;
+    // The adjacent nodes of u are marked with a new generation, so that
+    // nothing needs clearing between calls
+    int gen = ++info->seen_gen;
     int k = 0;
 
     adj_it_t it = {};
     adj_it_init(&it, info, u);
     for (var n = adj_it_next(&it); n; n = adj_it_next(&it)) {
-        nodeset_upsert(&seen, n, info->scratch);
+        info->seen[n->lvn_idx] = gen;
         if (info->degree[n->lvn_idx] >= info->K) {
             k += 1;
         }
@@ -559,7 +600,7 @@ conservative_adj(reg_alloc_info_t* info, lv_node_t* u, lv_node_t* v)
 
     adj_it_init(&it, info, v);
     for (var n = adj_it_next(&it); n; n = adj_it_next(&it)) {
-        if (!nodeset_ismember(seen, n)) {
+        if (info->seen[n->lvn_idx] != gen) {
             if (info->degree[n->lvn_idx] >= info->K) {
                 k += 1;
             }
@@ -576,8 +617,7 @@ add_work_list(reg_alloc_info_t* info, lv_node_t* u)
             && !is_move_related(info, u)
             && info->degree[u->lvn_idx] < info->K)
     {
-        var u_cell = node_list_remove(&info->freeze_worklist, u);
-        worklist_prepend(info, WL_SIMPLIFY, u_cell);
+        worklist_move(info, u, WL_FREEZE, WL_SIMPLIFY);
     }
 }
 
@@ -600,6 +640,9 @@ add_edge(reg_alloc_info_t* info, lv_node_t* u, lv_node_t* v)
 {
     if (!lv_is_adj(u, v) && !lv_eq(u, v)) {
         lv_mk_edge(u, v);
+        info->added_edges = lv_node_pair_cons(
+                lv_node_pair(u, v, info->scratch), info->added_edges,
+                info->scratch);
         if (!worklist_contains(info, WL_PRECOLORED, u)) {
             add_edge_helper(info, u, v);
         }
@@ -612,25 +655,24 @@ add_edge(reg_alloc_info_t* info, lv_node_t* u, lv_node_t* v)
 static void
 combine(reg_alloc_info_t* info, lv_node_t* u, lv_node_t* v)
 {
-    lv_node_list_t* v_cell;
     if (worklist_contains(info, WL_FREEZE, v)) {
-        v_cell = node_list_remove(&info->freeze_worklist, v);
+        worklist_move(info, v, WL_FREEZE, WL_COALESCED);
     } else {
-        v_cell = node_list_remove(&info->spill_worklist, v);
+        worklist_move(info, v, WL_SPILL, WL_COALESCED);
     }
 
-    worklist_prepend(info, WL_COALESCED, v_cell);
-
-    Table_put(info->alias, v, u);
+    info->alias[v->lvn_idx] = u->lvn_idx;
 
     // The text in the move has some errata:
     // https://www.cs.princeton.edu/~appel/modern/ml/errata99.html p248
 
     // Combine v's move_list into u's
-    for (var m = info->move_list[v->lvn_idx]; m; m = m->npl_list) {
-        info->move_list[u->lvn_idx] =
-            list_cons(m->npl_node,
-                    info->move_list[u->lvn_idx], info->scratch);
+    for (var m = info->move_list[v->lvn_idx]; m; m = m->ml_list) {
+        move_list_t* cell = Arena_alloc(
+                info->scratch, sizeof *cell, __FILE__, __LINE__);
+        cell->ml_move = m->ml_move;
+        cell->ml_list = info->move_list[u->lvn_idx];
+        info->move_list[u->lvn_idx] = cell;
     }
     enable_moves_node(info, v);
 
@@ -644,8 +686,7 @@ combine(reg_alloc_info_t* info, lv_node_t* u, lv_node_t* v)
 
     if (info->degree[u->lvn_idx] >= info->K
             && worklist_contains(info, WL_FREEZE, u)) {
-        var u_cell = node_list_remove(&info->freeze_worklist, u);
-        worklist_prepend(info, WL_SPILL, u_cell);
+        worklist_move(info, u, WL_FREEZE, WL_SPILL);
     }
 }
 
@@ -657,11 +698,11 @@ combine(reg_alloc_info_t* info, lv_node_t* u, lv_node_t* v)
 static void
 coalesce(reg_alloc_info_t* info)
 {
-    assert(info->worklist_moves != NULL);
-    var m_cell = info->worklist_moves;
+    int m = info->worklist_moves;
+    assert(m >= 0);
 
-    lv_node_t* x = get_alias(info, m_cell->npl_node->np_node0);
-    lv_node_t* y = get_alias(info, m_cell->npl_node->np_node1);
+    lv_node_t* x = get_alias(info, info->moves[m]->np_node0);
+    lv_node_t* y = get_alias(info, info->moves[m]->np_node1);
 
     lv_node_t *u, *v;
     if (worklist_contains(info, WL_PRECOLORED, y)) {
@@ -671,16 +712,13 @@ coalesce(reg_alloc_info_t* info)
     }
 
     // remove from worklist_moves
-    info->worklist_moves = info->worklist_moves->npl_list;
+    info->worklist_moves = info->move_next[m];
 
     if (lv_eq(u, v)) {
-        // add to coalesced_moves
-        m_cell->npl_list = info->coalesced_moves;
-        info->coalesced_moves = m_cell;
+        info->move_set[m] = MV_COALESCED;
         add_work_list(info, u);
     } else if (worklist_contains(info, WL_PRECOLORED, v) || lv_is_adj(u, v)) {
-        m_cell->npl_list = info->constrained_moves;
-        info->constrained_moves = m_cell;
+        info->move_set[m] = MV_CONSTRAINED;
         add_work_list(info, u);
         add_work_list(info, v);
     } else {
@@ -688,15 +726,12 @@ coalesce(reg_alloc_info_t* info)
         if ((is_u_precolored && all_adjacent_ok(info, u, v))
                 || (!is_u_precolored && conservative_adj(info, u, v))) {
 
-            // add to coalesced_moves
-            m_cell->npl_list = info->coalesced_moves;
-            info->coalesced_moves = m_cell;
+            info->move_set[m] = MV_COALESCED;
             combine(info, u, v);
             add_work_list(info, u);
         } else {
-            // add to active_moves
-            m_cell->npl_list = info->active_moves;
-            info->active_moves = m_cell;
+            info->move_set[m] = MV_ACTIVE;
+            info->active_stamp[m] = info->next_active_stamp++;
         }
     }
 }
@@ -707,9 +742,9 @@ freeze_moves(reg_alloc_info_t* info, lv_node_t* u)
 {
     node_move_it_t it = {};
     node_move_it_init(&it, info, u);
-    for (var m = node_move_it_next(&it); m; m = node_move_it_next(&it)) {
-        lv_node_t* x = get_alias(info, m->np_node0);
-        lv_node_t* y = get_alias(info, m->np_node1);
+    for (int m = node_move_it_next(&it); m >= 0; m = node_move_it_next(&it)) {
+        lv_node_t* x = get_alias(info, info->moves[m]->np_node0);
+        lv_node_t* y = get_alias(info, info->moves[m]->np_node1);
 
         lv_node_t* v;
         if (lv_eq(get_alias(info, y), get_alias(info, u))) {
@@ -718,15 +753,14 @@ freeze_moves(reg_alloc_info_t* info, lv_node_t* u)
             v = get_alias(info, y);
         }
 
-        var m_cell = node_pair_list_remove(&info->active_moves, m);
-        m_cell->npl_list = info->frozen_moves;
-        info->frozen_moves = m_cell;
+        // We only freeze once worklist_moves is empty
+        assert(info->move_set[m] == MV_ACTIVE);
+        info->move_set[m] = MV_FROZEN;
 
         if (!is_move_related(info, v) && get_degree(info, v) < info->K) {
 
             if (worklist_contains(info, WL_FREEZE, v)) {
-                var v_cell = node_list_remove(&info->freeze_worklist, v);
-                worklist_prepend(info, WL_SIMPLIFY, v_cell);
+                worklist_move(info, v, WL_FREEZE, WL_SIMPLIFY);
             }
 
         }
@@ -740,44 +774,52 @@ freeze_moves(reg_alloc_info_t* info, lv_node_t* u)
 static void
 freeze(reg_alloc_info_t* info)
 {
-    var u = info->freeze_worklist->nl_node;
-    var u_cell = node_list_remove(&info->freeze_worklist, u);
-    worklist_prepend(info, WL_SIMPLIFY, u_cell);
+    var u = worklist_first(info, WL_FREEZE);
+    worklist_move(info, u, WL_FREEZE, WL_SIMPLIFY);
     freeze_moves(info, u);
 }
 
 
 /*
- * We use a spill cost that is the number of uses and defs in the flow
- * graph.
+ * The spill cost of a node is the number of uses and defs of its temp in
+ * the flow graph, each weighted by 10 to the power of the depth of the
+ * loops it is in, since those are the ones that will be run the most.
+ * The temps made by spilling live for only an instruction or so, and to
+ * spill them again would free nothing, so they are never chosen.
  */
-static int
-spill_cost(
-        reg_alloc_info_t* info,
-        lv_node_t* node)
+static void
+compute_spill_costs(reg_alloc_info_t* info)
 {
-    temp_t t = *temp_for_node(info, node);
-    int cost = 0;
-
     var flow = info->flowgraph;
+    int* loop_depths = lv_loop_depths(flow, info->scratch);
+
     for (var it = lv_nodes(flow->lvfg_control); lv_node_it_next(&it); ) {
         var node = &it.lvni_node;
-        temp_list_t* use_n = nt_get(flow->lvfg_use, node);
-        for (var u = use_n; u; u = u->tmp_list) {
-            if (u->tmp_temp.temp_id == t.temp_id) {
-                cost += 1;
-                break;
-            }
+        double weight = 1;
+        for (int d = 0; d < loop_depths[node->lvn_idx]; d++) {
+            weight *= 10;
         }
-        temp_list_t* def_n = nt_get(flow->lvfg_def, node);
-        for (var d = def_n; d; d = d->tmp_list) {
-            if (d->tmp_temp.temp_id == t.temp_id) {
-                cost += 1;
-                break;
+        temp_list_t* lists[] = {
+            nt_get(flow->lvfg_use, node),
+            nt_get(flow->lvfg_def, node),
+        };
+        for (int i = 0; i < NELEMS(lists); i++) {
+            for (var t = lists[i]; t; t = t->tmp_list) {
+                // The lists are sorted, so a repeated temp is counted once
+                var next = t->tmp_list;
+                if (next && next->tmp_temp.temp_id == t->tmp_temp.temp_id) {
+                    continue;
+                }
+                lv_node_t* t_node =
+                    lv_temp_node(info->interference, t->tmp_temp);
+                info->spill_cost[t_node->lvn_idx] += weight;
             }
         }
     }
-    return cost;
+    size_t count_nodes = lv_graph_length(info->interference->lvig_graph);
+    for (size_t i = info->first_spill_node; i < count_nodes; i++) {
+        info->spill_cost[i] = INFINITY;
+    }
 }
 
 
@@ -790,19 +832,20 @@ select_spill(
     // 3. push m onto simplify_worklist
     // 4. freeze moves
 
-    // Find the node with the least spill cost
-    var m = info->spill_worklist->nl_node;
-    var cost = spill_cost(info, m);
-    for (var c = info->spill_worklist->nl_list; c; c = c->nl_list) {
-        var this_cost = spill_cost(info, c->nl_node);
+    // Find the node that is cheapest to spill for the most interference
+    // it removes
+    var m = worklist_first(info, WL_SPILL);
+    var cost = info->spill_cost[m->lvn_idx] / info->degree[m->lvn_idx];
+    for (var c = worklist_next(info, m); c; c = worklist_next(info, c)) {
+        var this_cost =
+            info->spill_cost[c->lvn_idx] / info->degree[c->lvn_idx];
         if (this_cost < cost) {
             cost = this_cost;
-            m = c->nl_node;
+            m = c;
         }
     }
 
-    var m_cell = node_list_remove(&info->spill_worklist, m);
-    worklist_prepend(info, WL_SIMPLIFY, m_cell);
+    worklist_move(info, m, WL_SPILL, WL_SIMPLIFY);
 
     freeze_moves(info, m);
 }
@@ -811,10 +854,9 @@ select_spill(
 static void
 assign_colors(reg_alloc_info_t* info)
 {
-    while (info->select_stack != NULL) {
+    for (lv_node_t* node; (node = worklist_first(info, WL_SELECT)); ) {
         // pop n from select_stack
-        var node = info->select_stack->nl_node;
-        var n_cell = node_list_remove(&info->select_stack, node);
+        worklist_remove(info, WL_SELECT, node);
 
         assert(info->K <= 64);
         uint64_t _ok_colors = 0;
@@ -844,10 +886,10 @@ assign_colors(reg_alloc_info_t* info)
         // If we have no remaining colours, spill.
         if (__builtin_popcountll(_ok_colors) == 0) {
             if (debug) { fprintf(stderr, "spill\n"); }
-            worklist_prepend(info, WL_SPILLED, n_cell);
+            worklist_prepend(info, WL_SPILLED, node);
         } else {
             // add n to coloured nodes
-            worklist_prepend(info, WL_COLORED, n_cell);
+            worklist_prepend(info, WL_COLORED, node);
 
             // store the new first available colour for n
             int new_color = __builtin_ctzll(_ok_colors);
@@ -856,8 +898,8 @@ assign_colors(reg_alloc_info_t* info)
         }
     }
 
-    for (var n = info->coalesced_nodes; n; n = n->nl_list) {
-        var node = n->nl_node;
+    for (var node = worklist_first(info, WL_COALESCED); node;
+            node = worklist_next(info, node)) {
         var alias = get_alias(info, node);
         info->color[node->lvn_idx] = info->color[alias->lvn_idx];
     }
@@ -867,8 +909,9 @@ assign_colors(reg_alloc_info_t* info)
 static void
 debug_print_degrees(reg_alloc_info_t* info, int count_nodes)
 {
-    fprintf(stderr, "len(precolored) = %d\n", list_length(info->precolored));
-    fprintf(stderr, "len(initial) = %d\n", list_length(info->initial));
+    fprintf(stderr, "len(precolored) = %d\n",
+            worklist_length(info, WL_PRECOLORED));
+    fprintf(stderr, "len(initial) = %d\n", worklist_length(info, WL_INITIAL));
 
     fprintf(stderr, "degree = [");
     for (int i = 0; i < count_nodes; i++) {
@@ -886,14 +929,12 @@ check_invariants(reg_alloc_info_t* info)
     //  degree(u) = |adj_list(u) ∩ (precolored ∪ simplify_worklist
     //                              ∪ freeze_worklist ∪ spill_worklist)|
 
-    lv_node_list_t* worklists[] = {
-        info->simplify_worklist, info->freeze_worklist, info->spill_worklist
-    };
-    const int n = sizeof worklists / sizeof(void*);
+    enum worklist_mem worklists[] = {WL_SIMPLIFY, WL_FREEZE, WL_SPILL};
+    const int n = NELEMS(worklists);
 
     for (int i = 0; i < n; i++) {
-        for (var u_cell = worklists[i]; u_cell; u_cell = u_cell->nl_list) {
-            var u = u_cell->nl_node;
+        for (var u = worklist_first(info, worklists[i]); u;
+                u = worklist_next(info, u)) {
             var d = info->degree[u->lvn_idx];
 
             int num_adj = 0;
@@ -910,8 +951,8 @@ check_invariants(reg_alloc_info_t* info)
     // Simplify worklist invariant:
     // u ∈ simplify_worklist ⇒
     //  degree(u) < K ∧ move_list[u] ∩ (active_moves ∪ worklist_moves) = ø
-    for (var u_cell = info->simplify_worklist; u_cell; u_cell = u_cell->nl_list) {
-        var u = u_cell->nl_node;
+    for (var u = worklist_first(info, WL_SIMPLIFY); u;
+            u = worklist_next(info, u)) {
         assert(info->degree[u->lvn_idx] < info->K || !is_move_related(info, u));
     }
 
@@ -919,16 +960,16 @@ check_invariants(reg_alloc_info_t* info)
     // u ∈ freeze_worklist ⇒
     //  degree(u) < K ∧ move_list[u] ∩ (active_moves ∪ worklist_moves) ≠ ø
 
-    for (var u_cell = info->freeze_worklist; u_cell; u_cell = u_cell->nl_list) {
-        var u = u_cell->nl_node;
+    for (var u = worklist_first(info, WL_FREEZE); u;
+            u = worklist_next(info, u)) {
         assert(info->degree[u->lvn_idx] < info->K || is_move_related(info, u));
     }
 
     // Spill worklist invariant:
     // u ∈ spill_worklist ⇒ degree(u) ≥ K
 
-    for (var u_cell = info->spill_worklist; u_cell; u_cell = u_cell->nl_list) {
-        var u = u_cell->nl_node;
+    for (var u = worklist_first(info, WL_SPILL); u;
+            u = worklist_next(info, u)) {
         assert(info->degree[u->lvn_idx] >= info->K);
     }
 }
@@ -936,12 +977,13 @@ check_invariants(reg_alloc_info_t* info)
 
 static
 struct ra_color_result {
-    Table_T racr_allocation; // temp_t* -> register (char*)
+    temp_map_t racr_allocation;
     temp_list_t* racr_spills; // a list of spills
 } ra_color(
     lv_igraph_t* interference,
+    size_t first_spill_node, // the nodes of temps made by spilling follow
     lv_flowgraph_t* flowgraph,
-    Table_T initial_allocation, // temp_t* -> register (char*)
+    temp_map_t initial_allocation, // the machine registers
     /* registers is just a list of all machine registers */
     const char* registers[],
     Arena_T ar_spills,
@@ -950,44 +992,65 @@ struct ra_color_result {
 {
     // Prepare
     reg_alloc_info_t info = {
-        .K = Table_length(initial_allocation),
+        .K = initial_allocation.tm_len,
         .flowgraph = flowgraph,
         .interference = interference,
+        .first_spill_node = first_spill_node,
         .scratch = Arena_new(),
     };
 #define Salloc(nbytes) Arena_alloc(info.scratch, nbytes, __FILE__, __LINE__)
 
-    var count_nodes = Table_length(interference->lvig_gtemp);
+    var count_nodes = lv_graph_length(interference->lvig_graph);
+    int count_moves = 0;
+    for (var m = interference->lvig_moves; m; m = m->npl_list) {
+        count_moves += 1;
+    }
     // Attention: all pointers to nodes which are stored, must be pointers
     // into this nodes array to avoid dangles / observed mutation
     lv_node_t* nodes = Salloc(count_nodes * sizeof *nodes);
     for (var it = lv_nodes(interference->lvig_graph); lv_node_it_next(&it); ) {
         nodes[it.lvni_node.lvn_idx] = it.lvni_node;
     }
+    info.nodes = nodes;
+    for (int i = 0; i < NUM_WORKLISTS; i++) {
+        info.wl_head[i] = -1;
+    }
+    info.wl_next = Salloc(count_nodes * sizeof *info.wl_next);
+    info.wl_prev = Salloc(count_nodes * sizeof *info.wl_prev);
+    info.worklist = Salloc(count_nodes * sizeof *info.worklist);
+    // This is correct, since we are allocating an array of pointers
+    // NOLINTNEXTLINE(bugprone-sizeof-expression)
+    info.moves = Salloc(count_moves * sizeof *info.moves);
+    info.move_set = Salloc(count_moves * sizeof *info.move_set);
+    info.move_next = Salloc(count_moves * sizeof *info.move_next);
+    info.active_stamp = Salloc(count_moves * sizeof *info.active_stamp);
+    info.move_buf = Salloc(count_moves * sizeof *info.move_buf);
+    info.worklist_moves = -1;
     info.degree = Salloc(count_nodes * sizeof *info.degree);
+    info.spill_cost = Salloc(count_nodes * sizeof *info.spill_cost);
     info.color = Salloc(count_nodes * sizeof *info.color);
-    // This is correct, since we are allocating an array of pointers
     // NOLINTNEXTLINE(bugprone-sizeof-expression)
     info.adj_list = Salloc(count_nodes * sizeof *info.adj_list);
     // NOLINTNEXTLINE(bugprone-sizeof-expression)
     info.move_list = Salloc(count_nodes * sizeof *info.move_list);
-    info.alias = Table_new(0, cmpnode, hashnode);
-    info.worklist = Salloc(count_nodes * sizeof *info.worklist);
-#undef Salloc
+    info.alias = Salloc(count_nodes * sizeof *info.alias);
+    info.seen = Salloc(count_nodes * sizeof *info.seen);
 
 
     for (int i = 0; i < count_nodes; i++) {
         var node = &nodes[i];
 
-        temp_t* t = temp_for_node(&info, node);
+        temp_t* t = lv_node_temp(interference, node);
+        if (!t) {
+            continue; // spilled in an earlier round
+        }
 
-        var is_precolored = !!Table_get(initial_allocation, t);
+        var is_precolored = !!temp_map_get(initial_allocation, *t);
         if (is_precolored) {
-            info.precolored = list_cons(node, info.precolored, info.scratch);
+            worklist_prepend(&info, WL_PRECOLORED, node);
             info.color[node->lvn_idx] = t->temp_id;
         } else {
-            info.initial = list_cons(node, info.initial, info.scratch);
-            info.worklist[node->lvn_idx] = WL_INITIAL;
+            worklist_prepend(&info, WL_INITIAL, node);
 
             for (var it = lv_adj(node); lv_node_it_next(&it);) {
                 var m = &nodes[it.lvni_node.lvn_idx];
@@ -999,59 +1062,66 @@ struct ra_color_result {
     /*
      * Construct the move_list
      */
-    for (var m = interference->lvig_moves; m; m = m->npl_list) {
+    int move_idx = 0;
+    for (var m = interference->lvig_moves; m; m = m->npl_list, move_idx++) {
+        info.moves[move_idx] = m->npl_node;
+        info.move_set[move_idx] = MV_FROZEN;
+
         // The move is added to the move list for both the target and dest
-        var node_pair = m->npl_node;
-        info.move_list[node_pair->np_node0->lvn_idx] =
-            list_cons(node_pair,
-                    info.move_list[node_pair->np_node0->lvn_idx], info.scratch);
-        info.move_list[node_pair->np_node1->lvn_idx] =
-            list_cons(node_pair,
-                    info.move_list[node_pair->np_node1->lvn_idx], info.scratch);
+        int ends[] = {m->npl_node->np_node0->lvn_idx,
+            m->npl_node->np_node1->lvn_idx};
+        for (int i = 0; i < 2; i++) {
+            move_list_t* cell = Salloc(sizeof *cell);
+            cell->ml_move = move_idx;
+            cell->ml_list = info.move_list[ends[i]];
+            info.move_list[ends[i]] = cell;
+        }
     }
 
-    // It's a bit cheeky but we can use lvig_moves for our move worklist
+    // The moves start on worklist_moves in the order of lvig_moves
     if (enable_coalescing) {
-        info.worklist_moves = interference->lvig_moves;
+        for (int m = count_moves - 1; m >= 0; m--) {
+            move_worklist_push(&info, m);
+        }
     }
+#undef Salloc
+
+    compute_spill_costs(&info);
 
     if (debug) { debug_print_degrees(&info, count_nodes); }
 
     /*
      * :: MakeWorklist ::
      */
-    for (var n = info.initial; n; n = info.initial) {
-        var node = n->nl_node;
+    for (lv_node_t* node; (node = worklist_first(&info, WL_INITIAL)); ) {
         if (info.degree[node->lvn_idx] >= info.K) {
             // add to spill_worklist
-            info.initial = n->nl_list;
-            worklist_prepend(&info, WL_SPILL, n);
+            worklist_move(&info, node, WL_INITIAL, WL_SPILL);
         } else if (enable_coalescing && is_move_related(&info, node)) {
             // add to freeze_worklist
-            info.initial = n->nl_list;
-            worklist_prepend(&info, WL_FREEZE, n);
+            worklist_move(&info, node, WL_INITIAL, WL_FREEZE);
         } else {
             // add to simplify_worklist
-            info.initial = n->nl_list;
-            worklist_prepend(&info, WL_SIMPLIFY, n);
+            worklist_move(&info, node, WL_INITIAL, WL_SIMPLIFY);
         }
     }
 
     /*
      * The loop before "AssignColors", from "Main"
      */
-    while (info.simplify_worklist || info.worklist_moves
-            || info.freeze_worklist || info.spill_worklist) {
+    for (;;) {
         if (debug) { check_invariants(&info); }
 
-        if (info.simplify_worklist) {
+        if (info.wl_head[WL_SIMPLIFY] >= 0) {
             simplify(&info);
-        } else if (info.worklist_moves) {
+        } else if (info.worklist_moves >= 0) {
             coalesce(&info);
-        } else if (info.freeze_worklist) {
+        } else if (info.wl_head[WL_FREEZE] >= 0) {
             freeze(&info);
-        } else {
+        } else if (info.wl_head[WL_SPILL] >= 0) {
             select_spill(&info);
+        } else {
+            break;
         }
     }
 
@@ -1065,37 +1135,33 @@ struct ra_color_result {
     struct ra_color_result result = {};
 
     // Return Spills
-    for (var n = info.spilled_nodes; n; n = n->nl_list) {
-        var node = n->nl_node;
+    for (var node = worklist_first(&info, WL_SPILLED); node;
+            node = worklist_next(&info, node)) {
         temp_t* temp = temp_for_node(&info, node);
         result.racr_spills =
             temp_list_cons(*temp, result.racr_spills, ar_spills);
     }
 
     // Return Allocation
-    result.racr_allocation = Table_new(0, cmptemp, hashtemp);
-    for (var n = info.precolored; n; n = n->nl_list) {
-        var node = n->nl_node;
-        var temp = temp_copy_to_arena(
-                ar_allocation, *temp_for_node(&info, node));
-        Table_put(result.racr_allocation,
-                temp,
-                Table_get(initial_allocation, temp));
-    }
-    for (var n = info.colored_nodes; n; n = n->nl_list) {
-        var node = n->nl_node;
+    result.racr_allocation =
+        temp_map_new(interference->lvig_tnode.len, ar_allocation);
+    for (var node = worklist_first(&info, WL_PRECOLORED); node;
+            node = worklist_next(&info, node)) {
+        var temp = *temp_for_node(&info, node);
+        temp_map_put(result.racr_allocation, temp,
+                temp_map_get(initial_allocation, temp));
+    }
+    for (var node = worklist_first(&info, WL_COLORED); node;
+            node = worklist_next(&info, node)) {
 
         var color_idx = info.color[node->lvn_idx];
         var register_name = registers[color_idx];
 
-        Table_put(
-                result.racr_allocation,
-                temp_copy_to_arena(ar_allocation, *temp_for_node(&info, node)),
-                // cast away const
-                (void*)register_name);
+        temp_map_put(result.racr_allocation, *temp_for_node(&info, node),
+                register_name);
     }
-    for (var n = info.coalesced_nodes; n; n = n->nl_list) {
-        var node = n->nl_node;
+    for (var node = worklist_first(&info, WL_COALESCED); node;
+            node = worklist_next(&info, node)) {
         var alias = get_alias(&info, node);
         if (worklist_contains(&info, WL_SPILLED, alias)) {
             continue;
@@ -1104,30 +1170,220 @@ struct ra_color_result {
         var color_idx = info.color[node->lvn_idx];
         var register_name = registers[color_idx];
 
-        Table_put(
-                result.racr_allocation,
-                temp_copy_to_arena(ar_allocation, *temp_for_node(&info, node)),
-                // cast away const
-                (void*)register_name);
+        temp_map_put(result.racr_allocation, *temp_for_node(&info, node),
+                register_name);
     }
 
     if (debug) { debug_print_degrees(&info, count_nodes); }
 
     // :: clean up ::
 
-    // TODO: move all the moves from the various worklists back to the
-    // lvig_moves list
+    assert(info.wl_head[WL_INITIAL] < 0);
+    assert(info.wl_head[WL_SIMPLIFY] < 0);
+    assert(info.wl_head[WL_SPILL] < 0);
 
-    assert(info.initial == NULL);
-    assert(info.simplify_worklist == NULL);
-    assert(info.spill_worklist == NULL);
+    // Leave the interference graph as it was, for the next round
+    for (var e = info.added_edges; e; e = e->npl_list) {
+        lv_rm_edge(e->npl_node->np_node0, e->npl_node->np_node1);
+    }
 
     // dealloc all adj_lists
-    Table_free(&info.alias);
     Arena_dispose(&info.scratch);
     return result;
 }
 
+
+/*
+ * Whether any of the ranges of a and b overlap. *from is where to start in
+ * b. It is moved past the ranges that end before a starts, which are not
+ * needed again, since the intervals are allocated in order of start.
+ */
+static bool
+intervals_intersect(const lv_interval_t* a, const lv_interval_t* b, int* from)
+{
+    int j = *from;
+    while (j < b->lvi_num_ranges && b->lvi_ranges[j].lvr_end < a->lvi_start) {
+        j++;
+    }
+    *from = j;
+    for (int i = 0; i < a->lvi_num_ranges && j < b->lvi_num_ranges; ) {
+        if (a->lvi_ranges[i].lvr_end < b->lvi_ranges[j].lvr_start) {
+            i++;
+        } else if (b->lvi_ranges[j].lvr_end < a->lvi_ranges[i].lvr_start) {
+            j++;
+        } else {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Linear scan allocation, after Poletto and Sarkar, with the lifetime holes
+ * of Wimmer and Mössenböck. The intervals are taken in order of start and
+ * each is given a register in which nothing else is live at any point in
+ * its ranges. When there is none, either it or the interval that is in
+ * the way and ends last is spilled.
+ *
+ * This is much quicker than colouring on large functions, but it spills
+ * more, and moves are only avoided by following the hints.
+ */
+static struct ra_color_result
+ra_linear_scan(
+    const struct intervals_and_table* live,
+    temp_map_t initial_allocation, // the machine registers
+    const char* registers[],
+    Arena_T ar_spills,
+    Arena_T ar_allocation
+    )
+{
+    const int K = initial_allocation.tm_len;
+    assert(K <= 64);
+    const int n = live->num_intervals;
+    const lv_interval_t* intervals = live->intervals;
+    var scratch = Arena_new();
+#define Salloc(nbytes) Arena_alloc(scratch, nbytes, __FILE__, __LINE__)
+    int* color = Salloc(n * sizeof *color);
+    bool* spilled = Salloc(n * sizeof *spilled);
+    int* cursor = Salloc(n * sizeof *cursor); // see intervals_intersect
+    // The intervals given each register that have not yet ended
+    arrtype(int)* assigned = Salloc(K * sizeof *assigned);
+    const lv_interval_t** fixed = Salloc(K * sizeof *fixed);
+    int* fixed_cursor = Salloc(K * sizeof *fixed_cursor);
+#undef Salloc
+
+    for (int k = 0; k < live->num_fixed; k++) {
+        int c = live->fixed[k].lvi_temp.temp_id;
+        assert(c < K);
+        fixed[c] = &live->fixed[k];
+    }
+
+    // By temp_id, 1 + the index of its interval, for following hints
+    int num_ids = K;
+    for (int k = 0; k < n; k++) {
+        if (intervals[k].lvi_temp.temp_id >= num_ids) {
+            num_ids = intervals[k].lvi_temp.temp_id + 1;
+        }
+    }
+    int* interval_idx = Arena_alloc(scratch,
+            num_ids * sizeof *interval_idx, __FILE__, __LINE__);
+    for (int k = 0; k < n; k++) {
+        interval_idx[intervals[k].lvi_temp.temp_id] = k + 1;
+    }
+
+    // Hints may point at intervals that come later, which have no colour yet
+    for (int k = 0; k < n; k++) {
+        color[k] = -1;
+    }
+
+    for (int k = 0; k < n; k++) {
+        var cur = &intervals[k];
+
+        uint64_t free_colors = 0;
+        // The only interval in the way in some register, that ends last
+        int victim = -1;
+        int victim_color = -1;
+        for (int c = 0; c < K; c++) {
+            if (fixed[c]
+                    && intervals_intersect(cur, fixed[c], &fixed_cursor[c])) {
+                continue;
+            }
+            int num_conflicts = 0;
+            int conflict = -1;
+            var a = &assigned[c];
+            for (int m = 0; m < a->len; ) {
+                int other = a->data[m];
+                if (intervals[other].lvi_end < cur->lvi_start) {
+                    a->data[m] = a->data[--a->len];
+                    continue;
+                }
+                if (intervals_intersect(cur, &intervals[other],
+                            &cursor[other])) {
+                    num_conflicts++;
+                    conflict = other;
+                }
+                m++;
+            }
+            if (num_conflicts == 0) {
+                free_colors |= 1ULL << c;
+            } else if (num_conflicts == 1 && (victim < 0
+                        || intervals[conflict].lvi_end
+                            > intervals[victim].lvi_end)) {
+                victim = conflict;
+                victim_color = c;
+            }
+        }
+
+        int hint_color = -1;
+        var hint = cur->lvi_hint;
+        if (hint.temp_id >= 0 && temp_is_machine(hint)) {
+            hint_color = hint.temp_id;
+        } else if (hint.temp_id >= 0) {
+            int hint_idx = hint.temp_id < num_ids
+                ? interval_idx[hint.temp_id] - 1 : -1;
+            if (hint_idx >= 0) {
+                hint_color = color[hint_idx];
+            }
+        }
+
+        int c = -1;
+        if (hint_color >= 0 && (free_colors & (1ULL << hint_color))) {
+            c = hint_color;
+        } else if (free_colors) {
+            c = __builtin_ctzll(free_colors);
+        } else if (victim >= 0) {
+            // The temps made by spilling live for one instruction, so they
+            // must not be spilled again.
+            bool is_short = cur->lvi_end - cur->lvi_start <= 1;
+            bool victim_short =
+                intervals[victim].lvi_end - intervals[victim].lvi_start <= 1;
+            if (intervals[victim].lvi_end > cur->lvi_end
+                    || (is_short && !victim_short)) {
+                c = victim_color;
+                var a = &assigned[c];
+                for (int m = 0; m < a->len; m++) {
+                    if (a->data[m] == victim) {
+                        a->data[m] = a->data[--a->len];
+                        break;
+                    }
+                }
+                spilled[victim] = true;
+                color[victim] = -1;
+            }
+        }
+
+        if (c < 0) {
+            if (debug) {
+                fprintf(stderr, "spill %d\n", cur->lvi_temp.temp_id);
+            }
+            spilled[k] = true;
+            continue;
+        }
+        color[k] = c;
+        arrpush(&assigned[c], scratch, k);
+    }
+
+    struct ra_color_result result = {};
+    result.racr_allocation = temp_map_new(num_ids, ar_allocation);
+    for (int k = 0; k < live->num_fixed; k++) {
+        var temp = live->fixed[k].lvi_temp;
+        temp_map_put(result.racr_allocation, temp,
+                temp_map_get(initial_allocation, temp));
+    }
+    for (int k = 0; k < n; k++) {
+        var temp = intervals[k].lvi_temp;
+        if (spilled[k]) {
+            result.racr_spills =
+                temp_list_cons(temp, result.racr_spills, ar_spills);
+        } else {
+            temp_map_put(result.racr_allocation, temp, registers[color[k]]);
+        }
+    }
+
+    Arena_dispose(&scratch);
+    return result;
+}
+
 static void
 replace_temp(temp_list_t* temp_list, temp_t to_be_replaced, temp_t replacement)
 {
@@ -1138,19 +1394,53 @@ replace_temp(temp_list_t* temp_list, temp_t to_be_replaced, temp_t replacement)
     }
 }
 
+/*
+ * A load from or a store to the slot of a spilled temp, as made by
+ * spill_temps. These are kept until the end, when the slots are shared.
+ */
+typedef struct spill_access_t {
+    assm_instr_t* sa_instr;
+    struct ac_frame_var* sa_slot;
+    bool sa_is_load;
+} spill_access_t;
+
+typedef arrtype(spill_access_t) spill_accesses_t;
+
+/*
+ * How a temp is spilled: a temp whose only def computes a constant or an
+ * address is rematerialised, by computing it again before each use, and any
+ * other lives in a slot in the frame.
+ */
+typedef struct spill_t {
+    int num_defs;
+    assm_instr_t* def; // the only one, if num_defs is 1
+    bool remat;
+    struct ac_frame_var* frame_var; // unless remat
+    // The temp it was last loaded into, and the instruction that uses it
+    temp_t loaded_as;
+    const assm_instr_t* loaded_for;
+} spill_t;
+
+/*
+ * Rewrites the instructions so that each of the temps to spill is either
+ * rematerialised or lives in a new slot in the frame. Each use is replaced
+ * by a new temp that is computed again or loaded from the slot just before,
+ * and each def by a new temp that is stored to the slot just after. The def
+ * of a rematerialised temp is removed. This is done for all of them in a
+ * single pass, after a pass to find the defs.
+ */
 static void
-spill_temp(
+spill_temps(
         Arena_T ar_instrs, // arena for body_instrs
         Arena_T ar_frags, // arena for fragments
         temp_state_t* temp_state,
         ac_frame_t* frame,
         assm_instr_t** pbody_instrs,
-        temp_t temp_to_spill
+        temp_list_t* temps_to_spill,
+        spill_accesses_t* accesses, // the loads and stores are added here
+        Arena_T ar_accesses
         )
 {
-    if (debug) {
-        fprintf(stderr, "spilling temp: %d\n", temp_to_spill.temp_id);
-    }
     /*
      * To think about:
      *   if temp_to_spill is already one of our function's local variables
@@ -1158,80 +1448,315 @@ spill_temp(
      */
 
     var backend = frame->acf_target->tgt_backend;
+    Arena_T scratch = Arena_new();
+
+    // By temp_id, up to the largest of the temps to spill
+    int num_ids = 0;
+    for (var t = temps_to_spill; t; t = t->tmp_list) {
+        if (t->tmp_temp.temp_id >= num_ids) {
+            num_ids = t->tmp_temp.temp_id + 1;
+        }
+    }
+    spill_t** spills =
+        Arena_alloc(scratch, num_ids * sizeof *spills, __FILE__, __LINE__);
+#define SpillOf(t) \
+    (((unsigned)(t).temp_id < (unsigned)num_ids) ? spills[(t).temp_id] : NULL)
+    for (var t = temps_to_spill; t; t = t->tmp_list) {
+        spill_t* spill =
+            Arena_alloc(scratch, sizeof *spill, __FILE__, __LINE__);
+        spills[t->tmp_temp.temp_id] = spill;
+    }
+    for (var instr = *pbody_instrs; instr; instr = instr->ai_list) {
+        if (instr->ai_tag == ASSM_INSTR_MOVE) {
+            spill_t* spill = SpillOf(instr->ai_move_dst);
+            if (spill) {
+                spill->num_defs++;
+            }
+        } else if (instr->ai_tag == ASSM_INSTR_OPER) {
+            for (var dst = instr->ai_oper_dst; dst; dst = dst->tmp_list) {
+                spill_t* spill = SpillOf(dst->tmp_temp);
+                if (spill) {
+                    spill->num_defs++;
+                    spill->def = instr;
+                }
+            }
+        }
+    }
+    for (var t = temps_to_spill; t; t = t->tmp_list) {
+        spill_t* spill = SpillOf(t->tmp_temp);
+        spill->remat = backend->rematerialise && spill->num_defs == 1
+            && spill->def
+            && backend->rematerialise(spill->def, t->tmp_temp, scratch);
+        if (debug) {
+            fprintf(stderr, "%s temp: %d\n",
+                    spill->remat ? "rematerialising" : "spilling",
+                    t->tmp_temp.temp_id);
+        }
+        if (!spill->remat) {
+            spill->frame_var =
+                ac_spill_temporary(frame, t->tmp_temp, ar_frags);
+        }
+    }
 
-    struct ac_frame_var* new_frame_var =
-        ac_spill_temporary(frame, temp_to_spill, ar_frags);
-    for (var pinstr = pbody_instrs; *pinstr; pinstr = &((*pinstr)->ai_list)) {
+    for (var pinstr = pbody_instrs; *pinstr; ) {
         var instr = *pinstr;
+        temp_list_t* dsts = NULL;
+        temp_list_t* srcs = NULL;
+        // The temps of a move, as lists
+        temp_list_t move_dst = {};
+        temp_list_t move_src = {};
         switch (instr->ai_tag) {
             case ASSM_INSTR_OPER:
-                if (temp_list_contains(instr->ai_oper_dst, temp_to_spill)) {
-                    // Want to store to our new stack location
-                    // after
-                    var new_temp = temp_newtemp(temp_state,
-                            temp_to_spill.temp_size, temp_to_spill.temp_ptr_dispo);
-                    replace_temp(instr->ai_oper_dst, temp_to_spill, new_temp);
-                    var new_instr = backend->store_temp(
-                            new_frame_var, new_temp, ar_instrs);
-
-                    // HACK to know spilled registers in stack maps
-                    assert(new_frame_var->acf_stored.temp_id == -1);
-                    new_frame_var->acf_stored = new_temp;
-
-                    // graft in
-                    new_instr->ai_list = instr->ai_list;
-                    instr->ai_list = new_instr;
-                }
-                if (temp_list_contains(instr->ai_oper_src, temp_to_spill)) {
-                    // Want to fetch from our new stack location
-                    // before
-                    var new_temp = temp_newtemp(temp_state,
-                            temp_to_spill.temp_size, temp_to_spill.temp_ptr_dispo);
-                    replace_temp(instr->ai_oper_src, temp_to_spill, new_temp);
-                    var new_instr = backend->load_temp(
-                            new_frame_var, new_temp, ar_instrs);
-                    // graft in
-                    new_instr->ai_list = instr;
-                    *pinstr = new_instr;
-                }
+                dsts = instr->ai_oper_dst;
+                srcs = instr->ai_oper_src;
                 break;
             case ASSM_INSTR_LABEL:
                 break;
             case ASSM_INSTR_MOVE:
-                if (temp_eq(instr->ai_move_dst, temp_to_spill)) {
-                    // Want to store to our new stack location
-                    // after
-                    var new_temp = temp_newtemp(temp_state,
-                            temp_to_spill.temp_size, temp_to_spill.temp_ptr_dispo);
-                    instr->ai_move_dst = new_temp;
-                    var new_instr = backend->store_temp(
-                            new_frame_var, new_temp, ar_instrs);
-                    /*
-                     * Hack to know what register was spilled when creating
-                     * stack maps.
-                     */
-                    assert(new_frame_var->acf_stored.temp_id == -1);
-                    new_frame_var->acf_stored = new_temp;
-
-                    // graft in
-                    new_instr->ai_list = instr->ai_list;
-                    instr->ai_list = new_instr;
+                move_dst.tmp_temp = instr->ai_move_dst;
+                move_src.tmp_temp = instr->ai_move_src;
+                dsts = &move_dst;
+                srcs = &move_src;
+                break;
+        }
+
+        if (dsts) {
+            spill_t* spill = SpillOf(dsts->tmp_temp);
+            if (spill && spill->remat) {
+                // It is computed where it is used instead
+                assert(instr == spill->def);
+                *pinstr = instr->ai_list;
+                continue;
+            }
+        }
+
+        for (var src = srcs; src; src = src->tmp_list) {
+            spill_t* spill = SpillOf(src->tmp_temp);
+            if (!spill) {
+                continue;
+            }
+            // Want to fetch from our new stack location, or compute again,
+            // before
+            var new_temp = temp_newtemp(temp_state,
+                    src->tmp_temp.temp_size, src->tmp_temp.temp_ptr_dispo);
+            var new_instr = spill->remat
+                ? backend->rematerialise(spill->def, new_temp, ar_instrs)
+                : backend->load_temp(spill->frame_var, new_temp, ar_instrs);
+            replace_temp(src, src->tmp_temp, new_temp);
+            spill->loaded_as = new_temp;
+            spill->loaded_for = instr;
+            if (!spill->remat) {
+                spill_access_t load = {new_instr, spill->frame_var, true};
+                arrpush(accesses, ar_accesses, load);
+            }
+            // graft in
+            new_instr->ai_list = instr;
+            *pinstr = new_instr;
+            pinstr = &new_instr->ai_list;
+        }
+        for (var dst = dsts; dst; dst = dst->tmp_list) {
+            spill_t* spill = SpillOf(dst->tmp_temp);
+            if (!spill) {
+                continue;
+            }
+            assert(!spill->remat);
+            var frame_var = spill->frame_var;
+            // Want to store to our new stack location
+            // after. An instruction that updates the temp, such as an add
+            // on x86_64, reads and writes the same register.
+            var new_temp = (spill->loaded_for == instr)
+                ? spill->loaded_as
+                : temp_newtemp(temp_state,
+                        dst->tmp_temp.temp_size, dst->tmp_temp.temp_ptr_dispo);
+            replace_temp(dst, dst->tmp_temp, new_temp);
+            var new_instr =
+                backend->store_temp(frame_var, new_temp, ar_instrs);
+
+            /*
+             * Hack to know what register was spilled when creating
+             * stack maps. It is only needed for the temps that inherit
+             * their pointer disposition, the callee-saves, which are
+             * defined once.
+             */
+            assert(frame_var->acf_stored.temp_id == -1
+                    || new_temp.temp_ptr_dispo != TEMP_DISP_INHERIT);
+            if (frame_var->acf_stored.temp_id == -1) {
+                frame_var->acf_stored = new_temp;
+            }
+
+            spill_access_t store = {new_instr, frame_var, false};
+            arrpush(accesses, ar_accesses, store);
+
+            // graft in
+            new_instr->ai_list = instr->ai_list;
+            instr->ai_list = new_instr;
+        }
+        if (instr->ai_tag == ASSM_INSTR_MOVE) {
+            instr->ai_move_dst = move_dst.tmp_temp;
+            instr->ai_move_src = move_src.tmp_temp;
+        }
+
+        // The stores have no temps to spill
+        pinstr = &instr->ai_list;
+    }
+
+#undef SpillOf
+    Arena_dispose(&scratch);
+}
+
+
+/*
+ * Lets the spilled temps share slots in the frame. A slot is live from a
+ * store to it until the last load from it, and slots that are never live
+ * at the same time are coloured the same and so share a word. Then the
+ * loads and stores are made again with the new offsets.
+ */
+static void
+share_spill_slots(
+        ac_frame_t* frame,
+        int locals_end, // where the frame ended before the first spill
+        assm_instr_t* instrs,
+        lv_flowgraph_t* flow,
+        const spill_accesses_t* accesses,
+        Arena_T ar_instrs)
+{
+    if (accesses->len == 0) {
+        return;
+    }
+    Arena_T scratch = Arena_new();
+#define Salloc(nbytes) Arena_alloc(scratch, nbytes, __FILE__, __LINE__)
+
+    // Number the slots, and find the access made by each instruction
+    struct ac_frame_var** slots = Salloc(accesses->len * sizeof *slots);
+    int num_slots = 0;
+    int* slot_of_access = Salloc(accesses->len * sizeof *slot_of_access);
+    Table_T slot_idx = Table_new(0, NULL, NULL); // frame var -> index + 1
+    Table_T access_idx = Table_new(0, NULL, NULL); // instr -> index + 1
+    for (int k = 0; k < accesses->len; k++) {
+        var a = &accesses->data[k];
+        intptr_t s = (intptr_t)Table_get(slot_idx, a->sa_slot);
+        if (!s) {
+            slots[num_slots++] = a->sa_slot;
+            s = num_slots;
+            Table_put(slot_idx, a->sa_slot, (void*)s);
+        }
+        slot_of_access[k] = s - 1;
+        Table_put(access_idx, a->sa_instr, (void*)(intptr_t)(k + 1));
+    }
+
+    const int n = lv_graph_length(flow->lvfg_control);
+    int* access_at = Salloc(n * sizeof *access_at);
+    {
+        int i = 0;
+        for (var instr = instrs; instr; instr = instr->ai_list, i++) {
+            assert(i < n);
+            access_at[i] = (intptr_t)Table_get(access_idx, instr) - 1;
+        }
+        assert(i == n);
+    }
+
+    // Liveness of the slots. A load is a use and a store a def.
+    const int len = BitsetLen(num_slots);
+    uint64_t* live_in = Salloc(n * len * sizeof *live_in);
+    uint64_t* live_out = Salloc(n * len * sizeof *live_out);
+    for (bool changed = true; changed; ) {
+        changed = false;
+        for (int i = n - 1; i >= 0; i--) {
+            uint64_t* out = &live_out[i * len];
+            uint64_t* in = &live_in[i * len];
+            lv_node_t node = {flow->lvfg_control, i};
+            var succs = lv_succ(&node);
+            while (lv_node_it_next(&succs)) {
+                const uint64_t* succ_in =
+                    &live_in[succs.lvni_node.lvn_idx * len];
+                for (int w = 0; w < len; w++) {
+                    out[w] |= succ_in[w];
+                }
+            }
+            int k = access_at[i];
+            for (int w = 0; w < len; w++) {
+                uint64_t new_in = out[w];
+                if (k >= 0 && slot_of_access[k] >> 6 == w) {
+                    uint64_t bit = 1ULL << (slot_of_access[k] & 63);
+                    new_in = accesses->data[k].sa_is_load
+                        ? (new_in | bit) : (new_in & ~bit);
                 }
-                if (temp_eq(instr->ai_move_src, temp_to_spill)) {
-                    // Want to fetch from our new stack location
-                    // before
-                    var new_temp = temp_newtemp(temp_state,
-                            temp_to_spill.temp_size, temp_to_spill.temp_ptr_dispo);
-                    instr->ai_move_src = new_temp;
-                    var new_instr = backend->load_temp(
-                            new_frame_var, new_temp, ar_instrs);
-                    // graft in
-                    new_instr->ai_list = instr;
-                    *pinstr = new_instr;
+                if (new_in != in[w]) {
+                    in[w] = new_in;
+                    changed = true;
                 }
-                break;
+            }
         }
     }
+
+    // Slots interfere where one is stored to while the other is live
+    uint64_t* interferes = Salloc(num_slots * len * sizeof *interferes);
+    for (int i = 0; i < n; i++) {
+        int k = access_at[i];
+        if (k < 0 || accesses->data[k].sa_is_load) {
+            continue;
+        }
+        int a = slot_of_access[k];
+        const uint64_t* live = &live_out[i * len];
+        for (int b = 0; b < num_slots; b++) {
+            if (b != a && IsBitSet(live, b)) {
+                SetBit(&interferes[a * len], b);
+                SetBit(&interferes[b * len], a);
+            }
+        }
+    }
+    // Any live at the start have not been stored to, so they interfere with
+    // each other there
+    for (int a = 0; a < num_slots; a++) {
+        for (int b = 0; b < num_slots && IsBitSet(live_in, a); b++) {
+            if (b != a && IsBitSet(live_in, b)) {
+                SetBit(&interferes[a * len], b);
+            }
+        }
+    }
+
+    // Colour them in order, with the lowest colour free
+    int* colours = Salloc(num_slots * sizeof *colours);
+    uint64_t* used = Salloc(len * sizeof *used);
+    for (int a = 0; a < num_slots; a++) {
+        memset(used, 0, len * sizeof *used);
+        for (int b = 0; b < a; b++) {
+            if (IsBitSet(&interferes[a * len], b)) {
+                SetBit(used, colours[b]);
+            }
+        }
+        int c = 0;
+        while (IsBitSet(used, c)) {
+            c++;
+        }
+        colours[a] = c;
+    }
+    ac_share_spill_slots(frame, locals_end, slots, colours, num_slots);
+
+    var backend = frame->acf_target->tgt_backend;
+    const int fp_id = frame->acf_target->tgt_fp.temp_id;
+    for (int k = 0; k < accesses->len; k++) {
+        var a = &accesses->data[k];
+        var instr = a->sa_instr;
+        assm_instr_t* remade;
+        if (a->sa_is_load) {
+            remade = backend->load_temp(a->sa_slot,
+                    instr->ai_oper_dst->tmp_temp, ar_instrs);
+        } else {
+            var src = instr->ai_oper_src;
+            while (src->tmp_temp.temp_id == fp_id) {
+                src = src->tmp_list;
+            }
+            remade = backend->store_temp(a->sa_slot, src->tmp_temp,
+                    ar_instrs);
+        }
+        instr->ai_assem = remade->ai_assem;
+    }
+
+#undef Salloc
+    Table_free(&access_idx);
+    Table_free(&slot_idx);
+    Arena_dispose(&scratch);
 }
 
 
@@ -1240,7 +1765,7 @@ spill_temp(
  */
 static void
 remove_dead_moves(
-        Table_T allocation, /* temp_t* -> register (char*) */
+        temp_map_t allocation,
         assm_instr_t** pbody_instrs)
 {
     for (var pinstr = pbody_instrs; *pinstr; ) {
@@ -1249,9 +1774,9 @@ remove_dead_moves(
             var dst = instr->ai_move_dst;
             var src = instr->ai_move_src;
             if (dst.temp_size == src.temp_size) {
-                const char* dst_reg = Table_get(allocation, &dst);
+                const char* dst_reg = temp_map_get(allocation, dst);
                 assert(dst_reg);
-                const char* src_reg = Table_get(allocation, &src);
+                const char* src_reg = temp_map_get(allocation, src);
                 assert(src_reg);
                 if (dst_reg == src_reg) {
 
@@ -1303,7 +1828,7 @@ static void
 record_spill_liveness(
         assm_instr_t* instrs,
         lv_flowgraph_t* flowgraph,
-        struct igraph_and_table igraph_and_table,
+        lv_node_temps_map_t* live_outs_map,
         temp_list_t* about_to_spill,
         Table_T label_to_spill_liveness, // sl_sym_t -> temp_list_t*
         Arena_T ar_spill_liveness
@@ -1313,8 +1838,7 @@ record_spill_liveness(
     var it = lv_nodes(flowgraph->lvfg_control); lv_node_it_next(&it);
     for (var instr = instrs; instr && lv_node_it_next(&it); instr = instr->ai_list) {
         if (is_call_instr(instr)) {
-            temp_list_t* live_outs =
-                nt_get(igraph_and_table.live_outs, &it.lvni_node);
+            temp_list_t* live_outs = nt_get(live_outs_map, &it.lvni_node);
 
             temp_list_t* spill_live_outs =
                 Table_get(label_to_spill_liveness, instr->ai_list->ai_label);
@@ -1372,8 +1896,8 @@ compute_cs_ptr_dispo_at_call_sites(
         ac_frame_t* frame,
         assm_instr_t* instrs,
         lv_flowgraph_t* flowgraph,
-        struct igraph_and_table igraph_and_table,
-        Table_T allocation, // temp_t* -> register (char*)
+        lv_node_temps_map_t* live_outs_map,
+        temp_map_t allocation,
         Table_T label_to_cs_bitmap // sl_sym_t -> uint32_t
         )
 {
@@ -1388,14 +1912,13 @@ compute_cs_ptr_dispo_at_call_sites(
     var it = lv_nodes(flowgraph->lvfg_control); lv_node_it_next(&it);
     for (var instr = instrs; instr && lv_node_it_next(&it); instr = instr->ai_list) {
         if (is_call_instr(instr)) {
-            temp_list_t* live_outs =
-                nt_get(igraph_and_table.live_outs, &it.lvni_node);
+            temp_list_t* live_outs = nt_get(live_outs_map, &it.lvni_node);
 
             // Any non-live callee saved will get a value of 0b00.
             uint32_t cs_bitmap = 0;
 
             for (var tl = live_outs; tl; tl = tl->tmp_list) {
-                const char* reg = Table_get(allocation, &(tl->tmp_temp));
+                const char* reg = temp_map_get(allocation, tl->tmp_temp);
                 var t = tl->tmp_temp;
                 for (int i = 0; i < csn; i++) {
                     // Safe comparison because these come from the same place.
@@ -1422,16 +1945,116 @@ compute_cs_ptr_dispo_at_call_sites(
 static void
 debug_print_instrs(assm_instr_t* body_instrs, ac_frame_t* frame)
 {
+    writer_t w;
+    wr_init(&w, stderr);
     for (var i = body_instrs; i; i = i->ai_list) {
-        char buf[128];
-        assm_format(buf, 128, i, frame->acf_temp_map, frame->acf_target);
-        fprintf(stderr, "%s", buf);
+        assm_format(&w, i, frame->acf_temp_map, frame->acf_target);
     }
+    wr_dispose(&w);
+}
+
+/*
+ * The nodes of the call instructions, which are the only ones we need the
+ * live-outs of when we have no interference graph.
+ */
+static nodeset_t*
+call_nodes(assm_instr_t* instrs, lv_flowgraph_t* flowgraph, Arena_T ar)
+{
+    nodeset_t* result = NULL;
+    var it = lv_nodes(flowgraph->lvfg_control); lv_node_it_next(&it);
+    for (var instr = instrs; instr && lv_node_it_next(&it); instr = instr->ai_list) {
+        if (is_call_instr(instr)) {
+            lv_node_t* node = Arena_alloc(ar, sizeof *node, __FILE__, __LINE__);
+            *node = it.lvni_node;
+            nodeset_upsert(&result, node, ar);
+        }
+    }
+    return result;
+}
+
+const char*
+ra_algorithm_name(enum ra_algorithm algorithm)
+{
+    switch (algorithm) {
+        case RA_GRAPH_COLORING: return "graph";
+        case RA_LINEAR_SCAN: return "linear";
+        case RA_AUTO: return "auto";
+    }
+    assert(!"unknown register allocator");
+    return NULL;
+}
+
+/*
+ * The temp with t's new id, giving it one if it has none yet
+ */
+static temp_t
+renumber_temp(temp_t t, temp_state_t* temp_state, Table_T new_ids,
+        Arena_T scratch)
+{
+    if (temp_is_machine(t)) {
+        return t;
+    }
+    intptr_t id = (intptr_t)Table_get(new_ids, &t);
+    if (!id) {
+        id = temp_newtemp(temp_state, t.temp_size, t.temp_ptr_dispo).temp_id;
+        Table_put(new_ids, temp_copy_to_arena(scratch, t), (void*)id);
+    }
+    t.temp_id = id;
+    return t;
+}
+
+/*
+ * Numbers the temps of the function from the first after the machine
+ * registers, in the order they are found. The temps of all the functions
+ * are numbered together before this, so the ids of any one function are
+ * spread out. With them dense, liveness and allocation can map temps to
+ * nodes and registers with arrays, indexed by temp_id. The temp lists are
+ * copied rather than changed, since instructions may share them.
+ */
+static void
+renumber_temps(temp_state_t* temp_state, assm_instr_t* instrs,
+        Arena_T ar_instrs)
+{
+    temp_state_restart(temp_state);
+    var scratch = Arena_new();
+    Table_T new_ids = Table_new(0, cmptemp, hashtemp); // temp_t* -> id
+
+    for (var instr = instrs; instr; instr = instr->ai_list) {
+        if (instr->ai_tag == ASSM_INSTR_MOVE) {
+            instr->ai_move_dst = renumber_temp(
+                    instr->ai_move_dst, temp_state, new_ids, scratch);
+            instr->ai_move_src = renumber_temp(
+                    instr->ai_move_src, temp_state, new_ids, scratch);
+        } else if (instr->ai_tag == ASSM_INSTR_OPER) {
+            temp_list_t** lists[] = {
+                &instr->ai_oper_dst, &instr->ai_oper_src,
+            };
+            for (int i = 0; i < NELEMS(lists); i++) {
+                temp_list_t* copy = NULL;
+                temp_list_t** pcopy = &copy;
+                for (var t = *lists[i]; t; t = t->tmp_list) {
+                    *pcopy = temp_list(renumber_temp(
+                                t->tmp_temp, temp_state, new_ids, scratch),
+                            ar_instrs);
+                    pcopy = &(*pcopy)->tmp_list;
+                }
+                *lists[i] = copy;
+            }
+        }
+    }
+
+    Table_free(&new_ids);
+    Arena_dispose(&scratch);
 }
 
 /*
  * Performs liveness analysis and register allocation.
  *
+ * If there are spills, all of them are rewritten at once and the
+ * allocation is tried again. For graph colouring, the interference graph
+ * is then updated for the new temps, rather than made again, so there is
+ * only one full liveness analysis.
+ *
  * body_instrs is no longer valid after calling this; it is mutated and
  * returned as ra_instrs in the returned structure.
  */
@@ -1441,6 +2064,7 @@ ra_alloc(
         temp_state_t* temp_state,
         assm_instr_t* body_instrs,
         ac_frame_t* frame,
+        enum ra_algorithm algorithm,
         bool print_interference_and_return,
         Table_T label_to_cs_bitmap,
         Table_T label_to_spill_liveness,
@@ -1449,79 +2073,147 @@ ra_alloc(
         Arena_T arena_allocation,
         Arena_T arena_fragments)
 {
-    // liveness analysis
+    // The interference graph is kept in scratch from one round to the
+    // next, and the flow graph in the arena of the round
     var scratch = Arena_new();
-    var flow_and_nodes = instrs2graph(body_instrs, scratch);
-    lv_flowgraph_t* flow = flow_and_nodes.flowgraph;
-    if (print_interference_and_return) {
-        flowgraph_print(out, flow, flow_and_nodes.node_list, body_instrs,
-                frame->acf_target);
-    }
-
-    var igraph_and_table =
-        interference_graph(flow, flow_and_nodes.node_list, scratch);
-    if (print_interference_and_return) {
-        igraph_show(out, igraph_and_table.igraph);
-        lv_free_interference_and_flow_graph(&igraph_and_table, &flow_and_nodes);
-        Arena_dispose(&scratch);
-        return (struct instr_list_and_allocation) { .ra_instrs = body_instrs };
-    }
-
-    // register allocation
-    var color_result =
-        ra_color(igraph_and_table.igraph, flow, frame->acf_temp_map,
-                frame->acf_target->register_names, scratch,
-                arena_allocation);
-
-    // :: check for spilled nodes, and rewrite program if so ::
-    if (color_result.racr_spills) {
+    struct igraph_and_table igraph_and_table = {};
+    temp_list_t* spilled = NULL; // in the previous round
+    struct ra_stats stats = {};
+    size_t first_spill_node = 0; // in the interference graph
+    const int locals_end = frame->acf_last_local_offset;
+    spill_accesses_t spill_accesses = {};
+
+    renumber_temps(temp_state, body_instrs, arena_instrs);
+
+    for (;;) {
+        stats.ras_rounds++;
+
+        // liveness analysis
+        var liveness_timer = st_begin(ST_PASS_LIVENESS);
+        var round = Arena_new();
+        var flow_and_nodes = instrs2graph(body_instrs, round);
+        lv_flowgraph_t* flow = flow_and_nodes.flowgraph;
+        var cg_nodes = flow_and_nodes.node_list;
+        if (print_interference_and_return) {
+            flowgraph_print(out, flow, cg_nodes, body_instrs,
+                    frame->acf_target);
+        }
+
+        if (algorithm == RA_AUTO) {
+            // Decided once, so that later rounds of spilling do not change
+            // it
+            algorithm =
+                (lv_graph_length(flow->lvfg_control) > RA_AUTO_LINEAR_THRESHOLD)
+                ? RA_LINEAR_SCAN : RA_GRAPH_COLORING;
+        }
+
+        // We only need the live-outs at the calls
+        var want_live_outs = call_nodes(body_instrs, flow, round);
+        struct intervals_and_table intervals = {};
+        lv_node_temps_map_t* live_outs;
+        stats.ras_flow_nodes = lv_graph_length(flow->lvfg_control);
+        if (algorithm == RA_LINEAR_SCAN) {
+            intervals = live_intervals(flow, cg_nodes, want_live_outs, round);
+            live_outs = intervals.live_outs;
+            stats.ras_interference_nodes = intervals.num_intervals;
+            stats.ras_liveness_iterations += intervals.iterations;
+        } else {
+            if (spilled) {
+                igraph_and_table = interference_graph_after_spills(
+                        &igraph_and_table, flow, cg_nodes, want_live_outs,
+                        spilled, scratch);
+            } else {
+                igraph_and_table = interference_graph(flow, cg_nodes,
+                        want_live_outs, scratch);
+                first_spill_node =
+                    lv_graph_length(igraph_and_table.igraph->lvig_graph);
+            }
+            live_outs = igraph_and_table.live_outs;
+            stats.ras_interference_nodes =
+                igraph_and_table.igraph->lvig_num_temps;
+            stats.ras_liveness_iterations += igraph_and_table.iterations;
+        }
+        st_end(&liveness_timer);
+        if (print_interference_and_return) {
+            if (algorithm == RA_LINEAR_SCAN) {
+                intervals_show(out, &intervals);
+            } else {
+                igraph_show(out, igraph_and_table.igraph);
+            }
+            lv_free_interference_and_flow_graph(&igraph_and_table,
+                    &flow_and_nodes);
+            Arena_dispose(&round);
+            Arena_dispose(&scratch);
+            return (struct instr_list_and_allocation) {
+                .ra_instrs = body_instrs,
+                .ra_stats = stats,
+            };
+        }
+
+        // register allocation
+        var regalloc_timer = st_begin(ST_PASS_REGALLOC);
+        var color_result = (algorithm == RA_LINEAR_SCAN)
+            ? ra_linear_scan(&intervals, frame->acf_temp_map,
+                    frame->acf_target->register_names, scratch,
+                    arena_allocation)
+            : ra_color(igraph_and_table.igraph, first_spill_node, flow,
+                    frame->acf_temp_map,
+                    frame->acf_target->register_names, scratch,
+                    arena_allocation);
+
+        if (!color_result.racr_spills) {
+            /* Must happen before removing the dead moves, so that flowgraph
+             * nodes line up with instructions.
+             */
+            compute_cs_ptr_dispo_at_call_sites(frame, body_instrs, flow,
+                    live_outs, color_result.racr_allocation,
+                    label_to_cs_bitmap);
+            share_spill_slots(frame, locals_end, body_instrs, flow,
+                    &spill_accesses, arena_instrs);
+
+            remove_dead_moves(color_result.racr_allocation, &body_instrs);
+
+            struct instr_list_and_allocation result = {
+                .ra_instrs = body_instrs,
+                .ra_allocation = color_result.racr_allocation,
+                .ra_stats = stats,
+            };
+
+            st_end(&regalloc_timer);
+            lv_free_interference_and_flow_graph(&igraph_and_table,
+                    &flow_and_nodes);
+            Arena_dispose(&round);
+            Arena_dispose(&scratch);
+            return result;
+        }
+
+        // :: spilled nodes, so rewrite the program and go again ::
         if (debug) {fprintf(stderr, "spilling!\n");}
         if (debug) {
             fprintf(stderr, "# before rewrite:\n");
             debug_print_instrs(body_instrs, frame);
         }
 
-        record_spill_liveness(body_instrs, flow, igraph_and_table,
+        record_spill_liveness(body_instrs, flow, live_outs,
                 color_result.racr_spills, label_to_spill_liveness,
                 arena_spill_liveness);
 
-        for (temp_list_t* x = color_result.racr_spills; x; x = x->tmp_list) {
-            spill_temp(arena_instrs, arena_fragments, temp_state,
-                    frame, &body_instrs, x->tmp_temp);
+        spill_temps(arena_instrs, arena_fragments, temp_state, frame,
+                &body_instrs, color_result.racr_spills, &spill_accesses,
+                scratch);
+        for (var x = color_result.racr_spills; x; x = x->tmp_list) {
+            stats.ras_spills++;
         }
+        spilled = color_result.racr_spills;
 
         if (debug) {
             fprintf(stderr, "# rewritten:\n");
             debug_print_instrs(body_instrs, frame);
         }
 
-        Table_free(&color_result.racr_allocation);
-
-        lv_free_interference_and_flow_graph(&igraph_and_table, &flow_and_nodes);
-        Arena_dispose(&scratch);
-        return ra_alloc(out, temp_state, body_instrs, frame, false,
-                label_to_cs_bitmap, label_to_spill_liveness,
-                arena_spill_liveness, arena_instrs, arena_allocation,
-                arena_fragments);
+        st_end(&regalloc_timer);
+        Arena_dispose(&round);
     }
-
-    /* Must happen before removing the dead moves, so that flowgraph
-     * nodes line up with instructions.
-     */
-    compute_cs_ptr_dispo_at_call_sites(frame, body_instrs, flow,
-            igraph_and_table, color_result.racr_allocation, label_to_cs_bitmap);
-
-    remove_dead_moves(color_result.racr_allocation, &body_instrs);
-
-    struct instr_list_and_allocation result = {
-        .ra_instrs = body_instrs,
-        .ra_allocation = color_result.racr_allocation
-    };
-
-    lv_free_interference_and_flow_graph(&igraph_and_table, &flow_and_nodes);
-    Arena_dispose(&scratch);
-
-    return result;
 }
 
 #include "test_harness.h"
@@ -1565,10 +2257,230 @@ test_nodeset()
     Arena_dispose(&ar);
 }
 
+void
+test_worklists()
+{
+    Arena_T ar = Arena_new();
+
+    var g = lv_new_graph(ar);
+    lv_node_t nodes[4];
+    for (int i = 0; i < NELEMS(nodes); i++) {
+        nodes[i] = *lv_new_node(g, ar);
+    }
+    int wl_next[4], wl_prev[4], alias[4];
+    enum worklist_mem worklist[4] = {};
+    reg_alloc_info_t info = {
+        .nodes = nodes,
+        .wl_next = wl_next,
+        .wl_prev = wl_prev,
+        .worklist = worklist,
+        .alias = alias,
+    };
+    for (int i = 0; i < NUM_WORKLISTS; i++) {
+        info.wl_head[i] = -1;
+    }
+
+    for (int i = 0; i < NELEMS(nodes); i++) {
+        worklist_prepend(&info, WL_SIMPLIFY, &nodes[i]);
+    }
+    // The last added is first
+    assert(worklist_first(&info, WL_SIMPLIFY) == &nodes[3]);
+    assert(worklist_length(&info, WL_SIMPLIFY) == 4);
+
+    // Taking from the middle, the front and the back
+    worklist_move(&info, &nodes[2], WL_SIMPLIFY, WL_SELECT);
+    worklist_move(&info, &nodes[3], WL_SIMPLIFY, WL_SELECT);
+    worklist_move(&info, &nodes[0], WL_SIMPLIFY, WL_COALESCED);
+    assert(worklist_first(&info, WL_SIMPLIFY) == &nodes[1]);
+    assert(worklist_next(&info, &nodes[1]) == NULL);
+    assert(worklist_first(&info, WL_SELECT) == &nodes[3]);
+    assert(worklist_next(&info, &nodes[3]) == &nodes[2]);
+    assert(worklist_contains(&info, WL_COALESCED, &nodes[0]));
+    assert(worklist_length(&info, WL_SIMPLIFY) == 1);
+
+    // 0 -> 2 -> 3, and then the path is compressed
+    info.alias[0] = 2;
+    worklist_move(&info, &nodes[2], WL_SELECT, WL_COALESCED);
+    info.alias[2] = 3;
+    assert(lv_eq(get_alias(&info, &nodes[0]), &nodes[3]));
+    assert(info.alias[0] == 3);
+    assert(lv_eq(get_alias(&info, &nodes[1]), &nodes[1]));
+
+    Arena_dispose(&ar);
+}
+
+void
+test_renumber_temps()
+{
+    Arena_T ar = Arena_new();
+    var program_temps = temp_state_new(ar);
+    for (int i = 0; i < 50; i++) {
+        temp_newtemp(program_temps, 8, TEMP_DISP_NOT_PTR); // other functions
+    }
+    var a = temp_newtemp(program_temps, 8, TEMP_DISP_PTR);
+    var b = temp_newtemp(program_temps, 4, TEMP_DISP_NOT_PTR);
+    var temp_state = temp_state_fork(program_temps, ar);
+    var rax = target_x86_64.tgt_ret0;
+    rax.temp_size = 4;
+
+    // b = *a; use a; rax = b. The first two share the list of a.
+    var srcs = temp_list(a, ar);
+    var load = assm_oper("movl (`s0), `d0\n", temp_list(b, ar), srcs, NULL,
+            ar);
+    var use = assm_oper("# `s0\n", NULL, srcs, NULL, ar);
+    var move = assm_move("movl `s0, `d0\n", rax, b, ar);
+    load->ai_list = use;
+    use->ai_list = move;
+
+    renumber_temps(temp_state, load, ar);
+
+    var new_a = load->ai_oper_src->tmp_temp;
+    var new_b = load->ai_oper_dst->tmp_temp;
+    assert(!temp_is_machine(new_b));
+    assert(new_a.temp_id == new_b.temp_id + 1); // dsts come before srcs
+    assert(new_a.temp_id < a.temp_id);
+    assert(new_a.temp_size == 8 && new_a.temp_ptr_dispo == TEMP_DISP_PTR);
+    assert(new_b.temp_size == 4 && new_b.temp_ptr_dispo == TEMP_DISP_NOT_PTR);
+
+    // The shared list is renumbered once, and is itself left alone
+    assert(temp_eq(use->ai_oper_src->tmp_temp, new_a));
+    assert(temp_eq(srcs->tmp_temp, a));
+    assert(temp_eq(move->ai_move_src, new_b));
+    assert(temp_eq(move->ai_move_dst, rax));
+
+    // New temps follow on
+    var c = temp_newtemp(temp_state, 8, TEMP_DISP_NOT_PTR);
+    assert(c.temp_id == new_a.temp_id + 1);
+
+    Arena_dispose(&ar);
+}
+
+void
+test_spill_temps()
+{
+    Arena_T ar = Arena_new();
+    var temp_state = temp_state_new(ar);
+    ac_frame_t frame = {.acf_target = &target_x86_64};
+    frame.ac_frame_vars_end = &frame.ac_frame_vars;
+
+    var c = temp_newtemp(temp_state, 8, TEMP_DISP_NOT_PTR);
+    var x = temp_newtemp(temp_state, 8, TEMP_DISP_NOT_PTR);
+    var y = temp_newtemp(temp_state, 8, TEMP_DISP_NOT_PTR);
+    var z = temp_newtemp(temp_state, 8, TEMP_DISP_NOT_PTR);
+
+    // c = 7; x = *y; z = c + x
+    var def_c = assm_remat("movq $7, `d0\n", temp_list(c, ar), NULL, ar);
+    var def_x = assm_oper("movq (`s0), `d0\n",
+            temp_list(x, ar), temp_list(y, ar), NULL, ar);
+    var def_z = assm_oper("leaq (`s0,`s1), `d0\n", temp_list(z, ar),
+            temp_list_cons(c, temp_list(x, ar), ar), NULL, ar);
+    def_c->ai_list = def_x;
+    def_x->ai_list = def_z;
+
+    assm_instr_t* instrs = def_c;
+    var to_spill = temp_list_cons(c, temp_list(x, ar), ar);
+    spill_accesses_t accesses = {};
+    spill_temps(ar, ar, temp_state, &frame, &instrs, to_spill, &accesses,
+            ar);
+
+    // Only x is given a slot in the frame
+    assert(frame.ac_frame_vars);
+    assert(temp_eq(frame.ac_frame_vars->acf_spilled, x));
+    assert(!frame.ac_frame_vars->acf_list);
+
+    // x = *y; store x; c = 7; load x; z = c + x
+    assm_instr_t* rewritten[5];
+    int n = 0;
+    for (var instr = instrs; instr; instr = instr->ai_list) {
+        assert(n < NELEMS(rewritten));
+        rewritten[n++] = instr;
+    }
+    assert(n == 5);
+    assert(rewritten[0] == def_x);
+    assert(rewritten[4] == def_z);
+    var remat_c = rewritten[2];
+    assert(remat_c->ai_assem == def_c->ai_assem);
+    assert(!remat_c->ai_oper_src);
+    assert(temp_eq(remat_c->ai_oper_dst->tmp_temp,
+                def_z->ai_oper_src->tmp_temp));
+    assert(!temp_eq(def_z->ai_oper_src->tmp_temp, c));
+    assert(temp_eq(rewritten[3]->ai_oper_dst->tmp_temp,
+                def_z->ai_oper_src->tmp_list->tmp_temp));
+
+    Arena_dispose(&ar);
+}
+
+void
+test_share_spill_slots()
+{
+    Arena_T ar = Arena_new();
+    var temp_state = temp_state_new(ar);
+    ac_frame_t frame = {.acf_target = &target_x86_64};
+    frame.ac_frame_vars_end = &frame.ac_frame_vars;
+
+    var p = temp_newtemp(temp_state, 8, TEMP_DISP_NOT_PTR);
+    temp_t t[4];
+    for (int i = 0; i < NELEMS(t); i++) {
+        t[i] = temp_newtemp(temp_state, 8, TEMP_DISP_NOT_PTR);
+    }
+
+    // t0 = *p; t1 = *t0; t2 = *p; t3 = *t2; *p = t1
+    // t1 is live while t2 and t3 are, but t0 is dead by then
+    int srcs[] = {-1, 0, -1, 2};
+    assm_instr_t* instrs = assm_oper("movq `s0, (`s1)\n", NULL,
+            temp_list_cons(t[1], temp_list(p, ar), ar), NULL, ar);
+    for (int i = NELEMS(t) - 1; i >= 0; i--) {
+        var src = (srcs[i] < 0) ? p : t[srcs[i]];
+        var instr = assm_oper("movq (`s0), `d0\n",
+                temp_list(t[i], ar), temp_list(src, ar), NULL, ar);
+        instr->ai_list = instrs;
+        instrs = instr;
+    }
+
+    temp_list_t* to_spill = NULL;
+    for (int i = 0; i < NELEMS(t); i++) {
+        to_spill = temp_list_cons(t[i], to_spill, ar);
+    }
+    spill_accesses_t accesses = {};
+    spill_temps(ar, ar, temp_state, &frame, &instrs, to_spill, &accesses,
+            ar);
+    assert(frame.acf_last_local_offset == -32);
+
+    var flow = instrs2graph(instrs, ar).flowgraph;
+    share_spill_slots(&frame, 0, instrs, flow, &accesses, ar);
+
+    int offsets[4];
+    for (var v = frame.ac_frame_vars; v; v = v->acf_list) {
+        for (int i = 0; i < NELEMS(t); i++) {
+            if (temp_eq(v->acf_spilled, t[i])) {
+                offsets[i] = v->acf_offset;
+            }
+        }
+    }
+    assert(offsets[0] == offsets[1]);
+    assert(offsets[2] == offsets[3]);
+    assert(offsets[1] != offsets[2]);
+    assert(frame.acf_last_local_offset == -16);
+
+    // The loads and stores use the new offsets
+    for (int k = 0; k < accesses.len; k++) {
+        char expected[16];
+        snprintf(expected, sizeof expected, " %d(",
+                accesses.data[k].sa_slot->acf_offset);
+        assert(strstr(accesses.data[k].sa_instr->ai_assem, expected));
+    }
+
+    Arena_dispose(&ar);
+}
+
 static void register_tests() __attribute__((constructor));
 void
 register_tests() {
 
     REGISTER_TEST(test_nodeset);
+    REGISTER_TEST(test_worklists);
+    REGISTER_TEST(test_renumber_temps);
+    REGISTER_TEST(test_spill_temps);
+    REGISTER_TEST(test_share_spill_slots);
 
 }
@@ -6,24 +6,51 @@
 #include "activation.h" // ac_frame_t
 #include "interfaces/table.h"
 
-/* type allocation = Table[temp_t, Frame.register] */
+/* type allocation = temp_map_t, from temp_id to Frame.register */
 
 /**
  * val alloc : Assem.instr list * Frame.frame -> Assem.instr list * allocation
  */
+/*
+ * Counts of the work done by ra_alloc, for --time-passes
+ */
+struct ra_stats {
+    int ras_flow_nodes; // in the final round
+    int ras_interference_nodes; // in the final round
+    int ras_liveness_iterations; // summed over all rounds
+    int ras_rounds; // 1 + the number of rounds of spilling
+    int ras_spills;
+};
+
+/*
+ * How temporaries are assigned registers. Graph colouring gives the better
+ * code; linear scan is quicker on large functions. Auto uses linear scan
+ * only for functions of more than RA_AUTO_LINEAR_THRESHOLD instructions.
+ */
+enum ra_algorithm {
+    RA_GRAPH_COLORING,
+    RA_LINEAR_SCAN,
+    RA_AUTO,
+};
+enum { RA_AUTO_LINEAR_THRESHOLD = 5000 };
+
+const char* ra_algorithm_name(enum ra_algorithm);
+
 struct instr_list_and_allocation {
     assm_instr_t* ra_instrs;
-    Table_T ra_allocation; // temp_t -> register (char*)
+    temp_map_t ra_allocation; // in arena_allocation
+    struct ra_stats ra_stats;
 };
 
 struct instr_list_and_allocation
 ra_alloc(FILE* out, temp_state_t*, assm_instr_t*, ac_frame_t* frame,
+        enum ra_algorithm,
         bool print_interference_and_return,
         Table_T label_to_cs_bitmap, // sl_sym_t -> uint32_t
         Table_T label_to_spill_liveness, // sl_sym_t -> tmp_list_t*
         Arena_T arena_spill_liveness,
         Arena_T arena_instrs,
-        Arena_T arena_allocation, // for the temp_t* s in ra_allocation
+        Arena_T arena_allocation, // for ra_allocation
         Arena_T arena_fragments // for frame variables etc
         );
 
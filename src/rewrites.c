@@ -9,7 +9,7 @@
 #define DL_LIST_IT(it, head) sl_decl_t* it = (head); it; it = it->dl_list
 #define var __auto_type
 
-extern Arena_T ast_arena;
+extern _Thread_local Arena_T ast_arena;
 
 typedef struct rewrite_info_t {
     sl_decl_t* program;
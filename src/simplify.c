@@ -0,0 +1,464 @@
+#include "simplify.h"
+#include <limits.h> /* INT_MIN, INT_MAX */
+#include <stdbool.h> /* bool */
+#include <stdint.h> /* int64_t, uint64_t */
+#include "interfaces/arena.h"
+#include "assertions.h"
+
+#define var __auto_type
+#define Alloc(arena, size) Arena_alloc(arena, size, __FILE__, __LINE__)
+
+/*
+ * The assignments to a temp, in a hash trie keyed by temp_id.
+ */
+typedef struct temp_defs_t {
+    struct temp_defs_t* child[4];
+    int key; // temp_id
+    int num_defs;
+    tree_exp_t* value; // the constant assigned, when there is one def
+} temp_defs_t;
+
+typedef struct simplify_info_t {
+    temp_defs_t* defs;
+    bool counting_defs; // the first pass, which finds the defs
+    bool found_constant; // a temp was found to be constant by this pass
+    Arena_T arena;
+    Arena_T scratch;
+} simplify_info_t;
+
+static tree_exp_t* simplify_exp(simplify_info_t*, tree_exp_t*);
+static tree_stm_t* simplify_stm(simplify_info_t*, tree_stm_t*);
+
+// https://nullprogram.com/blog/2018/07/31/
+static uint32_t temp_id_hash(int temp_id)
+{
+    uint32_t x = temp_id;
+    x ^= x >> 15;
+    x *= 0x2c1b3c6dU;
+    x ^= x >> 12;
+    x *= 0x297a2d39U;
+    x ^= x >> 15;
+    return x;
+}
+
+static temp_defs_t* td_upsert(temp_defs_t** m, int key, Arena_T ar)
+{
+    for (uint32_t h = temp_id_hash(key); *m; h <<= 2) {
+        if (key == (*m)->key) {
+            return *m;
+        }
+        m = &(*m)->child[h>>30];
+    }
+    if (!ar) {
+        return NULL;
+    }
+    *m = Alloc(ar, sizeof **m);
+    (*m)->key = key;
+    return *m;
+}
+
+static tree_stm_t* jump_to(sl_sym_t dst, Arena_T a)
+{
+    sl_sym_t* labels = Alloc(a, 1 * sizeof *labels);
+    labels[0] = dst;
+    return tree_stm_jump(tree_exp_name(dst, a), 1, labels, a);
+}
+
+static bool is_const(const tree_exp_t* e)
+{
+    return e->te_tag == TREE_EXP_CONST;
+}
+
+/*
+ * Whether e could be left out without losing a side-effect. Loads are
+ * kept, since they may fault, and so are divisions.
+ */
+static bool is_pure(const tree_exp_t* e)
+{
+    switch (e->te_tag) {
+        case TREE_EXP_CONST:
+        case TREE_EXP_NAME:
+        case TREE_EXP_TEMP:
+            return true;
+        case TREE_EXP_BINOP:
+            return e->te_binop != TREE_BINOP_DIV
+                && is_pure(e->te_lhs) && is_pure(e->te_rhs);
+        case TREE_EXP_MEM:
+        case TREE_EXP_CALL:
+        case TREE_EXP_ESEQ:
+            return false;
+    }
+}
+
+/*
+ * Whether lhs and rhs are constants we know how the machine will compute
+ * with. Constants narrower than 4 bytes are only folded when they are not
+ * negative, so that it doesn't matter how they are extended.
+ */
+static bool can_fold(const tree_exp_t* lhs, const tree_exp_t* rhs)
+{
+    if (!is_const(lhs) || !is_const(rhs) || lhs->te_size != rhs->te_size) {
+        return false;
+    }
+    switch (lhs->te_size) {
+        case 4:
+        case 8:
+            return true;
+        case 1:
+        case 2:
+            return lhs->te_const >= 0 && rhs->te_const >= 0;
+        default:
+            return false;
+    }
+}
+
+/*
+ * Narrows r, the result of an operation on constants of the given size, to
+ * the value of a CONST. 4 byte results wrap around, as on the machine.
+ */
+static bool narrow_const(int64_t r, size_t size, int* result)
+{
+    switch (size) {
+        case 4:
+            *result = (int32_t)(uint32_t)r;
+            return true;
+        case 8:
+            if (r < INT_MIN || r > INT_MAX) {
+                return false;
+            }
+            *result = r;
+            return true;
+        default:
+            if (r < 0 || r >= (INT64_C(1) << (8 * size - 1))) {
+                return false;
+            }
+            *result = r;
+            return true;
+    }
+}
+
+static uint64_t size_mask(size_t size)
+{
+    return (size <= 4) ? UINT32_MAX : UINT64_MAX;
+}
+
+/*
+ * Computes a op b, for constants of the given size. Returns false when the
+ * result is left to the machine, e.g. division by zero.
+ */
+static bool fold_binop(
+        tree_binop_t op, int64_t a, int64_t b, size_t size, int* result)
+{
+    const int bits = (size <= 4) ? 32 : 64;
+    int64_t r;
+    switch (op) {
+        case TREE_BINOP_PLUS: r = a + b; break;
+        case TREE_BINOP_MINUS: r = a - b; break;
+        case TREE_BINOP_MUL: r = a * b; break;
+        case TREE_BINOP_DIV:
+            // These trap
+            if (b == 0 || (size == 4 && a == INT32_MIN && b == -1)) {
+                return false;
+            }
+            r = a / b;
+            break;
+        case TREE_BINOP_AND: r = a & b; break;
+        case TREE_BINOP_OR: r = a | b; break;
+        case TREE_BINOP_XOR: r = a ^ b; break;
+        case TREE_BINOP_LSHIFT:
+        case TREE_BINOP_RSHIFT:
+        case TREE_BINOP_ARSHIFT:
+            if (b < 0 || b >= bits) {
+                return false;
+            }
+            r = (op == TREE_BINOP_LSHIFT) ? (int64_t)((uint64_t)a << b)
+                : (op == TREE_BINOP_RSHIFT)
+                ? (int64_t)(((uint64_t)a & size_mask(size)) >> b)
+                : a >> b;
+            break;
+    }
+    return narrow_const(r, size, result);
+}
+
+static bool eval_relop(tree_relop_t op, int64_t a, int64_t b, size_t size)
+{
+    uint64_t ua = (uint64_t)a & size_mask(size);
+    uint64_t ub = (uint64_t)b & size_mask(size);
+    switch (op) {
+        case TREE_RELOP_EQ: return a == b;
+        case TREE_RELOP_NE: return a != b;
+        case TREE_RELOP_LT: return a < b;
+        case TREE_RELOP_GT: return a > b;
+        case TREE_RELOP_LE: return a <= b;
+        case TREE_RELOP_GE: return a >= b;
+        case TREE_RELOP_ULT: return ua < ub;
+        case TREE_RELOP_ULE: return ua <= ub;
+        case TREE_RELOP_UGT: return ua > ub;
+        case TREE_RELOP_UGE: return ua >= ub;
+    }
+}
+
+/*
+ * Whether x may stand in for the binop e, when the operation turns out to
+ * do nothing. The garbage collector must see no difference.
+ */
+static bool can_replace(const tree_exp_t* e, const tree_exp_t* x)
+{
+    return x->te_size == e->te_size
+        && tree_dispo_from_type(x->te_type)
+            == tree_dispo_from_type(e->te_type);
+}
+
+/* Simplifies a binop whose operands have already been simplified */
+static tree_exp_t* simplify_binop(simplify_info_t* info, tree_exp_t* e)
+{
+    var ar = info->arena;
+    var op = e->te_binop;
+    int value;
+
+    if (can_fold(e->te_lhs, e->te_rhs)
+            && fold_binop(op, e->te_lhs->te_const, e->te_rhs->te_const,
+                e->te_size, &value)) {
+        return tree_exp_const(value, e->te_size, e->te_type, ar);
+    }
+
+    // Instruction selection expects constants on the right
+    bool is_commutative = op == TREE_BINOP_PLUS || op == TREE_BINOP_MUL
+        || op == TREE_BINOP_AND || op == TREE_BINOP_OR
+        || op == TREE_BINOP_XOR;
+    if (is_commutative && is_const(e->te_lhs) && !is_const(e->te_rhs)) {
+        var tmp = e->te_lhs;
+        e->te_lhs = e->te_rhs;
+        e->te_rhs = tmp;
+    }
+
+    var lhs = e->te_lhs;
+    var rhs = e->te_rhs;
+    if (!is_const(rhs)) {
+        return e;
+    }
+    const int c = rhs->te_const;
+    switch (op) {
+        case TREE_BINOP_PLUS:
+        case TREE_BINOP_MINUS:
+        case TREE_BINOP_OR:
+        case TREE_BINOP_XOR:
+        case TREE_BINOP_LSHIFT:
+        case TREE_BINOP_RSHIFT:
+        case TREE_BINOP_ARSHIFT:
+            if (c == 0 && can_replace(e, lhs)) {
+                return lhs;
+            }
+            break;
+        case TREE_BINOP_MUL:
+        case TREE_BINOP_DIV:
+            if (c == 1 && can_replace(e, lhs)) {
+                return lhs;
+            }
+            if (op == TREE_BINOP_MUL && c == 0 && is_pure(lhs)) {
+                return tree_exp_const(0, e->te_size, e->te_type, ar);
+            }
+            break;
+        case TREE_BINOP_AND:
+            if (c == 0 && is_pure(lhs)) {
+                return tree_exp_const(0, e->te_size, e->te_type, ar);
+            }
+            if (c == -1 && e->te_size >= 4 && can_replace(e, lhs)) {
+                return lhs;
+            }
+            break;
+    }
+
+    // (x + c1) + c2 => x + (c1 + c2)
+    if (op == TREE_BINOP_PLUS && lhs->te_tag == TREE_EXP_BINOP
+            && lhs->te_binop == TREE_BINOP_PLUS
+            && can_fold(lhs->te_rhs, rhs)
+            && fold_binop(TREE_BINOP_PLUS, lhs->te_rhs->te_const, c,
+                rhs->te_size, &value)) {
+        e->te_lhs = lhs->te_lhs;
+        e->te_rhs = tree_exp_const(value, rhs->te_size, rhs->te_type, ar);
+        return simplify_binop(info, e);
+    }
+    return e;
+}
+
+static tree_exp_t* simplify_temp(simplify_info_t* info, tree_exp_t* e)
+{
+    if (info->counting_defs) {
+        return e;
+    }
+    var defs = td_upsert(&info->defs, e->te_temp.temp_id, NULL);
+    if (defs && defs->num_defs == 1 && defs->value
+            && defs->value->te_size == e->te_size) {
+        return tree_exp_const(
+                defs->value->te_const, e->te_size, e->te_type, info->arena);
+    }
+    return e;
+}
+
+/*
+ * Records an assignment to the temp dst. value is the expression assigned,
+ * or NULL if it is not known.
+ */
+static void note_def(
+        simplify_info_t* info, const tree_exp_t* dst, tree_exp_t* value)
+{
+    if (temp_is_machine(dst->te_temp)) {
+        return;
+    }
+    if (value && (!is_const(value) || value->te_size != dst->te_size)) {
+        value = NULL;
+    }
+    if (info->counting_defs) {
+        var defs = td_upsert(&info->defs, dst->te_temp.temp_id, info->scratch);
+        defs->num_defs++;
+        defs->value = value;
+        info->found_constant |= (value != NULL);
+        return;
+    }
+    var defs = td_upsert(&info->defs, dst->te_temp.temp_id, NULL);
+    assert(defs);
+    if (defs->num_defs == 1 && !defs->value && value) {
+        defs->value = value;
+        info->found_constant = true;
+    }
+}
+
+/* Simplifies the destination of a move, which is not itself a use */
+static tree_exp_t* simplify_dst(
+        simplify_info_t* info, tree_exp_t* dst, tree_exp_t* value)
+{
+    switch (dst->te_tag) {
+        case TREE_EXP_TEMP:
+            note_def(info, dst, value);
+            return dst;
+        case TREE_EXP_MEM:
+            dst->te_mem_addr = simplify_exp(info, dst->te_mem_addr);
+            return dst;
+        case TREE_EXP_ESEQ:
+            dst->te_eseq_stm = simplify_stm(info, dst->te_eseq_stm);
+            dst->te_eseq_exp = simplify_dst(info, dst->te_eseq_exp, NULL);
+            return dst;
+        default:
+            return simplify_exp(info, dst);
+    }
+}
+
+static tree_exp_t* simplify_exp(simplify_info_t* info, tree_exp_t* e)
+{
+    switch (e->te_tag) {
+        case TREE_EXP_CONST:
+        case TREE_EXP_NAME:
+            return e;
+        case TREE_EXP_TEMP:
+            return simplify_temp(info, e);
+        case TREE_EXP_BINOP:
+            e->te_lhs = simplify_exp(info, e->te_lhs);
+            e->te_rhs = simplify_exp(info, e->te_rhs);
+            return simplify_binop(info, e);
+        case TREE_EXP_MEM:
+            e->te_mem_addr = simplify_exp(info, e->te_mem_addr);
+            return e;
+        case TREE_EXP_CALL:
+            e->te_func = simplify_exp(info, e->te_func);
+            for (var parg = &e->te_args; *parg; parg = &(*parg)->te_list) {
+                var next = (*parg)->te_list;
+                *parg = simplify_exp(info, *parg);
+                (*parg)->te_list = next;
+            }
+            return e;
+        case TREE_EXP_ESEQ:
+            e->te_eseq_stm = simplify_stm(info, e->te_eseq_stm);
+            e->te_eseq_exp = simplify_exp(info, e->te_eseq_exp);
+            return e;
+    }
+}
+
+static tree_stm_t* simplify_stm(simplify_info_t* info, tree_stm_t* s)
+{
+    switch (s->tst_tag) {
+        case TREE_STM_MOVE:
+            s->tst_move_exp = simplify_exp(info, s->tst_move_exp);
+            s->tst_move_dst =
+                simplify_dst(info, s->tst_move_dst, s->tst_move_exp);
+            return s;
+        case TREE_STM_EXP:
+            s->tst_exp = simplify_exp(info, s->tst_exp);
+            return s;
+        case TREE_STM_JUMP:
+            s->tst_jump_dst = simplify_exp(info, s->tst_jump_dst);
+            return s;
+        case TREE_STM_CJUMP:
+        {
+            var lhs = simplify_exp(info, s->tst_cjump_lhs);
+            var rhs = simplify_exp(info, s->tst_cjump_rhs);
+            if (can_fold(lhs, rhs)) {
+                bool taken = eval_relop(s->tst_cjump_op,
+                        lhs->te_const, rhs->te_const, lhs->te_size);
+                var jump = jump_to(
+                        taken ? s->tst_cjump_true : s->tst_cjump_false,
+                        info->arena);
+                jump->tst_list = s->tst_list;
+                return jump;
+            }
+            s->tst_cjump_lhs = lhs;
+            s->tst_cjump_rhs = rhs;
+            return s;
+        }
+        case TREE_STM_SEQ:
+            s->tst_seq_s1 = simplify_stm(info, s->tst_seq_s1);
+            s->tst_seq_s2 = simplify_stm(info, s->tst_seq_s2);
+            return s;
+        case TREE_STM_LABEL:
+            return s;
+    }
+}
+
+static void simplify_code(simplify_info_t* info, sl_fragment_t* frag)
+{
+    info->defs = NULL;
+    info->counting_defs = true;
+    info->found_constant = false;
+    frag->fr_body = simplify_stm(info, frag->fr_body);
+
+    // Once a temp is replaced by its value, more of the tree may fold, and
+    // so more temps may turn out to be constant
+    info->counting_defs = false;
+    while (info->found_constant) {
+        info->found_constant = false;
+        frag->fr_body = simplify_stm(info, frag->fr_body);
+    }
+}
+
+void simplify_tree(Arena_T arena, sl_fragment_t* fragments)
+{
+    simplify_info_t info = {
+        .arena = arena,
+        .scratch = Arena_new(),
+    };
+
+    for (var frag = fragments; frag; frag = frag->fr_list) {
+        switch (frag->fr_tag) {
+            case FR_CODE:
+                simplify_code(&info, frag);
+                break;
+            case FR_STRING:
+            case FR_FRAME_MAP:
+                continue;
+        }
+        Arena_clear(info.scratch);
+    }
+
+    Arena_dispose(&info.scratch);
+}
+
+void simplify_fragment(Arena_T arena, sl_fragment_t* frag)
+{
+    assert(frag->fr_tag == FR_CODE);
+    simplify_info_t info = {
+        .arena = arena,
+        .scratch = Arena_new(),
+    };
+    simplify_code(&info, frag);
+    Arena_dispose(&info.scratch);
+}
@@ -0,0 +1,19 @@
+#ifndef __SIMPLIFY_H__
+#define __SIMPLIFY_H__
+// vim:ft=c:
+
+#include "fragment.h"
+
+/*
+ * Simplifies the tree of each FR_CODE fragment, between translation and
+ * canonicalisation. Constant subtrees are folded, identities such as x + 0
+ * and x * 1 are applied, conditional jumps on constants become plain jumps
+ * and temps that are only ever assigned a constant are replaced by it.
+ */
+void simplify_tree(Arena_T, sl_fragment_t* fragments);
+
+/* Simplifies a single FR_CODE fragment */
+void simplify_fragment(Arena_T, sl_fragment_t* frag);
+
+
+#endif /* __SIMPLIFY_H__ */
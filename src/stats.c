@@ -0,0 +1,236 @@
+#include "stats.h"
+#include <pthread.h>
+#include <stdlib.h> // atexit, realloc
+#include <sys/resource.h> // getrusage
+#include <time.h> // clock_gettime
+#include "interfaces/arena.h"
+#include "assertions.h"
+
+#define var __auto_type
+
+bool st_enabled = false;
+
+static FILE* st_out;
+static st_format_t st_format;
+static uint64_t st_start_ns;
+
+static const char* pass_names[ST_NUM_PASSES] = {
+    [ST_PASS_PARSE] = "parse",
+    [ST_PASS_SEMANTICS] = "semantics",
+    [ST_PASS_REWRITES] = "rewrites",
+    [ST_PASS_ACTIVATION] = "activation",
+    [ST_PASS_TRANSLATE] = "translate",
+    [ST_PASS_INLINE] = "inline",
+    [ST_PASS_SIMPLIFY] = "simplify",
+    [ST_PASS_CANONICALISE] = "canonicalise",
+    [ST_PASS_CODEGEN] = "codegen",
+    [ST_PASS_LIVENESS] = "liveness",
+    [ST_PASS_REGALLOC] = "regalloc",
+    [ST_PASS_EMIT] = "emit",
+};
+
+static const bool is_per_function_pass[ST_NUM_PASSES] = {
+    [ST_PASS_CODEGEN] = true,
+    [ST_PASS_LIVENESS] = true,
+    [ST_PASS_REGALLOC] = true,
+    [ST_PASS_EMIT] = true,
+};
+
+// Updated atomically
+static struct pass_totals {
+    uint64_t pt_ns;
+    long pt_peak_bytes;
+    long pt_peak_rss;
+    int pt_runs;
+} pass_totals[ST_NUM_PASSES];
+
+static pthread_mutex_t functions_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct {
+    st_func_stats_t* data;
+    int len;
+    int cap;
+} functions;
+
+static uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * The most memory that the process has had resident at any point so far,
+ * in bytes.
+ */
+static long peak_rss_bytes()
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    return usage.ru_maxrss;
+#else
+    return usage.ru_maxrss * 1024L; // Linux and the BSDs count in KiB
+#endif
+}
+
+static void atomic_max(long* p, long x)
+{
+    long current = __atomic_load_n(p, __ATOMIC_RELAXED);
+    while (x > current && !__atomic_compare_exchange_n(
+                p, &current, x, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+static void st_report();
+
+void st_enable(FILE* out, st_format_t format)
+{
+    assert(format == ST_FORMAT_TEXT || format == ST_FORMAT_JSON);
+    st_enabled = true;
+    st_out = out;
+    st_format = format;
+    st_start_ns = now_ns();
+    atexit(st_report);
+}
+
+st_timer_t st_begin(st_pass_t pass)
+{
+    if (!st_enabled) {
+        return (st_timer_t){ .stt_pass = pass };
+    }
+    long start_bytes = 0;
+    if (is_per_function_pass[pass]) {
+        // Other functions may be in their passes on other threads
+        Arena_reset_thread_high_water();
+        start_bytes = Arena_thread_bytes_in_use();
+    } else {
+        Arena_reset_high_water();
+    }
+    return (st_timer_t){
+        .stt_pass = pass,
+        .stt_start_ns = now_ns(),
+        .stt_start_bytes = start_bytes,
+    };
+}
+
+void st_end(st_timer_t* timer)
+{
+    if (!st_enabled) {
+        return;
+    }
+    var totals = &pass_totals[timer->stt_pass];
+    uint64_t elapsed = now_ns() - timer->stt_start_ns;
+    __atomic_add_fetch(&totals->pt_ns, elapsed, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&totals->pt_runs, 1, __ATOMIC_RELAXED);
+
+    long bytes = is_per_function_pass[timer->stt_pass]
+        ? Arena_thread_high_water() - timer->stt_start_bytes
+        : Arena_high_water();
+    atomic_max(&totals->pt_peak_bytes, bytes);
+    atomic_max(&totals->pt_peak_rss, peak_rss_bytes());
+}
+
+void st_record_function(const st_func_stats_t* stats)
+{
+    if (!st_enabled) {
+        return;
+    }
+    pthread_mutex_lock(&functions_lock);
+    if (functions.len == functions.cap) {
+        int new_cap = functions.cap ? 2 * functions.cap : 64;
+        var new_data = realloc(functions.data, new_cap * sizeof *functions.data);
+        if (!new_data) {
+            perror("out of memory");
+            abort();
+        }
+        functions.data = new_data;
+        functions.cap = new_cap;
+    }
+    functions.data[functions.len++] = *stats;
+    pthread_mutex_unlock(&functions_lock);
+}
+
+static double ms(uint64_t ns)
+{
+    return ns / 1e6;
+}
+
+static void st_report_text(FILE* out, uint64_t total_ns)
+{
+    fprintf(out, "===== time passes =====\n");
+    fprintf(out, "%-14s %8s %12s %16s %14s\n",
+            "pass", "runs", "wall (ms)", "peak arena (KiB)",
+            "peak rss (KiB)");
+    for (int i = 0; i < ST_NUM_PASSES; i++) {
+        var totals = &pass_totals[i];
+        if (totals->pt_runs == 0) {
+            continue;
+        }
+        fprintf(out, "%-14s %8d %12.3f %16ld %14ld\n", pass_names[i],
+                totals->pt_runs, ms(totals->pt_ns),
+                totals->pt_peak_bytes / 1024, totals->pt_peak_rss / 1024);
+    }
+    fprintf(out, "%-14s %8s %12.3f %16s %14ld\n", "total", "", ms(total_ns),
+            "", peak_rss_bytes() / 1024);
+
+    if (functions.len == 0) {
+        return;
+    }
+    fprintf(out, "===== functions =====\n");
+    fprintf(out, "%-24s %8s %10s %12s %11s %9s %7s\n",
+            "function", "instrs", "flow nodes", "igraph nodes",
+            "live iters", "ra rounds", "spills");
+    for (int i = 0; i < functions.len; i++) {
+        var f = &functions.data[i];
+        fprintf(out, "%-24s %8d %10d %12d %11d %9d %7d\n",
+                f->stf_name, f->stf_instrs, f->stf_flow_nodes,
+                f->stf_interference_nodes, f->stf_liveness_iterations,
+                f->stf_regalloc_rounds, f->stf_spills);
+    }
+}
+
+static void st_report_json(FILE* out, uint64_t total_ns)
+{
+    fprintf(out, "{\n  \"total_ms\": %.3f,\n  \"peak_rss_bytes\": %ld,\n"
+            "  \"passes\": [", ms(total_ns), peak_rss_bytes());
+    const char* sep = "\n";
+    for (int i = 0; i < ST_NUM_PASSES; i++) {
+        var totals = &pass_totals[i];
+        if (totals->pt_runs == 0) {
+            continue;
+        }
+        fprintf(out, "%s    {\"name\": \"%s\", \"runs\": %d, \"wall_ms\": %.3f, "
+                "\"peak_arena_bytes\": %ld, \"peak_rss_bytes\": %ld}",
+                sep, pass_names[i], totals->pt_runs, ms(totals->pt_ns),
+                totals->pt_peak_bytes, totals->pt_peak_rss);
+        sep = ",\n";
+    }
+    fprintf(out, "\n  ],\n  \"functions\": [");
+    sep = "\n";
+    for (int i = 0; i < functions.len; i++) {
+        var f = &functions.data[i];
+        // function names are identifiers, so need no escaping
+        fprintf(out, "%s    {\"name\": \"%s\", \"instrs\": %d, "
+                "\"flow_nodes\": %d, \"interference_nodes\": %d, "
+                "\"liveness_iterations\": %d, \"regalloc_rounds\": %d, "
+                "\"spills\": %d}", sep,
+                f->stf_name, f->stf_instrs, f->stf_flow_nodes,
+                f->stf_interference_nodes, f->stf_liveness_iterations,
+                f->stf_regalloc_rounds, f->stf_spills);
+        sep = ",\n";
+    }
+    fprintf(out, "\n  ]\n}\n");
+}
+
+static void st_report()
+{
+    uint64_t total_ns = now_ns() - st_start_ns;
+    switch (st_format) {
+        case ST_FORMAT_TEXT: st_report_text(st_out, total_ns); break;
+        case ST_FORMAT_JSON: st_report_json(st_out, total_ns); break;
+    }
+    fflush(st_out);
+    free(functions.data);
+}
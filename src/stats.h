@@ -0,0 +1,82 @@
+#ifndef __STATS_H__
+#define __STATS_H__
+// vim:ft=c:
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "symbols.h" // sl_sym_t
+
+/*
+ * Timing and statistics for --time-passes.
+ *
+ * Timers may be used from multiple threads. The per-function passes
+ * (codegen, liveness, regalloc, emit) are summed over all functions, and
+ * so with -j they may add up to more than the elapsed time.
+ */
+
+typedef enum st_pass {
+    ST_PASS_PARSE,
+    ST_PASS_SEMANTICS,
+    ST_PASS_REWRITES,
+    ST_PASS_ACTIVATION,
+    ST_PASS_TRANSLATE,
+    ST_PASS_INLINE,
+    ST_PASS_SIMPLIFY,
+    ST_PASS_CANONICALISE,
+    ST_PASS_CODEGEN,
+    ST_PASS_LIVENESS,
+    ST_PASS_REGALLOC,
+    ST_PASS_EMIT,
+    ST_NUM_PASSES,
+} st_pass_t;
+
+typedef enum st_format {
+    ST_FORMAT_TEXT = 1,
+    ST_FORMAT_JSON,
+} st_format_t;
+
+typedef struct st_timer {
+    st_pass_t stt_pass;
+    uint64_t stt_start_ns;
+    long stt_start_bytes; // per-function passes only
+} st_timer_t;
+
+/* Counts collected for each function as it passes through the backend */
+typedef struct st_func_stats {
+    sl_sym_t stf_name;
+    int stf_instrs; // after instruction selection
+    int stf_flow_nodes; // in the final round of allocation
+    int stf_interference_nodes; // in the final round of allocation
+    int stf_liveness_iterations; // summed over all rounds
+    int stf_regalloc_rounds; // 1 + the number of rounds of spilling
+    int stf_spills;
+} st_func_stats_t;
+
+extern bool st_enabled;
+
+/*
+ * Turns on collection, and arranges for the report to be written to out
+ * when the program exits.
+ */
+void st_enable(FILE* out, st_format_t format);
+
+/*
+ * A pass is timed by st_begin and st_end. For the whole-program passes,
+ * the peak arena bytes is the high water mark while the pass runs.
+ * For the per-function passes, it is the most that the pass held at once,
+ * beyond what its thread held when it began, for any one function.
+ * The peak RSS of a pass is that of the process by the end of the pass,
+ * so it only grows from one pass to the next and a jump shows the pass
+ * that needed the memory.
+ */
+st_timer_t st_begin(st_pass_t pass);
+void st_end(st_timer_t* timer);
+
+/*
+ * Records the statistics for a function. Functions are reported in the
+ * order they are recorded.
+ */
+void st_record_function(const st_func_stats_t* stats);
+
+#endif /* __STATS_H__ */
@@ -32,8 +32,7 @@ typedef struct target_t {
     const temp_array_t callee_saves;
     const char** register_names;
     const char* (*register_for_size)(const char* regname, size_t size);
-    Table_T // temp_t* -> const char*
-        (*tgt_temp_map)(); // returns table mapping temps to their register names
+    temp_map_t (*tgt_temp_map)(); // the names of the machine registers
 
     struct codegen_t* tgt_backend;
 } target_t;
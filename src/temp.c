@@ -22,6 +22,20 @@ temp_state_t* temp_state_new(Arena_T a)
     return ts;
 }
 
+temp_state_t* temp_state_fork(const temp_state_t* ts, Arena_T a)
+{
+    temp_state_t* fork = Alloc(a, sizeof *fork);
+    fork->next_temp = ts->next_temp;
+    fork->next_label = -1; // labels are not allowed from a fork
+    return fork;
+}
+
+void temp_state_restart(temp_state_t* ts)
+{
+    assert(ts->next_label == -1); // only a fork's temps are its own
+    ts->next_temp = start_temp;
+}
+
 temp_t temp_newtemp(temp_state_t* ts, unsigned size, temp_ptr_disposition_t ptr_dispo)
 {
     assert(size <= 8); // register width on a 64-bit architecture
@@ -51,6 +65,7 @@ void temp_copy(temp_t* dst, const temp_t* src)
 
 sl_sym_t temp_newlabel(temp_state_t* ts)
 {
+    assert(ts->next_label >= 0);
     int label_id = ts->next_label++;
     char str[45];
     snprintf(str, sizeof str, "L%d", label_id); // snprintf null terminates str
@@ -64,6 +79,7 @@ sl_sym_t temp_namedlabel(temp_state_t* ts, const char* name)
 
 sl_sym_t temp_prefixedlabel(temp_state_t* ts, const char* prefix)
 {
+    assert(ts->next_label >= 0);
     int label_id = ts->next_label++;
     char* str = NULL;
     asprintf(&str, "L%s%d", prefix, label_id);
@@ -72,6 +88,21 @@ sl_sym_t temp_prefixedlabel(temp_state_t* ts, const char* prefix)
     return result;
 }
 
+temp_map_t temp_map_new(int len, Arena_T ar)
+{
+    temp_map_t m = {
+        .tm_regs = Alloc(ar, len * sizeof *m.tm_regs),
+        .tm_len = len,
+    };
+    return m;
+}
+
+void temp_map_put(temp_map_t m, temp_t t, const char* reg)
+{
+    assert((unsigned)t.temp_id < (unsigned)m.tm_len);
+    m.tm_regs[t.temp_id] = reg;
+}
+
 temp_list_t* temp_list(temp_t temp, Arena_T ar)
 {
     return temp_list_cons(temp, NULL, ar);
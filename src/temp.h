@@ -26,6 +26,20 @@ typedef struct temp_list {
 } temp_list_t;
 
 temp_state_t* temp_state_new(Arena_T);
+/*
+ * Creates a temp_state that continues numbering temps from where ts is up
+ * to, without advancing ts. This is for the backend of a single function,
+ * which may run concurrently with the backends of other functions. The
+ * temps it creates are only unique within that function. It may not be
+ * used to create labels, since those must be unique across the program.
+ */
+temp_state_t* temp_state_fork(const temp_state_t* ts, Arena_T);
+/*
+ * Numbers the next temps of the fork ts from the first after the machine
+ * registers again. This is for the register allocator, which renumbers the
+ * temps of its function densely, so that they can index arrays.
+ */
+void temp_state_restart(temp_state_t* ts);
 
 temp_t temp_newtemp(temp_state_t* ts, unsigned size, temp_ptr_disposition_t ptr_dispo);
 // Not sure what this is for
@@ -38,6 +52,28 @@ sl_sym_t temp_newlabel(temp_state_t* ts);
 sl_sym_t temp_namedlabel(temp_state_t* ts, const char* name);
 sl_sym_t temp_prefixedlabel(temp_state_t* ts, const char* name);
 
+/*
+ * A map from temps to the names of their registers, indexed by temp_id.
+ * Temps without a register map to NULL. The registers of a target are one
+ * of these, and so is the register allocation of a function.
+ */
+typedef struct temp_map {
+    const char** tm_regs;
+    int tm_len; // one more than the largest temp_id that can have a register
+} temp_map_t;
+
+/* A map, with no registers yet, for the temps with ids less than len */
+temp_map_t temp_map_new(int len, Arena_T);
+
+static inline const char* temp_map_get(temp_map_t m, temp_t t)
+{
+    return ((unsigned)t.temp_id < (unsigned)m.tm_len)
+        ? m.tm_regs[t.temp_id] : NULL;
+}
+
+/* t must be one of the temps that the map was made for */
+void temp_map_put(temp_map_t m, temp_t t, const char* reg);
+
 temp_list_t* temp_list(temp_t temp, Arena_T);
 temp_list_t* temp_list_cons(temp_t hd, temp_list_t* tail, Arena_T);
 temp_list_t* temp_list_concat(temp_list_t* lead, temp_list_t* tail, Arena_T);
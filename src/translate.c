@@ -1,5 +1,6 @@
 #include "translate.h"
 #include <stdbool.h> /* bool */
+#include <stdint.h> /* uintptr_t */
 #include <string.h>
 #include "grammar.tab.h"
 #include "arena_util.h"
@@ -9,16 +10,18 @@
 #define var __auto_type
 #define Alloc(arena, size) Arena_alloc(arena, size, __FILE__, __LINE__)
 
-typedef struct translate_info_t {
+struct translate_info_t {
     const sl_decl_t* program;
     temp_state_t* temp_state;
     sl_sym_t current_loop_end;
     sl_sym_t function_end_label;
     bool is_end_label_used;
     sl_fragment_t* string_fragments;
-    Arena_T ret_arena;
+    translate_types_t* types;
+    Arena_T ret_arena; // for the tree of the current function
+    Arena_T data_arena; // for strings and frame maps, which outlive it
     Arena_T scratch;
-} translate_info_t;
+};
 
 struct translate_exp_t;
 typedef struct translate_exp_t translate_exp_t;
@@ -216,44 +219,70 @@ static label_bifunc_t translate_un_cx(translate_exp_t* ex)
 }
 
 
-static const sl_decl_t* lookup_struct_decl(const sl_decl_t* program, sl_sym_t name)
+/*
+ * A hash trie from a key to the tree type it has been translated to. Struct
+ * types are keyed by their name, and pointer types by their pointee.
+ */
+typedef struct interned_type_t {
+    struct interned_type_t* child[4];
+    const void* key;
+    const sl_decl_t* decl; // for struct types
+    tree_typ_t* type;
+} interned_type_t;
+
+struct translate_types_t {
+    const sl_decl_t* program;
+    interned_type_t* structs;
+    interned_type_t* pointers;
+    Arena_T arena;
+};
+
+// https://nullprogram.com/blog/2018/07/31/
+static uint32_t ptr_hash(const void* p)
 {
-    const sl_decl_t* x;
-    for (x = program; x; x = x->dl_list) {
-        if (x->dl_tag == SL_DECL_STRUCT) {
-            if (x->dl_name == name) {
-                return x;
-            }
+    uint64_t x = (uintptr_t)p;
+    x ^= x >> 32;
+    x *= 0xd6e8feb86659fd93U;
+    x ^= x >> 32;
+    return x;
+}
+
+static interned_type_t*
+it_upsert(interned_type_t** m, const void* key, Arena_T ar)
+{
+    for (uint32_t h = ptr_hash(key); *m; h <<= 2) {
+        if (key == (*m)->key) {
+            return *m;
         }
+        m = &(*m)->child[h>>30];
+    }
+    if (!ar) {
+        return NULL;
     }
-    fprintf(stderr, "type->name = %s\n", name);
-    assert(!"unknown type name");
+    *m = Alloc(ar, sizeof **m);
+    (*m)->key = key;
+    return *m;
 }
 
-struct translated_type {
-    sl_sym_t name;
-    tree_typ_t* type;
-    const struct translated_type *link;
-};
-
-static tree_typ_t* find_translated(
-        sl_sym_t type_name, const struct translated_type *translated)
+translate_types_t*
+translate_types_new(Arena_T arena, const sl_decl_t* program)
 {
-    for (var t = translated; t; t = t->link) {
-        if (t->name == type_name) {
-            return t->type;
+    translate_types_t* types = Alloc(arena, sizeof *types);
+    *types = (translate_types_t){ .program = program, .arena = arena };
+    for (var d = program; d; d = d->dl_list) {
+        if (d->dl_tag == SL_DECL_STRUCT) {
+            it_upsert(&types->structs, d->dl_name, arena)->decl = d;
         }
     }
-    return NULL;
+    return types;
 }
 
-static tree_typ_t*
-translate_type0(
-        Arena_T arena, const sl_decl_t* program,
-        const sl_type_t* type, const struct translated_type *translated)
+tree_typ_t* translate_type(translate_types_t* types, const sl_type_t* type)
 {
+    Arena_T arena = types->arena;
     switch (type->ty_tag) {
         case SL_TYPE_NAME:
+        {
             if (type->ty_name == symbol("int")) {
                 return tree_typ_int(arena);
             }
@@ -264,52 +293,47 @@ translate_type0(
                 return tree_typ_void(arena);
             }
 
+            var interned = it_upsert(&types->structs, type->ty_name, NULL);
+            if (!interned) {
+                fprintf(stderr, "type->name = %s\n", type->ty_name);
+                assert(!"unknown type name");
+            }
+            if (interned->type) {
+                return interned->type;
+            }
             /*
-             * To handle recursive definitions, we first allocate the result
-             * and then pass it along when translating the fields in case it's
-             * there
+             * To handle recursive definitions, the struct is interned
+             * before its fields are translated
              */
-            tree_typ_t* found = find_translated(type->ty_name, translated);
-            if (found) {
-                return found;
+            const sl_decl_t* decl = interned->decl;
+            int num_fields = 0;
+            for (var field = decl->dl_params; field; field = field->dl_list) {
+                num_fields++;
             }
-            tree_typ_t* result = tree_typ_struct(NULL, arena);
-            const struct translated_type already_translated = {
-                .name = type->ty_name,
-                .type = result,
-                .link = translated,
-            };
-
-            const sl_decl_t* decl = lookup_struct_decl(program, type->ty_name);
-            assert(decl->dl_tag == SL_DECL_STRUCT);
-
-            tree_typ_t* fields = NULL;
-            for (const sl_decl_t* field = decl->dl_params; field;
-                    field = field->dl_list) {
-                var translated_field = translate_type0(arena,
-                        program, field->dl_type, &already_translated);
-                fields = tree_typ_append(fields, translated_field);
+            tree_typ_t** fields = (num_fields > 0)
+                ? Alloc(arena, num_fields * sizeof *fields) : NULL;
+            interned->type = tree_typ_struct(fields, num_fields, arena);
+            int i = 0;
+            for (var field = decl->dl_params; field; field = field->dl_list) {
+                fields[i++] = translate_type(types, field->dl_type);
             }
-
-            result->tt_fields = fields;
-            return result;
+            return interned->type;
+        }
         case SL_TYPE_PTR:
-            return tree_typ_ptr(
-                    translate_type0(arena, program, type->ty_pointee, translated),
-                    arena);
+        {
+            var pointee = translate_type(types, type->ty_pointee);
+            var interned = it_upsert(&types->pointers, pointee, arena);
+            if (!interned->type) {
+                interned->type = tree_typ_ptr(pointee, arena);
+            }
+            return interned->type;
+        }
         case SL_TYPE_ARRAY:
         case SL_TYPE_FUNC:
             assert(!"not implemented");
     }
 }
 
-tree_typ_t*
-translate_type(
-        Arena_T arena, const sl_decl_t* program, const sl_type_t* type)
-{
-    return translate_type0(arena, program, type, NULL);
-}
-
 
 /* forward declaration so we can be recursive  */
 static translate_exp_t* translate_expr(
@@ -330,7 +354,7 @@ static tree_exp_t* translate_var_mem_ref_expr(
 
     if (frame_var->acf_tag == ACF_ACCESS_REG) {
         return tree_exp_temp(frame_var->acf_reg, frame_var->acf_size,
-                translate_type(info->ret_arena, info->program, type), arena);
+                translate_type(info->types, type), arena);
     }
     assert(frame_var->acf_tag == ACF_ACCESS_FRAME);
 
@@ -350,7 +374,7 @@ static tree_exp_t* translate_var_mem_ref_expr(
             arena
         ),
         frame_var->acf_size,
-        translate_type(info->ret_arena, info->program, type),
+        translate_type(info->types, type),
         arena
     );
     return result;
@@ -565,12 +589,12 @@ static sl_sym_t label_for_descriptor(
     sl_sym_t descriptor_label = temp_newlabel(info->temp_state);
 
     // move from scratch
-    descriptor = strdup_arena(info->ret_arena, descriptor);
+    descriptor = strdup_arena(info->data_arena, descriptor);
 
     info->string_fragments =
         fr_append(info->string_fragments,
                 sl_string_fragment(
-                    descriptor_label, descriptor, info->ret_arena));
+                    descriptor_label, descriptor, info->data_arena));
     return descriptor_label;
 }
 
@@ -594,13 +618,14 @@ static translate_exp_t* translate_expr_new(
     tree_stm_t* assign = tree_stm_move(
             tree_exp_temp(
                 r, r.temp_size,
-                translate_type(ar, info->program, expr->ex_type), ar),
+                translate_type(info->types, expr->ex_type), ar),
             tree_exp_call(
                 tree_exp_name("sl_alloc_des", ar),
                 arg_exp,
                 ac_word_size,
-                translate_type(ar, info->program, expr->ex_type),
-                ac_calculate_ptr_maps(frame, expr->ex_new_defd_vars, ar),
+                translate_type(info->types, expr->ex_type),
+                ac_calculate_ptr_maps(
+                    frame, expr->ex_new_defd_vars, info->data_arena),
                 ar
             ),
             ar
@@ -623,19 +648,19 @@ static translate_exp_t* translate_expr_new(
                     (offset == 0)
                     ? tree_exp_temp(
                         r, r.temp_size,
-                        translate_type(ar, info->program, expr->ex_type), ar)
+                        translate_type(info->types, expr->ex_type), ar)
                     : tree_exp_binop(
                         TREE_BINOP_PLUS,
                         tree_exp_temp(
                             r, r.temp_size,
-                            translate_type(ar, info->program, expr->ex_type), ar),
+                            translate_type(info->types, expr->ex_type), ar),
                         tree_exp_const(
                             offset, ac_word_size,
                             tree_typ_ptr_diff(ar), ar),
                         ar
                     ),
                     arg_size,
-                    translate_type(ar, info->program, arg->ex_type),
+                    translate_type(info->types, arg->ex_type),
                     ar
                 ),
                 translate_un_ex(info, init_exp),
@@ -653,7 +678,7 @@ static translate_exp_t* translate_expr_new(
             init_seq,
             tree_exp_temp(
                 r, r.temp_size,
-                translate_type(ar, info->program, expr->ex_type), ar),
+                translate_type(info->types, expr->ex_type), ar),
             ar
     );
     return translate_ex(result, info->scratch);
@@ -680,8 +705,8 @@ static translate_exp_t* translate_expr_call(
         tree_exp_name(expr->ex_fn_name, ar),
         translated_args,
         size_of_type(info->program, expr->ex_type),
-        translate_type(ar, info->program, expr->ex_type),
-        ac_calculate_ptr_maps(frame, expr->ex_fn_defd_vars, ar),
+        translate_type(info->types, expr->ex_type),
+        ac_calculate_ptr_maps(frame, expr->ex_fn_defd_vars, info->data_arena),
         ar
     );
     return translate_ex(result, info->scratch);
@@ -799,8 +824,7 @@ static translate_exp_t* translate_expr_deref(
     assert(size > 0);
     assert(size != -1);
     tree_typ_t* type =
-        translate_type(
-                info->ret_arena, info->program, expr->ex_deref_arg->ex_type);
+        translate_type(info->types, expr->ex_deref_arg->ex_type);
 
     tree_exp_t* result = tree_exp_mem(arg, size, type, info->ret_arena);
     return translate_ex(result, info->scratch);
@@ -845,7 +869,7 @@ static translate_exp_t* translate_expr_member(
 
         if (mem->dl_name == expr->ex_member) {
             member_type =
-                translate_type(arena, info->program, mem->dl_type);
+                translate_type(info->types, mem->dl_type);
             break;
         }
 
@@ -938,7 +962,7 @@ static translate_exp_t* translate_expr_if(
 
     size_t cons_sz = size_of_type(info->program, expr->ex_if_cons->ex_type);
     tree_typ_t* cons_ty =
-        translate_type(arena, info->program, expr->ex_if_cons->ex_type);
+        translate_type(info->types, expr->ex_if_cons->ex_type);
     temp_t r = temp_newtemp(info->temp_state, cons_sz, tree_dispo_from_type(cons_ty));
     tree_exp_t* r_exp = tree_exp_temp(r, cons_sz, cons_ty, arena);
 
@@ -1035,18 +1059,55 @@ static tree_stm_t* translate_decl(
     }
 }
 
+translate_info_t*
+translate_begin(
+        Arena_T data_arena, temp_state_t* temp_state,
+        const sl_decl_t* program, translate_types_t* types)
+{
+    translate_info_t* info = Alloc(data_arena, sizeof *info);
+    *info = (translate_info_t){
+        .temp_state = temp_state, .program = program, .types = types,
+        .data_arena = data_arena, .scratch = Arena_new(),
+    };
+    return info;
+}
+
+sl_fragment_t*
+translate_function(
+        translate_info_t* info, const sl_decl_t* decl, ac_frame_t* frame,
+        Arena_T arena)
+{
+    assert(decl->dl_tag == SL_DECL_FUNC);
+    info->ret_arena = arena;
+    var body = translate_decl(info, frame, decl);
+    body = proc_entry_exit_1(arena, info->temp_state, frame, body);
+    var frag = sl_code_fragment(body, frame, arena);
+    info->ret_arena = NULL;
+    Arena_clear(info->scratch);
+    return frag;
+}
+
+sl_fragment_t* translate_strings(const translate_info_t* info)
+{
+    return info->string_fragments;
+}
+
+void translate_end(translate_info_t** pinfo)
+{
+    Arena_dispose(&(*pinfo)->scratch);
+    *pinfo = NULL;
+}
+
 // TODO: change this to return the code and data fragments separately.
 sl_fragment_t*
 translate_program(
         Arena_T arena, temp_state_t* temp_state,
-        const sl_decl_t* program, ac_frame_t* frames)
+        const sl_decl_t* program, translate_types_t* types,
+        ac_frame_t* frames)
 {
     // return some sort of list of functions, with each carrying a reference
     // to the activation record, and to the IR representation
-    translate_info_t info = {
-        .temp_state = temp_state, .program = program, .ret_arena = arena,
-        .scratch = Arena_new(),
-    };
+    var info = translate_begin(arena, temp_state, program, types);
 
     sl_fragment_t* result = NULL;
 
@@ -1055,21 +1116,18 @@ translate_program(
     for (d = program, f = frames; d; d = d->dl_list) {
         assert(f); // d => f
         if (d->dl_tag == SL_DECL_FUNC) {
-            var body = translate_decl(&info, f, d);
-            body = proc_entry_exit_1(arena, temp_state, f, body);
-            var frag = sl_code_fragment(body, f, arena);
+            var frag = translate_function(info, d, f, arena);
             result = fr_append(result, frag);
 
             // the next frame will be for the next function, so iter
             f = f->acf_link;
         }
-        Arena_clear(info.scratch);
     }
     assert(!f);
 
-    result = fr_append(result, info.string_fragments);
+    result = fr_append(result, translate_strings(info));
 
-    Arena_dispose(&info.scratch);
+    translate_end(&info);
 
     return result;
 }
@@ -6,6 +6,14 @@
 #include "activation.h" /* ac_frame_t */
 #include "fragment.h" /* sl_fragment_t */
 
+/*
+ * The tree types of a program's types. Each distinct type is translated
+ * once and then shared, so that tree types can be compared by pointer.
+ */
+typedef struct translate_types_t translate_types_t;
+
+translate_types_t* translate_types_new(Arena_T, const sl_decl_t* program);
+
 /*
  * translate a program in our ast into the tree language IR
  *
@@ -14,11 +22,37 @@
  */
 sl_fragment_t* translate_program(
         Arena_T, temp_state_t* temp_state,
-        const sl_decl_t* program, ac_frame_t* frames);
+        const sl_decl_t* program, translate_types_t* types,
+        ac_frame_t* frames);
+
+/*
+ * For translating one function at a time, rather than the whole program,
+ * so that the tree of each function can be freed once it has been
+ * compiled. Strings and frame maps are allocated in data_arena, since
+ * they are needed until the data segment is emitted.
+ */
+typedef struct translate_info_t translate_info_t;
+
+translate_info_t* translate_begin(
+        Arena_T data_arena, temp_state_t* temp_state,
+        const sl_decl_t* program, translate_types_t* types);
+
+/* Returns the FR_CODE fragment for decl, allocated in arena */
+sl_fragment_t* translate_function(
+        translate_info_t*, const sl_decl_t* decl, ac_frame_t* frame,
+        Arena_T arena);
+
+/*
+ * The string fragments for the functions translated so far. New strings
+ * are appended to the end of the list.
+ */
+sl_fragment_t* translate_strings(const translate_info_t*);
+
+void translate_end(translate_info_t**);
 
 /*
  * convert a structlang type into a tree language type
  */
-tree_typ_t* translate_type(Arena_T, const sl_decl_t* program, const sl_type_t* type);
+tree_typ_t* translate_type(translate_types_t*, const sl_type_t* type);
 
 #endif /* __TRANSLATE_H__ */
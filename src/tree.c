@@ -19,32 +19,36 @@ static tree_typ_t* tree_typ_new(int tag, Arena_T a)
     return t;
 }
 
-/*
 static tree_typ_t base_types[] = {
     { .tt_tag = TREE_TYPE_INT },
     { .tt_tag = TREE_TYPE_BOOL },
     { .tt_tag = TREE_TYPE_VOID },
     { .tt_tag = TREE_TYPE_PTR_DIFF },
 };
-*/
+static tree_typ_t ptr_to_void = {
+    .tt_tag = TREE_TYPE_PTR, .tt_pointee = &base_types[2],
+};
 
 tree_typ_t* tree_typ_int(Arena_T a)
 {
-    return tree_typ_new(TREE_TYPE_INT, a);
+    return &base_types[0];
 }
 
 tree_typ_t* tree_typ_bool(Arena_T a)
 {
-    return tree_typ_new(TREE_TYPE_BOOL, a);
+    return &base_types[1];
 }
 
 tree_typ_t* tree_typ_void(Arena_T a)
 {
-    return tree_typ_new(TREE_TYPE_VOID, a);
+    return &base_types[2];
 }
 
 tree_typ_t* tree_typ_ptr(tree_typ_t* pointee, Arena_T a)
 {
+    if (pointee == &base_types[2]) {
+        return &ptr_to_void;
+    }
     var t = tree_typ_new(TREE_TYPE_PTR, a);
     t->tt_pointee = pointee;
     return t;
@@ -52,25 +56,17 @@ tree_typ_t* tree_typ_ptr(tree_typ_t* pointee, Arena_T a)
 
 tree_typ_t* tree_typ_ptr_diff(Arena_T a)
 {
-    return tree_typ_new(TREE_TYPE_PTR_DIFF, a);
+    return &base_types[3];
 }
 
-tree_typ_t* tree_typ_struct(tree_typ_t* fields, Arena_T a)
+tree_typ_t* tree_typ_struct(tree_typ_t** fields, int num_fields, Arena_T a)
 {
     var t = tree_typ_new(TREE_TYPE_STRUCT, a);
     t->tt_fields = fields;
+    t->tt_num_fields = num_fields;
     return t;
 }
 
-tree_typ_t* tree_typ_append(tree_typ_t* hd, tree_typ_t* to_append)
-{
-    tree_typ_t** p = &hd;
-    while (*p)
-        p = &(*p)->tt_list;
-    *p = to_append;
-    return hd;
-}
-
 
 static exp tree_exp_new(int tag, Arena_T a)
 {
@@ -27,9 +27,11 @@ struct tree_typ_t {
     } tt_tag;
     union {
         tree_typ_t* tt_pointee; // TREE_TYPE_PTR
-        tree_typ_t* tt_fields; // TREE_TYPE_STRUCT
+        struct {
+            tree_typ_t** tt_fields; // TREE_TYPE_STRUCT
+            int tt_num_fields;
+        };
     };
-    tree_typ_t* tt_list; /* used to link struct fields */
 };
 
 enum tree_binop_t {
@@ -135,14 +137,17 @@ struct tree_stm_t {
     tree_stm_t* tst_list;
 };
 
-
+/*
+ * The base types, and pointers to void, are shared and must not be
+ * modified. Other types are shared by translate_type, so once built they
+ * should be treated as immutable, and may be compared by pointer.
+ */
 tree_typ_t* tree_typ_int(Arena_T);
 tree_typ_t* tree_typ_bool(Arena_T);
 tree_typ_t* tree_typ_void(Arena_T);
 tree_typ_t* tree_typ_ptr(tree_typ_t* pointee, Arena_T);
 tree_typ_t* tree_typ_ptr_diff(Arena_T);
-tree_typ_t* tree_typ_struct(tree_typ_t* fields /* list */, Arena_T);
-tree_typ_t* tree_typ_append(tree_typ_t* hd, tree_typ_t* to_append);
+tree_typ_t* tree_typ_struct(tree_typ_t** fields, int num_fields, Arena_T);
 
 /* the integer constant _value_ */
 tree_exp_t* tree_exp_const(int value, size_t size, tree_typ_t* type, Arena_T);
@@ -0,0 +1,181 @@
+#include "worker_pool.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h> // perror
+#include <stdlib.h> // realloc, abort
+#include "mem.h" // xmalloc
+#include "assertions.h"
+
+#define var __auto_type
+
+struct worker_pool {
+    pthread_mutex_t lock;
+    pthread_cond_t task_available; // signalled on submit and on dispose
+    pthread_cond_t task_done;
+    wp_task_func_t run_task;
+
+    // Indexed by ticket
+    struct wp_task {
+        void* task;
+        bool done;
+    } *tasks;
+    int num_tasks; // the number submitted
+    int cap_tasks;
+    int next_task; // the next task to be picked up by a worker
+    bool stopping;
+
+    int num_workers;
+    struct wp_worker {
+        worker_pool_t* pool;
+        int idx;
+        pthread_t thread;
+    } workers[];
+};
+
+static void* worker_main(void* arg)
+{
+    struct wp_worker* worker = arg;
+    var pool = worker->pool;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (pool->next_task == pool->num_tasks && !pool->stopping) {
+            pthread_cond_wait(&pool->task_available, &pool->lock);
+        }
+        if (pool->next_task == pool->num_tasks) {
+            // stopping, and there is nothing left to do
+            break;
+        }
+        int ticket = pool->next_task++;
+        void* task = pool->tasks[ticket].task;
+        pthread_mutex_unlock(&pool->lock);
+
+        pool->run_task(task, worker->idx);
+
+        pthread_mutex_lock(&pool->lock);
+        pool->tasks[ticket].done = true;
+        pthread_cond_broadcast(&pool->task_done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+worker_pool_t* wp_new(int num_workers, wp_task_func_t run_task)
+{
+    assert(num_workers > 0);
+    assert(run_task);
+
+    worker_pool_t* pool =
+        xmalloc(sizeof *pool + num_workers * sizeof pool->workers[0]);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->task_available, NULL);
+    pthread_cond_init(&pool->task_done, NULL);
+    pool->run_task = run_task;
+    pool->num_workers = num_workers;
+
+    for (int i = 0; i < num_workers; i++) {
+        var worker = &pool->workers[i];
+        worker->pool = pool;
+        worker->idx = i;
+        int err = pthread_create(&worker->thread, NULL, worker_main, worker);
+        if (err) {
+            fprintf(stderr, "pthread_create: error %d\n", err);
+            abort();
+        }
+    }
+    return pool;
+}
+
+int wp_submit(worker_pool_t* pool, void* task)
+{
+    pthread_mutex_lock(&pool->lock);
+    assert(!pool->stopping);
+    if (pool->num_tasks == pool->cap_tasks) {
+        int new_cap = pool->cap_tasks ? 2 * pool->cap_tasks : 64;
+        var new_tasks = realloc(pool->tasks, new_cap * sizeof *pool->tasks);
+        if (!new_tasks) {
+            perror("out of memory");
+            abort();
+        }
+        pool->tasks = new_tasks;
+        pool->cap_tasks = new_cap;
+    }
+    int ticket = pool->num_tasks++;
+    pool->tasks[ticket] = (struct wp_task){ .task = task };
+    pthread_cond_signal(&pool->task_available);
+    pthread_mutex_unlock(&pool->lock);
+    return ticket;
+}
+
+void wp_wait(worker_pool_t* pool, int ticket)
+{
+    pthread_mutex_lock(&pool->lock);
+    assert(ticket >= 0 && ticket < pool->num_tasks);
+    while (!pool->tasks[ticket].done) {
+        pthread_cond_wait(&pool->task_done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void wp_dispose(worker_pool_t** ppool)
+{
+    assert(ppool && *ppool);
+    var pool = *ppool;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->task_available);
+    pthread_mutex_unlock(&pool->lock);
+
+    // The workers drain the queue before they exit
+    for (int i = 0; i < pool->num_workers; i++) {
+        pthread_join(pool->workers[i].thread, NULL);
+    }
+
+    pthread_cond_destroy(&pool->task_done);
+    pthread_cond_destroy(&pool->task_available);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->tasks);
+    free(pool);
+    *ppool = NULL;
+}
+
+
+#include "test_harness.h"
+
+static void test_task(void* task, int worker_idx)
+{
+    int* x = task;
+    *x = *x * 2;
+}
+
+void test_worker_pool()
+{
+    enum { N = 100 };
+    int xs[N];
+    for (int i = 0; i < N; i++) {
+        xs[i] = i;
+    }
+
+    var pool = wp_new(4, test_task);
+    for (int i = 0; i < N; i++) {
+        int ticket = wp_submit(pool, &xs[i]);
+        assert(ticket == i);
+    }
+    wp_wait(pool, N / 2);
+    assert(xs[N / 2] == N);
+
+    wp_dispose(&pool);
+    assert(pool == NULL);
+    for (int i = 0; i < N; i++) {
+        assert(xs[i] == 2 * i);
+    }
+}
+
+static void register_tests() __attribute__((constructor));
+void
+register_tests() {
+
+    REGISTER_TEST(test_worker_pool);
+
+}
@@ -0,0 +1,39 @@
+#ifndef __WORKER_POOL_H__
+#define __WORKER_POOL_H__
+// vim:ft=c:
+
+/*
+ * A fixed size pool of threads that runs tasks in the order that they
+ * were submitted, though of course possibly concurrently with one another.
+ * The submitter can wait for any task to complete using the ticket that
+ * was returned when it was submitted.
+ */
+typedef struct worker_pool worker_pool_t;
+
+/*
+ * Runs a single task. worker_idx is in the range [0, num_workers) and
+ * identifies the thread that is running the task, so that the task may
+ * make use of per-worker resources, e.g. arenas, without locking.
+ */
+typedef void (*wp_task_func_t)(void* task, int worker_idx);
+
+worker_pool_t* wp_new(int num_workers, wp_task_func_t run_task);
+
+/*
+ * Queues task to be run. Returns a ticket for use with wp_wait.
+ * Tickets are handed out in sequence, starting at 0.
+ */
+int wp_submit(worker_pool_t* pool, void* task);
+
+/*
+ * Blocks until the task with the given ticket has completed.
+ */
+void wp_wait(worker_pool_t* pool, int ticket);
+
+/*
+ * Waits for all submitted tasks to complete, stops the threads and frees
+ * the pool. *ppool is set to NULL.
+ */
+void wp_dispose(worker_pool_t** ppool);
+
+#endif /* __WORKER_POOL_H__ */
@@ -0,0 +1,144 @@
+#include "writer.h"
+#include <stdbool.h>
+#include <stdlib.h> // realloc, free, abort
+#include "assertions.h"
+
+void wr_init(writer_t* w, FILE* file)
+{
+    assert(w);
+    *w = (writer_t){ .wr_file = file };
+}
+
+void wr_flush(writer_t* w)
+{
+    if (w->wr_file && w->wr_len > 0) {
+        if (!w->wr_error) {
+            size_t written = fwrite(w->wr_buf, 1, w->wr_len, w->wr_file);
+            w->wr_error = written != w->wr_len;
+        }
+        w->wr_len = 0;
+    }
+}
+
+void wr_dispose(writer_t* w)
+{
+    wr_flush(w);
+    free(w->wr_buf);
+    *w = (writer_t){};
+}
+
+void wr_reserve(writer_t* w, size_t n)
+{
+    if (w->wr_len + n <= w->wr_cap) {
+        return;
+    }
+    // When writing to a file, we keep to one chunk unless a single write
+    // is bigger than that.
+    wr_flush(w);
+    if (w->wr_len + n <= w->wr_cap) {
+        return;
+    }
+    size_t new_cap = w->wr_cap ? 2 * w->wr_cap : WR_CHUNK_SIZE;
+    while (new_cap < w->wr_len + n) {
+        new_cap *= 2;
+    }
+    char* new_buf = realloc(w->wr_buf, new_cap);
+    if (!new_buf) {
+        perror("out of memory");
+        abort();
+    }
+    w->wr_buf = new_buf;
+    w->wr_cap = new_cap;
+}
+
+void wr_put_int(writer_t* w, long x)
+{
+    char digits[24];
+    char* end = digits + sizeof digits;
+    char* d = end;
+    // work with negatives so that LONG_MIN does not overflow
+    bool negative = x < 0;
+    if (!negative) {
+        x = -x;
+    }
+    do {
+        *--d = '0' - (x % 10);
+        x /= 10;
+    } while (x != 0);
+    if (negative) {
+        *--d = '-';
+    }
+    wr_write(w, d, end - d);
+}
+
+
+#include <limits.h>
+#include "test_harness.h"
+
+void test_writer()
+{
+    writer_t w;
+    wr_init(&w, NULL);
+    wr_puts(&w, "\tmov ");
+    wr_put_int(&w, 0);
+    wr_putc(&w, ',');
+    wr_put_int(&w, -45);
+    wr_putc(&w, ',');
+    wr_put_int(&w, LONG_MIN);
+    wr_putc(&w, ',');
+    wr_put_int(&w, LONG_MAX);
+    wr_putc(&w, '\n');
+    const char* expected =
+        "\tmov 0,-45,-9223372036854775808,9223372036854775807\n";
+    assert(w.wr_len == strlen(expected));
+    assert(memcmp(w.wr_buf, expected, w.wr_len) == 0);
+
+    // without a file, everything is kept
+    for (int i = 0; i < WR_CHUNK_SIZE; i++) {
+        wr_putc(&w, 'x');
+    }
+    assert(w.wr_len == strlen(expected) + WR_CHUNK_SIZE);
+    wr_dispose(&w);
+    assert(w.wr_buf == NULL);
+
+    // with a file, it's written out in chunks
+    char* out_buf = NULL;
+    size_t out_len = 0;
+    FILE* out = open_memstream(&out_buf, &out_len);
+    assert(out);
+    wr_init(&w, out);
+    char line[200];
+    memset(line, 'y', sizeof line);
+    for (int i = 0; i < 1000; i++) {
+        wr_write(&w, line, sizeof line);
+    }
+    assert(w.wr_cap == WR_CHUNK_SIZE);
+    wr_dispose(&w);
+    fclose(out);
+    assert(out_len == 1000 * sizeof line);
+    free(out_buf);
+
+    // a failed write is remembered, and what follows it is dropped
+    char in_buf[] = "read only";
+    FILE* in = fmemopen(in_buf, sizeof in_buf, "r");
+    assert(in);
+    wr_init(&w, in);
+    wr_puts(&w, "lost");
+    wr_flush(&w);
+    assert(w.wr_error);
+    assert(w.wr_len == 0);
+    wr_puts(&w, "also lost");
+    wr_flush(&w);
+    assert(w.wr_error);
+    assert(w.wr_len == 0);
+    wr_dispose(&w);
+    fclose(in);
+}
+
+static void register_tests() __attribute__((constructor));
+void
+register_tests() {
+
+    REGISTER_TEST(test_writer);
+
+}
@@ -0,0 +1,68 @@
+#ifndef __WRITER_H__
+#define __WRITER_H__
+// vim:ft=c:
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h> // memcpy, strlen
+
+/*
+ * A buffered writer for emitting assembly. Text is appended directly into
+ * a large buffer which is written to the file in big chunks, rather than
+ * going through printf for each piece.
+ *
+ * If there is no file, the buffer grows to hold everything that is
+ * written, and the text can be taken from wr_buf.
+ *
+ * If a write to the file fails, wr_error is set and anything written
+ * after that is dropped. Check it before wr_dispose, which clears it.
+ */
+typedef struct writer {
+    FILE* wr_file;
+    char* wr_buf;
+    size_t wr_len;
+    size_t wr_cap;
+    bool wr_error;
+} writer_t;
+
+enum { WR_CHUNK_SIZE = 64 * 1024 };
+
+/* file may be NULL */
+void wr_init(writer_t* w, FILE* file);
+
+/* Writes out anything buffered to the file, if there is one. */
+void wr_flush(writer_t* w);
+
+/* Flushes and then frees the buffer. */
+void wr_dispose(writer_t* w);
+
+/* Makes room for n more bytes. */
+void wr_reserve(writer_t* w, size_t n);
+
+static inline void wr_write(writer_t* w, const char* s, size_t n)
+{
+    if (__builtin_expect(w->wr_len + n > w->wr_cap, 0)) {
+        wr_reserve(w, n);
+    }
+    memcpy(w->wr_buf + w->wr_len, s, n);
+    w->wr_len += n;
+}
+
+static inline void wr_puts(writer_t* w, const char* s)
+{
+    wr_write(w, s, strlen(s));
+}
+
+static inline void wr_putc(writer_t* w, char c)
+{
+    if (__builtin_expect(w->wr_len + 1 > w->wr_cap, 0)) {
+        wr_reserve(w, 1);
+    }
+    w->wr_buf[w->wr_len++] = c;
+}
+
+/* Writes a decimal integer */
+void wr_put_int(writer_t* w, long x);
+
+#endif /* __WRITER_H__ */
@@ -29,6 +29,8 @@ typedef struct codegen_state_t {
  */
 #define Assm_oper(s, dst, src, jmp) \
     assm_oper(s, dst, src, jmp, state.ret_arena)
+#define Assm_remat(s, dst, src) \
+    assm_remat(s, dst, src, state.ret_arena)
 #define Assm_label(s, lbl) \
     assm_label(s, lbl, state.ret_arena)
 #define Assm_move(s, dst, src) \
@@ -207,8 +209,9 @@ static assm_instr_t*
 x86_64_load_temp(struct ac_frame_var* v, temp_t temp, Arena_T ar)
 {
     char* s = NULL;
+    // The slot is a word, but the register is only as wide as the temp
     asprintf_arena(ar, &s, "mov%s %d(`s0), `d0	# unspill\n",
-            suff_from_size(v->acf_size), v->acf_offset);
+            suff_from_size(temp.temp_size), v->acf_offset);
     var src_list = temp_list(FP, ar);
     return assm_oper(s, temp_list(temp, ar), src_list, NULL, ar);
 }
@@ -218,7 +221,7 @@ x86_64_store_temp(struct ac_frame_var* v, temp_t temp, Arena_T ar)
 {
     char* s = NULL;
     asprintf_arena(ar, &s, "mov%s `s1, %d(`s0)	# spill\n",
-            suff_from_size(v->acf_size), v->acf_offset);
+            suff_from_size(temp.temp_size), v->acf_offset);
     var src_list =
         temp_list_cons(FP,
                 temp_list(temp, ar), ar);
@@ -230,6 +233,20 @@ x86_64_store_temp(struct ac_frame_var* v, temp_t temp, Arena_T ar)
             ar);
 }
 
+/*
+ * Constants, label addresses and frame addresses, as munched by munch_exp,
+ * can be computed again wherever they are needed instead of being spilled.
+ */
+static assm_instr_t*
+x86_64_rematerialise(const assm_instr_t* def, temp_t temp, Arena_T ar)
+{
+    if (def->ai_tag != ASSM_INSTR_OPER || !def->ai_oper_remat) {
+        return NULL;
+    }
+    var src_list = def->ai_oper_src ? temp_list(FP, ar) : NULL;
+    return assm_remat(def->ai_assem, temp_list(temp, ar), src_list, ar);
+}
+
 /*
  * Used mostly for working out the total size required when considering
  * the alignment requirements of adjacent stored data.
@@ -389,6 +406,19 @@ static temp_t munch_exp(codegen_state_t state, tree_exp_t* exp)
             switch (exp->te_binop) {
                 case TREE_BINOP_PLUS:
                 {
+                    // BINOP(+, TEMP fp, CONST)
+                    if (exp->te_lhs->te_tag == TREE_EXP_TEMP
+                            && exp->te_lhs->te_temp.temp_id == FP.temp_id
+                            && exp->te_rhs->te_tag == TREE_EXP_CONST
+                            && exp->te_size == word_size) {
+                        temp_t r = new_temp_for_exp(state.temp_state, exp);
+                        char* s = NULL;
+                        Asprintf(&s, "leaq %d(`s0), `d0\n",
+                                exp->te_rhs->te_const);
+                        emit(state,
+                            Assm_remat(s, temp_list(r), temp_list(FP)));
+                        return r;
+                    }
                     // BINOP(+, e1, CONST)
                     if (exp->te_rhs->te_tag == TREE_EXP_CONST) {
                         temp_t r = new_temp_for_exp(state.temp_state, exp);
@@ -475,8 +505,8 @@ static temp_t munch_exp(codegen_state_t state, tree_exp_t* exp)
                     // rax <- rdx:rax / t0
                     // rdx <- rdx:rax mod t0
                     //
-                    // so need to clear rdx, put rax as both src and dest
-                    // and put rax, rdx and t0 in src list
+                    // so need to sign extend rax into rdx, put rax as both
+                    // src and dest and put rax, rdx and t0 in src list
 
                     temp_t rhs = Munch_exp(exp->te_rhs);
 
@@ -490,9 +520,10 @@ static temp_t munch_exp(codegen_state_t state, tree_exp_t* exp)
                     // There must be no munch between the following two
                     // instructions
                     temp_t rdx = special_regs[1];
-                    Asprintf(&s, "xorq `s0, `d0\n");
+                    Asprintf(&s, "%s\n", (exp->te_size == 8) ? "cqto"
+                            : (exp->te_size == 4) ? "cltd" : "cwtd");
                     emit(state,
-                         Assm_oper(s, temp_list(rdx), temp_list(rdx), NULL));
+                         Assm_oper(s, temp_list(rdx), temp_list(rax), NULL));
 
                     Asprintf(&s, "idiv%s `s0\n", suff(exp));
                     // r has to be in both sources and destinations
@@ -581,7 +612,7 @@ static temp_t munch_exp(codegen_state_t state, tree_exp_t* exp)
             temp_t r = new_temp_for_exp(state.temp_state, exp);
             char* s = NULL;
             Asprintf(&s, "mov%s $%d, `d0\n", suff(exp), exp->te_const);
-            emit(state, Assm_oper(s, temp_list(r), NULL, NULL));
+            emit(state, Assm_remat(s, temp_list(r), NULL));
             return r;
         }
         case TREE_EXP_TEMP:
@@ -595,7 +626,7 @@ static temp_t munch_exp(codegen_state_t state, tree_exp_t* exp)
             temp_t r = new_temp_for_exp(state.temp_state, exp);
             char* s = NULL;
             Asprintf(&s, "leaq	%s(%%rip), `d0\n", exp->te_name);
-            emit(state, Assm_oper(s, temp_list(r), NULL, NULL));
+            emit(state, Assm_remat(s, temp_list(r), NULL));
             return r;
         }
         case TREE_EXP_CALL:
@@ -770,7 +801,7 @@ static void munch_stm(codegen_state_t state, tree_stm_t* stm)
                     char* s = NULL;
                     Asprintf(&s, "mov%s $%d, `d0\n", suff(src), src->te_const);
                     emit(state,
-                         Assm_oper(s, temp_list(dst->te_temp), NULL, NULL));
+                         Assm_remat(s, temp_list(dst->te_temp), NULL));
                 }
                 // MOVE(TEMP t, TEMP t) -- this is covered by the munch
                 // MOVE(TEMP t, e1)
@@ -1150,11 +1181,12 @@ static codegen_t x86_64_codegen_module = {
     .proc_entry_exit_3 = x86_64_proc_entry_exit_3,
     .load_temp = x86_64_load_temp,
     .store_temp = x86_64_store_temp,
+    .rematerialise = x86_64_rematerialise,
     .emit_text_segment_header = emit_text_segment_header,
     .emit_data_segment = emit_data_segment,
 };
 
-static Table_T x86_64_temp_map();
+static temp_map_t x86_64_temp_map();
 
 const target_t target_x86_64 = {
     .word_size = 8,
@@ -1178,32 +1210,12 @@ const target_t target_x86_64 = {
 };
 static_assert(NELEMS(callee_saves) <= TARGET_CS_COUNT_MAX, "callee save count");
 
-/*
- * These are used when we have Tables with temp_t's as keys
- */
-static int cmptemp(const void* x, const void* y)
-{
-    const temp_t* xx = x;
-    const temp_t* yy = y;
-    return xx->temp_id - yy->temp_id;
-}
-static unsigned hashtemp(const void* key)
+static temp_map_t x86_64_temp_map()
 {
-    const temp_t* k = key;
-    return k->temp_id;
-}
-
-static Table_T x86_64_temp_map()
-{
-    static Table_T result = NULL;
-    if (result)
-        return result;
-
-    result = Table_new(0, cmptemp, hashtemp);
-    for (int i = 0; i < NELEMS(x86_64_registers); i++) {
-        Table_put(result,
-                &(x86_64_temp_map_temps[i]),
-                (void*)x86_64_registers[i]);
-    }
+    // The machine registers are temps 0 to 15, in order
+    temp_map_t result = {
+        .tm_regs = x86_64_registers,
+        .tm_len = NELEMS(x86_64_registers),
+    };
     return result;
 }